@@ -8,6 +8,10 @@
 #include "websocket_protocol.h"
 #include "assets/lang_config.h"
 #include "mcp_server.h"
+#include "settings.h"
+#include "server_config.h"
+#include "metrics.h"
+#include "trace_recorder.h"
 
 #include <cstring>
 #include <esp_log.h>
@@ -15,6 +19,7 @@
 #include <driver/gpio.h>
 #include <arpa/inet.h>
 #include <font_awesome.h>
+#include <esp_app_desc.h>
 
 #define TAG "Application"
 
@@ -68,16 +73,23 @@ Application::~Application() {
     vEventGroupDelete(event_group_);
 }
 
-void Application::CheckNewVersion(Ota& ota) {
+/*
+ * In background mode the protocol was already started with the server config saved by the
+ * last check, so the device stays usable: no activating state or alerts while checking,
+ * and an upgrade waits until the device is idle.
+ */
+void Application::CheckNewVersion(Ota& ota, bool background) {
     const int MAX_RETRY = 10;
     int retry_count = 0;
     int retry_delay = 10; // 初始重试延迟为10秒
 
     auto& board = Board::GetInstance();
     while (true) {
-        SetDeviceState(kDeviceStateActivating);
         auto display = board.GetDisplay();
-        display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
+        if (!background) {
+            SetDeviceState(kDeviceStateActivating);
+            display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
+        }
 
         if (!ota.CheckVersion()) {
             retry_count++;
@@ -86,14 +98,16 @@ void Application::CheckNewVersion(Ota& ota) {
                 return;
             }
 
-            char buffer[256];
-            snprintf(buffer, sizeof(buffer), Lang::Strings::CHECK_NEW_VERSION_FAILED, retry_delay, ota.GetCheckVersionUrl().c_str());
-            Alert(Lang::Strings::ERROR, buffer, "cloud_slash", Lang::Sounds::OGG_EXCLAMATION);
+            if (!background) {
+                char buffer[256];
+                snprintf(buffer, sizeof(buffer), Lang::Strings::CHECK_NEW_VERSION_FAILED, retry_delay, ota.GetCheckVersionUrl().c_str());
+                Alert(Lang::Strings::ERROR, buffer, "cloud_slash", Lang::Sounds::OGG_EXCLAMATION);
+            }
 
             ESP_LOGW(TAG, "Check new version failed, retry in %d seconds (%d/%d)", retry_delay, retry_count, MAX_RETRY);
             for (int i = 0; i < retry_delay; i++) {
                 vTaskDelay(pdMS_TO_TICKS(1000));
-                if (device_state_ == kDeviceStateIdle) {
+                if (!background && device_state_ == kDeviceStateIdle) {
                     break;
                 }
             }
@@ -104,6 +118,9 @@ void Application::CheckNewVersion(Ota& ota) {
         retry_delay = 10; // 重置重试延迟时间
 
         if (ota.HasNewVersion()) {
+            while (background && device_state_ != kDeviceStateIdle) {
+                vTaskDelay(pdMS_TO_TICKS(1000));
+            }
             Alert(Lang::Strings::OTA_UPGRADE, Lang::Strings::UPGRADING, "download", Lang::Sounds::OGG_UPGRADE);
 
             vTaskDelay(pdMS_TO_TICKS(3000));
@@ -117,12 +134,11 @@ void Application::CheckNewVersion(Ota& ota) {
             audio_service_.Stop();
             vTaskDelay(pdMS_TO_TICKS(1000));
 
+            // Progress is reported once per second from the download task, flash writes run in their own task
             bool upgrade_success = ota.StartUpgrade([display](int progress, size_t speed) {
-                std::thread([display, progress, speed]() {
-                    char buffer[32];
-                    snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
-                    display->SetChatMessage("system", buffer);
-                }).detach();
+                char buffer[32];
+                snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
+                display->SetChatMessage("system", buffer);
             });
 
             if (!upgrade_success) {
@@ -151,6 +167,9 @@ void Application::CheckNewVersion(Ota& ota) {
             break;
         }
 
+        if (background) {
+            SetDeviceState(kDeviceStateActivating);
+        }
         display->SetStatus(Lang::Strings::ACTIVATION);
         // Activation code is shown to the user and waiting for the user to input
         if (ota.HasActivationCode()) {
@@ -255,15 +274,15 @@ void Application::ToggleChatState() {
             }
 
             SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop : kListeningModeRealtime);
-        });
+        }, kMainEventControl);
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
-        });
+        }, kMainEventControl);
     } else if (device_state_ == kDeviceStateListening) {
         Schedule([this]() {
             protocol_->CloseAudioChannel();
-        });
+        }, kMainEventControl);
     }
 }
 
@@ -292,12 +311,12 @@ void Application::StartListening() {
             }
 
             SetListeningMode(kListeningModeManualStop);
-        });
+        }, kMainEventControl);
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
             SetListeningMode(kListeningModeManualStop);
-        });
+        }, kMainEventControl);
     }
 }
 
@@ -323,12 +342,33 @@ void Application::StopListening() {
             protocol_->SendStopListening();
             SetDeviceState(kDeviceStateIdle);
         }
-    });
+    }, kMainEventControl);
+}
+
+static bool HasSavedServerConfig() {
+    auto saved = LoadServerConfig();
+    return saved.has_mqtt || saved.has_websocket;
 }
 
+/*
+ * Boot stages (see boot_sequence.h), each starts when the stages it depends on are done:
+ *
+ *   audio, main_loop        -> idle: wake word and local commands available
+ *   idle, mcp_tools         -> network
+ *   network, idle           -> ota
+ *   network, mcp_tools, idle -> protocol (after ota instead, if no server config is saved yet)
+ *
+ * The network waits for the audio service and the idle state: Wi-Fi config mode plays sounds,
+ * reads the microphone and sets its own device state, and boards register local commands and
+ * MCP tools in StartNetwork.
+ *
+ * With a saved server config the version check runs in the background and no longer
+ * delays the protocol; new server settings from the check apply on the next boot.
+ */
 void Application::Start() {
     auto& board = Board::GetInstance();
     SetDeviceState(kDeviceStateStarting);
+    boot_sequence_.Mark("board_ready");
 
     /* Setup the display */
     auto display = board.GetDisplay();
@@ -336,97 +376,152 @@ void Application::Start() {
     // Print board name/version info
     display->SetChatMessage("system", SystemInfo::GetUserAgent().c_str());
 
-    /* Setup the audio service */
-    auto codec = board.GetAudioCodec();
-    audio_service_.Initialize(codec);
-    audio_service_.Start();
+    // Used by the ota and protocol stages, which may still run when Start() returns
+    ota_ = std::make_unique<Ota>();
+    bool use_saved_config = HasSavedServerConfig();
 
-    AudioServiceCallbacks callbacks;
-    callbacks.on_send_queue_available = [this]() {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
-    };
-    callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
-    };
-    callbacks.on_vad_change = [this](bool speaking) {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
-    };
-    audio_service_.SetCallbacks(callbacks);
+    /* Setup the audio service */
+    boot_sequence_.AddStage("audio", {}, [this, &board]() {
+        auto codec = board.GetAudioCodec();
+        audio_service_.Initialize(codec);
+        audio_service_.Start();
+
+        AudioServiceCallbacks callbacks;
+        callbacks.on_send_queue_available = [this]() {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+        };
+        callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
+        };
+        callbacks.on_vad_change = [this](bool speaking) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
+        };
+        audio_service_.SetCallbacks(callbacks);
+    }, 4096 * 2);
+
+    boot_sequence_.AddStage("main_loop", {}, [this]() {
+        // Start the main event loop task with priority 3
+        xTaskCreate([](void* arg) {
+            ((Application*)arg)->MainEventLoop();
+            vTaskDelete(NULL);
+        }, "main_event_loop", 2048 * 4, this, 3, &main_event_loop_task_handle_);
+
+        /* Start the clock timer to update the status bar */
+        esp_timer_start_periodic(clock_timer_handle_, 1000000);
+    });
 
-    // Start the main event loop task with priority 3
-    xTaskCreate([](void* arg) {
-        ((Application*)arg)->MainEventLoop();
-        vTaskDelete(NULL);
-    }, "main_event_loop", 2048 * 4, this, 3, &main_event_loop_task_handle_);
+    boot_sequence_.AddStage("idle", {"audio", "main_loop"}, [this]() {
+        SetDeviceState(kDeviceStateIdle);
+        boot_sequence_.Mark("wake_word_ready");
+    });
 
-    /* Start the clock timer to update the status bar */
-    esp_timer_start_periodic(clock_timer_handle_, 1000000);
+    // Add MCP common tools before the board adds its own in StartNetwork
+    boot_sequence_.AddStage("mcp_tools", {}, []() {
+        McpServer::GetInstance().AddCommonTools();
+    });
 
     /* Wait for the network to be ready */
-    board.StartNetwork();
-
-    // Update the status bar immediately to show the network state
-    display->UpdateStatusBar(true);
+    boot_sequence_.AddStage("network", {"idle", "mcp_tools"}, [&board, display]() {
+        board.StartNetwork();
+        // Update the status bar immediately to show the network state
+        display->UpdateStatusBar(true);
+    }, 4096 * 2);
 
     // Check for new firmware version or get the MQTT broker address
-    Ota ota;
-    CheckNewVersion(ota);
+    boot_sequence_.AddStage("ota", {"network", "idle"}, [this, use_saved_config]() {
+        CheckNewVersion(*ota_, use_saved_config);
+        has_server_time_ = ota_->HasServerTime();
+        if (use_saved_config && (device_state_ == kDeviceStateActivating || device_state_ == kDeviceStateUpgrading)) {
+            SetDeviceState(kDeviceStateIdle);
+        }
+    }, 4096 * 2);
 
-    // Initialize the protocol
-    display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
+    auto start_protocol = [this, use_saved_config]() {
+        StartProtocol(*ota_, use_saved_config);
+    };
+    if (use_saved_config) {
+        boot_sequence_.AddStage("protocol", {"network", "mcp_tools", "idle"}, start_protocol, 4096 * 2);
+    } else {
+        boot_sequence_.AddStage("protocol", {"ota", "mcp_tools"}, start_protocol, 4096 * 2);
+    }
+
+    boot_sequence_.Run();
+    boot_sequence_.PrintTimeline();
+}
 
-    // Add MCP common tools before initializing the protocol
-    McpServer::GetInstance().AddCommonTools();
+void Application::StartProtocol(Ota& ota, bool use_saved_config) {
+    auto& board = Board::GetInstance();
+    auto display = board.GetDisplay();
+    auto codec = board.GetAudioCodec();
+
+    // Initialize the protocol
+    bool use_websocket;
+    if (use_saved_config) {
+        // Server config saved by a previous version check
+        auto saved = LoadServerConfig();
+        use_websocket = !saved.has_mqtt && saved.has_websocket;
+    } else {
+        display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
+        use_websocket = !ota.HasMqttConfig() && ota.HasWebsocketConfig();
+        if (!ota.HasMqttConfig() && !ota.HasWebsocketConfig()) {
+            ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
+        }
+    }
 
-    if (ota.HasMqttConfig()) {
-        protocol_ = std::make_unique<MqttProtocol>();
-    } else if (ota.HasWebsocketConfig()) {
-        protocol_ = std::make_unique<WebsocketProtocol>();
+    // The main loop reads protocol_, it is only set there once the protocol is started
+    std::unique_ptr<Protocol> protocol;
+    if (use_websocket) {
+        protocol = std::make_unique<WebsocketProtocol>();
     } else {
-        ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
-        protocol_ = std::make_unique<MqttProtocol>();
+        protocol = std::make_unique<MqttProtocol>();
     }
 
-    protocol_->OnConnected([this]() {
+    protocol->OnConnected([this]() {
         DismissAlert();
     });
 
-    protocol_->OnNetworkError([this](const std::string& message) {
+    protocol->OnNetworkError([this](const std::string& message) {
         last_error_message_ = message;
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
-    protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
+    protocol->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
+        Metrics::GetInstance().Increment(kMetricAudioPacketsReceived);
         if (device_state_ == kDeviceStateSpeaking) {
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
     });
-    protocol_->OnAudioChannelOpened([this, codec, &board]() {
+    protocol->OnAudioChannelOpened([protocol = protocol.get(), codec, &board]() {
         board.SetPowerSaveMode(false);
-        if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
+        if (protocol->server_sample_rate() != codec->output_sample_rate()) {
             ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
-                protocol_->server_sample_rate(), codec->output_sample_rate());
+                protocol->server_sample_rate(), codec->output_sample_rate());
         }
     });
-    protocol_->OnAudioChannelClosed([this, &board]() {
+    protocol->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
         Schedule([this]() {
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
-        });
+        }, kMainEventControl);
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
+    protocol->OnIncomingJson([this, display](const cJSON* root) {
         // Parse JSON data
         auto type = cJSON_GetObjectItem(root, "type");
+        if (!cJSON_IsString(type)) {
+            return;
+        }
         if (strcmp(type->valuestring, "tts") == 0) {
             auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
+            if (!cJSON_IsString(state)) {
+                ESP_LOGW(TAG, "TTS message without state");
+            } else if (strcmp(state->valuestring, "start") == 0) {
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
                         SetDeviceState(kDeviceStateSpeaking);
                     }
-                });
+                }, kMainEventControl);
             } else if (strcmp(state->valuestring, "stop") == 0) {
                 Schedule([this]() {
                     if (device_state_ == kDeviceStateSpeaking) {
@@ -436,14 +531,14 @@ void Application::Start() {
                             SetDeviceState(kDeviceStateListening);
                         }
                     }
-                });
+                }, kMainEventControl);
             } else if (strcmp(state->valuestring, "sentence_start") == 0) {
                 auto text = cJSON_GetObjectItem(root, "text");
                 if (cJSON_IsString(text)) {
                     ESP_LOGI(TAG, "<< %s", text->valuestring);
                     Schedule([this, display, message = std::string(text->valuestring)]() {
                         display->SetChatMessage("assistant", message.c_str());
-                    });
+                    }, kMainEventUi);
                 }
             }
         } else if (strcmp(type->valuestring, "stt") == 0) {
@@ -452,14 +547,14 @@ void Application::Start() {
                 ESP_LOGI(TAG, ">> %s", text->valuestring);
                 Schedule([this, display, message = std::string(text->valuestring)]() {
                     display->SetChatMessage("user", message.c_str());
-                });
+                }, kMainEventUi);
             }
         } else if (strcmp(type->valuestring, "llm") == 0) {
             auto emotion = cJSON_GetObjectItem(root, "emotion");
             if (cJSON_IsString(emotion)) {
                 Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
                     display->SetEmotion(emotion_str.c_str());
-                });
+                }, kMainEventUi);
             }
         } else if (strcmp(type->valuestring, "mcp") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
@@ -474,7 +569,7 @@ void Application::Start() {
                     // Do a reboot if user requests a OTA update
                     Schedule([this]() {
                         Reboot();
-                    });
+                    }, kMainEventControl);
                 } else {
                     ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
                 }
@@ -495,7 +590,7 @@ void Application::Start() {
             if (cJSON_IsObject(payload)) {
                 Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
                     display->SetChatMessage("system", payload_str.c_str());
-                });
+                }, kMainEventUi);
             } else {
                 ESP_LOGW(TAG, "Invalid custom message format: missing payload");
             }
@@ -504,29 +599,34 @@ void Application::Start() {
             ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
         }
     });
-    bool protocol_started = protocol_->Start();
+    bool protocol_started = protocol->Start();
 
     // Print heap stats
     SystemInfo::PrintHeapStats();
-    SetDeviceState(kDeviceStateIdle);
+    if (!use_saved_config) {
+        SetDeviceState(kDeviceStateIdle);
+    }
 
-    has_server_time_ = ota.HasServerTime();
     if (protocol_started) {
-        std::string message = std::string(Lang::Strings::VERSION) + ota.GetCurrentVersion();
+        std::string message = std::string(Lang::Strings::VERSION) + esp_app_get_description()->version;
         display->ShowNotification(message.c_str());
         display->SetChatMessage("system", "");
         // Play the success sound to indicate the device is ready
         audio_service_.PlaySound(Lang::Sounds::OGG_SUCCESS);
     }
-}
 
-// Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        main_tasks_.push_back(std::move(callback));
-    }
-    xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
+    // Publish the protocol in the main loop, a wake word heard while it was starting is handled now.
+    // Control events are never dropped
+    Protocol* started = protocol.release();
+    Schedule([this, started]() {
+        protocol_.reset(started);
+        protocol_initialized_ = true;
+        if (pending_wake_word_) {
+            pending_wake_word_ = false;
+            OnWakeWordDetected();
+        }
+    }, kMainEventControl);
+    boot_sequence_.Mark("protocol_ready");
 }
 
 // The Main Event Loop controls the chat state and websocket connection
@@ -547,10 +647,18 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
+            auto& uplink_controller = audio_service_.GetUplinkController();
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (!protocol_->SendAudio(std::move(packet))) {
+                int64_t trace_time = packet->trace_time_us;
+                int64_t send_start_time = esp_timer_get_time();
+                bool sent = protocol_->SendAudio(std::move(packet));
+                uplink_controller.OnPacketSent(send_start_time - trace_time, esp_timer_get_time() - send_start_time, sent);
+                if (!sent) {
+                    Metrics::GetInstance().Increment(kMetricAudioSendFailures);
                     break;
                 }
+                Metrics::GetInstance().Increment(kMetricAudioPacketsSent);
+                audio_service_.GetLatencyTracer().Record(kAudioTraceSendAudio, trace_time);
             }
         }
 
@@ -566,31 +674,42 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SCHEDULE) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto tasks = std::move(main_tasks_);
-            lock.unlock();
-            for (auto& task : tasks) {
-                task();
+            // Highest priority first, a limited batch per wakeup so audio sending is not starved
+            for (int i = 0; i < MAIN_EVENT_BATCH_SIZE && main_events_.RunNext(); i++) {
+            }
+            if (!main_events_.Empty()) {
+                xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
             }
         }
 
         if (bits & MAIN_EVENT_CLOCK_TICK) {
             clock_ticks_++;
-            auto display = Board::GetInstance().GetDisplay();
+            auto& board = Board::GetInstance();
+            auto display = board.GetDisplay();
             display->UpdateStatusBar();
+
+            uint32_t received = 0, lost = 0;
+            if (protocol_ != nullptr) {
+                protocol_->GetAudioLoss(received, lost);
+            }
+            audio_service_.GetUplinkController().OnLinkQuality(board.GetNetworkRssi(), received, lost);
         
-            // Print the debug info every 10 seconds
-            if (clock_ticks_ % 10 == 0) {
-                // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
-                // SystemInfo::PrintTaskList();
-                SystemInfo::PrintHeapStats();
+            // Sample the runtime metrics every 10 seconds
+            if (clock_ticks_ % METRICS_SAMPLE_INTERVAL_S == 0) {
+                auto& metrics = Metrics::GetInstance();
+                metrics.Sample();
+                metrics.PrintSummary();
             }
         }
     }
 }
 
 void Application::OnWakeWordDetected() {
-    if (!protocol_) {
+    if (!protocol_initialized_) {
+        // The wake word is available before the network, remember it until the protocol is ready
+        ESP_LOGI(TAG, "Wake word detected while the protocol is starting");
+        pending_wake_word_ = true;
+        audio_service_.EnableWakeWordDetection(true);
         return;
     }
 
@@ -647,6 +766,7 @@ void Application::SetDeviceState(DeviceState state) {
     auto previous_state = device_state_;
     device_state_ = state;
     ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
+    TraceRecorder::GetInstance().Record(kTraceDeviceState, 0, state);
 
     // Send the state change event
     DeviceStateEventManager::GetInstance().PostStateChangeEvent(previous_state, state);
@@ -678,6 +798,8 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
+            // 回到待机时提交对话中修改的设置（音量等）
+            Settings::Flush();
             break;
         case kDeviceStateConnecting:
             display->SetStatus(Lang::Strings::CONNECTING);
@@ -692,6 +814,8 @@ void Application::SetDeviceState(DeviceState state) {
             if (!audio_service_.IsAudioProcessorRunning()) {
                 // Send the start listening command
                 protocol_->SendStartListening(listening_mode_);
+                // Realtime mode runs the device AEC with the VAD turned off, nothing would be gated
+                audio_service_.EnableUplinkGate(protocol_->server_vad_gate() && listening_mode_ != kListeningModeRealtime);
                 audio_service_.EnableVoiceProcessing(true);
                 audio_service_.EnableWakeWordDetection(false);
             }
@@ -728,17 +852,17 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
             if (protocol_) {
                 protocol_->SendWakeWordDetected(wake_word); 
             }
-        }); 
+        }, kMainEventControl); 
     } else if (device_state_ == kDeviceStateSpeaking) {
         Schedule([this]() {
             AbortSpeaking(kAbortReasonNone);
-        });
+        }, kMainEventControl);
     } else if (device_state_ == kDeviceStateListening) {   
         Schedule([this]() {
             if (protocol_) {
                 protocol_->CloseAudioChannel();
             }
-        });
+        }, kMainEventControl);
     }
 }
 
@@ -760,19 +884,19 @@ bool Application::CanEnterSleepMode() {
 }
 
 void Application::SendMcpMessage(const std::string& payload) {
-    if (protocol_ == nullptr) {
-        return;
-    }
-
-    // Make sure you are using main thread to send MCP message
+    // Make sure you are using main thread to send MCP message, protocol_ is only read there
     if (xTaskGetCurrentTaskHandle() == main_event_loop_task_handle_) {
         ESP_LOGI(TAG, "Send MCP message in main thread");
-        protocol_->SendMcpMessage(payload);
+        if (protocol_ != nullptr) {
+            protocol_->SendMcpMessage(payload);
+        }
     } else {
         ESP_LOGI(TAG, "Send MCP message in sub thread");
         Schedule([this, payload = std::move(payload)]() {
-            protocol_->SendMcpMessage(payload);
-        });
+            if (protocol_ != nullptr) {
+                protocol_->SendMcpMessage(payload);
+            }
+        }, kMainEventMcpReply);
     }
 }
 
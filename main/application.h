@@ -7,14 +7,14 @@
 #include <esp_timer.h>
 
 #include <string>
-#include <mutex>
-#include <deque>
 #include <memory>
 
 #include "protocol.h"
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#include "main_event_queue.h"
+#include "boot_sequence.h"
 
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
@@ -25,6 +25,9 @@
 #define MAIN_EVENT_CHECK_NEW_VERSION_DONE (1 << 5)
 #define MAIN_EVENT_CLOCK_TICK (1 << 6)
 
+// Scheduled events run per wakeup of the main loop before other event bits are checked again
+#define MAIN_EVENT_BATCH_SIZE 8
+
 
 enum AecMode {
     kAecOff,
@@ -46,7 +49,17 @@ public:
     void MainEventLoop();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
-    void Schedule(std::function<void()> callback);
+    // Run callback in the main loop, the type selects its priority (see main_event_queue.h).
+    // Only kMainEventMcpTool and kMainEventProtocol callbacks can be dropped when their queue is
+    // full, Schedule returns false then; all other types are always run
+    template <typename F>
+    bool Schedule(F&& callback, MainEventType type = kMainEventGeneric) {
+        if (!main_events_.Push(type, std::forward<F>(callback))) {
+            return false;
+        }
+        xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
+        return true;
+    }
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -62,14 +75,18 @@ public:
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
+    MainEventQueue& GetMainEventQueue() { return main_events_; }
+    BootSequence& GetBootSequence() { return boot_sequence_; }
 
 private:
     Application();
     ~Application();
 
-    std::mutex mutex_;
-    std::deque<std::function<void()>> main_tasks_;
+    MainEventQueue main_events_;
+    BootSequence boot_sequence_;
+    // Only accessed in the main loop once set
     std::unique_ptr<Protocol> protocol_;
+    std::unique_ptr<Ota> ota_;
     EventGroupHandle_t event_group_ = nullptr;
     esp_timer_handle_t clock_timer_handle_ = nullptr;
     volatile DeviceState device_state_ = kDeviceStateUnknown;
@@ -80,12 +97,16 @@ private:
 
     bool has_server_time_ = false;
     bool aborted_ = false;
+    // Only accessed in the main loop
+    bool protocol_initialized_ = false;
+    bool pending_wake_word_ = false;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
     void OnWakeWordDetected();
-    void CheckNewVersion(Ota& ota);
+    void CheckNewVersion(Ota& ota, bool background);
+    void StartProtocol(Ota& ota, bool use_saved_config);
     void ShowActivationCode(const std::string& code, const std::string& message);
     void SetListeningMode(ListeningMode mode);
 };
@@ -70,3 +70,39 @@ void AudioCodec::EnableOutput(bool enable) {
     output_enabled_ = enable;
     ESP_LOGI(TAG, "Set output enable to %s", enable ? "true" : "false");
 }
+
+void AudioCodec::SetInputStandby(bool standby) {
+    // Duplex channels share the clock with the output, they are only gated by EnableInput
+    if (standby == input_standby_ || rx_handle_ == nullptr || duplex_) {
+        return;
+    }
+    input_standby_ = standby;
+    if (standby) {
+        ESP_ERROR_CHECK(i2s_channel_disable(rx_handle_));
+    } else {
+        ESP_ERROR_CHECK(i2s_channel_enable(rx_handle_));
+    }
+    ESP_LOGI(TAG, "Set input standby to %s", standby ? "true" : "false");
+}
+
+void AudioCodec::SetOutputStandby(bool standby) {
+    if (standby == output_standby_ || tx_handle_ == nullptr || duplex_) {
+        return;
+    }
+    output_standby_ = standby;
+    if (standby) {
+        ESP_ERROR_CHECK(i2s_channel_disable(tx_handle_));
+    } else {
+        // Precharge the DMA descriptors with silence, otherwise the stale buffers
+        // are clocked out first and the amplifier pops
+        static const uint8_t silence[256] = {};
+        size_t loaded = 0;
+        do {
+            if (i2s_channel_preload_data(tx_handle_, silence, sizeof(silence), &loaded) != ESP_OK) {
+                break;
+            }
+        } while (loaded == sizeof(silence));
+        ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
+    }
+    ESP_LOGI(TAG, "Set output standby to %s", standby ? "true" : "false");
+}
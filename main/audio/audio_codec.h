@@ -23,6 +23,9 @@ public:
     virtual void SetOutputVolume(int volume);
     virtual void EnableInput(bool enable);
     virtual void EnableOutput(bool enable);
+    // Standby stops the I2S DMA but keeps the codec powered, so resuming is fast
+    virtual void SetInputStandby(bool standby);
+    virtual void SetOutputStandby(bool standby);
 
     virtual void OutputData(std::vector<int16_t>& data);
     virtual bool InputData(std::vector<int16_t>& data);
@@ -37,6 +40,11 @@ public:
     inline int output_volume() const { return output_volume_; }
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
+    inline bool input_standby() const { return input_standby_; }
+    inline bool output_standby() const { return output_standby_; }
+    // Samples dropped because the capture buffer was full / reads that waited for late DMA data
+    inline uint32_t input_overruns() const { return input_overruns_; }
+    inline uint32_t input_underruns() const { return input_underruns_; }
 
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
@@ -46,11 +54,15 @@ protected:
     bool input_reference_ = false;
     bool input_enabled_ = false;
     bool output_enabled_ = false;
+    bool input_standby_ = false;
+    bool output_standby_ = false;
     int input_sample_rate_ = 0;
     int output_sample_rate_ = 0;
     int input_channels_ = 1;
     int output_channels_ = 1;
     int output_volume_ = 70;
+    volatile uint32_t input_overruns_ = 0;
+    volatile uint32_t input_underruns_ = 0;
 
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
@@ -0,0 +1,76 @@
+#ifndef AUDIO_FEED_CLOCK_H
+#define AUDIO_FEED_CLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Feed times of the frames given to the audio processor.
+ *
+ * The input task calls OnFeed() with the samples per channel of each frame it feeds, the
+ * processor task calls OnOutput() with the samples of each frame it outputs. Both sides count
+ * samples from the last Reset(), so an output frame is matched to the fed frame that held its
+ * last sample and the afe_fetch stage is timed from the feed of that frame, however the feed
+ * and fetch sizes of the AFE line up. The entries are a single producer / single consumer ring
+ * like AudioFeedRing, a full ring drops the new entry and the frames it covered are not timed.
+ */
+#define AUDIO_FEED_CLOCK_SIZE 16
+
+class AudioFeedClock {
+public:
+    AudioFeedClock() = default;
+    AudioFeedClock(const AudioFeedClock&) = delete;
+    AudioFeedClock& operator=(const AudioFeedClock&) = delete;
+
+    // Call while the processor is stopped, before it is started again
+    void Reset() {
+        fed_ = 0;
+        output_ = 0;
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // Producer side
+    inline void OnFeed(size_t samples, int64_t time_us) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint64_t begin = fed_;
+        fed_ += samples;
+        if (head - tail_.load(std::memory_order_acquire) >= AUDIO_FEED_CLOCK_SIZE) {
+            return;
+        }
+        entries_[head % AUDIO_FEED_CLOCK_SIZE] = { begin, fed_, time_us };
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    // Consumer side: feed time of the frame that held the last of the next `samples` output
+    // samples, 0 if that frame was not recorded
+    inline int64_t OnOutput(size_t samples) {
+        output_ += samples;
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        // Frames that were fully output are done with
+        while (tail != head && entries_[tail % AUDIO_FEED_CLOCK_SIZE].end < output_) {
+            tail++;
+        }
+        tail_.store(tail, std::memory_order_release);
+        if (tail == head) {
+            return 0;
+        }
+        auto& entry = entries_[tail % AUDIO_FEED_CLOCK_SIZE];
+        return entry.begin < output_ ? entry.time_us : 0;
+    }
+
+private:
+    struct Entry {
+        uint64_t begin;         // Samples fed before this frame
+        uint64_t end;
+        int64_t time_us;
+    };
+    Entry entries_[AUDIO_FEED_CLOCK_SIZE] = {};
+    std::atomic<uint32_t> head_ = 0;
+    std::atomic<uint32_t> tail_ = 0;
+    uint64_t fed_ = 0;          // Producer only
+    uint64_t output_ = 0;       // Consumer only
+};
+
+#endif // AUDIO_FEED_CLOCK_H
@@ -0,0 +1,92 @@
+#ifndef AUDIO_FEED_RING_H
+#define AUDIO_FEED_RING_H
+
+#include <esp_heap_caps.h>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Single producer / single consumer ring of 16-bit PCM samples.
+ *
+ * The producer is the I2S RX DMA callback (ISR context), which converts the raw
+ * 32-bit slots straight into the ring; the consumer is the audio input task.
+ * The storage is allocated once from internal RAM, so the capture path does no
+ * heap allocation per frame. The capacity is a power of two and the head / tail
+ * counters run freely, so no lock is needed between the two sides.
+ */
+class AudioFeedRing {
+public:
+    AudioFeedRing() = default;
+    ~AudioFeedRing() {
+        if (buffer_ != nullptr) {
+            heap_caps_free(buffer_);
+        }
+    }
+    AudioFeedRing(const AudioFeedRing&) = delete;
+    AudioFeedRing& operator=(const AudioFeedRing&) = delete;
+
+    bool Allocate(size_t samples) {
+        size_t capacity = 1;
+        while (capacity < samples) {
+            capacity <<= 1;
+        }
+        buffer_ = (int16_t*)heap_caps_malloc(capacity * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+        if (buffer_ == nullptr) {
+            return false;
+        }
+        mask_ = capacity - 1;
+        head_.store(0);
+        tail_.store(0);
+        return true;
+    }
+
+    inline bool allocated() const { return buffer_ != nullptr; }
+    inline size_t capacity() const { return mask_ + 1; }
+    inline size_t available() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_relaxed);
+    }
+
+    // Producer side: convert 32-bit I2S slots to int16 (value >> shift, saturated).
+    // Returns the number of samples stored, the rest did not fit and are dropped.
+    inline size_t PushInt32(const int32_t* src, size_t count, int shift) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t space = capacity() - (head - tail_.load(std::memory_order_acquire));
+        if (count > space) {
+            count = space;
+        }
+        for (size_t i = 0; i < count; i++) {
+            int32_t value = src[i] >> shift;
+            buffer_[(head + i) & mask_] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+        }
+        head_.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side: copy up to count samples into dest
+    inline size_t Pop(int16_t* dest, size_t count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t ready = head_.load(std::memory_order_acquire) - tail;
+        if (count > ready) {
+            count = ready;
+        }
+        for (size_t i = 0; i < count; i++) {
+            dest[i] = buffer_[(tail + i) & mask_];
+        }
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side: discard everything captured so far
+    inline void Clear() {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    int16_t* buffer_ = nullptr;
+    size_t mask_ = 0;
+    std::atomic<size_t> head_ = 0;
+    std::atomic<size_t> tail_ = 0;
+};
+
+#endif // AUDIO_FEED_RING_H
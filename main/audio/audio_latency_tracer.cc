@@ -0,0 +1,48 @@
+#include "audio_latency_tracer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+static const char* const kStageNames[kAudioTraceStageCount] = {
+    "i2s_read",
+    "afe_fetch",
+    "encode_start",
+    "encode_end",
+    "send_audio",
+    "protocol_receive",
+    "decode",
+    "resample",
+    "output_data",
+};
+
+const char* AudioLatencyTracer::GetStageName(AudioTraceStage stage) {
+    return stage < kAudioTraceStageCount ? kStageNames[stage] : "unknown";
+}
+
+void AudioLatencyTracer::Reset() {
+    for (auto& ring : stages_) {
+        ring.count.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::string AudioLatencyTracer::GetReportJson() const {
+    std::string json = "{";
+    uint32_t samples[AUDIO_TRACE_WINDOW];
+    for (int i = 0; i < kAudioTraceStageCount; i++) {
+        auto& ring = stages_[i];
+        uint32_t count = ring.count.load(std::memory_order_relaxed);
+        size_t n = std::min<uint32_t>(count, AUDIO_TRACE_WINDOW);
+        std::copy_n(ring.samples, n, samples);
+        std::sort(samples, samples + n);
+
+        auto percentile = [&samples, n](int p) -> uint32_t {
+            return n == 0 ? 0 : samples[(n - 1) * p / 100];
+        };
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":{\"count\":%lu,\"p50\":%lu,\"p95\":%lu,\"p99\":%lu}",
+            i == 0 ? "" : ",", kStageNames[i], count, percentile(50), percentile(95), percentile(99));
+        json += buffer;
+    }
+    json += "}";
+    return json;
+}
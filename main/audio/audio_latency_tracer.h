@@ -0,0 +1,65 @@
+#ifndef AUDIO_LATENCY_TRACER_H
+#define AUDIO_LATENCY_TRACER_H
+
+#include <esp_timer.h>
+#include <sdkconfig.h>
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+/*
+ * Per-stage latency of the audio pipeline.
+ *
+ * Uplink:   (MIC) -> i2s_read -> afe_fetch -> encode_start (queue wait) -> encode_end -> send_audio
+ * Downlink: protocol_receive (queue wait) -> decode -> resample -> output_data (queue wait + write)
+ *
+ * Each stage keeps the last AUDIO_TRACE_WINDOW samples (in microseconds) in a ring that
+ * is written with a single atomic increment, so recording never blocks the audio tasks.
+ * Percentiles are only computed when a report is requested.
+ */
+#define AUDIO_TRACE_WINDOW 128
+
+enum AudioTraceStage {
+    kAudioTraceI2sRead,
+    kAudioTraceAfeFetch,
+    kAudioTraceEncodeStart,
+    kAudioTraceEncodeEnd,
+    kAudioTraceSendAudio,
+    kAudioTraceProtocolReceive,
+    kAudioTraceDecode,
+    kAudioTraceResample,
+    kAudioTraceOutputData,
+    kAudioTraceStageCount,
+};
+
+class AudioLatencyTracer {
+public:
+    AudioLatencyTracer() = default;
+
+    // Record the time elapsed since start_time_us (from esp_timer_get_time)
+    inline void Record(AudioTraceStage stage, int64_t start_time_us) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACER
+        if (start_time_us <= 0) {
+            return;
+        }
+        auto& ring = stages_[stage];
+        uint32_t index = ring.count.fetch_add(1, std::memory_order_relaxed);
+        ring.samples[index % AUDIO_TRACE_WINDOW] = (uint32_t)(esp_timer_get_time() - start_time_us);
+#endif
+    }
+
+    void Reset();
+    // {"i2s_read":{"count":n,"p50":us,"p95":us,"p99":us}, ...}
+    std::string GetReportJson() const;
+    static const char* GetStageName(AudioTraceStage stage);
+
+private:
+    struct StageRing {
+        std::atomic<uint32_t> count = 0;
+        uint32_t samples[AUDIO_TRACE_WINDOW] = {};
+    };
+    StageRing stages_[kAudioTraceStageCount];
+};
+
+#endif // AUDIO_LATENCY_TRACER_H
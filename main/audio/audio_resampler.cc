@@ -0,0 +1,222 @@
+#include "audio_resampler.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+
+#define TAG "AudioResampler"
+
+// Stopband attenuation of the prototype filter
+#define RESAMPLER_ATTENUATION_DB 70.0
+
+struct ResamplerProfile {
+    int input_sample_rate;
+    int output_sample_rate;
+    int taps_per_phase;
+};
+
+// Filter lengths for the ratios used by the codecs and servers we ship with
+static const ResamplerProfile kResamplerProfiles[] = {
+    { 24000, 16000, 32 },   // TTS downlink on 16 kHz codecs
+    { 16000, 24000, 16 },   // 16 kHz server audio on 24 kHz codecs
+    { 48000, 16000, 64 },   // 48 kHz I2S microphones
+    { 44100, 16000, 32 },   // 44.1 kHz codecs
+};
+#define RESAMPLER_DEFAULT_TAPS_PER_PHASE 24
+#define RESAMPLER_MAX_FILTER_TAPS 8192
+
+static double BesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+static inline int16_t DotProduct(const int16_t* x, const int16_t* h, int taps) {
+    // Four independent accumulators keep the MAC pipeline busy, taps is a multiple of 4
+    int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (int i = 0; i < taps; i += 4) {
+        acc0 += int32_t(x[i]) * h[i];
+        acc1 += int32_t(x[i + 1]) * h[i + 1];
+        acc2 += int32_t(x[i + 2]) * h[i + 2];
+        acc3 += int32_t(x[i + 3]) * h[i + 3];
+    }
+    int32_t acc = ((acc0 + acc1) + (acc2 + acc3) + (1 << 14)) >> 15;
+    return (acc > INT16_MAX) ? INT16_MAX : (acc < INT16_MIN) ? INT16_MIN : (int16_t)acc;
+}
+
+void AudioResampler::Configure(int input_sample_rate, int output_sample_rate, int channels) {
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    channels_ = channels;
+
+    int divisor = std::gcd(input_sample_rate, output_sample_rate);
+    up_ = output_sample_rate / divisor;
+    down_ = input_sample_rate / divisor;
+
+    int taps_per_phase = RESAMPLER_DEFAULT_TAPS_PER_PHASE;
+    for (const auto& profile : kResamplerProfiles) {
+        if (profile.input_sample_rate == input_sample_rate && profile.output_sample_rate == output_sample_rate) {
+            taps_per_phase = profile.taps_per_phase;
+            break;
+        }
+    }
+    // Bound the table size for unusual ratios, keep the tap count a multiple of 4
+    taps_per_phase = std::min(taps_per_phase, RESAMPLER_MAX_FILTER_TAPS / up_);
+    taps_per_phase = std::max(4, taps_per_phase & ~3);
+
+    DesignFilter(taps_per_phase);
+    Reset();
+    ESP_LOGI(TAG, "Resample %d -> %d Hz, %d channel(s), ratio %d/%d, %d taps per phase",
+        input_sample_rate_, output_sample_rate_, channels_, up_, down_, taps_per_phase_);
+}
+
+void AudioResampler::DesignFilter(int taps_per_phase) {
+    taps_per_phase_ = taps_per_phase;
+    const int length = taps_per_phase * up_;
+
+    // Frequencies are normalized to the upsampled rate; the cutoff is placed so that the
+    // transition band ends at the Nyquist frequency of the lower of the two rates.
+    const double nyquist = 0.5 / std::max(up_, down_);
+    const double transition = (RESAMPLER_ATTENUATION_DB - 7.95) / (14.36 * (length - 1));
+    const double cutoff = std::max(nyquist - transition / 2, nyquist * 0.75);
+    const double beta = 0.1102 * (RESAMPLER_ATTENUATION_DB - 8.7);
+    const double center = (length - 1) / 2.0;
+    const double window_norm = BesselI0(beta);
+
+    std::vector<double> prototype(length);
+    for (int i = 0; i < length; i++) {
+        double t = i - center;
+        double x = 2.0 * cutoff * t;
+        double sinc = (t == 0) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        double r = t / center;
+        double window = BesselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / window_norm;
+        prototype[i] = 2.0 * cutoff * up_ * sinc * window;
+    }
+
+    // Split into reversed sub-filters, each normalized to unity DC gain so that the
+    // passband gain does not ripple with the phase.
+    coefficients_.assign(length, 0);
+    for (int phase = 0; phase < up_; phase++) {
+        double sum = 0;
+        for (int k = 0; k < taps_per_phase; k++) {
+            sum += prototype[phase + k * up_];
+        }
+        int16_t* dest = &coefficients_[phase * taps_per_phase];
+        for (int k = 0; k < taps_per_phase; k++) {
+            double value = prototype[phase + k * up_] / sum * 32768.0;
+            value = std::min(32767.0, std::max(-32768.0, std::round(value)));
+            dest[taps_per_phase - 1 - k] = (int16_t)value;
+        }
+    }
+}
+
+void AudioResampler::Reset() {
+    history_stride_ = taps_per_phase_ > 0 ? taps_per_phase_ - 1 : 0;
+    history_.assign(history_stride_ * channels_, 0);
+    next_frame_ = 0;
+    phase_ = 0;
+}
+
+size_t AudioResampler::GetOutputSamples(size_t input_samples) const {
+    if (!configured()) {
+        return input_samples;
+    }
+    // Count the output positions that fall inside the block, in upsampled units
+    int64_t span = int64_t(input_samples / channels_) * up_ - int64_t(next_frame_) * up_ - phase_;
+    if (span <= 0) {
+        return 0;
+    }
+    return size_t((span + down_ - 1) / down_) * channels_;
+}
+
+size_t AudioResampler::GetInputSamples(size_t output_samples) const {
+    if (!configured()) {
+        return output_samples;
+    }
+    size_t outputs = output_samples / channels_;
+    if (outputs == 0) {
+        return 0;
+    }
+    // The last wanted output must fall inside the block, in upsampled units
+    int64_t last = int64_t(next_frame_) * up_ + phase_ + int64_t(outputs - 1) * down_;
+    return size_t(last / up_ + 1) * channels_;
+}
+
+void AudioResampler::LoadInput(const int16_t* input, size_t frames) {
+    const size_t keep = taps_per_phase_ - 1;
+    if (keep + frames > history_stride_) {
+        // Grow the rows once, the buffer is reused for every following block
+        size_t stride = keep + frames;
+        std::vector<int16_t> grown(stride * channels_, 0);
+        for (int c = 0; c < channels_; c++) {
+            std::copy_n(history_.begin() + c * history_stride_, keep, grown.begin() + c * stride);
+        }
+        history_.swap(grown);
+        history_stride_ = stride;
+    }
+
+    for (int c = 0; c < channels_; c++) {
+        int16_t* row = &history_[c * history_stride_ + keep];
+        const int16_t* src = input + c;
+        for (size_t i = 0; i < frames; i++, src += channels_) {
+            row[i] = *src;
+        }
+    }
+}
+
+size_t AudioResampler::Run(size_t frames, int16_t* output) {
+    const int taps = taps_per_phase_;
+    size_t frame = next_frame_;
+    int phase = phase_;
+    int16_t* dest = output;
+
+    while (frame < frames) {
+        const int16_t* coefficients = &coefficients_[phase * taps];
+        for (int c = 0; c < channels_; c++) {
+            *dest++ = DotProduct(&history_[c * history_stride_ + frame], coefficients, taps);
+        }
+        phase += down_;
+        frame += phase / up_;
+        phase %= up_;
+    }
+    next_frame_ = frame - frames;
+    phase_ = phase;
+
+    // Keep the newest (taps - 1) input frames as history for the next block
+    for (int c = 0; c < channels_; c++) {
+        int16_t* row = &history_[c * history_stride_];
+        std::memmove(row, row + frames, (taps - 1) * sizeof(int16_t));
+    }
+    return dest - output;
+}
+
+size_t AudioResampler::Process(const int16_t* input, size_t input_samples, int16_t* output) {
+    if (!configured()) {
+        std::memmove(output, input, input_samples * sizeof(int16_t));
+        return input_samples;
+    }
+    size_t frames = input_samples / channels_;
+    LoadInput(input, frames);
+    return Run(frames, output);
+}
+
+void AudioResampler::Process(std::vector<int16_t>& data) {
+    if (!configured()) {
+        return;
+    }
+    size_t frames = data.size() / channels_;
+    size_t output_samples = GetOutputSamples(data.size());
+    LoadInput(data.data(), frames);
+    if (output_samples > data.size()) {
+        data.resize(output_samples);
+    }
+    data.resize(Run(frames, data.data()));
+}
@@ -0,0 +1,67 @@
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Polyphase FIR resampler for interleaved 16-bit PCM.
+ *
+ * The conversion ratio is reduced to up / down (L / M). A windowed-sinc prototype
+ * filter of L * taps_per_phase taps is designed once in Configure() and stored as
+ * L reversed Q15 sub-filters, so every output sample is a single contiguous dot
+ * product over the planar history buffer. All channels share the same phase, so a
+ * stereo mic + reference frame is converted in one pass without splitting it into
+ * separate vectors.
+ *
+ * The common ratios (24k->16k, 16k->24k, 48k->16k, 44.1k->16k) use tuned filter
+ * lengths from a static table; other ratios fall back to a generic design.
+ * The input block is copied into the planar buffer before filtering, so input and
+ * output may point to the same memory.
+ */
+class AudioResampler {
+public:
+    AudioResampler() = default;
+
+    void Configure(int input_sample_rate, int output_sample_rate, int channels = 1);
+    void Reset();
+
+    // Resample interleaved PCM in place, data is resized to the produced samples
+    void Process(std::vector<int16_t>& data);
+    // Resample interleaved PCM, returns the number of samples written to output
+    size_t Process(const int16_t* input, size_t input_samples, int16_t* output);
+    // Number of interleaved output samples the next Process call produces for the given input
+    size_t GetOutputSamples(size_t input_samples) const;
+    // Fewest interleaved input samples for which the next Process call produces at least
+    // output_samples, exactly that many when downsampling
+    size_t GetInputSamples(size_t output_samples) const;
+
+    inline bool configured() const { return up_ > 0; }
+    inline int input_sample_rate() const { return input_sample_rate_; }
+    inline int output_sample_rate() const { return output_sample_rate_; }
+    inline int channels() const { return channels_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int channels_ = 1;
+    int up_ = 0;
+    int down_ = 0;
+    int taps_per_phase_ = 0;
+
+    // Reversed sub-filters, taps_per_phase_ coefficients for each of the up_ phases
+    std::vector<int16_t> coefficients_;
+    // Planar working buffer, one row of (taps - 1) history + block per channel
+    std::vector<int16_t> history_;
+    size_t history_stride_ = 0;
+    // Position of the next output sample, in input frames from the block start
+    size_t next_frame_ = 0;
+    int phase_ = 0;
+
+    void DesignFilter(int taps_per_phase);
+    void LoadInput(const int16_t* input, size_t frames);
+    size_t Run(size_t frames, int16_t* output);
+};
+
+#endif // AUDIO_RESAMPLER_H
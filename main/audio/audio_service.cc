@@ -1,6 +1,9 @@
 #include "audio_service.h"
+#include "metrics.h"
+#include "trace_recorder.h"
 #include <esp_log.h>
 #include <cstring>
+#include <algorithm>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -36,14 +39,17 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+    opus_encoder_ = std::make_unique<OpusUplinkEncoder>(16000, 1, OPUS_FRAME_DURATION_MS);
 
     if (codec->input_sample_rate() != 16000) {
-        input_resampler_.Configure(codec->input_sample_rate(), 16000);
-        reference_resampler_.Configure(codec->input_sample_rate(), 16000);
+        // Mic and reference channels share one resampler, they are converted in a single pass
+        input_resampler_.Configure(codec->input_sample_rate(), 16000, codec->input_channels());
     }
 
+#if CONFIG_USE_AUDIO_DEBUGGER
+    audio_debugger_ = std::make_unique<AudioDebugger>();
+#endif
+
 #if CONFIG_USE_AUDIO_PROCESSOR
     audio_processor_ = std::make_unique<AfeAudioProcessor>();
 #else
@@ -61,11 +67,16 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
+        latency_tracer_.Record(kAudioTraceAfeFetch, feed_clock_.OnOutput(data.size()));
+        if (audio_debugger_) {
+            audio_debugger_->Feed(kAudioTapProcessed, data, 16000, 1);
+        }
         PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
+        uplink_gate_.OnVadChange(speaking);
         if (callbacks_.on_vad_change) {
             callbacks_.on_vad_change(speaking);
         }
@@ -96,7 +107,9 @@ void AudioService::Start() {
     service_stopped_ = false;
     xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING | AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING);
 
-    esp_timer_start_periodic(audio_power_timer_, 1000000);
+    auto now = std::chrono::steady_clock::now();
+    last_input_time_ = last_output_time_ = input_active_since_ = output_active_since_ = now;
+    esp_timer_start_once(audio_power_timer_, CONFIG_AUDIO_POWER_STANDBY_TIMEOUT_MS * 1000);
 
 #if CONFIG_USE_AUDIO_PROCESSOR
     /* Start the audio input task */
@@ -152,37 +165,27 @@ void AudioService::Stop() {
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
-    if (!codec_->input_enabled()) {
-        esp_timer_stop(audio_power_timer_);
-        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-        codec_->EnableInput(true);
-    }
+    WakeInput();
 
+    int64_t read_start_time = esp_timer_get_time();
     if (codec_->input_sample_rate() != sample_rate) {
-        data.resize(samples * codec_->input_sample_rate() / sample_rate * codec_->input_channels());
+        // Read exactly the input the resampler needs for the requested frames, with fractional
+        // ratios (e.g. 44.1k) this changes by a frame from call to call. Upsampling may give a
+        // frame more, it is kept for the next call instead of being dropped
+        size_t wanted = samples * codec_->input_channels();
+        size_t carried = input_carry_.size();
+        data.resize(input_resampler_.GetInputSamples(wanted - carried));
         if (!codec_->InputData(data)) {
             return false;
         }
-        if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
-        } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+        input_resampler_.Process(data);
+        if (carried > 0) {
+            data.insert(data.begin(), input_carry_.begin(), input_carry_.end());
+            input_carry_.clear();
+        }
+        if (data.size() > wanted) {
+            input_carry_.assign(data.begin() + wanted, data.end());
+            data.resize(wanted);
         }
     } else {
         data.resize(samples * codec_->input_channels());
@@ -191,22 +194,25 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         }
     }
 
-    /* Update the last input time */
-    last_input_time_ = std::chrono::steady_clock::now();
+    latency_tracer_.Record(kAudioTraceI2sRead, read_start_time);
+    last_feed_time_us_ = esp_timer_get_time();
     debug_statistics_.input_count++;
 
-#if CONFIG_USE_AUDIO_DEBUGGER
-    // 音频调试：发送原始音频数据
-    if (audio_debugger_ == nullptr) {
-        audio_debugger_ = std::make_unique<AudioDebugger>();
+    if (audio_debugger_) {
+        // 音频调试：发送原始音频数据，并定期发送各阶段延迟统计
+        audio_debugger_->Feed(kAudioTapMicRaw, data, sample_rate, codec_->input_channels());
+        if (last_feed_time_us_ - last_trace_report_time_us_ >= AUDIO_TRACE_REPORT_INTERVAL_MS * 1000) {
+            last_trace_report_time_us_ = last_feed_time_us_;
+            audio_debugger_->SendReport(latency_tracer_.GetReportJson());
+        }
     }
-    audio_debugger_->Feed(data);
-#endif
 
     return true;
 }
 
 void AudioService::AudioInputTask() {
+    // Reused for every frame, the wake word and AFE consumers only read from it
+    std::vector<int16_t> data;
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
             AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
@@ -228,7 +234,6 @@ void AudioService::AudioInputTask() {
                 EnableAudioTesting(false);
                 continue;
             }
-            std::vector<int16_t> data;
             int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
             if (ReadAudioData(data, 16000, samples)) {
                 // If input channels is 2, we need to fetch the left channel data
@@ -246,7 +251,6 @@ void AudioService::AudioInputTask() {
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
@@ -258,10 +262,10 @@ void AudioService::AudioInputTask() {
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+                    feed_clock_.OnFeed(samples, last_feed_time_us_);
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -285,18 +289,28 @@ void AudioService::AudioOutputTask() {
 
         auto task = std::move(audio_playback_queue_.front());
         audio_playback_queue_.pop_front();
+        UpdateQueueMetrics();
         audio_queue_cv_.notify_all();
         lock.unlock();
 
-        if (!codec_->output_enabled()) {
-            esp_timer_stop(audio_power_timer_);
-            esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-            codec_->EnableOutput(true);
+        WakeOutput();
+        if (output_ramp_position_ >= 0) {
+            /* Fade in the first samples after a wakeup to avoid a click */
+            int ramp_samples = codec_->output_sample_rate() * AUDIO_POWER_RAMP_MS / 1000;
+            for (auto& sample : task->pcm) {
+                if (output_ramp_position_ >= ramp_samples) {
+                    output_ramp_position_ = -1;
+                    break;
+                }
+                sample = (int32_t)sample * output_ramp_position_++ / ramp_samples;
+            }
+        }
+        if (audio_debugger_) {
+            audio_debugger_->Feed(kAudioTapPlayback, task->pcm, codec_->output_sample_rate(), 1);
         }
         codec_->OutputData(task->pcm);
+        latency_tracer_.Record(kAudioTraceOutputData, task->trace_time_us);
 
-        /* Update the last output time */
-        last_output_time_ = std::chrono::steady_clock::now();
         debug_statistics_.playback_count++;
 
 #if CONFIG_USE_SERVER_AEC
@@ -327,28 +341,43 @@ void AudioService::OpusCodecTask() {
         if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
             auto packet = std::move(audio_decode_queue_.front());
             audio_decode_queue_.pop_front();
+            UpdateQueueMetrics();
             audio_queue_cv_.notify_all();
             lock.unlock();
 
             auto task = std::make_unique<AudioTask>();
             task->type = kAudioTaskTypeDecodeToPlaybackQueue;
             task->timestamp = packet->timestamp;
+            latency_tracer_.Record(kAudioTraceProtocolReceive, packet->trace_time_us);
 
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
+            // 空包表示网络丢失的一帧，解码器对空输入做丢包隐藏 (PLC)
+            bool concealment = packet->payload.empty();
+            int64_t decode_start_time = esp_timer_get_time();
             if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
+                if (!concealment) {
+                    latency_tracer_.Record(kAudioTraceDecode, decode_start_time);
+                    Metrics::GetInstance().Record(kMetricOpusDecode, esp_timer_get_time() - decode_start_time);
+                }
+                if (audio_debugger_) {
+                    audio_debugger_->Feed(kAudioTapDecoded, task->pcm, opus_decoder_->sample_rate(), 1);
+                }
                 // Resample if the sample rate is different
                 if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
+                    int64_t resample_start_time = esp_timer_get_time();
+                    output_resampler_.Process(task->pcm);
+                    latency_tracer_.Record(kAudioTraceResample, resample_start_time);
                 }
 
+                task->trace_time_us = esp_timer_get_time();
                 lock.lock();
                 audio_playback_queue_.push_back(std::move(task));
+                UpdateQueueMetrics();
                 audio_queue_cv_.notify_all();
             } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
+                if (!concealment) {
+                    ESP_LOGE(TAG, "Failed to decode audio");
+                }
                 lock.lock();
             }
             debug_statistics_.decode_count++;
@@ -358,6 +387,7 @@ void AudioService::OpusCodecTask() {
         if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
+            UpdateQueueMetrics();
             audio_queue_cv_.notify_all();
             lock.unlock();
 
@@ -365,15 +395,28 @@ void AudioService::OpusCodecTask() {
             packet->frame_duration = OPUS_FRAME_DURATION_MS;
             packet->sample_rate = 16000;
             packet->timestamp = task->timestamp;
+            latency_tracer_.Record(kAudioTraceEncodeStart, task->trace_time_us);
+            UplinkSettings uplink_settings;
+            if (uplink_controller_.Update(uplink_settings)) {
+                opus_encoder_->Apply(uplink_settings);
+            }
+            opus_encoder_->ForceDtx(task->type == kAudioTaskTypeEncodeToSendQueue && uplink_gate_.IsSuppressing());
+            int64_t encode_start_time = esp_timer_get_time();
             if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
                 ESP_LOGE(TAG, "Failed to encode audio");
                 continue;
             }
+            int64_t encode_time = esp_timer_get_time() - encode_start_time;
+            latency_tracer_.Record(kAudioTraceEncodeEnd, encode_start_time);
+            Metrics::GetInstance().Record(kMetricOpusEncode, encode_time);
+            packet->trace_time_us = esp_timer_get_time();
 
             if (task->type == kAudioTaskTypeEncodeToSendQueue) {
                 {
                     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
+                    uplink_gate_.Push(std::move(packet), audio_send_queue_, MAX_SEND_PACKETS_IN_QUEUE);
+                    UpdateQueueMetrics();
+                    uplink_controller_.OnPacketEncoded(encode_time, audio_send_queue_.size());
                 }
                 if (callbacks_.on_send_queue_available) {
                     callbacks_.on_send_queue_available();
@@ -409,6 +452,7 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
     auto task = std::make_unique<AudioTask>();
     task->type = type;
     task->pcm = std::move(pcm);
+    task->trace_time_us = esp_timer_get_time();
     
     /* Push the task to the encode queue */
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
@@ -425,19 +469,23 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
 
     audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
     audio_encode_queue_.push_back(std::move(task));
+    UpdateQueueMetrics();
     audio_queue_cv_.notify_all();
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
+    packet->trace_time_us = esp_timer_get_time();
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
     if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
         if (wait) {
             audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
         } else {
+            Metrics::GetInstance().Increment(kMetricDecodeQueueDrops);
             return false;
         }
     }
     audio_decode_queue_.push_back(std::move(packet));
+    UpdateQueueMetrics();
     audio_queue_cv_.notify_all();
     return true;
 }
@@ -449,6 +497,7 @@ std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
     }
     auto packet = std::move(audio_send_queue_.front());
     audio_send_queue_.pop_front();
+    UpdateQueueMetrics();
     audio_queue_cv_.notify_all();
     return packet;
 }
@@ -493,6 +542,14 @@ void AudioService::EnableWakeWordDetection(bool enable) {
     }
 }
 
+bool AudioService::AddLocalCommand(const std::string& phrase, std::function<void()> callback) {
+    if (!wake_word_ || !wake_word_->AddCommand(phrase, callback)) {
+        ESP_LOGW(TAG, "Local command is not supported by the wake word engine: %s", phrase.c_str());
+        return false;
+    }
+    return true;
+}
+
 void AudioService::EnableVoiceProcessing(bool enable) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
@@ -504,6 +561,7 @@ void AudioService::EnableVoiceProcessing(bool enable) {
         /* We should make sure no audio is playing */
         ResetDecoder();
         audio_input_need_warmup_ = true;
+        feed_clock_.Reset();
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
@@ -512,6 +570,14 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     }
 }
 
+void AudioService::EnableUplinkGate(bool enable) {
+#if CONFIG_USE_VAD_GATED_UPLINK
+    uplink_gate_.Reset(enable);
+#else
+    uplink_gate_.Reset(false);
+#endif
+}
+
 void AudioService::EnableAudioTesting(bool enable) {
     ESP_LOGI(TAG, "%s audio testing", enable ? "Enabling" : "Disabling");
     if (enable) {
@@ -540,11 +606,7 @@ void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
 }
 
 void AudioService::PlaySound(const std::string_view& ogg) {
-    if (!codec_->output_enabled()) {
-        esp_timer_stop(audio_power_timer_);
-        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-        codec_->EnableOutput(true);
-    }
+    WakeOutput();
 
     const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
     size_t size = ogg.size();
@@ -650,20 +712,127 @@ void AudioService::ResetDecoder() {
     audio_decode_queue_.clear();
     audio_playback_queue_.clear();
     audio_testing_queue_.clear();
+    UpdateQueueMetrics();
     audio_queue_cv_.notify_all();
 }
 
+// Called with audio_queue_mutex_ held
+void AudioService::UpdateQueueMetrics() {
+    auto& metrics = Metrics::GetInstance();
+    metrics.SetGauge(kMetricDecodeQueue, audio_decode_queue_.size());
+    metrics.SetGauge(kMetricEncodeQueue, audio_encode_queue_.size());
+    metrics.SetGauge(kMetricSendQueue, audio_send_queue_.size());
+    metrics.SetGauge(kMetricPlaybackQueue, audio_playback_queue_.size());
+    TraceRecorder::GetInstance().Record(kTraceAudioQueues, 0, std::min<size_t>(audio_decode_queue_.size(), 255) |
+        std::min<size_t>(audio_encode_queue_.size(), 255) << 8 | std::min<size_t>(audio_send_queue_.size(), 255) << 16 |
+        std::min<size_t>(audio_playback_queue_.size(), 255) << 24);
+}
+
+/*
+ * Each direction steps down Active -> Standby -> Off as it stays idle, and goes back to
+ * Active as soon as it is used. A direction that was just woken stays active for at least
+ * CONFIG_AUDIO_POWER_HOLD_MS, so short gaps between sentences do not toggle the DMA.
+ */
+static AudioPowerState GetIdlePowerState(int64_t idle_ms, int64_t active_ms, int64_t& next_check_ms) {
+    if (active_ms < CONFIG_AUDIO_POWER_HOLD_MS) {
+        next_check_ms = std::min(next_check_ms, CONFIG_AUDIO_POWER_HOLD_MS - active_ms);
+        return kAudioPowerActive;
+    }
+    if (idle_ms >= CONFIG_AUDIO_POWER_OFF_TIMEOUT_MS) {
+        return kAudioPowerOff;
+    }
+    if (idle_ms >= CONFIG_AUDIO_POWER_STANDBY_TIMEOUT_MS) {
+        next_check_ms = std::min(next_check_ms, CONFIG_AUDIO_POWER_OFF_TIMEOUT_MS - idle_ms);
+        return kAudioPowerStandby;
+    }
+    next_check_ms = std::min(next_check_ms, CONFIG_AUDIO_POWER_STANDBY_TIMEOUT_MS - idle_ms);
+    return kAudioPowerActive;
+}
+
 void AudioService::CheckAndUpdateAudioPowerState() {
+    std::lock_guard<std::mutex> lock(audio_power_mutex_);
     auto now = std::chrono::steady_clock::now();
-    auto input_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_input_time_).count();
-    auto output_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_output_time_).count();
-    if (input_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->input_enabled()) {
-        codec_->EnableInput(false);
+    auto elapsed_ms = [&now](std::chrono::steady_clock::time_point since) -> int64_t {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now - since).count();
+    };
+
+    int64_t next_check_ms = INT64_MAX;
+    auto input_state = GetIdlePowerState(elapsed_ms(last_input_time_), elapsed_ms(input_active_since_), next_check_ms);
+    if (input_state > input_power_state_) {
+        codec_->SetInputStandby(true);
+        if (input_state == kAudioPowerOff) {
+            codec_->EnableInput(false);
+        }
+        input_power_state_ = input_state;
+    }
+    auto output_state = GetIdlePowerState(elapsed_ms(last_output_time_), elapsed_ms(output_active_since_), next_check_ms);
+    if (output_state > output_power_state_) {
+        codec_->SetOutputStandby(true);
+        if (output_state == kAudioPowerOff) {
+            codec_->EnableOutput(false);
+        }
+        output_power_state_ = output_state;
+    }
+
+    // Both directions off: nothing to do until the next wakeup re-arms the timer
+    if (next_check_ms != INT64_MAX && !(input_power_state_ == kAudioPowerOff && output_power_state_ == kAudioPowerOff)) {
+        esp_timer_start_once(audio_power_timer_, std::max<int64_t>(next_check_ms, 10) * 1000);
+    }
+}
+
+void AudioService::RecordWakeLatency(int64_t start_time_us) {
+    uint32_t latency = esp_timer_get_time() - start_time_us;
+    power_statistics_.last_wake_latency_us = latency;
+    power_statistics_.max_wake_latency_us = std::max(power_statistics_.max_wake_latency_us, latency);
+    if (!esp_timer_is_active(audio_power_timer_) && !service_stopped_) {
+        esp_timer_start_once(audio_power_timer_, CONFIG_AUDIO_POWER_HOLD_MS * 1000);
+    }
+}
+
+void AudioService::WakeInput() {
+    std::lock_guard<std::mutex> lock(audio_power_mutex_);
+    last_input_time_ = std::chrono::steady_clock::now();
+    if (!codec_->input_enabled()) {
+        // Disabled outside of the service, e.g. by the power save timer
+        input_power_state_ = kAudioPowerOff;
     }
-    if (output_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->output_enabled()) {
-        codec_->EnableOutput(false);
+    if (input_power_state_ == kAudioPowerActive) {
+        return;
     }
-    if (!codec_->input_enabled() && !codec_->output_enabled()) {
-        esp_timer_stop(audio_power_timer_);
+
+    int64_t start_time = esp_timer_get_time();
+    if (input_power_state_ == kAudioPowerOff) {
+        codec_->EnableInput(true);
     }
-}
\ No newline at end of file
+    codec_->SetInputStandby(false);
+    RecordWakeLatency(start_time);
+    ESP_LOGI(TAG, "Input woke from %s in %lu us", input_power_state_ == kAudioPowerOff ? "off" : "standby",
+        power_statistics_.last_wake_latency_us);
+    input_power_state_ = kAudioPowerActive;
+    input_active_since_ = last_input_time_;
+    power_statistics_.input_wakeups++;
+}
+
+void AudioService::WakeOutput() {
+    std::lock_guard<std::mutex> lock(audio_power_mutex_);
+    last_output_time_ = std::chrono::steady_clock::now();
+    if (!codec_->output_enabled()) {
+        output_power_state_ = kAudioPowerOff;
+    }
+    if (output_power_state_ == kAudioPowerActive) {
+        return;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    if (output_power_state_ == kAudioPowerOff) {
+        codec_->EnableOutput(true);
+    }
+    codec_->SetOutputStandby(false);
+    RecordWakeLatency(start_time);
+    ESP_LOGI(TAG, "Output woke from %s in %lu us", output_power_state_ == kAudioPowerOff ? "off" : "standby",
+        power_statistics_.last_wake_latency_us);
+    output_power_state_ = kAudioPowerActive;
+    output_active_since_ = last_output_time_;
+    output_ramp_position_ = 0;
+    power_statistics_.output_wakeups++;
+}
@@ -6,17 +6,22 @@
 #include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
 #include <esp_timer.h>
 
-#include <opus_encoder.h>
 #include <opus_decoder.h>
-#include <opus_resampler.h>
 
 #include "audio_codec.h"
+#include "audio_resampler.h"
+#include "audio_latency_tracer.h"
+#include "audio_feed_clock.h"
+#include "opus_uplink_encoder.h"
+#include "uplink_controller.h"
+#include "vad_uplink_gate.h"
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
@@ -40,10 +45,11 @@
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
+#define AUDIO_TRACE_REPORT_INTERVAL_MS 5000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
 
-#define AUDIO_POWER_TIMEOUT_MS 15000
-#define AUDIO_POWER_CHECK_INTERVAL_MS 1000
+// Fade-in applied to the first output samples after the speaker path wakes up
+#define AUDIO_POWER_RAMP_MS 10
 
 
 #define AS_EVENT_AUDIO_TESTING_RUNNING      (1 << 0)
@@ -69,6 +75,20 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    int64_t trace_time_us = 0;
+};
+
+enum AudioPowerState {
+    kAudioPowerActive,
+    kAudioPowerStandby,     // Codec powered, I2S DMA stopped
+    kAudioPowerOff,         // Codec powered down
+};
+
+struct AudioPowerStatistics {
+    uint32_t input_wakeups = 0;
+    uint32_t output_wakeups = 0;
+    uint32_t last_wake_latency_us = 0;
+    uint32_t max_wake_latency_us = 0;
 };
 
 struct DebugStatistics {
@@ -95,9 +115,13 @@ public:
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
 
     void EnableWakeWordDetection(bool enable);
+    // 注册本地命令词（需要 CONFIG_USE_CUSTOM_WAKE_WORD），回调在音频输入任务中执行
+    bool AddLocalCommand(const std::string& phrase, std::function<void()> callback);
     void EnableVoiceProcessing(bool enable);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
+    // Call before EnableVoiceProcessing(true), only when the server accepted the vad_gate feature
+    void EnableUplinkGate(bool enable);
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
@@ -106,6 +130,13 @@ public:
     void PlaySound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
+    AudioPowerState GetInputPowerState() const { return input_power_state_; }
+    AudioPowerState GetOutputPowerState() const { return output_power_state_; }
+    const AudioPowerStatistics& GetPowerStatistics() const { return power_statistics_; }
+    AudioLatencyTracer& GetLatencyTracer() { return latency_tracer_; }
+    UplinkController& GetUplinkController() { return uplink_controller_; }
+    VadUplinkGate& GetUplinkGate() { return uplink_gate_; }
+    AudioDebugger* GetAudioDebugger() { return audio_debugger_.get(); }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -113,12 +144,18 @@ private:
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
-    std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
+    std::unique_ptr<OpusUplinkEncoder> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    AudioResampler input_resampler_;
+    std::vector<int16_t> input_carry_;     // Resampled input beyond the last requested frames
+    AudioResampler output_resampler_;
     DebugStatistics debug_statistics_;
+    AudioLatencyTracer latency_tracer_;
+    AudioFeedClock feed_clock_;            // Times the AFE stage of each frame from its feed
+    UplinkController uplink_controller_;
+    VadUplinkGate uplink_gate_;
+    std::atomic<int64_t> last_feed_time_us_ = 0;
+    int64_t last_trace_report_time_us_ = 0;
 
     EventGroupHandle_t event_group_;
 
@@ -143,8 +180,15 @@ private:
     bool audio_input_need_warmup_ = false;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
+    std::mutex audio_power_mutex_;
+    AudioPowerState input_power_state_ = kAudioPowerActive;
+    AudioPowerState output_power_state_ = kAudioPowerActive;
+    AudioPowerStatistics power_statistics_;
     std::chrono::steady_clock::time_point last_input_time_;
     std::chrono::steady_clock::time_point last_output_time_;
+    std::chrono::steady_clock::time_point input_active_since_;
+    std::chrono::steady_clock::time_point output_active_since_;
+    int output_ramp_position_ = -1;    // -1 when no fade-in is pending
 
     void AudioInputTask();
     void AudioOutputTask();
@@ -152,6 +196,10 @@ private:
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
+    void WakeInput();
+    void WakeOutput();
+    void RecordWakeLatency(int64_t start_time_us);
+    void UpdateQueueMetrics();
 };
 
 #endif
\ No newline at end of file
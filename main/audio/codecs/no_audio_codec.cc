@@ -6,6 +6,11 @@
 
 #define TAG "NoAudioCodec"
 
+// Capture ring length in milliseconds, enough to ride out a few late input task wakeups
+#define FEED_RING_DURATION_MS 240
+// A DMA frame arrives every AUDIO_CODEC_DMA_FRAME_NUM samples, waiting longer means the RX DMA stalled
+#define FEED_READ_TIMEOUT_MS 100
+
 NoAudioCodec::~NoAudioCodec() {
     if (rx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_disable(rx_handle_));
@@ -13,6 +18,9 @@ NoAudioCodec::~NoAudioCodec() {
     if (tx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_disable(tx_handle_));
     }
+    if (feed_ready_ != nullptr) {
+        vSemaphoreDelete(feed_ready_);
+    }
 }
 
 NoAudioCodecDuplex::NoAudioCodecDuplex(int input_sample_rate, int output_sample_rate, gpio_num_t bclk, gpio_num_t ws, gpio_num_t dout, gpio_num_t din) {
@@ -141,6 +149,7 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
     std_cfg.gpio_cfg.dout = I2S_GPIO_UNUSED;
     std_cfg.gpio_cfg.din = mic_din;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle_, &std_cfg));
+    InitializeDmaCapture();
     ESP_LOGI(TAG, "Simplex channels created");
 }
 
@@ -211,6 +220,7 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
     std_cfg.gpio_cfg.dout = I2S_GPIO_UNUSED;
     std_cfg.gpio_cfg.din = mic_din;
     ESP_ERROR_CHECK(i2s_channel_init_std_mode(rx_handle_, &std_cfg));
+    InitializeDmaCapture();
     ESP_LOGI(TAG, "Simplex channels created");
 }
 
@@ -301,7 +311,66 @@ int NoAudioCodec::Write(const int16_t* data, int samples) {
     return bytes_written / sizeof(int32_t);
 }
 
+void NoAudioCodec::InitializeDmaCapture() {
+    // Must run before the RX channel is enabled
+    if (!feed_ring_.Allocate(input_sample_rate_ * FEED_RING_DURATION_MS / 1000)) {
+        ESP_LOGE(TAG, "Failed to allocate feed ring, using blocking reads");
+        return;
+    }
+    feed_ready_ = xSemaphoreCreateBinary();
+    i2s_event_callbacks_t callbacks = {};
+    callbacks.on_recv = OnDmaReceive;
+    ESP_ERROR_CHECK(i2s_channel_register_event_callback(rx_handle_, &callbacks, this));
+    ESP_LOGI(TAG, "DMA capture enabled, feed ring %u samples", (unsigned)feed_ring_.capacity());
+}
+
+bool IRAM_ATTR NoAudioCodec::OnDmaReceive(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    auto codec = static_cast<NoAudioCodec*>(user_ctx);
+    if (!codec->input_enabled_) {
+        return false;
+    }
+    size_t count = event->size / sizeof(int32_t);
+    size_t stored = codec->feed_ring_.PushInt32(static_cast<const int32_t*>(event->dma_buf), count, 12);
+    if (stored < count) {
+        codec->input_overruns_ += count - stored;
+    }
+    BaseType_t need_yield = pdFALSE;
+    xSemaphoreGiveFromISR(codec->feed_ready_, &need_yield);
+    return need_yield == pdTRUE;
+}
+
+void NoAudioCodec::EnableInput(bool enable) {
+    if (enable && !input_enabled_ && feed_ring_.allocated()) {
+        // Drop samples left over from before the input was disabled
+        feed_ring_.Clear();
+    }
+    AudioCodec::EnableInput(enable);
+}
+
+void NoAudioCodec::SetInputStandby(bool standby) {
+    AudioCodec::SetInputStandby(standby);
+    if (!standby && feed_ring_.allocated()) {
+        feed_ring_.Clear();
+    }
+}
+
 int NoAudioCodec::Read(int16_t* dest, int samples) {
+    if (feed_ring_.allocated()) {
+        int total = 0;
+        while (total < samples) {
+            total += feed_ring_.Pop(dest + total, samples - total);
+            if (total < samples && xSemaphoreTake(feed_ready_, pdMS_TO_TICKS(FEED_READ_TIMEOUT_MS)) != pdTRUE) {
+                input_underruns_++;
+                ESP_LOGW(TAG, "No capture data for %d ms, underruns: %lu", FEED_READ_TIMEOUT_MS, input_underruns_);
+            }
+        }
+        if (input_overruns_ != reported_overruns_) {
+            reported_overruns_ = input_overruns_;
+            ESP_LOGW(TAG, "Feed ring overrun, dropped samples: %lu", reported_overruns_);
+        }
+        return total;
+    }
+
     size_t bytes_read;
 
     std::vector<int32_t> bit32_buffer(samples);
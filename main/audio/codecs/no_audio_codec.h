@@ -5,17 +5,29 @@
 
 #include <driver/gpio.h>
 #include <driver/i2s_pdm.h>
+#include <freertos/semphr.h>
 #include <mutex>
 
+#include "audio_feed_ring.h"
+
 class NoAudioCodec : public AudioCodec {
 protected:
     std::mutex data_if_mutex_;
+    // DMA driven capture, the RX callback converts samples straight into feed_ring_
+    AudioFeedRing feed_ring_;
+    SemaphoreHandle_t feed_ready_ = nullptr;
+    uint32_t reported_overruns_ = 0;
 
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
+    void InitializeDmaCapture();
+
+    static bool OnDmaReceive(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx);
 
 public:
     virtual ~NoAudioCodec();
+    virtual void EnableInput(bool enable) override;
+    virtual void SetInputStandby(bool standby) override;
 };
 
 class NoAudioCodecDuplex : public NoAudioCodec {
@@ -0,0 +1,75 @@
+#include "opus_uplink_encoder.h"
+
+#include <esp_log.h>
+
+#define TAG "OpusUplinkEncoder"
+
+// 60ms at the highest bitrate the controller uses is well below this
+#define MAX_OPUS_PACKET_SIZE 1500
+
+OpusUplinkEncoder::OpusUplinkEncoder(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), channels_(channels), duration_ms_(duration_ms) {
+    int error;
+    encoder_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    if (encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio encoder, error code: %d", error);
+        return;
+    }
+    frame_size_ = sample_rate / 1000 * channels * duration_ms;
+    Apply(UplinkSettings());
+}
+
+OpusUplinkEncoder::~OpusUplinkEncoder() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (encoder_ != nullptr) {
+        opus_encoder_destroy(encoder_);
+    }
+}
+
+bool OpusUplinkEncoder::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (encoder_ == nullptr) {
+        return false;
+    }
+    if (pcm.size() != frame_size_) {
+        ESP_LOGE(TAG, "Audio data size %u is not equal to frame size %u", pcm.size(), frame_size_);
+        return false;
+    }
+    opus.resize(MAX_OPUS_PACKET_SIZE);
+    int ret = opus_encode(encoder_, pcm.data(), frame_size_ / channels_, opus.data(), opus.size());
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to encode audio, error code: %d", ret);
+        return false;
+    }
+    opus.resize(ret);
+    return true;
+}
+
+void OpusUplinkEncoder::Apply(const UplinkSettings& settings) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (encoder_ == nullptr) {
+        return;
+    }
+    opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(settings.bitrate));
+    opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(settings.complexity));
+    settings_dtx_ = settings.dtx;
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(settings_dtx_ || force_dtx_ ? 1 : 0));
+    opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(settings.fec ? 1 : 0));
+    opus_encoder_ctl(encoder_, OPUS_SET_PACKET_LOSS_PERC(settings.loss_percent));
+}
+
+void OpusUplinkEncoder::ForceDtx(bool force) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (encoder_ == nullptr || force == force_dtx_) {
+        return;
+    }
+    force_dtx_ = force;
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(settings_dtx_ || force_dtx_ ? 1 : 0));
+}
+
+void OpusUplinkEncoder::ResetState() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+    }
+}
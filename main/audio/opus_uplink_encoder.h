@@ -0,0 +1,53 @@
+#ifndef OPUS_UPLINK_ENCODER_H
+#define OPUS_UPLINK_ENCODER_H
+
+#include <opus.h>
+
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Encoder settings chosen by the UplinkController
+struct UplinkSettings {
+    int level = 0;
+    int bitrate = OPUS_AUTO;    // bits per second
+    int complexity = 0;         // 0 ~ 10
+    bool dtx = false;
+    bool fec = false;           // In-band FEC, needs loss_percent > 0 to have an effect
+    int loss_percent = 0;
+};
+
+/*
+ * Opus encoder of the uplink, on libopus directly so bitrate, complexity, DTX and in-band FEC
+ * can be changed between frames without recreating the encoder.
+ */
+class OpusUplinkEncoder {
+public:
+    OpusUplinkEncoder(int sample_rate, int channels, int duration_ms);
+    ~OpusUplinkEncoder();
+    OpusUplinkEncoder(const OpusUplinkEncoder&) = delete;
+    OpusUplinkEncoder& operator=(const OpusUplinkEncoder&) = delete;
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline int duration_ms() const { return duration_ms_; }
+
+    // pcm must be exactly one frame
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus);
+    void Apply(const UplinkSettings& settings);
+    // DTX regardless of the settings, while the VAD gate suppresses silence
+    void ForceDtx(bool force);
+    void ResetState();
+
+private:
+    std::mutex mutex_;
+    OpusEncoder* encoder_ = nullptr;
+    bool settings_dtx_ = false;
+    bool force_dtx_ = false;
+    int sample_rate_;
+    int channels_;
+    int duration_ms_;
+    size_t frame_size_;
+};
+
+#endif // OPUS_UPLINK_ENCODER_H
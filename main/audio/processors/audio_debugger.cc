@@ -6,8 +6,11 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
+#include <esp_timer.h>
 #include <cstring>
+#include <cstdlib>
 #include <string>
+#include <algorithm>
 #endif
 
 #define TAG "AudioDebugger"
@@ -15,24 +18,14 @@
 
 AudioDebugger::AudioDebugger() {
 #if CONFIG_USE_AUDIO_DEBUGGER
+    for (auto& tap : taps_) {
+        tap.datagram.reserve(sizeof(AudioTapHeader) + AUDIO_TAP_MAX_PAYLOAD);
+    }
     udp_sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
     if (udp_sockfd_ >= 0) {
-        // 解析配置的服务器地址 "IP:PORT"
-        std::string server_addr = CONFIG_AUDIO_DEBUG_UDP_SERVER;
-        size_t colon_pos = server_addr.find(':');
-        
-        if (colon_pos != std::string::npos) {
-            std::string ip = server_addr.substr(0, colon_pos);
-            int port = std::stoi(server_addr.substr(colon_pos + 1));
-            
-            memset(&udp_server_addr_, 0, sizeof(udp_server_addr_));
-            udp_server_addr_.sin_family = AF_INET;
-            udp_server_addr_.sin_port = htons(port);
-            inet_pton(AF_INET, ip.c_str(), &udp_server_addr_.sin_addr);
-            
-            ESP_LOGI(TAG, "Initialized server address: %s", CONFIG_AUDIO_DEBUG_UDP_SERVER);
+        if (SetServer(CONFIG_AUDIO_DEBUG_UDP_SERVER)) {
+            SetStageMask(CONFIG_AUDIO_DEBUG_TAP_STAGES);
         } else {
-            ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_AUDIO_DEBUG_UDP_SERVER);
             close(udp_sockfd_);
             udp_sockfd_ = -1;
         }
@@ -51,18 +44,124 @@ AudioDebugger::~AudioDebugger() {
 #endif
 }
 
-void AudioDebugger::Feed(const std::vector<int16_t>& data) {
+bool AudioDebugger::SetServer(const std::string& server_addr) {
 #if CONFIG_USE_AUDIO_DEBUGGER
-    if (udp_sockfd_ >= 0) {
-        ssize_t sent = sendto(udp_sockfd_, data.data(), data.size() * sizeof(int16_t), 0,
-                             (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
-        if (sent < 0) {
-            ESP_LOGW(TAG, "Failed to send audio data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
-        } else {
-            ESP_LOGD(TAG, "Sent %d bytes audio data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
+    // 解析服务器地址 "IP:PORT"
+    size_t colon_pos = server_addr.find(':');
+    if (colon_pos == std::string::npos) {
+        ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", server_addr.c_str());
+        return false;
+    }
+    std::string ip = server_addr.substr(0, colon_pos);
+    int port = atoi(server_addr.c_str() + colon_pos + 1);
+
+    // 解析失败时保留原来的地址, 发送中的数据不受影响
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) != 1) {
+        ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", server_addr.c_str());
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    udp_server_addr_ = addr;
+    ESP_LOGI(TAG, "Initialized server address: %s", server_addr.c_str());
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AudioDebugger::SetStageMask(uint32_t mask) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stage_mask_ = mask & ((1 << kAudioTapStageCount) - 1);
+    for (auto& tap : taps_) {
+        tap.frames = 0;
+    }
+}
+
+void AudioDebugger::Feed(AudioTapStage stage, const std::vector<int16_t>& data, int sample_rate, int channels) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (udp_sockfd_ < 0 || !(stage_mask_ & (1 << stage)) || data.empty() || sample_rate <= 0 || channels <= 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& tap = taps_[stage];
+    const size_t frame_bytes = channels * sizeof(int16_t);
+    const size_t frames = data.size() / channels;
+    int64_t start_time = esp_timer_get_time() - (int64_t)frames * 1000000 / sample_rate;
+
+    if (tap.frames > 0) {
+        // Start a new datagram when the format changes or the stream was interrupted
+        int64_t expected_time = tap.timestamp_us + (int64_t)tap.frames * 1000000 / tap.sample_rate;
+        if (tap.sample_rate != sample_rate || tap.channels != channels ||
+            start_time - expected_time > AUDIO_TAP_MAX_GAP_US) {
+            Flush(stage);
+        }
+    }
+
+    auto src = reinterpret_cast<const uint8_t*>(data.data());
+    size_t offset = 0;
+    while (offset < frames) {
+        if (tap.frames == 0) {
+            tap.sample_rate = sample_rate;
+            tap.channels = channels;
+            tap.timestamp_us = start_time + (int64_t)offset * 1000000 / sample_rate;
+            tap.datagram.resize(sizeof(AudioTapHeader));
+        }
+        size_t count = std::min(AUDIO_TAP_MAX_PAYLOAD / frame_bytes - tap.frames, frames - offset);
+        tap.datagram.insert(tap.datagram.end(), src + offset * frame_bytes, src + (offset + count) * frame_bytes);
+        tap.frames += count;
+        offset += count;
+        if ((tap.frames + 1) * frame_bytes > AUDIO_TAP_MAX_PAYLOAD) {
+            Flush(stage);
         }
     }
 #endif
 }
 
- 
\ No newline at end of file
+void AudioDebugger::Flush(AudioTapStage stage) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    auto& tap = taps_[stage];
+    if (tap.frames == 0) {
+        return;
+    }
+
+    AudioTapHeader header;
+    memcpy(header.magic, AUDIO_TAP_MAGIC, sizeof(header.magic));
+    header.version = AUDIO_TAP_VERSION;
+    header.stage = stage;
+    header.channels = tap.channels;
+    header.reserved = 0;
+    header.sequence = tap.sequence++;
+    header.sample_rate = tap.sample_rate;
+    header.frames = tap.frames;
+    header.timestamp_us = tap.timestamp_us;
+    memcpy(tap.datagram.data(), &header, sizeof(header));
+    tap.frames = 0;
+
+    if (sendto(udp_sockfd_, tap.datagram.data(), tap.datagram.size(), 0,
+               (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_)) < 0) {
+        ESP_LOGW(TAG, "Failed to send audio tap to server: %d", errno);
+    }
+#endif
+}
+
+void AudioDebugger::SendReport(const std::string& json) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    if (udp_sockfd_ >= 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Push out partially filled taps so a paused stream does not hold its last frames
+        for (int i = 0; i < kAudioTapStageCount; i++) {
+            Flush((AudioTapStage)i);
+        }
+        std::string message = AUDIO_DEBUGGER_REPORT_MAGIC + json;
+        if (sendto(udp_sockfd_, message.data(), message.size(), 0,
+                   (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_)) < 0) {
+            ESP_LOGW(TAG, "Failed to send report to server: %d", errno);
+        }
+    }
+#endif
+}
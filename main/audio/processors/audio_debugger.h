@@ -2,21 +2,82 @@
 #define AUDIO_DEBUGGER_H
 
 #include <vector>
+#include <string>
+#include <mutex>
 #include <cstdint>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+/*
+ * Audio tap protocol (UDP, little-endian)
+ *
+ * Every datagram starts with an AudioTapHeader followed by interleaved int16 PCM of one
+ * stage. Frames of the same stage are batched until a datagram is close to
+ * AUDIO_TAP_MAX_PAYLOAD, so a 60 ms frame no longer costs one sendto. The sequence number
+ * counts datagrams per stage (gaps mean loss) and timestamp_us is the esp_timer time of the
+ * first sample, which lets the receiver align the stages into one multi-track WAV.
+ * See scripts/audio_debug_server.py.
+ *
+ * Latency reports are sent as text datagrams starting with AUDIO_DEBUGGER_REPORT_MAGIC.
+ */
+#define AUDIO_TAP_MAGIC "XZTP"
+#define AUDIO_TAP_VERSION 1
+#define AUDIO_TAP_MAX_PAYLOAD 1400
+#define AUDIO_TAP_MAX_GAP_US 20000
+#define AUDIO_DEBUGGER_REPORT_MAGIC "XZRP"
+
+enum AudioTapStage : uint8_t {
+    kAudioTapMicRaw = 0,        // Codec input, after input resampling (mic + reference)
+    kAudioTapProcessed = 1,     // Audio processor (AEC / NS) output
+    kAudioTapDecoded = 2,       // Decoded TTS, before output resampling
+    kAudioTapPlayback = 3,      // PCM written to the codec
+    kAudioTapStageCount,
+};
+
+struct __attribute__((packed)) AudioTapHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t stage;
+    uint8_t channels;
+    uint8_t reserved;
+    uint32_t sequence;
+    uint32_t sample_rate;
+    uint32_t frames;
+    uint64_t timestamp_us;
+};
+
 class AudioDebugger {
 public:
     AudioDebugger();
     ~AudioDebugger();
 
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(AudioTapStage stage, const std::vector<int16_t>& data, int sample_rate, int channels);
+    // Text report datagram, prefixed with AUDIO_DEBUGGER_REPORT_MAGIC so receivers can tell it from audio
+    void SendReport(const std::string& json);
+
+    // Bit n enables stage n
+    void SetStageMask(uint32_t mask);
+    bool SetServer(const std::string& server_addr);
+    inline uint32_t stage_mask() const { return stage_mask_; }
 
 private:
+    struct TapBuffer {
+        std::vector<uint8_t> datagram;
+        uint32_t sequence = 0;
+        int sample_rate = 0;
+        int channels = 0;
+        uint32_t frames = 0;
+        int64_t timestamp_us = 0;
+    };
+
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+    std::mutex mutex_;
+    volatile uint32_t stage_mask_ = 0;
+    TapBuffer taps_[kAudioTapStageCount];
+
+    void Flush(AudioTapStage stage);
 };
 
-#endif 
\ No newline at end of file
+#endif
@@ -0,0 +1,188 @@
+#include "uplink_controller.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#define TAG "UplinkController"
+
+// The complexity stops going up once encoding takes a third of a 60ms frame
+#define UPLINK_MAX_ENCODE_US 20000
+
+struct UplinkLevel {
+    int bitrate;
+    int complexity;
+    bool dtx;
+};
+
+// OPUS_AUTO 在 16kHz 单声道下只有约 17kbps，最高一级给出明确的码率
+static const UplinkLevel kUplinkLevels[] = {
+    { 24000, 0, false },
+    { 16000, 1, false },
+    { 12000, 2, false },
+    { 8000, 3, true },
+};
+#define UPLINK_LEVEL_COUNT (int)(sizeof(kUplinkLevels) / sizeof(kUplinkLevels[0]))
+
+UplinkController::UplinkController() {
+    settings_.bitrate = kUplinkLevels[0].bitrate;
+    settings_.complexity = kUplinkLevels[0].complexity;
+    settings_.dtx = kUplinkLevels[0].dtx;
+    // The encoder starts with the defaults of UplinkSettings, the first Update applies level 0
+    changed_ = true;
+}
+
+void UplinkController::OnPacketSent(int64_t queue_wait_us, int64_t send_us, bool success) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!success) {
+        send_failures_++;
+        return;
+    }
+    sent_++;
+    total_send_us_ += send_us;
+    if (queue_wait_us > max_queue_wait_us_) {
+        max_queue_wait_us_ = queue_wait_us;
+    }
+}
+
+void UplinkController::OnPacketEncoded(int64_t encode_us, size_t send_queue_depth) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (encode_us > max_encode_us_) {
+        max_encode_us_ = encode_us;
+    }
+    if (send_queue_depth > max_queue_depth_) {
+        max_queue_depth_ = send_queue_depth;
+    }
+    queue_depth_ = send_queue_depth;
+}
+
+void UplinkController::OnLinkQuality(int rssi, uint32_t received, uint32_t lost) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rssi_ = rssi;
+    if (received < last_received_ || lost < last_lost_) {
+        // A new audio channel, the totals start again
+        last_received_ = 0;
+        last_lost_ = 0;
+    }
+    uint32_t new_received = received - last_received_;
+    uint32_t new_lost = lost - last_lost_;
+    // Wait for enough packets to say something about the loss
+    if (new_received + new_lost >= 10) {
+        int permille = new_lost * 1000 / (new_received + new_lost);
+        loss_permille_ = (loss_permille_ * 3 + permille) / 4;
+        last_received_ = received;
+        last_lost_ = lost;
+    }
+}
+
+bool UplinkController::Update(UplinkSettings& settings) {
+#if CONFIG_USE_ADAPTIVE_UPLINK
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    if (now - last_evaluate_time_ >= UPLINK_EVALUATE_INTERVAL_MS * 1000) {
+        last_evaluate_time_ = now;
+        Evaluate();
+    }
+    if (!changed_) {
+        return false;
+    }
+    changed_ = false;
+    settings = settings_;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void UplinkController::Evaluate() {
+    // A full TCP send buffer blocks every send for a while even when the link keeps up with the
+    // bitrate, slow sends only count once packets back up behind them
+    bool slow_sends = sent_ > 0 && total_send_us_ / sent_ >= UPLINK_CONGESTED_SEND_MS * 1000 &&
+        max_queue_depth_ > 1;
+    bool congested = send_failures_ > 0 || max_queue_depth_ >= UPLINK_CONGESTED_QUEUE_DEPTH ||
+        max_queue_wait_us_ >= UPLINK_CONGESTED_WAIT_MS * 1000 || slow_sends;
+    bool clean = !congested && sent_ > 0 && max_queue_depth_ <= 1;
+
+    // The backlog of a congested link takes a few intervals to drain after a step down, only
+    // step further while it is not shrinking
+    bool draining = send_failures_ == 0 && queue_depth_ < last_queue_depth_;
+
+    int level = settings_.level;
+    if (congested) {
+        if (!draining) {
+            level++;
+        }
+        clean_intervals_ = 0;
+    } else if (clean && ++clean_intervals_ >= UPLINK_RECOVER_INTERVALS) {
+        level--;
+        clean_intervals_ = 0;
+    }
+    // A weak signal does not carry the higher bitrates for long
+    int min_level = 0;
+    if (rssi_ != 0 && rssi_ < -85) {
+        min_level = 2;
+    } else if (rssi_ != 0 && rssi_ < -78) {
+        min_level = 1;
+    }
+    if (level < min_level) {
+        level = min_level;
+    }
+    if (level >= UPLINK_LEVEL_COUNT) {
+        level = UPLINK_LEVEL_COUNT - 1;
+    }
+    SetLevel(level, max_encode_us_);
+
+    last_queue_depth_ = queue_depth_;
+    max_queue_depth_ = 0;
+    max_queue_wait_us_ = 0;
+    total_send_us_ = 0;
+    max_encode_us_ = 0;
+    sent_ = 0;
+    send_failures_ = 0;
+}
+
+void UplinkController::SetLevel(int level, int64_t max_encode_us) {
+    UplinkSettings settings;
+    settings.level = level;
+    settings.bitrate = kUplinkLevels[level].bitrate;
+    settings.dtx = kUplinkLevels[level].dtx;
+    settings.complexity = kUplinkLevels[level].complexity;
+    if (max_encode_us > UPLINK_MAX_ENCODE_US && settings.complexity > settings_.complexity) {
+        settings.complexity = settings_.complexity;
+    }
+    settings.fec = loss_permille_ >= UPLINK_FEC_LOSS_PERCENT * 10;
+    if (settings.fec) {
+        settings.loss_percent = (loss_permille_ + 9) / 10;
+        if (settings.loss_percent > 30) {
+            settings.loss_percent = 30;
+        }
+    }
+
+    if (settings.level == settings_.level && settings.complexity == settings_.complexity &&
+        settings.fec == settings_.fec && settings.loss_percent == settings_.loss_percent) {
+        return;
+    }
+    ESP_LOGI(TAG, "Uplink level %d: bitrate %d, complexity %d, dtx %d, fec %d (loss %d%%), rssi %d",
+        settings.level, settings.bitrate, settings.complexity, settings.dtx, settings.fec, settings.loss_percent, rssi_);
+    settings_ = settings;
+    changed_ = true;
+    Metrics::GetInstance().SetGauge(kMetricUplinkLevel, level);
+}
+
+std::string UplinkController::GetStatusJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "level", settings_.level);
+    cJSON_AddNumberToObject(root, "bitrate", settings_.bitrate);
+    cJSON_AddNumberToObject(root, "complexity", settings_.complexity);
+    cJSON_AddBoolToObject(root, "dtx", settings_.dtx);
+    cJSON_AddBoolToObject(root, "fec", settings_.fec);
+    cJSON_AddNumberToObject(root, "loss_percent", settings_.loss_percent);
+    cJSON_AddNumberToObject(root, "rssi", rssi_);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
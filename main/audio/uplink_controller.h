@@ -0,0 +1,72 @@
+#ifndef UPLINK_CONTROLLER_H
+#define UPLINK_CONTROLLER_H
+
+#include "opus_uplink_encoder.h"
+
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Uplink congestion control.
+ *
+ * Once per UPLINK_EVALUATE_INTERVAL_MS the controller looks at what happened to the uplink
+ * since the last evaluation: the deepest send queue, the time packets waited in it and
+ * Protocol::SendAudio took, send failures, the receive loss of the audio channel and the
+ * Wi-Fi RSSI. A congested interval moves one level down the bitrate ladder at once, unless the
+ * send queue is already shrinking after the last step, a level back up needs
+ * UPLINK_RECOVER_INTERVALS clean intervals in a row. Lower levels raise the
+ * complexity to keep the speech intelligible, unless encoding already takes too long. In-band
+ * FEC is switched on with the measured loss while it stays above UPLINK_FEC_LOSS_PERCENT.
+ */
+#define UPLINK_EVALUATE_INTERVAL_MS 1000
+#define UPLINK_RECOVER_INTERVALS 5
+#define UPLINK_CONGESTED_QUEUE_DEPTH 4      // 240ms of audio waiting to be sent
+#define UPLINK_CONGESTED_WAIT_MS 200
+#define UPLINK_CONGESTED_SEND_MS 20
+#define UPLINK_FEC_LOSS_PERCENT 2
+
+class UplinkController {
+public:
+    UplinkController();
+
+    // Main loop, after every Protocol::SendAudio
+    void OnPacketSent(int64_t queue_wait_us, int64_t send_us, bool success);
+    // Opus task, after every encoded frame
+    void OnPacketEncoded(int64_t encode_us, size_t send_queue_depth);
+    // Main loop, once a second. rssi 0 means unknown, received / lost are totals of the channel
+    void OnLinkQuality(int rssi, uint32_t received, uint32_t lost);
+
+    // Opus task, true when the encoder needs new settings
+    bool Update(UplinkSettings& settings);
+    // {"level":n,"bitrate":n,"complexity":n,"dtx":false,"fec":false,"loss_percent":n,"rssi":n}
+    std::string GetStatusJson();
+
+private:
+    std::mutex mutex_;
+    UplinkSettings settings_;
+    bool changed_ = false;
+    int64_t last_evaluate_time_ = 0;
+    int clean_intervals_ = 0;
+
+    // Observations of the current interval
+    size_t max_queue_depth_ = 0;
+    size_t queue_depth_ = 0;            // Of the last encoded packet
+    size_t last_queue_depth_ = 0;       // queue_depth_ at the previous evaluation
+    int64_t max_queue_wait_us_ = 0;
+    int64_t total_send_us_ = 0;
+    int64_t max_encode_us_ = 0;
+    uint32_t sent_ = 0;
+    uint32_t send_failures_ = 0;
+
+    int rssi_ = 0;
+    uint32_t last_received_ = 0;
+    uint32_t last_lost_ = 0;
+    int loss_permille_ = 0;         // Smoothed receive loss
+
+    void Evaluate();
+    void SetLevel(int level, int64_t max_encode_us);
+};
+
+#endif // UPLINK_CONTROLLER_H
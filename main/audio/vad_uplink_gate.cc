@@ -0,0 +1,101 @@
+#include "vad_uplink_gate.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+
+#define TAG "VadUplinkGate"
+
+void VadUplinkGate::Reset(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (enabled != enabled_) {
+        ESP_LOGI(TAG, "VAD gated uplink %s", enabled ? "enabled" : "disabled");
+    }
+    enabled_ = enabled;
+    hangover_ = VAD_GATE_HANGOVER_FRAMES;
+    silent_frames_ = 0;
+    preroll_.clear();
+}
+
+void VadUplinkGate::OnVadChange(bool speaking) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    speaking_ = speaking;
+}
+
+void VadUplinkGate::Push(std::unique_ptr<AudioStreamPacket> packet, std::deque<std::unique_ptr<AudioStreamPacket>>& send_queue,
+                         size_t max_queued) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.frames++;
+    stats_.duration_ms += packet->frame_duration;
+    stats_.bytes_encoded += packet->payload.size();
+
+    if (!enabled_ || speaking_ || hangover_ > 0) {
+        if (speaking_) {
+            hangover_ = VAD_GATE_HANGOVER_FRAMES;
+        } else if (hangover_ > 0) {
+            hangover_--;
+        }
+        silent_frames_ = 0;
+        // Speech started, the onset is in the preroll. The send queue keeps its bound, the
+        // oldest preroll goes first when there is no room
+        size_t room = max_queued > send_queue.size() + 1 ? max_queued - send_queue.size() - 1 : 0;
+        while (preroll_.size() > room) {
+            preroll_.pop_front();
+            Metrics::GetInstance().Increment(kMetricUplinkSuppressed);
+        }
+        while (!preroll_.empty()) {
+            Send(std::move(preroll_.front()), send_queue);
+            preroll_.pop_front();
+        }
+        Send(std::move(packet), send_queue);
+        return;
+    }
+
+    if (silent_frames_++ % VAD_GATE_HINT_FRAMES == 0) {
+        // Frames older than the hint can no longer go out in order, the preroll starts over
+        Metrics::GetInstance().Increment(kMetricUplinkSuppressed, preroll_.size());
+        preroll_.clear();
+        Send(std::move(packet), send_queue);
+        return;
+    }
+    preroll_.push_back(std::move(packet));
+    if (preroll_.size() > VAD_GATE_PREROLL_FRAMES) {
+        preroll_.pop_front();
+        Metrics::GetInstance().Increment(kMetricUplinkSuppressed);
+    }
+}
+
+void VadUplinkGate::Send(std::unique_ptr<AudioStreamPacket> packet, std::deque<std::unique_ptr<AudioStreamPacket>>& send_queue) {
+    stats_.frames_sent++;
+    stats_.bytes_sent += packet->payload.size();
+    Metrics::GetInstance().Increment(kMetricUplinkBytes, packet->payload.size());
+    send_queue.push_back(std::move(packet));
+}
+
+bool VadUplinkGate::IsSuppressing() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return enabled_ && !speaking_ && hangover_ == 0;
+}
+
+VadGateStats VadUplinkGate::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::string VadUplinkGate::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "enabled", enabled_);
+    cJSON_AddNumberToObject(root, "frames", stats_.frames);
+    cJSON_AddNumberToObject(root, "frames_sent", stats_.frames_sent);
+    cJSON_AddNumberToObject(root, "bytes_encoded", stats_.bytes_encoded);
+    cJSON_AddNumberToObject(root, "bytes_sent", stats_.bytes_sent);
+    // Per minute of listening
+    cJSON_AddNumberToObject(root, "bytes_per_minute", stats_.duration_ms > 0 ?
+        (int)((uint64_t)stats_.bytes_sent * 60000 / stats_.duration_ms) : 0);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,64 @@
+#ifndef VAD_UPLINK_GATE_H
+#define VAD_UPLINK_GATE_H
+
+#include "protocol.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+/*
+ * VAD gate of the listening uplink, used when the server accepted the "vad_gate" feature.
+ *
+ * Every frame is still encoded so the Opus state stays continuous, the gate only decides
+ * what is sent. While the AFE VAD reports speech, and for VAD_GATE_HANGOVER_FRAMES after it
+ * falls, everything goes out. In silence the encoder runs Opus DTX and the gate sends one
+ * packet every VAD_GATE_HINT_FRAMES as a comfort noise hint, so the server decoder keeps its
+ * background noise and its VAD keeps a clock. The other silent packets wait in a ring of
+ * VAD_GATE_PREROLL_FRAMES and are sent ahead of the first speech packet, the AFE VAD only
+ * fires some way into the word. A hint drops the preroll before it, so packets always go out
+ * in encoding order.
+ */
+#define VAD_GATE_PREROLL_FRAMES 3       // 180ms before the VAD fires
+#define VAD_GATE_HANGOVER_FRAMES 8      // 480ms, pauses inside a sentence are sent as they are
+#define VAD_GATE_HINT_FRAMES 7          // One packet per 420ms of silence
+
+struct VadGateStats {
+    uint32_t frames = 0;            // Encoded frames while listening
+    uint32_t duration_ms = 0;       // Audio in those frames
+    uint32_t frames_sent = 0;
+    uint32_t bytes_encoded = 0;
+    uint32_t bytes_sent = 0;
+};
+
+class VadUplinkGate {
+public:
+    // Start of a listening turn. The first frames count as hangover so the words spoken right
+    // after the wake word are never held back
+    void Reset(bool enabled);
+    void OnVadChange(bool speaking);
+    // Called for every encoded frame in order, appends the packets to send now. The caller makes
+    // room for the packet itself, the preroll is cut so send_queue stays within max_queued
+    void Push(std::unique_ptr<AudioStreamPacket> packet, std::deque<std::unique_ptr<AudioStreamPacket>>& send_queue,
+              size_t max_queued);
+    // Silence is being suppressed, the encoder should run DTX
+    bool IsSuppressing();
+    VadGateStats GetStats();
+    // {"enabled":false,"frames":n,"frames_sent":n,"bytes_encoded":n,"bytes_sent":n,"bytes_per_minute":n}
+    std::string GetStatsJson();
+
+private:
+    std::mutex mutex_;
+    bool enabled_ = false;
+    bool speaking_ = false;
+    int hangover_ = 0;
+    uint32_t silent_frames_ = 0;
+    std::deque<std::unique_ptr<AudioStreamPacket>> preroll_;
+    VadGateStats stats_;
+
+    void Send(std::unique_ptr<AudioStreamPacket> packet, std::deque<std::unique_ptr<AudioStreamPacket>>& send_queue);
+};
+
+#endif // VAD_UPLINK_GATE_H
@@ -20,6 +20,9 @@ public:
     virtual void EncodeWakeWordData() = 0;
     virtual bool GetWakeWordOpus(std::vector<uint8_t>& opus) = 0;
     virtual const std::string& GetLastDetectedWakeWord() const = 0;
+
+    // 本地命令词: 识别到后直接在音频输入任务中回调，不唤醒对话。回调必须立即返回
+    virtual bool AddCommand(const std::string& phrase, std::function<void()> callback) { return false; }
 };
 
 #endif
@@ -55,14 +55,30 @@ bool CustomWakeWord::Initialize(AudioCodec* codec) {
     multinet_ = esp_mn_handle_from_name(mn_name_);
     multinet_model_data_ = multinet_->create(mn_name_, 3000);  // 3 秒超时
     multinet_->set_det_threshold(multinet_model_data_, CONFIG_CUSTOM_WAKE_WORD_THRESHOLD / 100.0f);
+    std::lock_guard<std::mutex> lock(commands_mutex_);
     esp_mn_commands_clear();
     esp_mn_commands_add(1, CONFIG_CUSTOM_WAKE_WORD);
+    for (size_t i = 0; i < commands_.size(); i++) {
+        esp_mn_commands_add(kFirstCommandId + i, commands_[i].phrase.c_str());
+    }
     esp_mn_commands_update();
     
     multinet_->print_active_speech_commands(multinet_model_data_);
     return true;
 }
 
+bool CustomWakeWord::AddCommand(const std::string& phrase, std::function<void()> callback) {
+    // Feed 在音频输入任务中读取命令表，注册可能来自其他任务
+    std::lock_guard<std::mutex> lock(commands_mutex_);
+    commands_.push_back({phrase, callback});
+    // 已经初始化过则立即生效，否则在 Initialize 中统一注册
+    if (multinet_model_data_ != nullptr) {
+        esp_mn_commands_add(kFirstCommandId + commands_.size() - 1, phrase.c_str());
+        esp_mn_commands_update();
+    }
+    return true;
+}
+
 void CustomWakeWord::OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) {
     wake_word_detected_callback_ = callback;
 }
@@ -80,6 +96,7 @@ void CustomWakeWord::Feed(const std::vector<int16_t>& data) {
         return;
     }
 
+    std::unique_lock<std::mutex> lock(commands_mutex_);
     esp_mn_state_t mn_state;
     // If input channels is 2, we need to fetch the left channel data
     if (codec_->input_channels() == 2) {
@@ -101,8 +118,24 @@ void CustomWakeWord::Feed(const std::vector<int16_t>& data) {
         esp_mn_results_t *mn_result = multinet_->get_results(multinet_model_data_);
         ESP_LOGI(TAG, "Custom wake word detected: command_id=%d, string=%s, prob=%f", 
                 mn_result->command_id[0], mn_result->string, mn_result->prob[0]);
-        
-        if (mn_result->command_id[0] == 1) {
+
+        // 本地命令词直接执行，保持检测状态，不进入对话
+        int command_id = mn_result->command_id[0];
+        int command_index = command_id - kFirstCommandId;
+        multinet_->clean(multinet_model_data_);
+        if (command_index >= 0 && command_index < (int)commands_.size()) {
+            ESP_LOGI(TAG, "Local command detected: %s", commands_[command_index].phrase.c_str());
+            // 回调在锁外执行，回调中注册命令词不会死锁
+            auto callback = commands_[command_index].callback;
+            lock.unlock();
+            if (callback) {
+                callback();
+            }
+            return;
+        }
+        lock.unlock();
+
+        if (command_id == 1) {
             last_detected_wake_word_ = CONFIG_CUSTOM_WAKE_WORD_DISPLAY;
         }
         running_ = false;
@@ -110,7 +143,6 @@ void CustomWakeWord::Feed(const std::vector<int16_t>& data) {
         if (wake_word_detected_callback_) {
             wake_word_detected_callback_(last_detected_wake_word_);
         }
-        multinet_->clean(multinet_model_data_);
     } else if (mn_state == ESP_MN_STATE_TIMEOUT) {
         ESP_LOGD(TAG, "Command word detection timeout, cleaning state");
         multinet_->clean(multinet_model_data_);
@@ -31,8 +31,17 @@ public:
     void EncodeWakeWordData();
     bool GetWakeWordOpus(std::vector<uint8_t>& opus);
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
+    bool AddCommand(const std::string& phrase, std::function<void()> callback) override;
 
 private:
+    struct LocalCommand {
+        std::string phrase;
+        std::function<void()> callback;
+    };
+
+    // command_id 1 是唤醒词，本地命令词从 2 开始
+    static constexpr int kFirstCommandId = 2;
+
     // multinet 相关成员变量
     esp_mn_iface_t* multinet_ = nullptr;
     model_iface_data_t* multinet_model_data_ = nullptr;
@@ -40,6 +49,9 @@ private:
     char* mn_name_ = nullptr;
  
     std::function<void(const std::string& wake_word)> wake_word_detected_callback_;
+    // Guards commands_ and the MultiNet command table, which AddCommand may update during Feed
+    std::mutex commands_mutex_;
+    std::vector<LocalCommand> commands_;
     AudioCodec* codec_ = nullptr;
     std::string last_detected_wake_word_;
     std::atomic<bool> running_ = false;
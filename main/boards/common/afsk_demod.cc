@@ -1,8 +1,8 @@
 #include "afsk_demod.h"
 #include <cstring>
+#include <cmath>
 #include <algorithm>
 #include "esp_log.h"
-#include "display.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -12,97 +12,6 @@ namespace audio_wifi_config
 {
     static const char *kLogTag = "AUDIO_WIFI_CONFIG";
 
-    void ReceiveWifiCredentialsFromAudio(Application *app,
-                                        WifiConfigurationAp *wifi_ap,
-                                        Display *display,
-                                        size_t input_channels
-                                    )
-    {
-        const int kInputSampleRate = 16000;                                    // Input sampling rate
-        const float kDownsampleStep = static_cast<float>(kInputSampleRate) / static_cast<float>(kAudioSampleRate); // Downsampling step
-        std::vector<int16_t> audio_data;
-        AudioSignalProcessor signal_processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize);
-        AudioDataBuffer data_buffer;
-
-        while (true)
-        {
-            // 检查Application状态，只有在WiFi配置模式下才处理音频
-            if (app->GetDeviceState() != kDeviceStateWifiConfiguring) {
-                // 不在WiFi配置状态，休眠100ms后再检查
-                vTaskDelay(pdMS_TO_TICKS(100));
-                continue;
-            }
-            
-            if (!app->GetAudioService().ReadAudioData(audio_data, 16000, 480)) { // 16kHz, 480 samples corresponds to 30ms data
-                // 读取音频失败，短暂延迟后重试
-                ESP_LOGI(kLogTag, "Failed to read audio data, retrying.");
-                vTaskDelay(pdMS_TO_TICKS(10));
-                continue;
-            }
-
-            if (input_channels == 2) { // 如果是双声道输入，转换为单声道
-                auto mono_data = std::vector<int16_t>(audio_data.size() / 2);
-                for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                    mono_data[i] = audio_data[j];
-                }
-                audio_data = std::move(mono_data);
-            }
-            
-            // Downsample the audio data
-            std::vector<float> downsampled_data;
-            size_t last_index = 0;
-
-            if (kDownsampleStep > 1.0f) {
-                downsampled_data.reserve(audio_data.size() / static_cast<size_t>(kDownsampleStep));
-                for (size_t i = 0; i < audio_data.size(); ++i) {
-                    size_t sample_index = static_cast<size_t>(i / kDownsampleStep);
-                    if ((sample_index + 1) > last_index) {
-                        downsampled_data.push_back(static_cast<float>(audio_data[i]));
-                        last_index = sample_index + 1;
-                    }
-                }
-            } else {
-                downsampled_data.reserve(audio_data.size());
-                for (int16_t sample : audio_data) {
-                    downsampled_data.push_back(static_cast<float>(sample));
-                }
-            }
-            
-            // Process audio samples to get probability data
-            auto probabilities = signal_processor.ProcessAudioSamples(downsampled_data);
-            
-            // Feed probability data to the data buffer
-            if (data_buffer.ProcessProbabilityData(probabilities, 0.5f)) {
-                // If complete data was received, extract WiFi credentials
-                if (data_buffer.decoded_text.has_value()) {
-                    ESP_LOGI(kLogTag, "Received text data: %s", data_buffer.decoded_text->c_str());
-                    display->SetChatMessage("system", data_buffer.decoded_text->c_str());
-                    
-                    // Split SSID and password by newline character
-                    std::string wifi_ssid, wifi_password;
-                    size_t newline_position = data_buffer.decoded_text->find('\n');
-                    if (newline_position != std::string::npos) {
-                        wifi_ssid = data_buffer.decoded_text->substr(0, newline_position);
-                        wifi_password = data_buffer.decoded_text->substr(newline_position + 1);
-                        ESP_LOGI(kLogTag, "WiFi SSID: %s, Password: %s", wifi_ssid.c_str(), wifi_password.c_str());
-                    } else {
-                        ESP_LOGE(kLogTag, "Invalid data format, no newline character found");
-                        continue;
-                    }
-                    
-                    if (wifi_ap->ConnectToWifi(wifi_ssid, wifi_password)) {
-                        wifi_ap->Save(wifi_ssid, wifi_password);  // Save WiFi credentials
-                        esp_restart();                            // Restart device to apply new WiFi configuration
-                    } else {
-                        ESP_LOGE(kLogTag, "Failed to connect to WiFi with received credentials");
-                    }
-                    data_buffer.decoded_text.reset();  // Clear processed data
-                }
-            }
-            vTaskDelay(pdMS_TO_TICKS(1));  // 1ms delay
-        }
-    }
-
     // Default start and end transmission identifiers
     // \x01\x02 = 00000001 00000010
     const std::vector<uint8_t> kDefaultStartTransmissionPattern = {
@@ -112,134 +21,170 @@ namespace audio_wifi_config
     const std::vector<uint8_t> kDefaultEndTransmissionPattern = {
         0, 0, 0, 0, 0, 0, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0};
 
-    // FrequencyDetector implementation
-    FrequencyDetector::FrequencyDetector(float frequency, size_t window_size)
-        : frequency_(frequency), window_size_(window_size) {
-        frequency_bin_ = std::floor(frequency_ * static_cast<float>(window_size_));
-        angular_frequency_ = 2.0f * M_PI * frequency_;
-        cos_coefficient_ = std::cos(angular_frequency_);
-        sin_coefficient_ = std::sin(angular_frequency_);
-        filter_coefficient_ = 2.0f * cos_coefficient_;
-
-        // Initialize state buffer
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
+    // Low-pass for 16 kHz -> 8 kHz, Hamming windowed sinc with 3.2 kHz cutoff, Q15, unity DC gain
+    static const int16_t kDecimatorCoefficients[Decimator::kTaps] = {
+        72, 0, -168, -183, 305, 783, 0, -1810, -1717, 2837, 9720, 13090,
+        9720, 2837, -1717, -1810, 0, 783, 305, -183, -168, 0, 72};
+
+    // One period of sin() in Q15, indexed by the top 8 bits of a 32-bit phase
+    static const int16_t *GetSineTable() {
+        static int16_t table[256];
+        static bool initialized = [] {
+            for (int i = 0; i < 256; i++) {
+                table[i] = static_cast<int16_t>(std::lround(32767.0 * std::sin(2.0 * M_PI * i / 256)));
+            }
+            return true;
+        }();
+        (void)initialized;
+        return table;
     }
 
-    void FrequencyDetector::Reset() {
-        state_buffer_.clear();
-        state_buffer_.push_back(0.0f);
-        state_buffer_.push_back(0.0f);
+    // Decimator implementation
+    void Decimator::Reset() {
+        memset(history_, 0, sizeof(history_));
+        position_ = 0;
+        odd_ = false;
     }
 
-    void FrequencyDetector::ProcessSample(float sample) {
-        if (state_buffer_.size() < 2) {
-            return;
+    inline bool Decimator::Process(int16_t sample, int16_t &output) {
+        history_[position_] = sample;
+        history_[position_ + kTaps] = sample;
+        if (++position_ == kTaps) {
+            position_ = 0;
+        }
+        odd_ = !odd_;
+        if (odd_) {
+            return false;
         }
 
-        float s_minus_2 = state_buffer_.front();  // S[-2]
-        state_buffer_.pop_front();
-        float s_minus_1 = state_buffer_.front();  // S[-1]
-        state_buffer_.pop_front();
-
-        float s_current = sample + filter_coefficient_ * s_minus_1 - s_minus_2;
-
-        state_buffer_.push_back(s_minus_1);  // Put S[-1] back
-        state_buffer_.push_back(s_current);  // Add new S[0]
-    }
-
-    float FrequencyDetector::GetAmplitude() const {
-        if (state_buffer_.size() < 2) {
-            return 0.0f;
+        // history_[position_ .. position_ + kTaps) holds the newest kTaps samples, oldest first
+        const int16_t *x = &history_[position_];
+        int32_t acc = 1 << 14;
+        for (size_t i = 0; i < kTaps; i++) {
+            acc += static_cast<int32_t>(x[i]) * kDecimatorCoefficients[i];
         }
+        acc >>= 15;
+        output = static_cast<int16_t>(std::clamp<int32_t>(acc, INT16_MIN, INT16_MAX));
+        return true;
+    }
 
-        float s_minus_1 = state_buffer_[1];                      // S[-1]
-        float s_minus_2 = state_buffer_[0];                      // S[-2]
-        float real_part = cos_coefficient_ * s_minus_1 - s_minus_2;  // Real part
-        float imaginary_part = sin_coefficient_ * s_minus_1;         // Imaginary part
+    // ToneCorrelator implementation
+    void ToneCorrelator::Configure(size_t sample_rate, size_t frequency, size_t window_size) {
+        phase_step_ = static_cast<uint32_t>(std::llround(static_cast<double>(frequency) / sample_rate * 4294967296.0));
+        window_size_ = std::clamp<size_t>(window_size, 1, kMaxWindow);
+        Reset();
+    }
 
-        return std::sqrt(real_part * real_part + imaginary_part * imaginary_part) / 
-               (static_cast<float>(window_size_) / 2.0f);
+    void ToneCorrelator::Reset() {
+        phase_ = 0;
+        position_ = 0;
+        sum_i_ = 0;
+        sum_q_ = 0;
+        memset(ring_i_, 0, sizeof(ring_i_));
+        memset(ring_q_, 0, sizeof(ring_q_));
     }
 
-    // AudioSignalProcessor implementation
-    AudioSignalProcessor::AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
-                                             size_t bit_rate, size_t window_size)
-        : input_buffer_size_(window_size), output_sample_count_(0) {
-        if (sample_rate % bit_rate != 0) {
-            // On ESP32 we can continue execution, but log the error
-            ESP_LOGW(kLogTag, "Sample rate %zu is not divisible by bit rate %zu", sample_rate, bit_rate);
+    inline int64_t ToneCorrelator::Process(int16_t sample) {
+        static const int16_t *sine = GetSineTable();
+        uint8_t index = phase_ >> 24;
+        phase_ += phase_step_;
+
+        int16_t i = (static_cast<int32_t>(sample) * sine[static_cast<uint8_t>(index + 64)]) >> 15;
+        int16_t q = (static_cast<int32_t>(sample) * sine[index]) >> 15;
+        sum_i_ += i - ring_i_[position_];
+        sum_q_ += q - ring_q_[position_];
+        ring_i_[position_] = i;
+        ring_q_[position_] = q;
+        if (++position_ == window_size_) {
+            position_ = 0;
         }
+        return static_cast<int64_t>(sum_i_) * sum_i_ + static_cast<int64_t>(sum_q_) * sum_q_;
+    }
 
-        float normalized_mark_freq = static_cast<float>(mark_frequency) / static_cast<float>(sample_rate);
-        float normalized_space_freq = static_cast<float>(space_frequency) / static_cast<float>(sample_rate);
-
-        mark_detector_ = std::make_unique<FrequencyDetector>(normalized_mark_freq, window_size);
-        space_detector_ = std::make_unique<FrequencyDetector>(normalized_space_freq, window_size);
-
-        samples_per_bit_ = sample_rate / bit_rate;  // Number of samples per bit
+    // AfskDemodulator implementation
+    AfskDemodulator::AfskDemodulator(size_t mark_frequency, size_t space_frequency, size_t bit_rate) {
+        bit_rate = std::max(bit_rate, kMinBitRate);
+        size_t window_size = (kAudioSampleRate + bit_rate / 2) / bit_rate;
+        mark_correlator_.Configure(kAudioSampleRate, mark_frequency, window_size);
+        space_correlator_.Configure(kAudioSampleRate, space_frequency, window_size);
+        bit_period_ = static_cast<int32_t>((kAudioSampleRate << 8) / bit_rate);
     }
 
-    std::vector<float> AudioSignalProcessor::ProcessAudioSamples(const std::vector<float> &samples) {
-        std::vector<float> result;
-
-        for (float sample : samples) {
-            if (input_buffer_.size() < input_buffer_size_) {
-                input_buffer_.push_back(sample);  // Just add, don't process yet
-            } else {
-                // Input buffer is full, process the data
-                input_buffer_.pop_front();   // Remove oldest sample
-                input_buffer_.push_back(sample);  // Add new sample
-                output_sample_count_++;
-
-                if (output_sample_count_ >= samples_per_bit_) {
-                    // Process all samples in the window using Goertzel algorithm
-                    for (float window_sample : input_buffer_) {
-                        mark_detector_->ProcessSample(window_sample);
-                        space_detector_->ProcessSample(window_sample);
-                    }
+    void AfskDemodulator::Reset() {
+        decimator_.Reset();
+        mark_correlator_.Reset();
+        space_correlator_.Reset();
+        clock_ = 0;
+        clock_adjusted_ = false;
+        last_mark_ = false;
+    }
 
-                    float mark_amplitude = mark_detector_->GetAmplitude();   // Mark amplitude
-                    float space_amplitude = space_detector_->GetAmplitude(); // Space amplitude
+    size_t AfskDemodulator::Process(const int16_t *samples, size_t frames, size_t stride, uint8_t *bits, size_t max_bits) {
+        size_t count = 0;
+        for (size_t n = 0; n < frames; n++) {
+            int16_t sample;
+            if (!decimator_.Process(samples[n * stride], sample)) {
+                continue;
+            }
 
-                    // Avoid division by zero
-                    float mark_probability = mark_amplitude / 
-                                           (space_amplitude + mark_amplitude + std::numeric_limits<float>::epsilon());
-                    result.push_back(mark_probability);
+            bool is_mark = mark_correlator_.Process(sample) > space_correlator_.Process(sample);
+            clock_ += 256;
+
+            // The window metric flips half a bit after a symbol edge, which should be half a
+            // period before the sampling instant. Only the first flip of a bit steers the clock,
+            // noise near the crossing makes it chatter, and the loop gain is 1/8.
+            if (is_mark != last_mark_) {
+                last_mark_ = is_mark;
+                if (!clock_adjusted_) {
+                    clock_adjusted_ = true;
+                    clock_ -= (clock_ - bit_period_ / 2) / 8;
+                }
+            }
 
-                    // Reset detector windows
-                    mark_detector_->Reset();
-                    space_detector_->Reset();
-                    output_sample_count_ = 0;  // Reset output counter
+            // The window now covers exactly one bit
+            if (clock_ >= bit_period_) {
+                clock_ -= bit_period_;
+                clock_adjusted_ = false;
+                if (count < max_bits) {
+                    bits[count++] = is_mark ? 1 : 0;
                 }
             }
         }
-
-        return result;
+        return count;
     }
 
     // AudioDataBuffer implementation
-    AudioDataBuffer::AudioDataBuffer()
-        : current_state_(DataReceptionState::kInactive),
-          start_of_transmission_(kDefaultStartTransmissionPattern),
-          end_of_transmission_(kDefaultEndTransmissionPattern),
-          enable_checksum_validation_(true) {
-        identifier_buffer_size_ = std::max(start_of_transmission_.size(), end_of_transmission_.size());
-        max_bit_buffer_size_ = 776;  // Preset bit buffer size, 776 bits = (32 + 1 + 63 + 1) * 8 = 776
+    static uint32_t PackIdentifier(const std::vector<uint8_t> &bits) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < bits.size() && i < 32; i++) {
+            value = (value << 1) | (bits[i] & 1);
+        }
+        return value;
+    }
+
+    static inline bool MatchIdentifier(uint32_t history, size_t history_size, uint32_t identifier, size_t identifier_size) {
+        if (identifier_size == 0 || history_size < identifier_size) {
+            return false;
+        }
+        uint32_t mask = identifier_size >= 32 ? 0xFFFFFFFF : ((1u << identifier_size) - 1);
+        return (history & mask) == identifier;
+    }
 
-        bit_buffer_.reserve(max_bit_buffer_size_);
+    AudioDataBuffer::AudioDataBuffer()
+        : AudioDataBuffer(97, kDefaultStartTransmissionPattern, kDefaultEndTransmissionPattern, true) {
+        // 97 bytes = 32 (SSID) + 1 (\n) + 63 (password) + 1 (checksum), plus the end identifier
     }
 
     AudioDataBuffer::AudioDataBuffer(size_t max_byte_size, const std::vector<uint8_t> &start_identifier,
                                    const std::vector<uint8_t> &end_identifier, bool enable_checksum)
         : current_state_(DataReceptionState::kInactive),
-          start_of_transmission_(start_identifier),
-          end_of_transmission_(end_identifier),
+          max_byte_size_(max_byte_size),
           enable_checksum_validation_(enable_checksum) {
-        identifier_buffer_size_ = std::max(start_of_transmission_.size(), end_of_transmission_.size());
-        max_bit_buffer_size_ = max_byte_size * 8;  // Bit buffer size in bytes
-
-        bit_buffer_.reserve(max_bit_buffer_size_);
+        start_identifier_ = PackIdentifier(start_identifier);
+        end_identifier_ = PackIdentifier(end_identifier);
+        start_identifier_size_ = std::min<size_t>(start_identifier.size(), 32);
+        end_identifier_size_ = std::min<size_t>(end_identifier.size(), 32);
+        byte_buffer_.reserve(max_byte_size_ + end_identifier_size_ / 8);
     }
 
     uint8_t AudioDataBuffer::CalculateChecksum(const std::string &text) {
@@ -251,98 +196,58 @@ namespace audio_wifi_config
     }
 
     void AudioDataBuffer::ClearBuffers() {
-        identifier_buffer_.clear();
-        bit_buffer_.clear();
+        identifier_bits_ = 0;
+        identifier_count_ = 0;
+        byte_buffer_.clear();
+        current_byte_ = 0;
+        current_bit_count_ = 0;
     }
 
-    bool AudioDataBuffer::ProcessProbabilityData(const std::vector<float> &probabilities, float threshold) {
-        for (float probability : probabilities) {
-            uint8_t bit = (probability > threshold) ? 1 : 0;
-
-            if (identifier_buffer_.size() >= identifier_buffer_size_) {
-                identifier_buffer_.pop_front();  // Maintain buffer size
+    bool AudioDataBuffer::ProcessBits(const uint8_t *bits, size_t count) {
+        for (size_t n = 0; n < count; n++) {
+            uint8_t bit = bits[n] & 1;
+            identifier_bits_ = (identifier_bits_ << 1) | bit;
+            if (identifier_count_ < 32) {
+                identifier_count_++;
             }
-            identifier_buffer_.push_back(bit);
 
             // Process received bit based on state machine
             switch (current_state_) {
             case DataReceptionState::kInactive:
-                if (identifier_buffer_.size() >= start_of_transmission_.size()) {
+                if (identifier_count_ >= start_identifier_size_) {
                     current_state_ = DataReceptionState::kWaiting;  // Enter waiting state
                     ESP_LOGI(kLogTag, "Entering Waiting state");
                 }
                 break;
 
             case DataReceptionState::kWaiting:
-                // Waiting state, possibly waiting for transmission end
-                if (identifier_buffer_.size() >= start_of_transmission_.size()) {
-                    std::vector<uint8_t> identifier_snapshot(identifier_buffer_.begin(), identifier_buffer_.end());
-                    if (identifier_snapshot == start_of_transmission_)
-                    {
-                        ClearBuffers();                                // Clear buffers
-                        current_state_ = DataReceptionState::kReceiving;  // Enter receiving state
-                        ESP_LOGI(kLogTag, "Entering Receiving state");
-                    }
+                if (MatchIdentifier(identifier_bits_, identifier_count_, start_identifier_, start_identifier_size_)) {
+                    ClearBuffers();                                   // Clear buffers
+                    current_state_ = DataReceptionState::kReceiving;  // Enter receiving state
+                    ESP_LOGI(kLogTag, "Entering Receiving state");
                 }
                 break;
 
             case DataReceptionState::kReceiving:
-                bit_buffer_.push_back(bit);
-                if (identifier_buffer_.size() >= end_of_transmission_.size()) {
-                    std::vector<uint8_t> identifier_snapshot(identifier_buffer_.begin(), identifier_buffer_.end());
-                    if (identifier_snapshot == end_of_transmission_) {
-                        current_state_ = DataReceptionState::kInactive;  // Enter inactive state
-
-                        // Convert bits to bytes
-                        std::vector<uint8_t> bytes = ConvertBitsToBytes(bit_buffer_);
-
-                        uint8_t received_checksum = 0;
-                        size_t minimum_length = 0;
-
-                        if (enable_checksum_validation_) {
-                            // If checksum is required, last byte is checksum
-                            minimum_length = 1 + start_of_transmission_.size() / 8;
-                            if (bytes.size() >= minimum_length)
-                            {
-                                received_checksum = bytes[bytes.size() - start_of_transmission_.size() / 8 - 1];
-                            }
-                        } else {
-                            minimum_length = start_of_transmission_.size() / 8;
-                        }
-
-                        if (bytes.size() < minimum_length) {
-                            ClearBuffers();
-                            ESP_LOGW(kLogTag, "Data too short, clearing buffer");
-                            return false;  // Data too short, return failure
-                        }
-
-                        // Extract text data (remove trailing identifier part)
-                        std::vector<uint8_t> text_bytes(
-                            bytes.begin(), bytes.begin() + bytes.size() - minimum_length);
-
-                        std::string result(text_bytes.begin(), text_bytes.end());
-
-                        // Validate checksum if required
-                        if (enable_checksum_validation_) {
-                            uint8_t calculated_checksum = CalculateChecksum(result);
-                            if (calculated_checksum != received_checksum) {
-                                // Checksum mismatch
-                                ESP_LOGW(kLogTag, "Checksum mismatch: expected %d, got %d", 
-                                        received_checksum, calculated_checksum);
-                                ClearBuffers();
-                                return false;
-                            }
-                        }
-
-                        ClearBuffers();
-                        decoded_text = result;
-                        return true;  // Return success
-                    } else if (bit_buffer_.size() >= max_bit_buffer_size_) {
-                        // If not end identifier and bit buffer is full, reset
-                        ClearBuffers();
-                        ESP_LOGW(kLogTag, "Buffer overflow, clearing buffer");
-                        current_state_ = DataReceptionState::kInactive;  // Reset state machine
+                current_byte_ = (current_byte_ << 1) | bit;
+                if (++current_bit_count_ < 8) {
+                    break;
+                }
+                byte_buffer_.push_back(current_byte_);
+                current_byte_ = 0;
+                current_bit_count_ = 0;
+
+                // The data is byte aligned after the start identifier, so the end identifier is only checked on byte boundaries
+                if (MatchIdentifier(identifier_bits_, identifier_count_, end_identifier_, end_identifier_size_)) {
+                    current_state_ = DataReceptionState::kInactive;  // Enter inactive state
+                    if (OnEndOfTransmission()) {
+                        return true;
                     }
+                } else if (byte_buffer_.size() >= max_byte_size_ + end_identifier_size_ / 8) {
+                    // If not end identifier and byte buffer is full, reset
+                    ClearBuffers();
+                    ESP_LOGW(kLogTag, "Buffer overflow, clearing buffer");
+                    current_state_ = DataReceptionState::kInactive;  // Reset state machine
                 }
                 break;
             }
@@ -351,21 +256,33 @@ namespace audio_wifi_config
         return false;
     }
 
-    std::vector<uint8_t> AudioDataBuffer::ConvertBitsToBytes(const std::vector<uint8_t> &bits) const {
-        std::vector<uint8_t> bytes;
-
-        // Ensure number of bits is a multiple of 8
-        size_t complete_bytes_count = bits.size() / 8;
-        bytes.reserve(complete_bytes_count);
+    bool AudioDataBuffer::OnEndOfTransmission() {
+        size_t identifier_bytes = end_identifier_size_ / 8;
+        size_t minimum_length = identifier_bytes + (enable_checksum_validation_ ? 1 : 0);
+        if (byte_buffer_.size() < minimum_length) {
+            ClearBuffers();
+            ESP_LOGW(kLogTag, "Data too short, clearing buffer");
+            return false;  // Data too short, return failure
+        }
 
-        for (size_t i = 0; i < complete_bytes_count; ++i) {
-            uint8_t byte_value = 0;
-            for (size_t j = 0; j < 8; ++j) {
-                byte_value |= bits[i * 8 + j] << (7 - j);
+        // Extract text data (remove trailing checksum and identifier)
+        std::string result(byte_buffer_.begin(), byte_buffer_.end() - minimum_length);
+
+        // Validate checksum if required
+        if (enable_checksum_validation_) {
+            uint8_t received_checksum = byte_buffer_[byte_buffer_.size() - identifier_bytes - 1];
+            uint8_t calculated_checksum = CalculateChecksum(result);
+            if (calculated_checksum != received_checksum) {
+                // Checksum mismatch
+                ESP_LOGW(kLogTag, "Checksum mismatch: expected %d, got %d",
+                        received_checksum, calculated_checksum);
+                ClearBuffers();
+                return false;
             }
-            bytes.push_back(byte_value);
         }
 
-        return bytes;
+        ClearBuffers();
+        decoded_text = std::move(result);
+        return true;  // Return success
     }
 }
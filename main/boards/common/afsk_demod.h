@@ -1,101 +1,115 @@
 #pragma once
 
 #include <vector>
-#include <deque>
 #include <string>
-#include <memory>
 #include <optional>
-#include <cmath>
-#include "wifi_configuration_ap.h"
-#include "application.h"
+#include <cstdint>
+#include <cstddef>
+
+class Application;
+class WifiConfigurationAp;
+class Display;
 
 // Audio signal processing constants for WiFi configuration via audio
-const size_t kAudioSampleRate = 6400;
+const size_t kInputSampleRate = 16000;
+const size_t kAudioSampleRate = 8000;       // Demodulator rate after 2:1 decimation
 const size_t kMarkFrequency = 1800;
 const size_t kSpaceFrequency = 1500;
 const size_t kBitRate = 100;
-const size_t kWindowSize = 64;
+const size_t kMinBitRate = 50;              // Sizes the correlator rings
 
 namespace audio_wifi_config
 {
     // Main function to receive WiFi credentials through audio signal
-    void ReceiveWifiCredentialsFromAudio(Application *app, WifiConfigurationAp *wifi_ap, Display *display, 
+    void ReceiveWifiCredentialsFromAudio(Application *app, WifiConfigurationAp *wifi_ap, Display *display,
                                          size_t input_channels = 1);
 
     /**
-     * Goertzel algorithm implementation for single frequency detection
-     * Used to detect specific audio frequencies in the AFSK demodulation process
+     * 2:1 decimator with a 23-tap Q15 low-pass FIR (passband to ~3 kHz, > 50 dB rejection
+     * of everything that would alias onto the AFSK tones). Only every second output is computed.
      */
-    class FrequencyDetector
+    class Decimator
     {
-    private:
-        float frequency_;              // Target frequency (normalized, i.e., f / fs)
-        size_t window_size_;           // Window size for analysis
-        float frequency_bin_;          // Frequency bin
-        float angular_frequency_;      // Angular frequency
-        float cos_coefficient_;        // cos(w)
-        float sin_coefficient_;        // sin(w)
-        float filter_coefficient_;     // 2 * cos(w)
-        std::deque<float> state_buffer_;  // Circular buffer for storing S[-1] and S[-2]
-
     public:
-        /**
-         * Constructor
-         * @param frequency Normalized frequency (f / fs)
-         * @param window_size Window size for analysis
-         */
-        FrequencyDetector(float frequency, size_t window_size);
+        static constexpr size_t kTaps = 23;
 
-        /**
-         * Reset the detector state
-         */
         void Reset();
 
         /**
-         * Process one audio sample
-         * @param sample Input audio sample
+         * Push one input sample
+         * @param sample Input sample at kInputSampleRate
+         * @param output Decimated sample, valid when true is returned
          */
-        void ProcessSample(float sample);
+        inline bool Process(int16_t sample, int16_t &output);
 
-        /**
-         * Calculate current amplitude
-         * @return Amplitude value
-         */
-        float GetAmplitude() const;
+    private:
+        int16_t history_[kTaps * 2] = {};   // Doubled so the newest kTaps samples are contiguous
+        size_t position_ = 0;
+        bool odd_ = false;
     };
 
     /**
-     * Audio signal processor for Mark/Space frequency pair detection
-     * Processes audio signals to extract digital data using AFSK demodulation
+     * Sliding-window IQ correlator for one tone
+     * The input is mixed with a Q15 NCO and the I / Q products are summed over one bit
+     * period with running sums over a ring buffer, so each sample costs two multiplies.
      */
-    class AudioSignalProcessor
+    class ToneCorrelator
     {
-    private:
-        std::deque<float> input_buffer_;             // Input sample buffer
-        size_t input_buffer_size_;                   // Input buffer size = window size
-        size_t output_sample_count_;                 // Output sample counter
-        size_t samples_per_bit_;                     // Samples per bit threshold
-        std::unique_ptr<FrequencyDetector> mark_detector_;   // Mark frequency detector
-        std::unique_ptr<FrequencyDetector> space_detector_;  // Space frequency detector
-
     public:
+        void Configure(size_t sample_rate, size_t frequency, size_t window_size);
+        void Reset();
+
         /**
-         * Constructor
-         * @param sample_rate Audio sampling rate
-         * @param mark_frequency Mark frequency for digital '1'
-         * @param space_frequency Space frequency for digital '0'
-         * @param bit_rate Data transmission bit rate
-         * @param window_size Analysis window size
+         * Process one sample
+         * @return Energy (I^2 + Q^2) of the last window_size samples
          */
-        AudioSignalProcessor(size_t sample_rate, size_t mark_frequency, size_t space_frequency,
-                           size_t bit_rate, size_t window_size);
+        inline int64_t Process(int16_t sample);
+
+    private:
+        static constexpr size_t kMaxWindow = kAudioSampleRate / kMinBitRate;
+
+        uint32_t phase_ = 0;
+        uint32_t phase_step_ = 0;
+        size_t window_size_ = 0;
+        size_t position_ = 0;
+        int32_t sum_i_ = 0;
+        int32_t sum_q_ = 0;
+        int16_t ring_i_[kMaxWindow] = {};
+        int16_t ring_q_[kMaxWindow] = {};
+    };
+
+    /**
+     * Streaming AFSK demodulator
+     * decimate -> mark / space correlators -> zero-crossing DPLL symbol timing -> bits.
+     * All state is fixed-size, no memory is allocated while processing.
+     */
+    class AfskDemodulator
+    {
+    public:
+        AfskDemodulator(size_t mark_frequency = kMarkFrequency, size_t space_frequency = kSpaceFrequency,
+                        size_t bit_rate = kBitRate);
+
+        void Reset();
 
         /**
-         * Process input audio samples
-         * @param samples Input audio sample vector
-         * @return Vector of Mark probability values (0.0 to 1.0)
+         * Demodulate interleaved 16 kHz PCM (only the first channel is used)
+         * @param samples Input samples
+         * @param frames Number of frames
+         * @param stride Number of interleaved channels
+         * @param bits Output bits (0 / 1)
+         * @param max_bits Capacity of bits
+         * @return Number of bits written
          */
-        std::vector<float> ProcessAudioSamples(const std::vector<float> &samples);
+        size_t Process(const int16_t *samples, size_t frames, size_t stride, uint8_t *bits, size_t max_bits);
+
+    private:
+        Decimator decimator_;
+        ToneCorrelator mark_correlator_;
+        ToneCorrelator space_correlator_;
+        int32_t bit_period_;        // Samples per bit, Q8
+        int32_t clock_ = 0;         // Symbol clock, Q8, a bit is sampled when it wraps
+        bool clock_adjusted_ = false;
+        bool last_mark_ = false;
     };
 
     /**
@@ -110,18 +124,22 @@ namespace audio_wifi_config
 
     /**
      * Data buffer for managing audio-to-digital data conversion
-     * Handles the complete process from audio signal to decoded text data
+     * Handles the complete process from demodulated bits to decoded text data
      */
     class AudioDataBuffer
     {
     private:
         DataReceptionState current_state_;       // Current reception state
-        std::deque<uint8_t> identifier_buffer_;  // Buffer for start/end identifier detection
-        size_t identifier_buffer_size_;          // Identifier buffer size
-        std::vector<uint8_t> bit_buffer_;        // Buffer for storing bit stream
-        size_t max_bit_buffer_size_;             // Maximum bit buffer size
-        const std::vector<uint8_t> start_of_transmission_;  // Start-of-transmission identifier
-        const std::vector<uint8_t> end_of_transmission_;    // End-of-transmission identifier
+        uint32_t identifier_bits_ = 0;           // Shift register of the latest bits for start/end detection
+        size_t identifier_count_ = 0;            // Number of valid bits in identifier_bits_
+        uint32_t start_identifier_ = 0;          // Start-of-transmission identifier, packed
+        uint32_t end_identifier_ = 0;            // End-of-transmission identifier, packed
+        size_t start_identifier_size_ = 0;
+        size_t end_identifier_size_ = 0;
+        std::vector<uint8_t> byte_buffer_;       // Received bytes, preallocated
+        uint8_t current_byte_ = 0;
+        size_t current_bit_count_ = 0;
+        size_t max_byte_size_;                   // Maximum byte buffer size
         bool enable_checksum_validation_;       // Whether to validate checksum
 
     public:
@@ -135,20 +153,20 @@ namespace audio_wifi_config
         /**
          * Constructor with custom parameters
          * @param max_byte_size Expected maximum data size in bytes
-         * @param start_identifier Start-of-transmission identifier
-         * @param end_identifier End-of-transmission identifier
+         * @param start_identifier Start-of-transmission identifier (at most 32 bits)
+         * @param end_identifier End-of-transmission identifier (at most 32 bits)
          * @param enable_checksum Whether to enable checksum validation
          */
         AudioDataBuffer(size_t max_byte_size, const std::vector<uint8_t> &start_identifier,
                       const std::vector<uint8_t> &end_identifier, bool enable_checksum = false);
 
         /**
-         * Process probability data and attempt to decode
-         * @param probabilities Vector of Mark probabilities
-         * @param threshold Decision threshold for bit detection
+         * Process demodulated bits and attempt to decode
+         * @param bits Bits (0 / 1)
+         * @param count Number of bits
          * @return true if complete data was successfully received and decoded
          */
-        bool ProcessProbabilityData(const std::vector<float> &probabilities, float threshold = 0.5f);
+        bool ProcessBits(const uint8_t *bits, size_t count);
 
         /**
          * Calculate checksum for ASCII text
@@ -158,12 +176,7 @@ namespace audio_wifi_config
         static uint8_t CalculateChecksum(const std::string &text);
 
     private:
-        /**
-         * Convert bit vector to byte vector
-         * @param bits Input bit vector
-         * @return Converted byte vector
-         */
-        std::vector<uint8_t> ConvertBitsToBytes(const std::vector<uint8_t> &bits) const;
+        bool OnEndOfTransmission();
 
         /**
          * Clear all buffers and reset state
@@ -174,4 +187,4 @@ namespace audio_wifi_config
     // Default start and end transmission identifiers
     extern const std::vector<uint8_t> kDefaultStartTransmissionPattern;
     extern const std::vector<uint8_t> kDefaultEndTransmissionPattern;
-}
\ No newline at end of file
+}
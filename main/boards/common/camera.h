@@ -10,6 +10,8 @@ public:
     virtual bool SetHMirror(bool enabled) = 0;
     virtual bool SetVFlip(bool enabled) = 0;
     virtual std::string Explain(const std::string& question) = 0;
+    // Timing of the last capture and its preview
+    virtual std::string GetTimingJson() = 0;
 };
 
 #endif // CAMERA_H
@@ -30,41 +30,9 @@ Esp32Camera::Esp32Camera(const camera_config_t& config) {
     preview_image_.header.cf = LV_COLOR_FORMAT_RGB565;
     preview_image_.header.flags = 0;
 
-    switch (config.frame_size) {
-        case FRAMESIZE_SVGA:
-            preview_image_.header.w = 800;
-            preview_image_.header.h = 600;
-            break;
-        case FRAMESIZE_VGA:
-            preview_image_.header.w = 640;
-            preview_image_.header.h = 480;
-            break;
-        case FRAMESIZE_QVGA:
-            preview_image_.header.w = 320;
-            preview_image_.header.h = 240;
-            break;
-        case FRAMESIZE_128X128:
-            preview_image_.header.w = 128;
-            preview_image_.header.h = 128;
-            break;
-        case FRAMESIZE_240X240:
-            preview_image_.header.w = 240;
-            preview_image_.header.h = 240;
-            break;
-        default:
-            ESP_LOGE(TAG, "Unsupported frame size: %d, image preview will not be shown", config.frame_size);
-            preview_image_.data_size = 0;
-            preview_image_.data = nullptr;
-            return;
-    }
-
-    preview_image_.header.stride = preview_image_.header.w * 2;
-    preview_image_.data_size = preview_image_.header.w * preview_image_.header.h * 2;
-    preview_image_.data = (uint8_t*)heap_caps_malloc(preview_image_.data_size, MALLOC_CAP_SPIRAM);
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-        return;
-    }
+    // 预览缓冲区在第一次拍照时按显示尺寸分配
+    preview_image_.data_size = 0;
+    preview_image_.data = nullptr;
 }
 
 Esp32Camera::~Esp32Camera() {
@@ -103,32 +71,110 @@ bool Esp32Camera::Capture() {
         }
     }
     auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "Camera captured %d frames in %d ms", frames_to_get, int((end_time - start_time) / 1000));
+    capture_us_ = end_time - start_time;
+    convert_us_ = 0;
+    preview_us_ = 0;
+    captures_++;
 
-    // 如果预览图片 buffer 为空，则跳过预览
-    // 但仍返回 true，因为此时图像可以上传至服务器
-    if (preview_image_.data_size == 0) {
-        ESP_LOGW(TAG, "Skip preview because of unsupported frame size");
-        return true;
-    }
-    if (preview_image_.data == nullptr) {
-        ESP_LOGE(TAG, "Preview image data is not initialized");
-        return true;
-    }
-    // 显示预览图片
+    // 显示不支持预览时跳过转换，图像仍可上传至服务器
     auto display = Board::GetInstance().GetDisplay();
+    int box_width = 0, box_height = 0;
     if (display != nullptr) {
-        auto src = (uint16_t*)fb_->buf;
-        auto dst = (uint16_t*)preview_image_.data;
-        size_t pixel_count = fb_->len / 2;
-        for (size_t i = 0; i < pixel_count; i++) {
-            // 交换每个16位字内的字节
-            dst[i] = __builtin_bswap16(src[i]);
-        }
+        display->GetPreviewSize(box_width, box_height);
+    }
+    auto convert_start = esp_timer_get_time();
+    if (box_width > 0 && box_height > 0 && UpdatePreview(box_width, box_height)) {
+        auto preview_start = esp_timer_get_time();
+        convert_us_ = preview_start - convert_start;
         display->SetPreviewImage(&preview_image_);
+        preview_us_ = esp_timer_get_time() - preview_start;
+    }
+    ESP_LOGI(TAG, "Camera captured %d frames in %d ms, preview %dx%d converted in %d us, shown in %d us", frames_to_get,
+        int(capture_us_ / 1000), (int)preview_image_.header.w, (int)preview_image_.header.h, int(convert_us_), int(preview_us_));
+    return true;
+}
+
+// Swaps the bytes of the two RGB565 pixels in a 32-bit word, the camera sends them big-endian
+static inline uint32_t Swap565Pair(uint32_t pixels) {
+    return ((pixels & 0x00FF00FF) << 8) | ((pixels >> 8) & 0x00FF00FF);
+}
+
+bool Esp32Camera::UpdatePreview(int box_width, int box_height) {
+    if (fb_->format != PIXFORMAT_RGB565) {
+        ESP_LOGW(TAG, "Skip preview because of unsupported pixel format %d", fb_->format);
+        return false;
+    }
+
+    // 按比例缩小到显示区域内，不放大，宽度取偶数以便每次处理两个像素
+    int src_width = fb_->width;
+    int src_height = fb_->height;
+    int width = src_width;
+    int height = src_height;
+    if (width > box_width || height > box_height) {
+        if (box_width * src_height < box_height * src_width) {
+            width = box_width;
+            height = src_height * box_width / src_width;
+        } else {
+            width = src_width * box_height / src_height;
+            height = box_height;
+        }
+    }
+    width &= ~1;
+    if (width < 2 || height < 1) {
+        return false;
+    }
+
+    size_t data_size = width * height * 2;
+    if (data_size > preview_capacity_) {
+        heap_caps_free((void*)preview_image_.data);
+        preview_image_.data = (uint8_t*)heap_caps_malloc(data_size, MALLOC_CAP_SPIRAM);
+        if (preview_image_.data == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+            preview_capacity_ = 0;
+            return false;
+        }
+        preview_capacity_ = data_size;
+    }
+    preview_image_.header.w = width;
+    preview_image_.header.h = height;
+    preview_image_.header.stride = width * 2;
+    preview_image_.data_size = data_size;
+
+    // 一次完成字节交换和最近邻缩放，只读取用到的行，每次写入两个像素
+    auto src = (const uint16_t*)fb_->buf;
+    auto dst = (uint32_t*)preview_image_.data;
+    uint32_t step_x = (src_width << 16) / width;
+    uint32_t step_y = (src_height << 16) / height;
+    uint32_t y_pos = 0;
+    for (int y = 0; y < height; y++, y_pos += step_y) {
+        const uint16_t* row = src + (y_pos >> 16) * src_width;
+        if (step_x == 0x10000) {
+            auto in = (const uint32_t*)row;
+            for (int x = 0; x < width / 2; x++) {
+                *dst++ = Swap565Pair(in[x]);
+            }
+        } else {
+            uint32_t x_pos = 0;
+            for (int x = 0; x < width / 2; x++) {
+                uint32_t pair = row[x_pos >> 16] | ((uint32_t)row[(x_pos + step_x) >> 16] << 16);
+                x_pos += step_x * 2;
+                *dst++ = Swap565Pair(pair);
+            }
+        }
     }
     return true;
 }
+
+std::string Esp32Camera::GetTimingJson() {
+    std::string json = "{\"captures\":" + std::to_string(captures_);
+    json += ",\"capture_us\":" + std::to_string(capture_us_);
+    json += ",\"convert_us\":" + std::to_string(convert_us_);
+    json += ",\"preview_us\":" + std::to_string(preview_us_);
+    json += ",\"preview_width\":" + std::to_string(preview_image_.header.w);
+    json += ",\"preview_height\":" + std::to_string(preview_image_.header.h) + "}";
+    return json;
+}
+
 bool Esp32Camera::SetHMirror(bool enabled) {
     sensor_t *s = esp_camera_sensor_get();
     if (s == nullptr) {
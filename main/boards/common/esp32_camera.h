@@ -19,11 +19,21 @@ struct JpegChunk {
 class Esp32Camera : public Camera {
 private:
     camera_fb_t* fb_ = nullptr;
+    // Byte swapped and downscaled to the size the display shows, reused between captures
     lv_img_dsc_t preview_image_;
+    size_t preview_capacity_ = 0;
     std::string explain_url_;
     std::string explain_token_;
     std::thread encoder_thread_;
 
+    // Timing of the last Capture()
+    uint32_t captures_ = 0;
+    int64_t capture_us_ = 0;
+    int64_t convert_us_ = 0;
+    int64_t preview_us_ = 0;
+
+    bool UpdatePreview(int box_width, int box_height);
+
 public:
     Esp32Camera(const camera_config_t& config);
     ~Esp32Camera();
@@ -34,6 +44,7 @@ public:
     virtual bool SetHMirror(bool enabled) override;
     virtual bool SetVFlip(bool enabled) override;
     virtual std::string Explain(const std::string& question);
+    virtual std::string GetTimingJson() override;
 };
 
 #endif // ESP32_CAMERA_H
\ No newline at end of file
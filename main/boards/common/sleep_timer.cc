@@ -118,6 +118,8 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        // 深度睡眠不会执行 shutdown handler，先提交未写入的设置
+        Settings::Flush();
         esp_deep_sleep_start();
     }
 }
@@ -136,6 +136,14 @@ const char* WifiBoard::GetNetworkStateIcon() {
     }
 }
 
+int WifiBoard::GetNetworkRssi() {
+    auto& wifi_station = WifiStation::GetInstance();
+    if (wifi_config_mode_ || !wifi_station.IsConnected()) {
+        return 0;
+    }
+    return wifi_station.GetRssi();
+}
+
 std::string WifiBoard::GetBoardJson() {
     // Set the board type for OTA
     auto& wifi_station = WifiStation::GetInstance();
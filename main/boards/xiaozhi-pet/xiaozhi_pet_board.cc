@@ -17,7 +17,13 @@
 
 #define TAG "XiaozhiPetBoard"
 
+#if CONFIG_USE_FONT_SUBSET
+LV_FONT_DECLARE(font_text_subset);
+#define TEXT_FONT font_text_subset
+#else
 LV_FONT_DECLARE(font_puhui_14_1);
+#define TEXT_FONT font_puhui_14_1
+#endif
 LV_FONT_DECLARE(font_awesome_14_1);
 
 class XiaozhiPetBoard : public WifiBoard {
@@ -119,7 +125,7 @@ private:
         // Create 128x64 LVGL monochrome display wrapper
         // mirror_x=true, mirror_y=true to fix upside-down and mirrored text
         display_ = new OledDisplay(panel_io_, panel_, 128, 64, true, true,
-            {&font_puhui_14_1, &font_awesome_14_1});
+            {&TEXT_FONT, &font_awesome_14_1});
         ESP_LOGI(TAG, "SH1106 OLED display initialized successfully (128x64)");
     }
 
@@ -143,6 +149,7 @@ private:
         ESP_LOGI(TAG, "Initializing pet controller");
         PetController::GetInstance().Init();
         PetController::GetInstance().RegisterMcpTools();
+        PetController::GetInstance().RegisterLocalCommands();
         ESP_LOGI(TAG, "Pet controller initialized and MCP tools registered");
 
         // NOTE: Emotion test code disabled - emotion system now integrated into Application state machine
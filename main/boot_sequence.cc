@@ -0,0 +1,166 @@
+#include "boot_sequence.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#include <cJSON.h>
+
+#include <cstring>
+
+#define TAG "BootSequence"
+
+struct BootStageTask {
+    int index;
+    std::function<void()>* callback;
+    QueueHandle_t done_queue;
+};
+
+BootSequence::~BootSequence() {
+    if (done_queue_ != nullptr) {
+        vQueueDelete(done_queue_);
+    }
+}
+
+void BootSequence::AddStage(const char* name, std::initializer_list<const char*> after, std::function<void()> callback,
+    uint32_t stack_size) {
+    Stage stage = {name, {}, callback, stack_size};
+    for (auto dependency : after) {
+        bool found = false;
+        for (int i = 0; i < (int)stages_.size(); i++) {
+            if (strcmp(stages_[i].name, dependency) == 0) {
+                stage.after.push_back(i);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            ESP_LOGE(TAG, "Stage %s depends on unknown stage %s", name, dependency);
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    stages_.push_back(std::move(stage));
+}
+
+bool BootSequence::IsReady(const Stage& stage) {
+    for (int index : stage.after) {
+        if (stages_[index].end_time_us < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BootSequence::StartStage(int index) {
+    auto& stage = stages_[index];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stage.start_time_us = esp_timer_get_time();
+    }
+    ESP_LOGI(TAG, "Stage %s started", stage.name);
+
+    auto task = new BootStageTask{index, &stage.callback, done_queue_};
+    auto ret = xTaskCreate([](void* arg) {
+        auto task = (BootStageTask*)arg;
+        (*task->callback)();
+        xQueueSend(task->done_queue, &task->index, portMAX_DELAY);
+        delete task;
+        vTaskDelete(NULL);
+    }, stage.name, stage.stack_size, task, uxTaskPriorityGet(NULL), nullptr);
+    if (ret != pdPASS) {
+        // Not enough memory for another task, run it here instead
+        ESP_LOGW(TAG, "Failed to create task for stage %s, running inline", stage.name);
+        delete task;
+        stage.callback();
+        xQueueSend(done_queue_, &index, portMAX_DELAY);
+    }
+}
+
+void BootSequence::Run() {
+    int total = stages_.size();
+    if (total == 0) {
+        return;
+    }
+    done_queue_ = xQueueCreate(total, sizeof(int));
+    std::vector<bool> started(total, false);
+    int running = 0;
+
+    while (true) {
+        for (int i = 0; i < total; i++) {
+            if (!started[i] && IsReady(stages_[i])) {
+                started[i] = true;
+                running++;
+                StartStage(i);
+            }
+        }
+        if (running == 0) {
+            break;
+        }
+
+        int index;
+        xQueueReceive(done_queue_, &index, portMAX_DELAY);
+        running--;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& stage = stages_[index];
+        stage.end_time_us = esp_timer_get_time();
+        ESP_LOGI(TAG, "Stage %s finished in %lldms", stage.name, (stage.end_time_us - stage.start_time_us) / 1000);
+    }
+
+    for (int i = 0; i < total; i++) {
+        if (!started[i]) {
+            ESP_LOGE(TAG, "Stage %s was never started, a dependency is missing", stages_[i].name);
+        }
+    }
+    Mark("boot_done");
+}
+
+void BootSequence::Mark(const char* milestone) {
+    auto now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& item : milestones_) {
+        if (strcmp(item.name, milestone) == 0) {
+            return;  // Only the first time counts
+        }
+    }
+    milestones_.push_back({milestone, now});
+    ESP_LOGI(TAG, "Milestone %s at %lldms", milestone, now / 1000);
+}
+
+void BootSequence::PrintTimeline() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ESP_LOGI(TAG, "Boot timeline (ms since boot):");
+    for (auto& stage : stages_) {
+        ESP_LOGI(TAG, "  %-16s %6lld -> %6lld  (%lld)", stage.name, stage.start_time_us / 1000, stage.end_time_us / 1000,
+            (stage.end_time_us - stage.start_time_us) / 1000);
+    }
+    for (auto& milestone : milestones_) {
+        ESP_LOGI(TAG, "  %-16s %6lld", milestone.name, milestone.time_us / 1000);
+    }
+}
+
+std::string BootSequence::GetTimelineJson() {
+    auto root = cJSON_CreateObject();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto stages = cJSON_AddArrayToObject(root, "stages");
+        for (auto& stage : stages_) {
+            auto item = cJSON_CreateObject();
+            cJSON_AddStringToObject(item, "name", stage.name);
+            auto after = cJSON_AddArrayToObject(item, "after");
+            for (int index : stage.after) {
+                cJSON_AddItemToArray(after, cJSON_CreateString(stages_[index].name));
+            }
+            cJSON_AddNumberToObject(item, "start_ms", stage.start_time_us / 1000);
+            cJSON_AddNumberToObject(item, "end_ms", stage.end_time_us / 1000);
+            cJSON_AddItemToArray(stages, item);
+        }
+        auto milestones = cJSON_AddObjectToObject(root, "milestones");
+        for (auto& milestone : milestones_) {
+            cJSON_AddNumberToObject(milestones, milestone.name, milestone.time_us / 1000);
+        }
+    }
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
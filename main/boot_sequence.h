@@ -0,0 +1,60 @@
+#ifndef BOOT_SEQUENCE_H
+#define BOOT_SEQUENCE_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Boot stages with dependencies.
+ *
+ * A stage starts in its own task as soon as every stage it depends on has finished, so
+ * independent stages (audio, network, MCP tools...) run in parallel. Run() returns when all
+ * stages are done. Every stage records its start and end time since boot; milestones
+ * such as "wake_word_ready" can be marked from anywhere, also after Run() returned.
+ */
+class BootSequence {
+public:
+    ~BootSequence();
+
+    // Dependencies must name stages added before this one
+    void AddStage(const char* name, std::initializer_list<const char*> after, std::function<void()> callback,
+        uint32_t stack_size = 4096);
+    void Run();
+    void Mark(const char* milestone);
+
+    void PrintTimeline();
+    // {"stages":[{"name":"audio","after":[],"start_ms":n,"end_ms":n},...],"milestones":{"wake_word_ready":n,...}}
+    std::string GetTimelineJson();
+
+private:
+    struct Stage {
+        const char* name;
+        std::vector<int> after;
+        std::function<void()> callback;
+        uint32_t stack_size;
+        int64_t start_time_us = -1;
+        int64_t end_time_us = -1;
+    };
+
+    struct Milestone {
+        const char* name;
+        int64_t time_us;
+    };
+
+    std::mutex mutex_;
+    std::vector<Stage> stages_;
+    std::vector<Milestone> milestones_;
+    QueueHandle_t done_queue_ = nullptr;
+
+    bool IsReady(const Stage& stage);
+    void StartStage(int index);
+};
+
+#endif // BOOT_SEQUENCE_H
@@ -4,6 +4,10 @@
 #include <cstdlib>
 #include <cstring>
 #include <font_awesome.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cJSON.h>
 
 #include "display.h"
 #include "board.h"
@@ -22,6 +26,7 @@ Display::Display() {
             DisplayLockGuard lock(display);
             lv_obj_add_flag(display->notification_label_, LV_OBJ_FLAG_HIDDEN);
             lv_obj_remove_flag(display->status_label_, LV_OBJ_FLAG_HIDDEN);
+            display->notification_shown_ = false;
         },
         .arg = this,
         .dispatch_method = ESP_TIMER_TASK,
@@ -66,15 +71,25 @@ void Display::SetStatus(const char* status) {
     if (status_label_ == nullptr) {
         return;
     }
-    lv_label_set_text(status_label_, status);
-    lv_obj_remove_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
-    if (notification_label_ != nullptr) {  // Check before accessing
-        lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
-    }
-
+    ApplyStatus(status);
     last_status_update_time_ = std::chrono::system_clock::now();
 }
 
+void Display::ApplyStatus(const char* status) {
+    // 相同的文本也会使标签区域失效并刷新屏幕，所以先比较
+    if (status_text_ != status) {
+        status_text_ = status;
+        lv_label_set_text(status_label_, status);
+    }
+    if (notification_shown_) {
+        notification_shown_ = false;
+        lv_obj_remove_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
+        if (notification_label_ != nullptr) {  // Check before accessing
+            lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+        }
+    }
+}
+
 void Display::ShowNotification(const std::string &notification, int duration_ms) {
     ShowNotification(notification.c_str(), duration_ms);
 }
@@ -86,6 +101,7 @@ void Display::ShowNotification(const char* notification, int duration_ms) {
     }
     lv_label_set_text(notification_label_, notification);
     lv_obj_remove_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+    notification_shown_ = true;
     if (status_label_ != nullptr) {  // Check before accessing
         lv_obj_add_flag(status_label_, LV_OBJ_FLAG_HIDDEN);
     }
@@ -99,24 +115,11 @@ void Display::UpdateStatusBar(bool update_all) {
     auto& board = Board::GetInstance();
     auto codec = board.GetAudioCodec();
 
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            // Skip mute update if label doesn't exist
-        } else {
-            // 如果静音状态改变，则更新图标
-            if (codec->output_volume() == 0 && !muted_) {
-                muted_ = true;
-                lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-            } else if (codec->output_volume() > 0 && muted_) {
-                muted_ = false;
-                lv_label_set_text(mute_label_, "");
-            }
-        }
-    }
+    // 先在锁外读取所有状态，再一次加锁只更新变化的部分
+    bool muted = codec->output_volume() == 0;
 
     // Update time
+    char time_str[16] = "";
     if (app.GetDeviceState() == kDeviceStateIdle) {
         if (last_status_update_time_ + std::chrono::seconds(10) < std::chrono::system_clock::now()) {
             // Set status to clock "HH:MM"
@@ -124,9 +127,7 @@ void Display::UpdateStatusBar(bool update_all) {
             struct tm* tm = localtime(&now);
             // Check if the we have already set the time
             if (tm->tm_year >= 2025 - 1900) {
-                char time_str[16];
                 strftime(time_str, sizeof(time_str), "%H:%M  ", tm);
-                SetStatus(time_str);
             } else {
                 ESP_LOGW(TAG, "System time is not set, tm_year: %d", tm->tm_year);
             }
@@ -137,10 +138,11 @@ void Display::UpdateStatusBar(bool update_all) {
     // 更新电池图标
     int battery_level;
     bool charging, discharging;
-    const char* icon = nullptr;
+    const char* battery_icon = nullptr;
+    bool low_battery = false;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
         if (charging) {
-            icon = FONT_AWESOME_BATTERY_BOLT;
+            battery_icon = FONT_AWESOME_BATTERY_BOLT;
         } else {
             const char* levels[] = {
                 FONT_AWESOME_BATTERY_EMPTY, // 0-19%
@@ -150,31 +152,14 @@ void Display::UpdateStatusBar(bool update_all) {
                 FONT_AWESOME_BATTERY_FULL, // 80-99%
                 FONT_AWESOME_BATTERY_FULL, // 100%
             };
-            icon = levels[battery_level / 20];
-        }
-        DisplayLockGuard lock(this);
-        if (battery_label_ != nullptr && battery_icon_ != icon) {
-            battery_icon_ = icon;
-            lv_label_set_text(battery_label_, battery_icon_);
-        }
-
-        if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
-                if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
-                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
-                }
-            } else {
-                // Hide the low battery popup when the battery is not empty
-                if (!lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框显示，则隐藏
-                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                }
-            }
+            battery_icon = levels[battery_level / 20];
         }
+        low_battery = strcmp(battery_icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging;
     }
 
     // 每 10 秒更新一次网络图标
     static int seconds_counter = 0;
+    const char* network_icon = nullptr;
     if (update_all || seconds_counter++ % 10 == 0) {
         // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
         auto device_state = Application::GetInstance().GetDeviceState();
@@ -186,16 +171,51 @@ void Display::UpdateStatusBar(bool update_all) {
             kDeviceStateActivating,
         };
         if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
-            }
+            network_icon = board.GetNetworkStateIcon();
         }
     }
 
+    bool play_low_battery = false;
+    {
+        DisplayLockGuard lock(this);
+        // 如果静音状态改变，则更新图标
+        if (mute_label_ != nullptr && muted != muted_) {
+            muted_ = muted;
+            lv_label_set_text(mute_label_, muted_ ? FONT_AWESOME_VOLUME_XMARK : "");
+        }
+
+        if (time_str[0] != '\0' && status_label_ != nullptr) {
+            ApplyStatus(time_str);
+            last_status_update_time_ = std::chrono::system_clock::now();
+        }
+
+        if (battery_icon != nullptr) {
+            if (battery_label_ != nullptr && battery_icon_ != battery_icon) {
+                battery_icon_ = battery_icon;
+                lv_label_set_text(battery_label_, battery_icon_);
+            }
+            // 低电量时显示提示框，电量恢复后隐藏
+            if (low_battery_popup_ != nullptr && low_battery != low_battery_shown_) {
+                low_battery_shown_ = low_battery;
+                if (low_battery) {
+                    lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                    play_low_battery = true;
+                } else {
+                    lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
+                }
+            }
+        }
+
+        if (network_label_ != nullptr && network_icon != nullptr && network_icon_ != network_icon) {
+            network_icon_ = network_icon;
+            lv_label_set_text(network_label_, network_icon_);
+        }
+    }
     esp_pm_lock_release(pm_lock_);
+
+    if (play_low_battery) {
+        app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
+    }
 }
 
 
@@ -242,4 +262,84 @@ void Display::SetPowerSaveMode(bool on) {
         SetChatMessage("system", "");
         SetEmotion("neutral");
     }
-}
\ No newline at end of file
+}
+std::vector<Display::ChatMessage> Display::GetChatMessages() {
+    DisplayLockGuard lock(this);
+    std::vector<ChatMessage> messages;
+    if (chat_message_label_ != nullptr) {
+        const char* text = lv_label_get_text(chat_message_label_);
+        if (text != nullptr && text[0] != '\0') {
+            messages.push_back({"assistant", text});
+        }
+    }
+    return messages;
+}
+
+void Display::ClearChatMessages() {
+    SetChatMessage("system", "");
+}
+
+std::string Display::RunChatBenchmark(int messages) {
+    static const char* kRoles[] = { "user", "assistant", "assistant", "system" };
+    static const char* kTexts[] = {
+        "你好",
+        "今天天气怎么样？",
+        "今天晴，最高气温二十六度，最低十八度，东南风三级，适合出门散步。",
+        "Hello! What can I do for you today?",
+        "我给你讲一个故事吧：从前有一座山，山里有一座庙，庙里有一个老和尚在给小和尚讲故事，"
+        "讲的是什么呢？从前有一座山，山里有一座庙，庙里有一个老和尚在给小和尚讲故事。",
+        "聆听中...",
+    };
+    const int role_count = sizeof(kRoles) / sizeof(kRoles[0]);
+    const int text_count = sizeof(kTexts) / sizeof(kTexts[0]);
+    if (messages > CHAT_BENCHMARK_MAX_MESSAGES) {
+        messages = CHAT_BENCHMARK_MAX_MESSAGES;
+    }
+
+    auto saved_messages = GetChatMessages();
+    ResetRenderStats();
+    size_t free_start = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t min_free = free_start;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    char text[320];
+    for (int i = 0; i < messages; i++) {
+        snprintf(text, sizeof(text), "%d %s", i, kTexts[(i * 7) % text_count]);
+        int64_t start = esp_timer_get_time();
+        SetChatMessage(kRoles[i % role_count], text);
+        int64_t elapsed = esp_timer_get_time() - start;
+        total_us += elapsed;
+        if (elapsed > max_us) {
+            max_us = elapsed;
+        }
+        size_t free_size = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+        if (free_size < min_free) {
+            min_free = free_size;
+        }
+        // Let LVGL render and run the scroll animation, like a real conversation
+        vTaskDelay(pdMS_TO_TICKS(30));
+    }
+    size_t free_end = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+    auto render_stats = GetRenderStatsJson();
+
+    ClearChatMessages();
+    for (auto& message : saved_messages) {
+        SetChatMessage(message.role.c_str(), message.content.c_str());
+    }
+
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "messages", messages);
+    cJSON_AddNumberToObject(root, "avg_set_message_us", messages > 0 ? (int)(total_us / messages) : 0);
+    cJSON_AddNumberToObject(root, "max_set_message_us", (int)max_us);
+    cJSON_AddItemToObject(root, "render", cJSON_Parse(render_stats.c_str()));
+    cJSON_AddNumberToObject(root, "internal_free_start", free_start);
+    cJSON_AddNumberToObject(root, "internal_free_min", min_free);
+    cJSON_AddNumberToObject(root, "internal_free_end", free_end);
+    cJSON_AddNumberToObject(root, "internal_largest_block", largest_block);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
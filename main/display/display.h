@@ -7,8 +7,12 @@
 #include <esp_pm.h>
 
 #include <string>
+#include <vector>
 #include <chrono>
 
+// One message every 30ms, a run takes at most 6 seconds
+#define CHAT_BENCHMARK_MAX_MESSAGES 200
+
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
     const lv_font_t* icon_font = nullptr;
@@ -27,10 +31,26 @@ public:
     virtual void SetChatMessage(const char* role, const char* content);
     virtual void SetIcon(const char* icon);
     virtual void SetPreviewImage(const lv_img_dsc_t* image);
+    // Largest preview image shown without scaling, 0 x 0 when the display shows no preview
+    virtual void GetPreviewSize(int& width, int& height) { width = 0; height = 0; }
     virtual void SetTheme(const std::string& theme_name);
     virtual std::string GetTheme() { return current_theme_name_; }
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
+    // {"frames":n,"avg_render_us":n,"max_render_us":n} since the last reset
+    virtual std::string GetRenderStatsJson() { return "{}"; }
+    virtual void ResetRenderStats() {}
+    struct ChatMessage {
+        std::string role;
+        std::string content;
+    };
+    // The conversation on the screen, oldest first
+    virtual std::vector<ChatMessage> GetChatMessages();
+    virtual void ClearChatMessages();
+    // Posts `messages` (at most CHAT_BENCHMARK_MAX_MESSAGES) chat messages of mixed roles and
+    // lengths, returns the time SetChatMessage took, the render stats and the internal heap over
+    // the run. The conversation on the screen before is put back afterwards
+    std::string RunChatBenchmark(int messages);
 
     inline int width() const { return width_; }
     inline int height() const { return height_; }
@@ -52,6 +72,10 @@ protected:
     lv_obj_t* low_battery_popup_ = nullptr;
     lv_obj_t* low_battery_label_ = nullptr;
     
+    // What the status bar currently shows, only the fields that changed are pushed to LVGL
+    std::string status_text_;
+    bool notification_shown_ = false;
+    bool low_battery_shown_ = false;
     const char* battery_icon_ = nullptr;
     const char* network_icon_ = nullptr;
     bool muted_ = false;
@@ -60,6 +84,9 @@ protected:
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    // Called with the display locked
+    void ApplyStatus(const char* status);
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
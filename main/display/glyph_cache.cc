@@ -0,0 +1,132 @@
+#include "glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cJSON.h>
+#include <cstring>
+
+#define TAG "GlyphCache"
+
+GlyphCache::GlyphCache() {
+#if CONFIG_USE_GLYPH_CACHE
+    budget_ = CONFIG_GLYPH_CACHE_SIZE_KB * 1024;
+#endif
+}
+
+const lv_font_t* GlyphCache::Wrap(const lv_font_t* font) {
+    if (budget_ == 0 || font == nullptr || font->get_glyph_bitmap != lv_font_get_bitmap_fmt_txt) {
+        return font;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = fonts_.find(font);
+    if (it != fonts_.end()) {
+        return it->second;
+    }
+    // lv_font_fmt_txt only reads font->dsc, so the copy keeps working with the original glyph data.
+    // user_data is unused by it and points back to the original
+    auto wrapped = new lv_font_t(*font);
+    wrapped->get_glyph_bitmap = GetGlyphBitmap;
+    wrapped->user_data = (void*)font;
+    fonts_[font] = wrapped;
+    ESP_LOGI(TAG, "Caching glyphs of font %p (line height %d), budget %u bytes", font, (int)font->line_height, budget_);
+    return wrapped;
+}
+
+const void* GlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto original = static_cast<const lv_font_t*>(g_dsc->resolved_font->user_data);
+    return GetInstance().Lookup(original, g_dsc, draw_buf);
+}
+
+const void* GlyphCache::Lookup(const lv_font_t* original, lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    if (g_dsc->req_raw_bitmap || draw_buf == nullptr) {
+        return original->get_glyph_bitmap(g_dsc, draw_buf);
+    }
+
+    // Key: the font (the wrapped one is unique per original) and the glyph id
+    uint64_t key = ((uint64_t)(uintptr_t)g_dsc->resolved_font << 32) | g_dsc->gid.index;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        hits_++;
+        Unlink(it->second);
+        PushFront(it->second);
+        return &it->second->draw_buf;
+    }
+
+    misses_++;
+    auto result = original->get_glyph_bitmap(g_dsc, draw_buf);
+    if (result != draw_buf) {
+        // Not rendered into the buffer, e.g. an empty glyph
+        return result;
+    }
+    uint32_t stride = draw_buf->header.stride;
+    uint32_t data_size = stride * g_dsc->box_h;
+    size_t size = sizeof(Entry) + data_size;
+    if (size > budget_) {
+        return result;
+    }
+    while (bytes_ + size > budget_ && tail_ != nullptr) {
+        Entry* oldest = tail_;
+        Unlink(oldest);
+        entries_.erase(oldest->key);
+        bytes_ -= oldest->size;
+        evictions_++;
+        heap_caps_free(oldest);
+    }
+
+    auto entry = (Entry*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (entry == nullptr) {
+        return result;
+    }
+    uint8_t* data = (uint8_t*)(entry + 1);
+    memcpy(data, draw_buf->data, data_size);
+    lv_draw_buf_init(&entry->draw_buf, g_dsc->box_w, g_dsc->box_h, (lv_color_format_t)draw_buf->header.cf,
+        stride, data, data_size);
+    entry->key = key;
+    entry->size = size;
+    PushFront(entry);
+    entries_[key] = entry;
+    bytes_ += size;
+    return &entry->draw_buf;
+}
+
+void GlyphCache::Unlink(Entry* entry) {
+    if (entry->prev != nullptr) {
+        entry->prev->next = entry->next;
+    } else {
+        head_ = entry->next;
+    }
+    if (entry->next != nullptr) {
+        entry->next->prev = entry->prev;
+    } else {
+        tail_ = entry->prev;
+    }
+}
+
+void GlyphCache::PushFront(Entry* entry) {
+    entry->prev = nullptr;
+    entry->next = head_;
+    if (head_ != nullptr) {
+        head_->prev = entry;
+    }
+    head_ = entry;
+    if (tail_ == nullptr) {
+        tail_ = entry;
+    }
+}
+
+std::string GlyphCache::GetStatsJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "budget", budget_);
+    cJSON_AddNumberToObject(root, "bytes", bytes_);
+    cJSON_AddNumberToObject(root, "glyphs", entries_.size());
+    cJSON_AddNumberToObject(root, "hits", hits_);
+    cJSON_AddNumberToObject(root, "misses", misses_);
+    cJSON_AddNumberToObject(root, "evictions", evictions_);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
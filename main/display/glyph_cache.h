@@ -0,0 +1,66 @@
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include <lvgl.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * LRU cache of rendered glyph bitmaps in PSRAM.
+ *
+ * lv_font_fmt_txt expands every glyph from its packed 1/2/4 bpp bitmap in flash (and
+ * decompresses it for compressed fonts) into an A8 buffer each time a label is drawn, so a
+ * TTS sentence that grows word by word renders the whole label again and again. Wrap()
+ * returns a copy of a font whose get_glyph_bitmap keeps the A8 result, keyed by font and
+ * glyph id, until CONFIG_GLYPH_CACHE_SIZE_KB is used up and the least recently drawn glyphs
+ * are dropped. Only called from the LVGL task, the mutex is for the statistics.
+ */
+class GlyphCache {
+public:
+    static GlyphCache& GetInstance() {
+        static GlyphCache instance;
+        return instance;
+    }
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    // The font to use instead of `font`, `font` itself when it is not a lv_font_fmt_txt font
+    // or the cache is disabled
+    const lv_font_t* Wrap(const lv_font_t* font);
+    // {"budget":n,"bytes":n,"glyphs":n,"hits":n,"misses":n,"evictions":n}
+    std::string GetStatsJson();
+
+private:
+    struct Entry {
+        Entry* prev;
+        Entry* next;
+        uint64_t key;
+        size_t size;
+        lv_draw_buf_t draw_buf;     // The A8 bitmap follows the entry
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<const lv_font_t*, lv_font_t*> fonts_;
+    std::unordered_map<uint64_t, Entry*> entries_;
+    Entry* head_ = nullptr;         // Most recently drawn
+    Entry* tail_ = nullptr;
+    size_t budget_ = 0;
+    size_t bytes_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t evictions_ = 0;
+
+    GlyphCache();
+    ~GlyphCache() = default;
+
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    const void* Lookup(const lv_font_t* original, lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    void Unlink(Entry* entry);
+    void PushFront(Entry* entry);
+};
+
+#endif // GLYPH_CACHE_H
@@ -1,5 +1,6 @@
 #include "lcd_display.h"
 #include "assets/lang_config.h"
+#include "glyph_cache.h"
 #include "settings.h"
 
 #include <vector>
@@ -10,6 +11,7 @@
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
 #include <cstring>
+#include <cJSON.h>
 
 #include "board.h"
 
@@ -72,6 +74,10 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     width_ = width;
     height_ = height;
 
+    // 文字和图标字体通过字形缓存绘制
+    fonts_.text_font = GlyphCache::GetInstance().Wrap(fonts.text_font);
+    fonts_.icon_font = GlyphCache::GetInstance().Wrap(fonts.icon_font);
+
     // Load theme from settings
     Settings settings("display", false);
     current_theme_name_ = settings.GetString("theme", "light");
@@ -294,6 +300,18 @@ LcdDisplay::~LcdDisplay() {
     if (content_ != nullptr) {
         lv_obj_del(content_);
     }
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    // 标签引用的文本缓冲区在对象删除后才能释放
+    if (chat_text_buffer_ != nullptr) {
+        heap_caps_free(chat_text_buffer_);
+    }
+    if (content_ != nullptr) {
+        lv_style_reset(&bubble_style_);
+        for (auto& style : role_styles_) {
+            lv_style_reset(&style);
+        }
+    }
+#endif
     if (status_bar_ != nullptr) {
         lv_obj_del(status_bar_);
     }
@@ -315,6 +333,47 @@ LcdDisplay::~LcdDisplay() {
     }
 }
 
+void LcdDisplay::InitRenderStats() {
+    // 渲染在 LVGL 任务中进行，这里只记录时间
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        self->render_start_time_ = esp_timer_get_time();
+    }, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        if (self->render_start_time_ == 0) {
+            return;
+        }
+        int64_t render_us = esp_timer_get_time() - self->render_start_time_;
+        self->render_start_time_ = 0;
+        self->render_count_++;
+        self->render_total_us_ += render_us;
+        if (render_us > self->render_max_us_) {
+            self->render_max_us_ = render_us;
+        }
+    }, LV_EVENT_RENDER_READY, this);
+}
+
+std::string LcdDisplay::GetRenderStatsJson() {
+    DisplayLockGuard lock(this);
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "frames", render_count_);
+    cJSON_AddNumberToObject(root, "avg_render_us", render_count_ > 0 ? (int)(render_total_us_ / render_count_) : 0);
+    cJSON_AddNumberToObject(root, "max_render_us", (int)render_max_us_);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void LcdDisplay::ResetRenderStats() {
+    DisplayLockGuard lock(this);
+    render_count_ = 0;
+    render_total_us_ = 0;
+    render_max_us_ = 0;
+}
+
 bool LcdDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -326,6 +385,7 @@ void LcdDisplay::Unlock() {
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    InitRenderStats();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
@@ -367,8 +427,9 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, 10, 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Chat messages recycle a fixed set of bubbles created here
     chat_message_label_ = nullptr;
+    CreateChatSlots();
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
@@ -433,67 +494,124 @@ void LcdDisplay::SetupUI() {
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
 }
-#if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
-#else
-#define  MAX_MESSAGES 20
-#endif
+
+void LcdDisplay::CreateChatSlots() {
+    // 样式先初始化，缓冲区分配失败时 SetTheme 仍会更新这些样式
+    lv_style_init(&bubble_style_);
+    lv_style_set_radius(&bubble_style_, 8);
+    lv_style_set_border_width(&bubble_style_, 1);
+    lv_style_set_pad_all(&bubble_style_, 8);
+    lv_style_set_text_font(&bubble_style_, fonts_.text_font);
+    for (auto& style : role_styles_) {
+        lv_style_init(&style);
+    }
+    UpdateChatStyles();
+
+    // 所有消息的文本缓冲区一次分配，之后的消息只复制文本
+    size_t buffer_size = CHAT_MAX_MESSAGES * CHAT_MESSAGE_MAX_BYTES;
+    chat_text_buffer_ = (char*)heap_caps_malloc(buffer_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (chat_text_buffer_ == nullptr) {
+        chat_text_buffer_ = (char*)heap_caps_malloc(buffer_size, MALLOC_CAP_8BIT);
+    }
+    if (chat_text_buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate chat text buffer (%u bytes)", buffer_size);
+        return;
+    }
+
+    for (int i = 0; i < CHAT_MAX_MESSAGES; i++) {
+        auto& slot = chat_slots_[i];
+        slot.text = chat_text_buffer_ + i * CHAT_MESSAGE_MAX_BYTES;
+        slot.text[0] = '\0';
+
+        // 全宽透明容器，气泡在其中按角色左、右或居中对齐
+        slot.row = lv_obj_create(content_);
+        lv_obj_set_width(slot.row, LV_HOR_RES);
+        lv_obj_set_height(slot.row, LV_SIZE_CONTENT);
+        lv_obj_set_style_bg_opa(slot.row, LV_OPA_TRANSP, 0);
+        lv_obj_set_style_border_width(slot.row, 0, 0);
+        lv_obj_set_style_pad_all(slot.row, 0, 0);
+        lv_obj_remove_flag(slot.row, LV_OBJ_FLAG_SCROLLABLE);
+        // 隐藏的对象不参与 flex 布局
+        lv_obj_add_flag(slot.row, LV_OBJ_FLAG_HIDDEN);
+
+        slot.bubble = lv_obj_create(slot.row);
+        lv_obj_add_style(slot.bubble, &bubble_style_, 0);
+        lv_obj_set_size(slot.bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+        lv_obj_set_style_flex_grow(slot.bubble, 0, 0);
+        lv_obj_remove_flag(slot.bubble, LV_OBJ_FLAG_SCROLLABLE);
+
+        slot.label = lv_label_create(slot.bubble);
+        lv_label_set_long_mode(slot.label, LV_LABEL_LONG_WRAP);
+        lv_label_set_text_static(slot.label, slot.text);
+    }
+}
+
+void LcdDisplay::UpdateChatStyles() {
+    lv_style_set_border_color(&bubble_style_, current_theme_.border);
+    lv_style_set_bg_color(&role_styles_[kChatRoleUser], current_theme_.user_bubble);
+    lv_style_set_text_color(&role_styles_[kChatRoleUser], current_theme_.text);
+    lv_style_set_bg_color(&role_styles_[kChatRoleAssistant], current_theme_.assistant_bubble);
+    lv_style_set_text_color(&role_styles_[kChatRoleAssistant], current_theme_.text);
+    lv_style_set_bg_color(&role_styles_[kChatRoleSystem], current_theme_.system_bubble);
+    lv_style_set_text_color(&role_styles_[kChatRoleSystem], current_theme_.system_text);
+}
+
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
+    if (content_ == nullptr || chat_text_buffer_ == nullptr) {
         return;
     }
     
     //避免出现空的消息框
     if(strlen(content) == 0) return;
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+
+    ChatRole chat_role = kChatRoleAssistant;
+    if (strcmp(role, "user") == 0) {
+        chat_role = kChatRoleUser;
+    } else if (strcmp(role, "system") == 0) {
+        chat_role = kChatRoleSystem;
+    }
+
+    // 折叠系统消息：最后一条也是系统消息时直接替换它的文本
+    ChatSlot* slot = nullptr;
+    if (chat_role == kChatRoleSystem && chat_last_slot_ >= 0) {
+        auto& last = chat_slots_[chat_last_slot_];
+        if (last.role == kChatRoleSystem && lv_obj_get_child(content_, -1) == last.row) {
+            slot = &last;
         }
     }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0 && child_count > 0) {
-        // 获取最后一个消息容器
-        lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-        if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-            // 获取容器内的气泡
-            lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-            if (last_bubble != nullptr) {
-                // 检查气泡类型是否为系统消息
-                void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                    // 如果最后一个消息也是系统消息，则删除它
-                    lv_obj_del(last_container);
-                }
+    if (slot == nullptr) {
+        // 复用最早的消息，移到末尾
+        chat_last_slot_ = chat_next_slot_;
+        chat_next_slot_ = (chat_next_slot_ + 1) % CHAT_MAX_MESSAGES;
+        slot = &chat_slots_[chat_last_slot_];
+        lv_obj_move_to_index(slot->row, -1);
+        lv_obj_remove_flag(slot->row, LV_OBJ_FLAG_HIDDEN);
+
+        // 早于现存最早消息的图片一并删除
+        lv_obj_t* oldest = chat_slots_[chat_next_slot_].row;
+        if (!lv_obj_has_flag(oldest, LV_OBJ_FLAG_HIDDEN)) {
+            lv_obj_t* child;
+            while ((child = lv_obj_get_child(content_, 0)) != oldest) {
+                lv_obj_del(child);
             }
         }
     }
-    
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 1, 0);
-    lv_obj_set_style_border_color(msg_bubble, current_theme_.border, 0);
-    lv_obj_set_style_pad_all(msg_bubble, 8, 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
+
+    // 超长的文本在 UTF-8 字符边界截断
+    size_t length = strlen(content);
+    if (length >= CHAT_MESSAGE_MAX_BYTES) {
+        length = CHAT_MESSAGE_MAX_BYTES - 1;
+        while (length > 0 && (content[length] & 0xC0) == 0x80) {
+            length--;
+        }
+    }
+    memcpy(slot->text, content, length);
+    slot->text[length] = '\0';
+    lv_label_set_text_static(slot->label, slot->text);
+
     // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), fonts_.text_font, 0);
+    lv_coord_t text_width = lv_txt_get_width(slot->text, length, fonts_.text_font, 0);
 
     // 计算气泡宽度
     lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
@@ -511,114 +629,84 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     } else {
         bubble_width = max_width;
     }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-    lv_obj_set_style_text_font(msg_text, fonts_.text_font, 0);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
 
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.user_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.assistant_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, current_theme_.system_bubble, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, current_theme_.system_text, 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+    // 只在宽度或角色变化时修改布局，气泡高度随文本自动变化
+    if (bubble_width != slot->width) {
+        lv_obj_set_width(slot->label, bubble_width);
+        slot->width = bubble_width;
     }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
-
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+    if (chat_role != slot->role) {
+        if (slot->role != kChatRoleNone) {
+            lv_obj_remove_style(slot->bubble, &role_styles_[slot->role], 0);
+        }
+        lv_obj_add_style(slot->bubble, &role_styles_[chat_role], 0);
+        if (chat_role == kChatRoleUser) {
+            lv_obj_align(slot->bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+        } else if (chat_role == kChatRoleSystem) {
+            lv_obj_align(slot->bubble, LV_ALIGN_CENTER, 0, 0);
+        } else {
+            lv_obj_align(slot->bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        }
+        slot->role = chat_role;
     }
+
+    // Auto-scroll to the message
+    lv_obj_scroll_to_view_recursive(slot->row, LV_ANIM_ON);
     
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = slot->label;
+}
+
+std::vector<Display::ChatMessage> LcdDisplay::GetChatMessages() {
+    static const char* kRoleNames[] = { "", "user", "assistant", "system" };
+    DisplayLockGuard lock(this);
+    std::vector<ChatMessage> messages;
+    if (chat_text_buffer_ == nullptr) {
+        return messages;
+    }
+    // chat_next_slot_ is the oldest message once every slot was used
+    for (int i = 0; i < CHAT_MAX_MESSAGES; i++) {
+        auto& slot = chat_slots_[(chat_next_slot_ + i) % CHAT_MAX_MESSAGES];
+        if (!lv_obj_has_flag(slot.row, LV_OBJ_FLAG_HIDDEN)) {
+            messages.push_back({kRoleNames[slot.role], slot.text});
+        }
+    }
+    return messages;
+}
+
+void LcdDisplay::ClearChatMessages() {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr || chat_text_buffer_ == nullptr) {
+        return;
+    }
+    // 图片消息不是复用的消息行，直接删除
+    for (int i = (int)lv_obj_get_child_cnt(content_) - 1; i >= 0; i--) {
+        lv_obj_t* child = lv_obj_get_child(content_, i);
+        bool is_slot = false;
+        for (auto& slot : chat_slots_) {
+            if (slot.row == child) {
+                is_slot = true;
+                break;
+            }
+        }
+        if (!is_slot) {
+            lv_obj_del(child);
+        }
+    }
+    for (auto& slot : chat_slots_) {
+        slot.text[0] = '\0';
+        lv_label_set_text_static(slot.label, slot.text);
+        lv_obj_add_flag(slot.row, LV_OBJ_FLAG_HIDDEN);
+    }
+    chat_next_slot_ = 0;
+    chat_last_slot_ = -1;
+    chat_message_label_ = nullptr;
+}
+
+void LcdDisplay::GetPreviewSize(int& width, int& height) {
+    // 与 SetPreviewImage 中图片的最大尺寸一致
+    width = width_ * 70 / 100;
+    height = height_ * 50 / 100;
 }
 
 void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
@@ -725,6 +813,7 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
 #else
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    InitRenderStats();
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, fonts_.text_font, 0);
@@ -827,6 +916,12 @@ void LcdDisplay::SetupUI() {
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
 }
 
+void LcdDisplay::GetPreviewSize(int& width, int& height) {
+    // 预览图片占屏幕的一半
+    width = width_ / 2;
+    height = height_ / 2;
+}
+
 void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     DisplayLockGuard lock(this);
     if (preview_image_ == nullptr) {
@@ -836,9 +931,21 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     if (img_dsc != nullptr) {
         // 设置图片源并显示预览图片
         lv_image_set_src(preview_image_, img_dsc);
-        if (img_dsc->header.w > 0) {
-            // zoom factor 0.5
-            lv_image_set_scale(preview_image_, 128 * width_ / img_dsc->header.w);
+        if (img_dsc->header.w > 0 && img_dsc->header.h > 0) {
+            // 缩放到屏幕的一半，小于预览区域的帧仍然放大；相机已经缩小到贴边的图片按原尺寸显示，
+            // 宽度取偶数可能少一个像素
+            int box_width, box_height;
+            GetPreviewSize(box_width, box_height);
+            int zoom = 256;
+            int w = img_dsc->header.w;
+            int h = img_dsc->header.h;
+            bool fitted = w <= box_width && h <= box_height && (w >= box_width - 1 || h >= box_height - 1);
+            if (!fitted) {
+                int zoom_w = 256 * box_width / w;
+                int zoom_h = 256 * box_height / h;
+                zoom = zoom_w < zoom_h ? zoom_w : zoom_h;
+            }
+            lv_image_set_scale(preview_image_, zoom);
         }
         lv_obj_remove_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
         // 隐藏emotion_label_
@@ -995,119 +1102,21 @@ void LcdDisplay::SetTheme(const std::string& theme_name) {
         
         // If we have the chat message style, update all message bubbles
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
-        // Iterate through all children of content (message containers or bubbles)
+        // 消息气泡共用这些样式，只需更新样式本身
+        UpdateChatStyles();
+        lv_obj_report_style_change(&bubble_style_);
+        for (auto& style : role_styles_) {
+            lv_obj_report_style_change(&style);
+        }
+
+        // 图片气泡不在消息槽中，单独更新
         uint32_t child_count = lv_obj_get_child_cnt(content_);
         for (uint32_t i = 0; i < child_count; i++) {
             lv_obj_t* obj = lv_obj_get_child(content_, i);
-            if (obj == nullptr) continue;
-            
-            lv_obj_t* bubble = nullptr;
-            
-            // 检查这个对象是容器还是气泡
-            // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-            // 如果是气泡（助手消息），则直接使用
-            if (lv_obj_get_child_cnt(obj) > 0) {
-                // 可能是容器，检查它是否为用户或系统消息容器
-                // 用户和系统消息容器是透明的
-                lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-                if (bg_opa == LV_OPA_TRANSP) {
-                    // 这是用户或系统消息的容器
-                    bubble = lv_obj_get_child(obj, 0);
-                } else {
-                    // 这可能是助手消息的气泡自身
-                    bubble = obj;
-                }
-            } else {
-                // 没有子元素，可能是其他UI元素，跳过
-                continue;
-            }
-            
-            if (bubble == nullptr) continue;
-            
-            // 使用保存的用户数据来识别气泡类型
-            void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-            if (bubble_type_ptr != nullptr) {
-                const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-                
-                // 根据气泡类型应用正确的颜色
-                if (strcmp(bubble_type, "user") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (strcmp(bubble_type, "assistant") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0); 
-                } else if (strcmp(bubble_type, "system") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                } else if (strcmp(bubble_type, "image") == 0) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 根据气泡类型设置文本颜色
-                        if (strcmp(bubble_type, "system") == 0) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
-            } else {
-                // 如果没有标记，回退到之前的逻辑（颜色比较）
-                // ...保留原有的回退逻辑...
-                lv_color_t bg_color = lv_obj_get_style_bg_color(bubble, 0);
-            
-                // 改进bubble类型检测逻辑，不仅使用颜色比较
-                bool is_user_bubble = false;
-                bool is_assistant_bubble = false;
-                bool is_system_bubble = false;
-            
-                // 检查用户bubble
-                if (lv_color_eq(bg_color, DARK_USER_BUBBLE_COLOR) || 
-                    lv_color_eq(bg_color, LIGHT_USER_BUBBLE_COLOR) ||
-                    lv_color_eq(bg_color, current_theme_.user_bubble)) {
-                    is_user_bubble = true;
-                }
-                // 检查系统bubble
-                else if (lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                         lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR) ||
-                         lv_color_eq(bg_color, current_theme_.system_bubble)) {
-                    is_system_bubble = true;
-                }
-                // 剩余的都当作助手bubble处理
-                else {
-                    is_assistant_bubble = true;
-                }
-            
-                // 根据bubble类型应用正确的颜色
-                if (is_user_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.user_bubble, 0);
-                } else if (is_assistant_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.assistant_bubble, 0);
-                } else if (is_system_bubble) {
-                    lv_obj_set_style_bg_color(bubble, current_theme_.system_bubble, 0);
-                }
-                
-                // Update border color
-                lv_obj_set_style_border_color(bubble, current_theme_.border, 0);
-                
-                // Update text color for the message
-                if (lv_obj_get_child_cnt(bubble) > 0) {
-                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                    if (text != nullptr) {
-                        // 回退到颜色检测逻辑
-                        if (lv_color_eq(bg_color, current_theme_.system_bubble) ||
-                            lv_color_eq(bg_color, DARK_SYSTEM_BUBBLE_COLOR) || 
-                            lv_color_eq(bg_color, LIGHT_SYSTEM_BUBBLE_COLOR)) {
-                            lv_obj_set_style_text_color(text, current_theme_.system_text, 0);
-                        } else {
-                            lv_obj_set_style_text_color(text, current_theme_.text, 0);
-                        }
-                    }
-                }
+            void* bubble_type_ptr = lv_obj_get_user_data(obj);
+            if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "image") == 0) {
+                lv_obj_set_style_bg_color(obj, current_theme_.system_bubble, 0);
+                lv_obj_set_style_border_color(obj, current_theme_.border, 0);
             }
         }
 #else
@@ -9,6 +9,14 @@
 
 #include <atomic>
 
+#if CONFIG_IDF_TARGET_ESP32P4
+#define CHAT_MAX_MESSAGES 40
+#else
+#define CHAT_MAX_MESSAGES 20
+#endif
+// Longer messages are cut at a character boundary, about 170 Chinese characters
+#define CHAT_MESSAGE_MAX_BYTES 512
+
 // Theme color structure
 struct ThemeColors {
     lv_color_t background;
@@ -38,7 +46,42 @@ protected:
     DisplayFonts fonts_;
     ThemeColors current_theme_;
 
+#if CONFIG_USE_WECHAT_MESSAGE_STYLE
+    enum ChatRole {
+        kChatRoleNone,
+        kChatRoleUser,
+        kChatRoleAssistant,
+        kChatRoleSystem,
+    };
+    // A chat row is created once and recycled, oldest first, by changing its text and role style
+    struct ChatSlot {
+        lv_obj_t* row = nullptr;        // Full width and transparent, aligns the bubble by role
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        char* text = nullptr;           // CHAT_MESSAGE_MAX_BYTES, shown by the label without a copy
+        ChatRole role = kChatRoleNone;
+        lv_coord_t width = 0;
+    };
+    ChatSlot chat_slots_[CHAT_MAX_MESSAGES];
+    int chat_next_slot_ = 0;
+    int chat_last_slot_ = -1;
+    char* chat_text_buffer_ = nullptr;
+    // Shared by all bubbles, a theme change only updates these
+    lv_style_t bubble_style_;
+    lv_style_t role_styles_[4];
+
+    void CreateChatSlots();
+    void UpdateChatStyles();
+#endif
+
+    // Render time of the frames since the last reset
+    int64_t render_start_time_ = 0;
+    uint32_t render_count_ = 0;
+    int64_t render_total_us_ = 0;
+    int64_t render_max_us_ = 0;
+
     void SetupUI();
+    void InitRenderStats();
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -51,12 +94,17 @@ public:
     virtual void SetEmotion(const char* emotion) override;
     virtual void SetIcon(const char* icon) override;
     virtual void SetPreviewImage(const lv_img_dsc_t* img_dsc) override;
+    virtual void GetPreviewSize(int& width, int& height) override;
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
     virtual void SetChatMessage(const char* role, const char* content) override; 
+    virtual std::vector<ChatMessage> GetChatMessages() override;
+    virtual void ClearChatMessages() override;
 #endif  
 
     // Add theme switching function
     virtual void SetTheme(const std::string& theme_name) override;
+    virtual std::string GetRenderStatsJson() override;
+    virtual void ResetRenderStats() override;
 };
 
 // RGB LCD显示器
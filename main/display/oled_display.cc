@@ -1,5 +1,6 @@
 #include "oled_display.h"
 #include "assets/lang_config.h"
+#include "glyph_cache.h"
 #include "lazy_blink_gif.h"  // GIF animation for idle state
 // #include "dynamic_eye_drawer.h"  // Not compatible with xiaozhi-pet
 
@@ -21,6 +22,10 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
     width_ = width;
     height_ = height;
 
+    // 文字和图标字体通过字形缓存绘制
+    fonts_.text_font = GlyphCache::GetInstance().Wrap(fonts.text_font);
+    fonts_.icon_font = GlyphCache::GetInstance().Wrap(fonts.icon_font);
+
     ESP_LOGI(TAG, "Initialize LVGL");
     lvgl_port_cfg_t port_cfg = ESP_LVGL_PORT_INIT_CONFIG();
     port_cfg.task_priority = 1;
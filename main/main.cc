@@ -7,11 +7,15 @@
 
 #include "application.h"
 #include "system_info.h"
+#include "trace_recorder.h"
 
 #define TAG "main"
 
 extern "C" void app_main(void)
 {
+    // Start tracing first so the boot sequence is recorded
+    TraceRecorder::GetInstance().Initialize();
+
     // Initialize the default event loop
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
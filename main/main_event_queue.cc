@@ -0,0 +1,156 @@
+#include "main_event_queue.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+
+#define TAG "MainEventQueue"
+
+static const char* const kPriorityNames[kMainEventPriorityCount] = {"high", "normal", "low"};
+
+MainEventPriority MainEventQueue::GetPriority(MainEventType type) {
+    switch (type) {
+    case kMainEventControl:
+        return kMainEventPriorityHigh;
+    case kMainEventMcpTool:
+        return kMainEventPriorityLow;
+    default:
+        return kMainEventPriorityNormal;
+    }
+}
+
+bool MainEventQueue::IsDroppable(MainEventType type) {
+    // A dropped tool call is answered with a busy error, missed housekeeping runs next time
+    return type == kMainEventMcpTool || type == kMainEventProtocol;
+}
+
+const char* MainEventQueue::GetTypeName(MainEventType type) {
+    static const char* const names[kMainEventTypeCount] = {"generic", "control", "ui", "protocol", "mcp_tool", "mcp_reply"};
+    return type < kMainEventTypeCount ? names[type] : "unknown";
+}
+
+void MainEventQueue::Histogram::Add(uint32_t us) {
+    int bucket = 0;
+    for (uint32_t limit = 64; bucket < MAIN_EVENT_HISTOGRAM_BUCKETS - 1 && us >= limit; limit <<= 1) {
+        bucket++;
+    }
+    buckets[bucket]++;
+    count++;
+    if (us > max_us) {
+        max_us = us;
+    }
+}
+
+bool MainEventQueue::PushCallback(MainEventType type, MainEventCallback&& callback) {
+    auto priority = GetPriority(type);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& ring = rings_[priority];
+    if (ring.size == ring.capacity) {
+        if (IsDroppable(type)) {
+            ring.overflows++;
+            ESP_LOGE(TAG, "Queue full, dropped %s event (priority %s, %lu dropped)",
+                GetTypeName(type), kPriorityNames[priority], (unsigned long)ring.overflows);
+            return false;
+        }
+        ring.spilled++;
+        ESP_LOGW(TAG, "Queue full, %s event spilled (priority %s, %u waiting)",
+            GetTypeName(type), kPriorityNames[priority], (unsigned)ring.spill.size() + 1);
+        auto& slot = ring.spill.emplace_back();
+        slot.callback = std::move(callback);
+        slot.type = type;
+        slot.enqueue_time_us = esp_timer_get_time();
+        return true;
+    }
+    auto& slot = ring.slots[(ring.head + ring.size) % ring.capacity];
+    slot.callback = std::move(callback);
+    slot.type = type;
+    slot.enqueue_time_us = esp_timer_get_time();
+    ring.size++;
+    return true;
+}
+
+bool MainEventQueue::RunNext() {
+    MainEventCallback callback;
+    MainEventType type = kMainEventGeneric;
+    int64_t start_time_us;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Ring* ring = nullptr;
+        for (auto& candidate : rings_) {
+            if (candidate.size > 0) {
+                ring = &candidate;
+                break;
+            }
+        }
+        if (ring == nullptr) {
+            return false;
+        }
+        auto& slot = ring->slots[ring->head];
+        callback = std::move(slot.callback);
+        type = slot.type;
+        start_time_us = esp_timer_get_time();
+        wait_[type].Add((uint32_t)(start_time_us - slot.enqueue_time_us));
+
+        ring->head = (ring->head + 1) % ring->capacity;
+        ring->size--;
+        // The oldest spilled event takes the free slot at the tail
+        if (!ring->spill.empty()) {
+            ring->slots[(ring->head + ring->size) % ring->capacity] = std::move(ring->spill.front());
+            ring->spill.pop_front();
+            ring->size++;
+        }
+    }
+
+    callback();
+    callback.Reset();
+
+    uint32_t run_us = (uint32_t)(esp_timer_get_time() - start_time_us);
+    std::lock_guard<std::mutex> lock(mutex_);
+    run_[type].Add(run_us);
+    return true;
+}
+
+bool MainEventQueue::Empty() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& ring : rings_) {
+        if (ring.size > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string MainEventQueue::GetReportJson() {
+    auto root = cJSON_CreateObject();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto overflows = cJSON_AddObjectToObject(root, "overflows");
+        auto spilled = cJSON_AddObjectToObject(root, "spilled");
+        for (int i = 0; i < kMainEventPriorityCount; i++) {
+            cJSON_AddNumberToObject(overflows, kPriorityNames[i], rings_[i].overflows);
+            cJSON_AddNumberToObject(spilled, kPriorityNames[i], rings_[i].spilled);
+        }
+
+        auto bounds = cJSON_AddArrayToObject(root, "bucket_limits_us");
+        for (int i = 0; i < MAIN_EVENT_HISTOGRAM_BUCKETS - 1; i++) {
+            cJSON_AddItemToArray(bounds, cJSON_CreateNumber(64 << i));
+        }
+
+        auto events = cJSON_AddObjectToObject(root, "events");
+        for (int type = 0; type < kMainEventTypeCount; type++) {
+            if (wait_[type].count == 0) {
+                continue;
+            }
+            auto item = cJSON_AddObjectToObject(events, GetTypeName((MainEventType)type));
+            cJSON_AddNumberToObject(item, "count", wait_[type].count);
+            cJSON_AddNumberToObject(item, "wait_max", wait_[type].max_us);
+            cJSON_AddNumberToObject(item, "run_max", run_[type].max_us);
+            cJSON_AddItemToObject(item, "wait", cJSON_CreateIntArray((const int*)wait_[type].buckets, MAIN_EVENT_HISTOGRAM_BUCKETS));
+            cJSON_AddItemToObject(item, "run", cJSON_CreateIntArray((const int*)run_[type].buckets, MAIN_EVENT_HISTOGRAM_BUCKETS));
+        }
+    }
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,189 @@
+#ifndef MAIN_EVENT_QUEUE_H
+#define MAIN_EVENT_QUEUE_H
+
+#include <esp_timer.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+/*
+ * Event queue of the main loop (Application::Schedule).
+ *
+ * Callables are stored in place in preallocated slots, nothing is allocated when an event
+ * is scheduled. Each event type maps to a priority; the main loop always runs the oldest
+ * event of the highest non-empty priority, so an abort or a state change is not stuck
+ * behind a burst of MCP tool calls. When a priority ring is full, MCP tool calls and protocol
+ * housekeeping are dropped and counted; every other event (state changes, control, UI, MCP
+ * replies) spills into an overflow list behind the ring, the only place that allocates, so it
+ * still runs in order.
+ *
+ * Queue wait and run time are recorded per event type in log2 histograms.
+ */
+#define MAIN_EVENT_CALLBACK_SIZE 64
+#define MAIN_EVENT_HISTOGRAM_BUCKETS 14     // <64us, <128us, ... <262ms, >=262ms
+
+enum MainEventPriority {
+    kMainEventPriorityHigh,
+    kMainEventPriorityNormal,
+    kMainEventPriorityLow,
+    kMainEventPriorityCount,
+};
+
+enum MainEventType : uint8_t {
+    kMainEventGeneric,      // normal
+    kMainEventControl,      // high: abort, state changes, reboot
+    kMainEventUi,           // normal: chat messages, emotions, sounds
+    kMainEventProtocol,     // normal: protocol housekeeping
+    kMainEventMcpTool,      // low: MCP tools/call
+    kMainEventMcpReply,     // normal: MCP messages from other tasks, tool results and errors
+    kMainEventTypeCount,
+};
+
+// Move-only void() callable with fixed inline storage, too large captures fail to compile
+template <size_t Capacity>
+class InplaceCallback {
+public:
+    InplaceCallback() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceCallback>>>
+    InplaceCallback(F&& callable) {
+        using Callable = std::decay_t<F>;
+        static_assert(sizeof(Callable) <= Capacity, "Callback captures too much state, capture a pointer instead");
+        static_assert(alignof(Callable) <= alignof(std::max_align_t), "Callback alignment not supported");
+        new (storage_) Callable(std::forward<F>(callable));
+        ops_ = &OpsFor<Callable>::kOps;
+    }
+
+    InplaceCallback(InplaceCallback&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    InplaceCallback& operator=(InplaceCallback&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceCallback(const InplaceCallback&) = delete;
+    InplaceCallback& operator=(const InplaceCallback&) = delete;
+
+    ~InplaceCallback() {
+        Reset();
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+
+    void Reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* destination, void* source);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Callable>
+    struct OpsFor {
+        static void Invoke(void* storage) { (*static_cast<Callable*>(storage))(); }
+        static void Move(void* destination, void* source) {
+            new (destination) Callable(std::move(*static_cast<Callable*>(source)));
+            static_cast<Callable*>(source)->~Callable();
+        }
+        static void Destroy(void* storage) { static_cast<Callable*>(storage)->~Callable(); }
+        static constexpr Ops kOps = {Invoke, Move, Destroy};
+    };
+
+    void MoveFrom(InplaceCallback& other) {
+        ops_ = other.ops_;
+        if (ops_ != nullptr) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+    const Ops* ops_ = nullptr;
+};
+
+using MainEventCallback = InplaceCallback<MAIN_EVENT_CALLBACK_SIZE>;
+
+class MainEventQueue {
+public:
+    MainEventQueue() = default;
+
+    // Returns false and counts an overflow if the ring of the event's priority is full and the
+    // event type may be dropped, see IsDroppable()
+    template <typename F>
+    bool Push(MainEventType type, F&& callable) {
+        return PushCallback(type, MainEventCallback(std::forward<F>(callable)));
+    }
+
+    // Run the highest priority pending event, returns false if the queue is empty
+    bool RunNext();
+    bool Empty();
+
+    // {"overflows":{"high":n,...},"spilled":{"high":n,...},"events":{"control":{"count":n,"wait_max":us,"run_max":us,"wait":[...],"run":[...]},...}}
+    std::string GetReportJson();
+    static MainEventPriority GetPriority(MainEventType type);
+    static bool IsDroppable(MainEventType type);
+    static const char* GetTypeName(MainEventType type);
+
+private:
+    struct Slot {
+        MainEventCallback callback;
+        MainEventType type = kMainEventGeneric;
+        int64_t enqueue_time_us = 0;
+    };
+
+    struct Ring {
+        Slot* slots;
+        size_t capacity;
+        size_t head = 0;
+        size_t size = 0;
+        uint32_t overflows = 0;
+        uint32_t spilled = 0;
+        // Events that must not be dropped and found the ring full, non-empty only while it is full
+        std::deque<Slot> spill;
+    };
+
+    struct Histogram {
+        uint32_t buckets[MAIN_EVENT_HISTOGRAM_BUCKETS] = {};
+        uint32_t count = 0;
+        uint32_t max_us = 0;
+
+        void Add(uint32_t us);
+    };
+
+    std::mutex mutex_;
+    Slot high_slots_[8];
+    Slot normal_slots_[24];
+    Slot low_slots_[16];
+    Ring rings_[kMainEventPriorityCount] = {
+        {high_slots_, sizeof(high_slots_) / sizeof(Slot)},
+        {normal_slots_, sizeof(normal_slots_) / sizeof(Slot)},
+        {low_slots_, sizeof(low_slots_) / sizeof(Slot)},
+    };
+    Histogram wait_[kMainEventTypeCount];
+    Histogram run_[kMainEventTypeCount];
+
+    bool PushCallback(MainEventType type, MainEventCallback&& callback);
+};
+
+#endif // MAIN_EVENT_QUEUE_H
@@ -8,11 +8,17 @@
 #include <esp_app_desc.h>
 #include <algorithm>
 #include <cstring>
+#include <system_error>
 #include <esp_pthread.h>
 
 #include "application.h"
 #include "display.h"
+#include "glyph_cache.h"
 #include "board.h"
+#include "metrics.h"
+#include "trace_recorder.h"
+#include "protocol.h"
+#include "protocol_replay.h"
 
 #define TAG "MCP"
 
@@ -109,6 +115,161 @@ void McpServer::AddCommonTools() {
             });
     }
 
+    AddUserOnlyTool("self.diagnostics.get_main_loop_latency",
+        "Get the main loop event statistics: dropped events per priority, and per event type the count,\n"
+        "max queue wait / run time in microseconds and log2 histograms (bucket limits in `bucket_limits_us`).",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetMainEventQueue().GetReportJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.get_boot_timeline",
+        "Get the boot timeline: start / end time in milliseconds since boot of every boot stage and\n"
+        "the milestones (`wake_word_ready`, `protocol_ready`, `boot_done`).",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetBootSequence().GetTimelineJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.get_metrics",
+        "Get the runtime metrics: counters since boot, current gauges (audio queue depths, CPU load,\n"
+        "free / largest free block of SRAM and PSRAM in bytes), Opus encode / decode time histograms,\n"
+        "per-task CPU percent and free stack, and the sample ring (one row every `interval_s`, counters\n"
+        "as increases and gauges as the highest value in the interval).\n"
+        "Args:\n"
+        "  `samples`: Number of ring rows to return, newest last",
+        PropertyList({
+            Property("samples", kPropertyTypeInteger, 6, 0, METRICS_RING_SIZE)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Metrics::GetInstance().GetReportJson(properties["samples"].value<int>());
+        });
+
+    AddUserOnlyTool("self.diagnostics.replay_capture",
+        "Download a capture of server messages (`scripts/mock_server.py --capture`, or a fuzzed one from\n"
+        "`scripts/fuzz_capture.py`) and run every record through the JSON / binary frame / UDP packet\n"
+        "parsers without acting on it. Returns per kind the count, rejected records, average / max parse\n"
+        "time in microseconds and the most heap held by one parsed message.\n"
+        "Args:\n"
+        "  `url`: Capture URL, e.g. `http://192.168.1.10:8002/capture.bin`",
+        PropertyList({
+            Property("url", kPropertyTypeString)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            ProtocolReplay replay;
+            if (!replay.Run(properties["url"].value<std::string>())) {
+                return false;
+            }
+            return replay.GetReportJson();
+        }, 8192);
+
+    if (camera) {
+        AddUserOnlyTool("self.diagnostics.get_camera_timing",
+            "Get the timing in microseconds of the last photo: capture, byte swap and downscale to the\n"
+            "preview size, and showing the preview on the display, with the preview size.",
+            PropertyList(),
+            [camera](const PropertyList& properties) -> ReturnValue {
+                return camera->GetTimingJson();
+            });
+    }
+
+    AddUserOnlyTool("self.diagnostics.chat_benchmark",
+        "Post a conversation of mixed user / assistant / system messages to the display and return the\n"
+        "average / max SetChatMessage time and frame render time in microseconds, with the free internal\n"
+        "heap at the start, lowest point and end of the run. The conversation on the screen before the\n"
+        "run is put back afterwards.\n"
+        "Args:\n"
+        "  `count`: Number of messages, one every 30ms",
+        PropertyList({
+            Property("count", kPropertyTypeInteger, 100, 1, CHAT_BENCHMARK_MAX_MESSAGES)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto display = Board::GetInstance().GetDisplay();
+            return display->RunChatBenchmark(properties["count"].value<int>());
+        }, 4096);
+
+#if CONFIG_USE_GLYPH_CACHE
+    AddUserOnlyTool("self.diagnostics.get_glyph_cache",
+        "Get the glyph cache budget and use in bytes, the cached glyphs and the hits / misses / evictions since boot.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return GlyphCache::GetInstance().GetStatsJson();
+        });
+#endif
+
+#if CONFIG_USE_TRACE_RECORDER
+    AddUserOnlyTool("self.diagnostics.upload_trace",
+        "Upload the binary scheduling trace (task switches, device states, audio queue depths, servo moves)\n"
+        "with a HTTP POST, e.g. to `scripts/trace_to_perfetto.py receive`. After a crash the trace of the\n"
+        "crashed boot is uploaded first and recording resumes afterwards.\n"
+        "Args:\n"
+        "  `url`: Receiver URL, e.g. `http://192.168.1.10:8090/trace`",
+        PropertyList({
+            Property("url", kPropertyTypeString)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& recorder = TraceRecorder::GetInstance();
+            if (!recorder.Upload(properties["url"].value<std::string>())) {
+                return false;
+            }
+            return recorder.GetStatusJson();
+        }, 6144);
+#endif
+
+#if CONFIG_USE_AUDIO_LATENCY_TRACER
+    AddUserOnlyTool("self.diagnostics.get_audio_latency",
+        "Get the p50 / p95 / p99 latency in microseconds of every audio pipeline stage.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& app = Application::GetInstance();
+            return app.GetAudioService().GetLatencyTracer().GetReportJson();
+        });
+#endif
+
+#if CONFIG_USE_ADAPTIVE_UPLINK
+    AddUserOnlyTool("self.diagnostics.get_uplink_status",
+        "Get the current uplink Opus settings chosen by the congestion controller, with the RSSI it saw.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& app = Application::GetInstance();
+            return app.GetAudioService().GetUplinkController().GetStatusJson();
+        });
+#endif
+
+#if CONFIG_USE_VAD_GATED_UPLINK
+    AddUserOnlyTool("self.diagnostics.get_vad_gate",
+        "Get the frames and bytes encoded and sent while listening since boot, with the bytes sent per minute.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& app = Application::GetInstance();
+            return app.GetAudioService().GetUplinkGate().GetStatsJson();
+        });
+#endif
+
+#if CONFIG_USE_AUDIO_DEBUGGER
+    AddUserOnlyTool("self.diagnostics.set_audio_tap",
+        "Select the audio pipeline stages streamed to the audio debug server.\n"
+        "Args:\n"
+        "  `stages`: Bitmask, 1 = raw mic, 2 = processed (AEC / NS), 4 = decoded TTS, 8 = playback, 0 = off\n"
+        "  `server`: Optional receiver address `IP:PORT`, empty to keep the current one",
+        PropertyList({
+            Property("stages", kPropertyTypeInteger, 0, 15),
+            Property("server", kPropertyTypeString, std::string(""))
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto debugger = Application::GetInstance().GetAudioService().GetAudioDebugger();
+            if (debugger == nullptr) {
+                return false;
+            }
+            auto server = properties["server"].value<std::string>();
+            if (!server.empty() && !debugger->SetServer(server)) {
+                return false;
+            }
+            debugger->SetStageMask(properties["stages"].value<int>());
+            return true;
+        });
+#endif
+
     // Restore the original tools list to the end of the tools list
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
 }
@@ -128,16 +289,17 @@ void McpServer::AddTool(const std::string& name, const std::string& description,
     AddTool(new McpTool(name, description, properties, callback));
 }
 
-void McpServer::AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
+void McpServer::AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback, size_t task_stack_size) {
     auto tool = new McpTool(name, description, properties, callback);
     tool->set_user_only(true);
+    tool->set_task_stack_size(task_stack_size);
     AddTool(tool);
 }
 
 void McpServer::ParseMessage(const std::string& message) {
-    cJSON* json = cJSON_Parse(message.c_str());
+    cJSON* json = Protocol::ParseJson(message.data(), message.size());
     if (json == nullptr) {
-        ESP_LOGE(TAG, "Failed to parse MCP message: %s", message.c_str());
+        ESP_LOGE(TAG, "Failed to parse MCP message: %.*s", (int)std::min<size_t>(message.size(), 128), message.c_str());
         return;
     }
     ParseMessage(json);
@@ -252,11 +414,16 @@ void McpServer::ReplyResult(int id, const std::string& result) {
 }
 
 void McpServer::ReplyError(int id, const std::string& message) {
+    // The message may echo a method or tool name sent by the server, escape it
+    auto message_json = cJSON_CreateString(message.c_str());
+    auto message_str = cJSON_PrintUnformatted(message_json);
     std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
     payload += std::to_string(id);
-    payload += ",\"error\":{\"message\":\"";
-    payload += message;
-    payload += "\"}}";
+    payload += ",\"error\":{\"message\":";
+    payload += message_str;
+    payload += "}}";
+    cJSON_free(message_str);
+    cJSON_Delete(message_json);
     Application::GetInstance().SendMcpMessage(payload);
 }
 
@@ -353,14 +520,50 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
         return;
     }
 
+    McpTool* tool = *tool_iter;
+    if (tool->task_stack_size() > 0) {
+        // Downloads, uploads and benchmarks take seconds, the main loop must not wait for them
+        if (task_call_running_.exchange(true)) {
+            ReplyError(id, "Device is busy, another diagnostics call is running");
+            return;
+        }
+        esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+        cfg.thread_name = "tool_call";
+        cfg.stack_size = tool->task_stack_size();
+        cfg.prio = 1;
+        esp_pthread_set_cfg(&cfg);
+        try {
+            std::thread([this, id, tool, arguments = std::move(arguments)]() {
+                try {
+                    ReplyResult(id, tool->Call(arguments));
+                } catch (const std::exception& e) {
+                    ESP_LOGE(TAG, "tools/call: %s", e.what());
+                    ReplyError(id, e.what());
+                }
+                task_call_running_ = false;
+            }).detach();
+        } catch (const std::system_error& e) {
+            ESP_LOGE(TAG, "tools/call: failed to create the thread: %s", e.what());
+            task_call_running_ = false;
+            ReplyError(id, "Failed to start the tool call");
+        }
+        // Threads created later by this task get the default config again
+        cfg = esp_pthread_get_default_config();
+        esp_pthread_set_cfg(&cfg);
+        return;
+    }
+
     // Use main thread to call the tool
     auto& app = Application::GetInstance();
-    app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
+    bool scheduled = app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
         try {
             ReplyResult(id, (*tool_iter)->Call(arguments));
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
             ReplyError(id, e.what());
         }
-    });
+    }, kMainEventMcpTool);
+    if (!scheduled) {
+        ReplyError(id, "Device is busy, too many pending tool calls");
+    }
 }
\ No newline at end of file
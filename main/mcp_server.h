@@ -8,6 +8,7 @@
 #include <variant>
 #include <optional>
 #include <stdexcept>
+#include <atomic>
 #include <thread>
 
 #include <cJSON.h>
@@ -178,6 +179,8 @@ private:
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
     bool user_only_ = false;
+    // Non zero: the call runs in a thread of this stack size instead of the main loop
+    size_t task_stack_size_ = 0;
 
 public:
     McpTool(const std::string& name, 
@@ -190,10 +193,12 @@ public:
         callback_(callback) {}
 
     void set_user_only(bool user_only) { user_only_ = user_only; }
+    void set_task_stack_size(size_t stack_size) { task_stack_size_ = stack_size; }
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
     inline bool user_only() const { return user_only_; }
+    inline size_t task_stack_size() const { return task_stack_size_; }
 
     std::string to_json() const {
         std::vector<std::string> required = properties_.GetRequired();
@@ -271,7 +276,9 @@ public:
     void AddCommonTools();
     void AddTool(McpTool* tool);
     void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
-    void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
+    // A non zero task_stack_size runs the tool in a thread of its own, for diagnostics that take
+    // seconds; the result is sent when it is ready and one such call runs at a time
+    void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback, size_t task_stack_size = 0);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
 
@@ -288,6 +295,7 @@ private:
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
 
     std::vector<McpTool*> tools_;
+    std::atomic<bool> task_call_running_ = false;
 };
 
 #endif // MCP_SERVER_H
@@ -0,0 +1,225 @@
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <cJSON.h>
+
+#include <cstring>
+#include <algorithm>
+
+#define TAG "Metrics"
+
+static const char* const kCounterNames[kMetricCounterCount] = {
+    "audio_sent", "audio_send_failures", "text_send_failures", "audio_received", "decode_drops", "servo_commands",
+    "udp_lost", "udp_late", "udp_duplicate", "udp_reordered", "uplink_bytes", "uplink_suppressed",
+    "mqtt_disconnects", "mqtt_reconnects", "mqtt_connect_failures", "udp_resumed",
+};
+
+static const char* const kGaugeNames[kMetricGaugeCount] = {
+    "decode_queue", "encode_queue", "send_queue", "playback_queue", "cpu_load",
+    "sram_free", "sram_largest", "sram_min_free", "psram_free", "psram_largest", "uplink_level",
+    "mqtt_outage_ms",
+};
+
+static const char* const kHistogramNames[kMetricHistogramCount] = {
+    "opus_encode", "opus_decode",
+};
+
+void Metrics::SetGauge(MetricGauge gauge, int32_t value) {
+    gauges_[gauge].store(value, std::memory_order_relaxed);
+    int32_t peak = peaks_[gauge].load(std::memory_order_relaxed);
+    while (value > peak && !peaks_[gauge].compare_exchange_weak(peak, value, std::memory_order_relaxed)) {
+    }
+}
+
+bool Metrics::IsSampledGauge(MetricGauge gauge) {
+    switch (gauge) {
+    case kMetricCpuLoad:
+    case kMetricInternalFree:
+    case kMetricInternalLargestBlock:
+    case kMetricInternalMinimumFree:
+    case kMetricPsramFree:
+    case kMetricPsramLargestBlock:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void Metrics::Record(MetricHistogram histogram, uint32_t us) {
+    auto& h = histograms_[histogram];
+    int bucket = 0;
+    for (uint32_t limit = 128; bucket < METRICS_HISTOGRAM_BUCKETS - 1 && us >= limit; limit <<= 1) {
+        bucket++;
+    }
+    h.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    uint32_t max_us = h.max_us.load(std::memory_order_relaxed);
+    while (us > max_us && !h.max_us.compare_exchange_weak(max_us, us, std::memory_order_relaxed)) {
+    }
+}
+
+void Metrics::Sample() {
+    SetGauge(kMetricInternalFree, heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    SetGauge(kMetricInternalLargestBlock, heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+    SetGauge(kMetricInternalMinimumFree, heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+    SetGauge(kMetricPsramFree, heap_caps_get_free_size(MALLOC_CAP_SPIRAM));
+    SetGauge(kMetricPsramLargestBlock, heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    SampleTasks();
+
+    auto& row = ring_[(ring_head_ + ring_size_) % METRICS_RING_SIZE];
+    if (ring_size_ < METRICS_RING_SIZE) {
+        ring_size_++;
+    } else {
+        ring_head_ = (ring_head_ + 1) % METRICS_RING_SIZE;
+    }
+    row.uptime_s = esp_timer_get_time() / 1000000;
+    for (int i = 0; i < kMetricGaugeCount; i++) {
+        // Start the next interval from the current value
+        int32_t value = gauges_[i].load(std::memory_order_relaxed);
+        int32_t peak = peaks_[i].exchange(value, std::memory_order_relaxed);
+        row.gauges[i] = IsSampledGauge((MetricGauge)i) ? value : peak;
+    }
+    for (int i = 0; i < kMetricCounterCount; i++) {
+        uint32_t value = counters_[i].load(std::memory_order_relaxed);
+        row.counters[i] = value - last_counters_[i];
+        last_counters_[i] = value;
+    }
+}
+
+// CPU usage of every task since the previous sample
+void Metrics::SampleTasks() {
+    UBaseType_t size = uxTaskGetNumberOfTasks() + 4;
+    auto status = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * size);
+    auto samples = (TaskSample*)malloc(sizeof(TaskSample) * METRICS_MAX_TASKS);
+    if (status == nullptr || samples == nullptr) {
+        free(status);
+        free(samples);
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE total_run_time;
+    size = uxTaskGetSystemState(status, size, &total_run_time);
+    uint32_t elapsed = ((uint32_t)total_run_time - last_total_run_time_) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+    bool first = last_total_run_time_ == 0;
+    last_total_run_time_ = total_run_time;
+
+    int count = 0;
+    uint32_t idle_time = 0;
+    for (UBaseType_t i = 0; i < size && count < METRICS_MAX_TASKS; i++) {
+        auto& sample = samples[count++];
+        sample.handle = status[i].xHandle;
+        strncpy(sample.name, status[i].pcTaskName, sizeof(sample.name) - 1);
+        sample.name[sizeof(sample.name) - 1] = '\0';
+        sample.run_time = status[i].ulRunTimeCounter;
+        sample.stack_free = status[i].usStackHighWaterMark;
+
+        // Tasks created during the interval count from zero
+        uint32_t previous = 0;
+        for (int j = 0; j < task_count_; j++) {
+            if (tasks_[j].handle == sample.handle) {
+                previous = tasks_[j].run_time;
+                break;
+            }
+        }
+        uint32_t used = sample.run_time - previous;
+        sample.cpu_percent = (first || elapsed == 0) ? 0 : (uint64_t)used * 100 / elapsed;
+        if (strncmp(sample.name, "IDLE", 4) == 0) {
+            idle_time += used;
+        }
+    }
+    memcpy(tasks_, samples, sizeof(TaskSample) * count);
+    free(status);
+    free(samples);
+    task_count_ = count;
+    if (!first && elapsed > 0 && idle_time <= elapsed) {
+        SetGauge(kMetricCpuLoad, 100 - (uint64_t)idle_time * 100 / elapsed);
+    }
+}
+
+void Metrics::PrintSummary() {
+    ESP_LOGI(TAG, "cpu %ld%% sram %ld/%ld (min %ld) psram %ld/%ld queues dec %ld enc %ld send %ld play %ld",
+        (long)gauges_[kMetricCpuLoad].load(), (long)gauges_[kMetricInternalFree].load(),
+        (long)gauges_[kMetricInternalLargestBlock].load(), (long)gauges_[kMetricInternalMinimumFree].load(),
+        (long)gauges_[kMetricPsramFree].load(), (long)gauges_[kMetricPsramLargestBlock].load(),
+        (long)gauges_[kMetricDecodeQueue].load(), (long)gauges_[kMetricEncodeQueue].load(),
+        (long)gauges_[kMetricSendQueue].load(), (long)gauges_[kMetricPlaybackQueue].load());
+}
+
+std::string Metrics::GetReportJson(int samples) {
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "interval_s", METRICS_SAMPLE_INTERVAL_S);
+    cJSON_AddNumberToObject(root, "uptime_s", esp_timer_get_time() / 1000000);
+
+    auto counters = cJSON_AddObjectToObject(root, "counters");
+    for (int i = 0; i < kMetricCounterCount; i++) {
+        cJSON_AddNumberToObject(counters, kCounterNames[i], counters_[i].load(std::memory_order_relaxed));
+    }
+    auto gauges = cJSON_AddObjectToObject(root, "gauges");
+    for (int i = 0; i < kMetricGaugeCount; i++) {
+        cJSON_AddNumberToObject(gauges, kGaugeNames[i], gauges_[i].load(std::memory_order_relaxed));
+    }
+
+    auto histograms = cJSON_AddObjectToObject(root, "histograms");
+    auto bounds = cJSON_AddArrayToObject(histograms, "bucket_limits_us");
+    for (int i = 0; i < METRICS_HISTOGRAM_BUCKETS - 1; i++) {
+        cJSON_AddItemToArray(bounds, cJSON_CreateNumber(128 << i));
+    }
+    for (int i = 0; i < kMetricHistogramCount; i++) {
+        auto& h = histograms_[i];
+        auto item = cJSON_AddObjectToObject(histograms, kHistogramNames[i]);
+        cJSON_AddNumberToObject(item, "count", h.count.load(std::memory_order_relaxed));
+        cJSON_AddNumberToObject(item, "max", h.max_us.load(std::memory_order_relaxed));
+        int buckets[METRICS_HISTOGRAM_BUCKETS];
+        for (int j = 0; j < METRICS_HISTOGRAM_BUCKETS; j++) {
+            buckets[j] = h.buckets[j].load(std::memory_order_relaxed);
+        }
+        cJSON_AddItemToObject(item, "buckets", cJSON_CreateIntArray(buckets, METRICS_HISTOGRAM_BUCKETS));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto tasks = cJSON_AddArrayToObject(root, "tasks");
+        for (int i = 0; i < task_count_; i++) {
+            auto item = cJSON_CreateArray();
+            cJSON_AddItemToArray(item, cJSON_CreateString(tasks_[i].name));
+            cJSON_AddItemToArray(item, cJSON_CreateNumber(tasks_[i].cpu_percent));
+            cJSON_AddItemToArray(item, cJSON_CreateNumber(tasks_[i].stack_free));
+            cJSON_AddItemToArray(tasks, item);
+        }
+
+        // Columnar rows keep the report small enough for a single MCP reply
+        auto ring = cJSON_AddObjectToObject(root, "ring");
+        auto columns = cJSON_AddArrayToObject(ring, "columns");
+        cJSON_AddItemToArray(columns, cJSON_CreateString("uptime_s"));
+        for (int i = 0; i < kMetricGaugeCount; i++) {
+            cJSON_AddItemToArray(columns, cJSON_CreateString(kGaugeNames[i]));
+        }
+        for (int i = 0; i < kMetricCounterCount; i++) {
+            cJSON_AddItemToArray(columns, cJSON_CreateString(kCounterNames[i]));
+        }
+        auto rows = cJSON_AddArrayToObject(ring, "rows");
+        int count = std::min(samples, ring_size_);
+        for (int i = ring_size_ - count; i < ring_size_; i++) {
+            auto& row = ring_[(ring_head_ + i) % METRICS_RING_SIZE];
+            int values[1 + kMetricGaugeCount + kMetricCounterCount];
+            int n = 0;
+            values[n++] = row.uptime_s;
+            for (int j = 0; j < kMetricGaugeCount; j++) {
+                values[n++] = row.gauges[j];
+            }
+            for (int j = 0; j < kMetricCounterCount; j++) {
+                values[n++] = row.counters[j];
+            }
+            cJSON_AddItemToArray(rows, cJSON_CreateIntArray(values, n));
+        }
+    }
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
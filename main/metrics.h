@@ -0,0 +1,132 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+/*
+ * Always-on runtime metrics for diagnosing stalls in the field.
+ *
+ * Counters, gauges and histograms are fixed arrays of atomics, so recording from the audio
+ * tasks costs a few instructions and never takes a lock. Sample() runs every
+ * METRICS_SAMPLE_INTERVAL_S from the main loop: it reads the heap and per-task CPU usage and
+ * appends one row to a ring of METRICS_RING_SIZE samples.
+ */
+#define METRICS_SAMPLE_INTERVAL_S 10
+#define METRICS_RING_SIZE 60                // 10 minutes of history
+#define METRICS_HISTOGRAM_BUCKETS 12        // <128us, <256us, ... <131ms, >=131ms
+#define METRICS_MAX_TASKS 32
+
+enum MetricCounter {
+    kMetricAudioPacketsSent,
+    kMetricAudioSendFailures,
+    kMetricTextSendFailures,
+    kMetricAudioPacketsReceived,
+    kMetricDecodeQueueDrops,
+    kMetricServoCommands,
+    kMetricUdpLost,
+    kMetricUdpLate,
+    kMetricUdpDuplicate,
+    kMetricUdpReordered,
+    kMetricUplinkBytes,         // Opus bytes queued for sending while listening
+    kMetricUplinkSuppressed,    // Silent frames the VAD gate did not send
+    kMetricMqttDisconnects,
+    kMetricMqttReconnects,
+    kMetricMqttConnectFailures,
+    kMetricUdpResumed,          // Audio channels opened with the key of the last session
+    kMetricCounterCount,
+};
+
+// The ring keeps the highest value of the queue and event gauges seen during the interval.
+// CPU load and the heap gauges are read once by Sample(), their rows hold the sampled value so
+// that a drop of free memory or of the largest block shows up in the row it happened in
+enum MetricGauge {
+    kMetricDecodeQueue,
+    kMetricEncodeQueue,
+    kMetricSendQueue,
+    kMetricPlaybackQueue,
+    kMetricCpuLoad,             // percent of all cores, excluding the idle tasks
+    kMetricInternalFree,
+    kMetricInternalLargestBlock,
+    kMetricInternalMinimumFree,
+    kMetricPsramFree,
+    kMetricPsramLargestBlock,
+    kMetricUplinkLevel,         // UplinkController level, 0 is the full bitrate
+    kMetricMqttOutage,          // ms from the last MQTT disconnect to the reconnect
+    kMetricGaugeCount,
+};
+
+enum MetricHistogram {
+    kMetricOpusEncode,
+    kMetricOpusDecode,
+    kMetricHistogramCount,
+};
+
+class Metrics {
+public:
+    static Metrics& GetInstance() {
+        static Metrics instance;
+        return instance;
+    }
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void Increment(MetricCounter counter, uint32_t value = 1) {
+        counters_[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+    void SetGauge(MetricGauge gauge, int32_t value);
+    static bool IsSampledGauge(MetricGauge gauge);
+    void Record(MetricHistogram histogram, uint32_t us);
+
+    void Sample();
+    void PrintSummary();
+    // {"interval_s":10,"counters":{..},"gauges":{..},"histograms":{..},"tasks":[[name,cpu%,stack_free],..],
+    //  "ring":{"columns":[..],"rows":[[uptime_s,..],..]}}, the last `samples` rows, oldest first
+    std::string GetReportJson(int samples);
+
+private:
+    Metrics() = default;
+
+    struct Histogram {
+        std::atomic<uint32_t> buckets[METRICS_HISTOGRAM_BUCKETS] = {};
+        std::atomic<uint32_t> count = 0;
+        std::atomic<uint32_t> max_us = 0;
+    };
+
+    struct Row {
+        uint32_t uptime_s;
+        int32_t gauges[kMetricGaugeCount];
+        uint32_t counters[kMetricCounterCount];     // Increase during the interval
+    };
+
+    struct TaskSample {
+        TaskHandle_t handle;
+        char name[configMAX_TASK_NAME_LEN];
+        uint32_t run_time;
+        uint8_t cpu_percent;
+        uint32_t stack_free;
+    };
+
+    std::atomic<uint32_t> counters_[kMetricCounterCount] = {};
+    std::atomic<int32_t> gauges_[kMetricGaugeCount] = {};
+    std::atomic<int32_t> peaks_[kMetricGaugeCount] = {};
+    Histogram histograms_[kMetricHistogramCount];
+
+    std::mutex mutex_;
+    Row ring_[METRICS_RING_SIZE];
+    int ring_head_ = 0;
+    int ring_size_ = 0;
+    uint32_t last_counters_[kMetricCounterCount] = {};
+    TaskSample tasks_[METRICS_MAX_TASKS];
+    int task_count_ = 0;
+    uint32_t last_total_run_time_ = 0;
+
+    void SampleTasks();
+};
+
+#endif // METRICS_H
@@ -1,6 +1,8 @@
 #include "ota.h"
+#include "ota_package.h"
 #include "system_info.h"
 #include "settings.h"
+#include "server_config.h"
 #include "assets/lang_config.h"
 
 #include <cJSON.h>
@@ -10,17 +12,304 @@
 #include <esp_app_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
 
 #include <cstring>
+#include <strings.h>
 #include <vector>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
 
 #define TAG "Ota"
 
+// 固件下载缓冲区：两块缓冲交替使用，网络读取与写flash并行
+#define OTA_BUFFER_SIZE (64 * 1024)
+#define OTA_FALLBACK_BUFFER_SIZE (8 * 1024)     // 没有PSRAM时使用的内部RAM缓冲区大小
+#define OTA_BUFFER_COUNT 2
+#define OTA_MAX_RESUME_ATTEMPTS 5
+#define OTA_WRITE_SIZE 4096
+#define OTA_IMAGE_HEADER_SIZE (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t))
+
+namespace {
+
+struct OtaBuffer {
+    uint8_t* data;
+    size_t size;
+};
+
+bool CheckImageHeader(const uint8_t* data) {
+    esp_app_desc_t new_app_info;
+    memcpy(&new_app_info, data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+    ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
+
+    auto current_version = esp_app_get_description()->version;
+    if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
+        ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Flash writer stage of the OTA pipeline.
+ *
+ * The downloader takes a free buffer, fills it from HTTP and submits it; the writer task
+ * streams submitted buffers into the OTA partition and updates the SHA-256 of the image,
+ * then hands the buffer back. A nullptr in the full queue ends the stream.
+ * After a write error the task keeps recycling buffers so the downloader never blocks.
+ *
+ * A download starting with the package magic is decoded by OtaPackageDecoder on the way,
+ * otherwise it is a plain application image. The partition is only opened after the
+ * image header passed the version check.
+ */
+class OtaFlashWriter {
+public:
+    explicit OtaFlashWriter(const esp_partition_t* partition) : partition_(partition) {
+        buffer_size_ = OTA_BUFFER_SIZE;
+        for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+            storage_[i] = (uint8_t*)heap_caps_malloc(buffer_size_, MALLOC_CAP_SPIRAM);
+        }
+        if (storage_[0] == nullptr || storage_[OTA_BUFFER_COUNT - 1] == nullptr) {
+            FreeStorage();
+            buffer_size_ = OTA_FALLBACK_BUFFER_SIZE;
+            for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+                storage_[i] = (uint8_t*)heap_caps_malloc(buffer_size_, MALLOC_CAP_8BIT);
+            }
+        }
+        stage_ = (uint8_t*)heap_caps_malloc(OTA_WRITE_SIZE, MALLOC_CAP_8BIT);
+
+        free_queue_ = xQueueCreate(OTA_BUFFER_COUNT, sizeof(OtaBuffer*));
+        full_queue_ = xQueueCreate(OTA_BUFFER_COUNT + 1, sizeof(OtaBuffer*));
+        done_ = xSemaphoreCreateBinary();
+        for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+            buffers_[i] = {storage_[i], 0};
+            auto buffer = &buffers_[i];
+            xQueueSend(free_queue_, &buffer, 0);
+        }
+        mbedtls_sha256_init(&sha256_);
+    }
+
+    ~OtaFlashWriter() {
+        StopTask();
+        if (begun_ && !ended_) {
+            esp_ota_abort(handle_);
+        }
+        mbedtls_sha256_free(&sha256_);
+        vSemaphoreDelete(done_);
+        vQueueDelete(full_queue_);
+        vQueueDelete(free_queue_);
+        heap_caps_free(stage_);
+        FreeStorage();
+    }
+
+    bool Valid() const {
+        for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+            if (storage_[i] == nullptr) {
+                return false;
+            }
+        }
+        return stage_ != nullptr && free_queue_ != nullptr && full_queue_ != nullptr && done_ != nullptr;
+    }
+
+    size_t GetBufferSize() const { return buffer_size_; }
+    size_t GetWrittenBytes() const { return written_.load(); }
+    bool HasFailed() const { return failed_.load(); }
+
+    // SHA-256 the package declares for the decoded image, nullptr for a plain image
+    const uint8_t* GetPackageSha256() const {
+        return decoder_ ? decoder_->GetImageSha256() : nullptr;
+    }
+
+    bool Start() {
+        if (xTaskCreate([](void* arg) {
+            ((OtaFlashWriter*)arg)->WriterTask();
+            vTaskDelete(NULL);
+        }, "ota_writer", 4096 + 2048, this, 4, &task_) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create OTA writer task");
+            task_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    OtaBuffer* AcquireBuffer() {
+        OtaBuffer* buffer = nullptr;
+        xQueueReceive(free_queue_, &buffer, portMAX_DELAY);
+        buffer->size = 0;
+        return buffer;
+    }
+
+    void SubmitBuffer(OtaBuffer* buffer) {
+        xQueueSend(full_queue_, &buffer, portMAX_DELAY);
+    }
+
+    // Wait for all submitted buffers to be written, then finalize the partition
+    esp_err_t Finish(uint8_t sha256[32]) {
+        StopTask();
+        if (failed_.load()) {
+            return ESP_FAIL;
+        }
+        if (decoder_ && !decoder_->Finished()) {
+            ESP_LOGE(TAG, "Firmware package is truncated");
+            return ESP_FAIL;
+        }
+        if (!begun_) {
+            ESP_LOGE(TAG, "Firmware image is too small");
+            return ESP_FAIL;
+        }
+        if (stage_size_ > 0 && !WriteFlash(stage_, stage_size_)) {
+            return ESP_FAIL;
+        }
+        mbedtls_sha256_finish(&sha256_, sha256);
+        ended_ = true;
+        ESP_LOGI(TAG, "Image of %u bytes written", image_size_);
+        return esp_ota_end(handle_);
+    }
+
+private:
+    const esp_partition_t* partition_;
+    esp_ota_handle_t handle_ = 0;
+    bool begun_ = false;
+    bool ended_ = false;
+    uint8_t* storage_[OTA_BUFFER_COUNT] = {};
+    OtaBuffer buffers_[OTA_BUFFER_COUNT];
+    size_t buffer_size_;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t full_queue_ = nullptr;
+    SemaphoreHandle_t done_ = nullptr;
+    TaskHandle_t task_ = nullptr;
+    mbedtls_sha256_context sha256_;
+    std::atomic<size_t> written_{0};
+    std::atomic<bool> failed_{false};
+
+    // Only accessed by the writer task until it has stopped
+    bool stream_started_ = false;
+    std::unique_ptr<OtaPackageDecoder> decoder_;
+    uint8_t image_header_[OTA_IMAGE_HEADER_SIZE];
+    size_t image_header_size_ = 0;
+    uint8_t* stage_ = nullptr;
+    size_t stage_size_ = 0;
+    size_t image_size_ = 0;
+
+    void WriterTask() {
+        OtaBuffer* buffer = nullptr;
+        while (xQueueReceive(full_queue_, &buffer, portMAX_DELAY) == pdTRUE && buffer != nullptr) {
+            if (!failed_.load()) {
+                if (ProcessInput(buffer->data, buffer->size)) {
+                    written_.fetch_add(buffer->size);
+                } else {
+                    failed_.store(true);
+                }
+            }
+            xQueueSend(free_queue_, &buffer, portMAX_DELAY);
+        }
+        xSemaphoreGive(done_);
+    }
+
+    bool ProcessInput(const uint8_t* data, size_t size) {
+        if (!stream_started_) {
+            stream_started_ = true;
+            if (OtaPackageDecoder::IsPackage(data, size)) {
+                auto running = esp_ota_get_running_partition();
+                decoder_ = std::make_unique<OtaPackageDecoder>(
+                    [this](const uint8_t* image, size_t image_size) {
+                        return WriteImage(image, image_size);
+                    },
+                    [running](size_t offset, uint8_t* base, size_t base_size) {
+                        return esp_partition_read(running, offset, base, base_size) == ESP_OK;
+                    });
+            }
+        }
+        if (decoder_) {
+            return decoder_->Feed(data, size);
+        }
+        return WriteImage(data, size);
+    }
+
+    bool WriteImage(const uint8_t* data, size_t size) {
+        if (!begun_) {
+            size_t n = std::min(size, OTA_IMAGE_HEADER_SIZE - image_header_size_);
+            memcpy(image_header_ + image_header_size_, data, n);
+            image_header_size_ += n;
+            data += n;
+            size -= n;
+            if (image_header_size_ < OTA_IMAGE_HEADER_SIZE) {
+                return true;
+            }
+            if (!CheckImageHeader(image_header_)) {
+                return false;
+            }
+            auto err = esp_ota_begin(partition_, OTA_WITH_SEQUENTIAL_WRITES, &handle_);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to begin OTA: %s", esp_err_to_name(err));
+                return false;
+            }
+            begun_ = true;
+            mbedtls_sha256_starts(&sha256_, 0);
+            if (!WriteImage(image_header_, image_header_size_)) {
+                return false;
+            }
+        }
+
+        // Decoded data arrives in small pieces, collect it so flash is written in whole sectors
+        if (stage_size_ == 0 && size >= OTA_WRITE_SIZE) {
+            return WriteFlash(data, size);
+        }
+        while (size > 0) {
+            size_t n = std::min(size, OTA_WRITE_SIZE - stage_size_);
+            memcpy(stage_ + stage_size_, data, n);
+            stage_size_ += n;
+            data += n;
+            size -= n;
+            if (stage_size_ == OTA_WRITE_SIZE) {
+                if (!WriteFlash(stage_, stage_size_)) {
+                    return false;
+                }
+                stage_size_ = 0;
+            }
+        }
+        return true;
+    }
+
+    bool WriteFlash(const uint8_t* data, size_t size) {
+        auto err = esp_ota_write(handle_, data, size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+            return false;
+        }
+        mbedtls_sha256_update(&sha256_, data, size);
+        image_size_ += size;
+        return true;
+    }
+
+    void StopTask() {
+        if (task_ == nullptr) {
+            return;
+        }
+        OtaBuffer* end = nullptr;
+        xQueueSend(full_queue_, &end, portMAX_DELAY);
+        xSemaphoreTake(done_, portMAX_DELAY);
+        task_ = nullptr;
+    }
+
+    void FreeStorage() {
+        for (int i = 0; i < OTA_BUFFER_COUNT; i++) {
+            heap_caps_free(storage_[i]);
+            storage_[i] = nullptr;
+        }
+    }
+};
+
+} // namespace
+
 
 Ota::Ota() {
 #ifdef ESP_EFUSE_BLOCK_USR_DATA
@@ -63,6 +352,8 @@ std::unique_ptr<Http> Ota::SetupHttp() {
     }
     http->SetHeader("User-Agent", user_agent);
     http->SetHeader("Accept-Language", Lang::CODE);
+    // Firmware payloads we can install, the server may answer with a compressed image or a delta
+    http->SetHeader("Firmware-Formats", OTA_PACKAGE_FORMATS);
     http->SetHeader("Content-Type", "application/json");
 
     return http;
@@ -139,47 +430,9 @@ bool Ota::CheckVersion() {
         }
     }
 
-    has_mqtt_config_ = false;
-    cJSON *mqtt = cJSON_GetObjectItem(root, "mqtt");
-    if (cJSON_IsObject(mqtt)) {
-        Settings settings("mqtt", true);
-        cJSON *item = NULL;
-        cJSON_ArrayForEach(item, mqtt) {
-            if (cJSON_IsString(item)) {
-                if (settings.GetString(item->string) != item->valuestring) {
-                    settings.SetString(item->string, item->valuestring);
-                }
-            } else if (cJSON_IsNumber(item)) {
-                if (settings.GetInt(item->string) != item->valueint) {
-                    settings.SetInt(item->string, item->valueint);
-                }
-            }
-        }
-        has_mqtt_config_ = true;
-    } else {
-        ESP_LOGI(TAG, "No mqtt section found !");
-    }
-
-    has_websocket_config_ = false;
-    cJSON *websocket = cJSON_GetObjectItem(root, "websocket");
-    if (cJSON_IsObject(websocket)) {
-        Settings settings("websocket", true);
-        cJSON *item = NULL;
-        cJSON_ArrayForEach(item, websocket) {
-            if (cJSON_IsString(item)) {
-                if (settings.GetString(item->string) != item->valuestring) {
-                    settings.SetString(item->string, item->valuestring);
-                }
-            } else if (cJSON_IsNumber(item)) {
-                if (settings.GetInt(item->string) != item->valueint) {
-                    settings.SetInt(item->string, item->valueint);
-                }
-            }
-        }
-        has_websocket_config_ = true;
-    } else {
-        ESP_LOGI(TAG, "No websocket section found!");
-    }
+    auto server_config = SaveServerConfig(root);
+    has_mqtt_config_ = server_config.has_mqtt;
+    has_websocket_config_ = server_config.has_websocket;
 
     has_server_time_ = false;
     cJSON *server_time = cJSON_GetObjectItem(root, "server_time");
@@ -217,6 +470,9 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // Optional hex SHA-256 of the image, verified before switching the boot partition
+        cJSON *sha256 = cJSON_GetObjectItem(firmware, "sha256");
+        firmware_sha256_ = cJSON_IsString(sha256) ? sha256->valuestring : "";
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -260,9 +516,14 @@ void Ota::MarkCurrentVersionValid() {
     }
 }
 
+/*
+ * Download and write are pipelined: this task reads HTTP into one buffer while the
+ * OtaFlashWriter task decodes and writes the other one to flash. A dropped connection is
+ * resumed with an HTTP Range request from the last received byte, the image hash is
+ * computed while writing so no second pass over the partition is needed.
+ */
 bool Ota::Upgrade(const std::string& firmware_url) {
     ESP_LOGI(TAG, "Upgrading firmware from %s", firmware_url.c_str());
-    esp_ota_handle_t update_handle = 0;
     auto update_partition = esp_ota_get_next_update_partition(NULL);
     if (update_partition == NULL) {
         ESP_LOGE(TAG, "Failed to get update partition");
@@ -270,87 +531,135 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     }
 
     ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
-
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
+    OtaFlashWriter writer(update_partition);
+    if (!writer.Valid()) {
+        ESP_LOGE(TAG, "Failed to allocate OTA buffers");
         return false;
     }
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+    if (!writer.Start()) {
         return false;
     }
+    const size_t buffer_size = writer.GetBufferSize();
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        return false;
-    }
-
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
-        }
-
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
+    auto network = Board::GetInstance().GetNetwork();
+    std::unique_ptr<Http> http;
+    OtaBuffer* buffer = nullptr;
+    size_t image_size = 0, received = 0, skip = 0;
+    size_t resume_offset = 0;
+    int resume_attempts = 0;
+
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    size_t recent_read = 0;
+
+    while (image_size == 0 || received < image_size) {
+        if (!http) {
+            if (received > 0) {
+                // Only consecutive attempts without progress count against the limit
+                if (received > resume_offset) {
+                    resume_offset = received;
+                    resume_attempts = 0;
+                }
+                if (++resume_attempts > OTA_MAX_RESUME_ATTEMPTS) {
+                    ESP_LOGE(TAG, "Too many interruptions, giving up at %u/%u", received, image_size);
+                    return false;
+                }
+                ESP_LOGW(TAG, "Resuming download at %u/%u in %ds (%d/%d)", received, image_size,
+                    resume_attempts, resume_attempts, OTA_MAX_RESUME_ATTEMPTS);
+                vTaskDelay(pdMS_TO_TICKS(1000 * resume_attempts));
             }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
-        }
-
-        if (ret == 0) {
-            break;
-        }
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                ESP_LOGI(TAG, "New firmware version: %s", new_app_info.version);
-
-                auto current_version = esp_app_get_description()->version;
-                if (memcmp(new_app_info.version, current_version, sizeof(new_app_info.version)) == 0) {
-                    ESP_LOGE(TAG, "Firmware version is the same, skipping upgrade");
+            http = network->CreateHttp(0);
+            if (received > 0) {
+                http->SetHeader("Range", "bytes=" + std::to_string(received) + "-");
+            }
+            if (!http->Open("GET", firmware_url)) {
+                ESP_LOGE(TAG, "Failed to open HTTP connection");
+                http.reset();
+                if (received == 0) {
                     return false;
                 }
+                continue;
+            }
 
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
+            int status_code = http->GetStatusCode();
+            size_t body_length = http->GetBodyLength();
+            if (status_code == 206 && received > 0) {
+                if (received + body_length != image_size) {
+                    ESP_LOGE(TAG, "Unexpected range length %u at offset %u, image size %u", body_length, received, image_size);
                     return false;
                 }
-
-                image_header_checked = true;
-                std::string().swap(image_header);
+            } else if (status_code == 200) {
+                if (body_length == 0) {
+                    ESP_LOGE(TAG, "Failed to get content length");
+                    return false;
+                }
+                if (received == 0) {
+                    image_size = body_length;
+                } else if (body_length != image_size) {
+                    ESP_LOGE(TAG, "Firmware size changed from %u to %u, aborting", image_size, body_length);
+                    return false;
+                } else {
+                    // Server does not support Range, discard what we already have
+                    ESP_LOGW(TAG, "Range not supported, skipping %u bytes", received);
+                    skip = received;
+                }
+            } else {
+                ESP_LOGE(TAG, "Failed to get firmware, status code: %d", status_code);
+                return false;
             }
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
+
+        if (buffer == nullptr) {
+            buffer = writer.AcquireBuffer();
+        }
+        if (writer.HasFailed()) {
             return false;
         }
+
+        uint8_t* dest = buffer->data + buffer->size;
+        int ret = http->Read((char*)dest, std::min(buffer_size - buffer->size, image_size - received + skip));
+        if (ret < 0 || (ret == 0 && received < image_size)) {
+            ESP_LOGW(TAG, "Connection lost at %u/%u: %d", received, image_size, ret);
+            http->Close();
+            http.reset();
+            continue;
+        }
+        recent_read += ret;
+        if (skip > 0) {
+            size_t dropped = std::min((size_t)ret, skip);
+            memmove(dest, dest + dropped, ret - dropped);
+            skip -= dropped;
+            ret -= dropped;
+        }
+        received += ret;
+        buffer->size += ret;
+
+        if (buffer->size == buffer_size || received == image_size) {
+            writer.SubmitBuffer(buffer);
+            buffer = nullptr;
+        }
+
+        // Calculate speed and progress every second, progress counts bytes already in flash
+        if (esp_timer_get_time() - last_calc_time >= 1000000) {
+            size_t written = writer.GetWrittenBytes();
+            size_t progress = written * 100 / image_size;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u written, %u received), Speed: %uB/s", progress, written, image_size, received, recent_read);
+            if (upgrade_callback_) {
+                upgrade_callback_(progress, recent_read);
+            }
+            last_calc_time = esp_timer_get_time();
+            recent_read = 0;
+        }
     }
     http->Close();
+    auto download_time = esp_timer_get_time() - start_time;
 
-    esp_err_t err = esp_ota_end(update_handle);
+    uint8_t sha256[32];
+    esp_err_t err = writer.Finish(sha256);
+    auto total_time = esp_timer_get_time() - start_time;
+    ESP_LOGI(TAG, "Downloaded %u bytes in %lldms, written in %lldms, %lluB/s", image_size,
+        download_time / 1000, total_time / 1000, (unsigned long long)image_size * 1000000 / std::max<int64_t>(total_time, 1));
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed, image is corrupted");
@@ -360,12 +669,30 @@ bool Ota::Upgrade(const std::string& firmware_url) {
         return false;
     }
 
+    char sha256_hex[65];
+    for (int i = 0; i < 32; i++) {
+        snprintf(sha256_hex + i * 2, sizeof(sha256_hex) - i * 2, "%02x", sha256[i]);
+    }
+    ESP_LOGI(TAG, "Firmware SHA-256: %s", sha256_hex);
+    auto package_sha256 = writer.GetPackageSha256();
+    if (package_sha256 != nullptr && memcmp(package_sha256, sha256, sizeof(sha256)) != 0) {
+        ESP_LOGE(TAG, "Decoded image does not match the package SHA-256");
+        return false;
+    }
+    if (!firmware_sha256_.empty() && strcasecmp(firmware_sha256_.c_str(), sha256_hex) != 0) {
+        ESP_LOGE(TAG, "Firmware SHA-256 mismatch, expected %s", firmware_sha256_.c_str());
+        return false;
+    }
+
     err = esp_ota_set_boot_partition(update_partition);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
         return false;
     }
 
+    if (upgrade_callback_) {
+        upgrade_callback_(100, 0);
+    }
     ESP_LOGI(TAG, "Firmware upgrade successful");
     return true;
 }
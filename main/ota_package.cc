@@ -0,0 +1,349 @@
+#include "ota_package.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/sha256.h>
+
+#include <cstring>
+#include <algorithm>
+
+#define TAG "OtaPackage"
+
+#define OTA_PACKAGE_BASE_CHUNK 4096
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t* AllocateBuffer(size_t size) {
+    auto buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (buffer == nullptr) {
+        buffer = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_8BIT);
+    }
+    return buffer;
+}
+
+OtaPackageDecoder::OtaPackageDecoder(OutputCallback output, BaseReader base_reader)
+    : output_(output), base_reader_(base_reader) {
+}
+
+OtaPackageDecoder::~OtaPackageDecoder() {
+    heap_caps_free(block_input_);
+    heap_caps_free(block_output_);
+    heap_caps_free(base_buffer_);
+}
+
+bool OtaPackageDecoder::IsPackage(const uint8_t* data, size_t size) {
+    return size >= 4 && memcmp(data, "XZPK", 4) == 0;
+}
+
+bool OtaPackageDecoder::Fail(const char* reason) {
+    ESP_LOGE(TAG, "Invalid package: %s", reason);
+    state_ = kStateError;
+    return false;
+}
+
+bool OtaPackageDecoder::Feed(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        switch (state_) {
+        case kStateHeader: {
+            size_t n = std::min(size, OTA_PACKAGE_HEADER_SIZE - header_size_);
+            memcpy(header_ + header_size_, data, n);
+            header_size_ += n;
+            data += n;
+            size -= n;
+            if (header_size_ == OTA_PACKAGE_HEADER_SIZE && !ParseHeader()) {
+                return false;
+            }
+            break;
+        }
+        case kStateBlockHeader: {
+            size_t n = std::min(size, 4 - block_received_);
+            memcpy(block_input_ + block_received_, data, n);
+            block_received_ += n;
+            data += n;
+            size -= n;
+            if (block_received_ == 4) {
+                uint32_t value = ReadLe32(block_input_);
+                block_stored_ = (value & 0x80000000) != 0;
+                block_length_ = value & 0x7FFFFFFF;
+                block_received_ = 0;
+                size_t expected = std::min(block_size_, stream_size_ - stream_decoded_);
+                if (block_length_ == 0 || block_length_ > block_size_ + block_size_ / 255 + 16 ||
+                    (block_stored_ && block_length_ != expected)) {
+                    return Fail("bad block length");
+                }
+                state_ = kStateBlockData;
+            }
+            break;
+        }
+        case kStateBlockData: {
+            size_t n = std::min(size, block_length_ - block_received_);
+            memcpy(block_input_ + block_received_, data, n);
+            block_received_ += n;
+            data += n;
+            size -= n;
+            if (block_received_ == block_length_) {
+                block_received_ = 0;
+                if (!DecodeBlock()) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case kStateDone:
+            ESP_LOGW(TAG, "Ignoring %u bytes after the end of the package", size);
+            return true;
+        case kStateError:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OtaPackageDecoder::ParseHeader() {
+    if (!IsPackage(header_, header_size_) || header_[4] != OTA_PACKAGE_VERSION) {
+        return Fail("unsupported version");
+    }
+    format_ = (OtaPackageFormat)header_[5];
+    block_size_ = ReadLe32(header_ + 8);
+    stream_size_ = ReadLe32(header_ + 12);
+    image_size_ = ReadLe32(header_ + 16);
+    base_size_ = ReadLe32(header_ + 20);
+    if (format_ != kOtaPackageLz4 && format_ != kOtaPackageDelta) {
+        return Fail("unknown format");
+    }
+    if (block_size_ == 0 || block_size_ > OTA_PACKAGE_MAX_BLOCK_SIZE || stream_size_ == 0 || image_size_ == 0) {
+        return Fail("bad sizes");
+    }
+    if (format_ == kOtaPackageLz4 && stream_size_ != image_size_) {
+        return Fail("stream size mismatch");
+    }
+    ESP_LOGI(TAG, "Package format %s, image %u bytes, stream %u bytes, block %u bytes",
+        format_ == kOtaPackageDelta ? "delta" : "lz4", image_size_, stream_size_, block_size_);
+
+    block_input_ = AllocateBuffer(block_size_ + block_size_ / 255 + 16);
+    block_output_ = AllocateBuffer(block_size_);
+    if (block_input_ == nullptr || block_output_ == nullptr) {
+        return Fail("out of memory");
+    }
+    if (format_ == kOtaPackageDelta) {
+        base_buffer_ = AllocateBuffer(OTA_PACKAGE_BASE_CHUNK);
+        if (base_buffer_ == nullptr) {
+            return Fail("out of memory");
+        }
+        if (!VerifyBase()) {
+            return false;
+        }
+    }
+    state_ = kStateBlockHeader;
+    return true;
+}
+
+// The delta only applies to the exact image it was generated from
+bool OtaPackageDecoder::VerifyBase() {
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    bool ok = true;
+    for (size_t offset = 0; offset < base_size_ && ok; offset += OTA_PACKAGE_BASE_CHUNK) {
+        size_t n = std::min((size_t)OTA_PACKAGE_BASE_CHUNK, base_size_ - offset);
+        ok = base_reader_(offset, base_buffer_, n);
+        mbedtls_sha256_update(&ctx, base_buffer_, n);
+    }
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+    if (!ok) {
+        return Fail("failed to read base image");
+    }
+    if (memcmp(digest, header_ + 56, sizeof(digest)) != 0) {
+        return Fail("base image does not match the running firmware");
+    }
+    return true;
+}
+
+bool OtaPackageDecoder::DecodeBlock() {
+    size_t expected = std::min(block_size_, stream_size_ - stream_decoded_);
+    const uint8_t* block = block_input_;
+    if (!block_stored_) {
+        if (!Lz4Decompress(block_input_, block_length_, block_output_, expected)) {
+            return Fail("corrupted block");
+        }
+        block = block_output_;
+    }
+    stream_decoded_ += expected;
+    if (!ConsumeStream(block, expected)) {
+        return false;
+    }
+
+    if (stream_decoded_ < stream_size_) {
+        state_ = kStateBlockHeader;
+        return true;
+    }
+    if (format_ == kOtaPackageDelta && (op_header_size_ > 0 || op_remaining_ > 0)) {
+        return Fail("truncated operation");
+    }
+    if (image_written_ != image_size_) {
+        return Fail("image size mismatch");
+    }
+    state_ = kStateDone;
+    return true;
+}
+
+bool OtaPackageDecoder::ConsumeStream(const uint8_t* data, size_t size) {
+    if (format_ == kOtaPackageLz4) {
+        return Emit(data, size);
+    }
+    return ConsumeDelta(data, size);
+}
+
+bool OtaPackageDecoder::ConsumeDelta(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        if (op_remaining_ == 0) {
+            // Collect the operation header: op u8, then one or two u32
+            op_header_[op_header_size_++] = *data++;
+            size--;
+            uint8_t op = op_header_[0];
+            size_t header_size = op == 2 ? 5 : 9;
+            if (op > 2) {
+                return Fail("unknown operation");
+            }
+            if (op_header_size_ == header_size) {
+                op_header_size_ = 0;
+                if (!StartOperation()) {
+                    return false;
+                }
+            }
+            continue;
+        }
+
+        size_t n = std::min(size, op_remaining_);
+        if (op_ == 1) {
+            if (!EmitBase(op_source_, data, n)) {
+                return false;
+            }
+            op_source_ += n;
+        } else if (!Emit(data, n)) {
+            return false;
+        }
+        op_remaining_ -= n;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool OtaPackageDecoder::StartOperation() {
+    op_ = op_header_[0];
+    if (op_ == 2) {
+        op_remaining_ = ReadLe32(op_header_ + 1);
+        return true;
+    }
+    op_source_ = ReadLe32(op_header_ + 1);
+    size_t length = ReadLe32(op_header_ + 5);
+    if (op_source_ > base_size_ || length > base_size_ - op_source_) {
+        return Fail("operation outside of the base image");
+    }
+    if (op_ == 0) {
+        // COPY consumes no stream bytes, run it right away
+        return EmitBase(op_source_, nullptr, length);
+    }
+    op_remaining_ = length;
+    return true;
+}
+
+bool OtaPackageDecoder::EmitBase(size_t source, const uint8_t* diff, size_t size) {
+    while (size > 0) {
+        size_t n = std::min(size, (size_t)OTA_PACKAGE_BASE_CHUNK);
+        if (!base_reader_(source, base_buffer_, n)) {
+            return Fail("failed to read base image");
+        }
+        if (diff != nullptr) {
+            for (size_t i = 0; i < n; i++) {
+                base_buffer_[i] += diff[i];
+            }
+            diff += n;
+        }
+        if (!Emit(base_buffer_, n)) {
+            return false;
+        }
+        source += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool OtaPackageDecoder::Emit(const uint8_t* data, size_t size) {
+    if (size > image_size_ - image_written_) {
+        return Fail("image larger than declared");
+    }
+    image_written_ += size;
+    if (!output_(data, size)) {
+        state_ = kStateError;
+        return false;
+    }
+    return true;
+}
+
+// LZ4 block format, the block must decode to exactly dst_size bytes
+bool OtaPackageDecoder::Lz4Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    const uint8_t* ip = src;
+    const uint8_t* const ip_end = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* const op_end = dst + dst_size;
+
+    while (ip < ip_end) {
+        uint8_t token = *ip++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15) {
+            uint8_t b;
+            do {
+                if (ip >= ip_end) {
+                    return false;
+                }
+                b = *ip++;
+                literal_length += b;
+            } while (b == 255);
+        }
+        if (literal_length > (size_t)(ip_end - ip) || literal_length > (size_t)(op_end - op)) {
+            return false;
+        }
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+        if (ip == ip_end) {
+            break;  // The last sequence only has literals
+        }
+
+        if (ip_end - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst)) {
+            return false;
+        }
+        size_t match_length = (token & 0x0F) + 4;
+        if ((token & 0x0F) == 15) {
+            uint8_t b;
+            do {
+                if (ip >= ip_end) {
+                    return false;
+                }
+                b = *ip++;
+                match_length += b;
+            } while (b == 255);
+        }
+        if (match_length > (size_t)(op_end - op)) {
+            return false;
+        }
+        // Byte by byte, matches may overlap their own output
+        const uint8_t* match = op - offset;
+        for (size_t i = 0; i < match_length; i++) {
+            op[i] = match[i];
+        }
+        op += match_length;
+    }
+    return op == op_end;
+}
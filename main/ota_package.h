@@ -0,0 +1,102 @@
+#ifndef _OTA_PACKAGE_H
+#define _OTA_PACKAGE_H
+
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Compressed and delta firmware packages, generated by scripts/ota_package.py.
+ *
+ * Layout (little endian):
+ *   header  "XZPK" | version u8 | format u8 | reserved u16 | block_size u32 | stream_size u32 |
+ *           image_size u32 | base_size u32 | image_sha256[32] | base_sha256[32]
+ *   blocks  length u32 (bit 31: stored) | LZ4 block, each block decodes to block_size bytes
+ *           (the last one to the rest of the stream) and does not reference other blocks
+ *
+ * For kOtaPackageLz4 the decoded stream is the application image. For kOtaPackageDelta it is
+ * a list of operations rebuilding the image from the running partition (the base):
+ *   0 COPY   src u32 | length u32              copy base bytes
+ *   1 ADD    src u32 | length u32 | diff[len]  base byte + diff byte (mod 256)
+ *   2 INSERT length u32 | data[len]            new bytes
+ */
+#define OTA_PACKAGE_HEADER_SIZE 88
+#define OTA_PACKAGE_VERSION 1
+#define OTA_PACKAGE_MAX_BLOCK_SIZE (64 * 1024)
+#define OTA_PACKAGE_FORMATS "bin,xzpk-lz4,xzpk-delta"
+
+enum OtaPackageFormat : uint8_t {
+    kOtaPackageLz4 = 1,
+    kOtaPackageDelta = 2,
+};
+
+class OtaPackageDecoder {
+public:
+    // Receives decoded image bytes in order, return false to abort
+    using OutputCallback = std::function<bool(const uint8_t* data, size_t size)>;
+    // Reads bytes of the base image (the running application partition)
+    using BaseReader = std::function<bool(size_t offset, uint8_t* data, size_t size)>;
+
+    OtaPackageDecoder(OutputCallback output, BaseReader base_reader);
+    ~OtaPackageDecoder();
+
+    static bool IsPackage(const uint8_t* data, size_t size);
+
+    // Feed package bytes as they arrive, returns false if the package is invalid
+    bool Feed(const uint8_t* data, size_t size);
+    bool Finished() const { return state_ == kStateDone; }
+
+    OtaPackageFormat GetFormat() const { return format_; }
+    size_t GetImageSize() const { return image_size_; }
+    const uint8_t* GetImageSha256() const { return header_ + 24; }
+
+private:
+    enum State {
+        kStateHeader,
+        kStateBlockHeader,
+        kStateBlockData,
+        kStateDone,
+        kStateError,
+    };
+
+    OutputCallback output_;
+    BaseReader base_reader_;
+    State state_ = kStateHeader;
+    uint8_t header_[OTA_PACKAGE_HEADER_SIZE];
+    size_t header_size_ = 0;
+    OtaPackageFormat format_ = kOtaPackageLz4;
+    size_t block_size_ = 0;
+    size_t stream_size_ = 0;
+    size_t image_size_ = 0;
+    size_t base_size_ = 0;
+
+    // Block assembly and decompression
+    uint8_t* block_input_ = nullptr;
+    uint8_t* block_output_ = nullptr;
+    size_t block_length_ = 0;
+    size_t block_received_ = 0;
+    bool block_stored_ = false;
+    size_t stream_decoded_ = 0;
+    size_t image_written_ = 0;
+
+    // Delta operation parser
+    uint8_t op_header_[9];
+    size_t op_header_size_ = 0;
+    uint8_t op_ = 0;
+    size_t op_source_ = 0;
+    size_t op_remaining_ = 0;
+    uint8_t* base_buffer_ = nullptr;
+
+    bool Fail(const char* reason);
+    bool ParseHeader();
+    bool VerifyBase();
+    bool DecodeBlock();
+    bool ConsumeStream(const uint8_t* data, size_t size);
+    bool ConsumeDelta(const uint8_t* data, size_t size);
+    bool StartOperation();
+    bool EmitBase(size_t source, const uint8_t* diff, size_t size);
+    bool Emit(const uint8_t* data, size_t size);
+    static bool Lz4Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
+};
+
+#endif // _OTA_PACKAGE_H
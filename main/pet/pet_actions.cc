@@ -5,7 +5,7 @@ static const char* TAG = "PetActions";
 
 PetActions::PetActions(PetServo* servo)
     : servo_(servo), current_action_(ACTION_UPRIGHT),
-      action_running_(false), stop_requested_(false) {
+      action_running_(false), stop_requested_(false), action_task_(nullptr) {
 
     // 设置默认参数
     default_params_.speed_delay = 80;
@@ -24,7 +24,11 @@ void PetActions::SetDefaultParams(const ActionParams& params) {
 }
 
 void PetActions::Delay(uint32_t ms) {
-    vTaskDelay(pdMS_TO_TICKS(ms));
+    if (stop_requested_) {
+        return;
+    }
+    // 等待 StopAction 的通知，超时即正常延时结束
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
 }
 
 bool PetActions::ShouldStop() {
@@ -33,6 +37,9 @@ bool PetActions::ShouldStop() {
 
 void PetActions::StopAction() {
     stop_requested_ = true;
+    if (action_running_ && action_task_ != nullptr) {
+        xTaskNotifyGive(action_task_);
+    }
     ESP_LOGI(TAG, "Action stop requested");
 }
 
@@ -43,6 +50,9 @@ void PetActions::PerformAction(PetActionId action_id, const ActionParams* params
         Delay(100);
     }
 
+    // 清除上一个动作遗留的停止通知
+    action_task_ = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
     action_running_ = true;
     stop_requested_ = false;
     current_action_ = action_id;
@@ -67,7 +67,7 @@ private:
     void ActionHello();
     void ActionStretch();
 
-    // 延时函数（支持中断）
+    // 延时函数（支持中断，StopAction 会立即唤醒）
     void Delay(uint32_t ms);
 
     // 检查是否需要停止
@@ -77,8 +77,9 @@ private:
     ActionParams default_params_;
     ActionParams current_params_;
     PetActionId current_action_;
-    bool action_running_;
-    bool stop_requested_;
+    volatile bool action_running_;
+    volatile bool stop_requested_;
+    TaskHandle_t action_task_;  // 正在执行动作的任务，用于中断 Delay
 };
 
 #endif // PET_ACTIONS_H
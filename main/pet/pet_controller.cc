@@ -1,9 +1,34 @@
 #include "pet_controller.h"
 #include "mcp_server.h"
+#include "application.h"
+#include "assets/lang_config.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 static const char* TAG = "PetController";
 
+#if CONFIG_USE_LOCAL_COMMAND_WORDS
+// 本地命令词（MultiNet 中文模型，拼音之间用空格隔开）
+struct LocalCommand {
+    const char* phrase;
+    PetActionId action_id;
+};
+
+static const LocalCommand kLocalCommands[] = {
+    {"zuo xia", ACTION_SIT},                 // 坐下
+    {"zhan qi lai", ACTION_UPRIGHT},         // 站起来
+    {"ting zhi", ACTION_UPRIGHT},            // 停止：打断当前动作并站立
+    {"pa xia", ACTION_GETDOWN},              // 趴下
+    {"qian jin", ACTION_ADVANCE},            // 前进
+    {"hou tui", ACTION_BACK},                // 后退
+    {"zuo zhuan", ACTION_LEFT_ROTATION},     // 左转
+    {"you zhuan", ACTION_RIGHT_ROTATION},    // 右转
+    {"yao yi yao", ACTION_SWING},            // 摇一摇
+    {"da zhao hu", ACTION_HELLO},            // 打招呼
+    {"shen lan yao", ACTION_STRETCH},        // 伸懒腰
+};
+#endif
+
 PetController::PetController()
     : servo_(nullptr), actions_(nullptr), task_handle_(nullptr),
       command_queue_(nullptr), initialized_(false) {
@@ -72,7 +97,8 @@ void PetController::TaskLoop() {
     while (true) {
         // 等待命令队列
         if (xQueueReceive(command_queue_, &cmd, portMAX_DELAY) == pdTRUE) {
-            ESP_LOGI(TAG, "Received action command: %d", cmd.action_id);
+            int latency_ms = (int)((esp_timer_get_time() - cmd.request_time_us) / 1000);
+            ESP_LOGI(TAG, "Received action command: %d, latency: %d ms", cmd.action_id, latency_ms);
             actions_->PerformAction(cmd.action_id, &cmd.params);
         }
     }
@@ -125,11 +151,37 @@ bool PetController::EnqueueAction(PetActionId action_id, const ActionParams* par
         cmd.params.repeat_count = 1;
         cmd.params.continuous = false;
     }
+    cmd.request_time_us = esp_timer_get_time();
 
     BaseType_t result = xQueueSend(command_queue_, &cmd, pdMS_TO_TICKS(100));
     return result == pdTRUE;
 }
 
+bool PetController::PreemptAction(PetActionId action_id, const ActionParams* params) {
+    if (!initialized_ || !command_queue_) {
+        ESP_LOGE(TAG, "Not initialized or no queue");
+        return false;
+    }
+
+    ActionCommand cmd;
+    cmd.action_id = action_id;
+
+    if (params) {
+        cmd.params = *params;
+    } else {
+        cmd.params.speed_delay = 80;
+        cmd.params.swing_delay = 10;
+        cmd.params.repeat_count = 1;
+        cmd.params.continuous = false;
+    }
+    cmd.request_time_us = esp_timer_get_time();
+
+    // 丢弃排队的动作，打断正在执行的动作（Delay 会被立即唤醒），新动作插到队首
+    xQueueReset(command_queue_);
+    StopCurrentAction();
+    return xQueueSendToFront(command_queue_, &cmd, 0) == pdTRUE;
+}
+
 void PetController::StopCurrentAction() {
     if (actions_) {
         actions_->StopAction();
@@ -229,3 +281,22 @@ void PetController::RegisterMcpTools() {
 
     ESP_LOGI(TAG, "MCP tools registered: self.pet.*");
 }
+
+void PetController::RegisterLocalCommands() {
+#if CONFIG_USE_LOCAL_COMMAND_WORDS
+    auto& audio_service = Application::GetInstance().GetAudioService();
+    int registered = 0;
+    for (const auto& command : kLocalCommands) {
+        // 回调在音频输入任务中执行，只做不阻塞的操作，提示音交给主循环播放
+        bool ok = audio_service.AddLocalCommand(command.phrase, [this, &command]() {
+            PreemptAction(command.action_id);
+            auto& app = Application::GetInstance();
+            app.Schedule([&app]() {
+                app.PlaySound(Lang::Sounds::OGG_POPUP);
+            }, kMainEventUi);
+        });
+        registered += ok ? 1 : 0;
+    }
+    ESP_LOGI(TAG, "Local commands registered: %d", registered);
+#endif
+}
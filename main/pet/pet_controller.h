@@ -11,6 +11,7 @@
 struct ActionCommand {
     PetActionId action_id;
     ActionParams params;
+    int64_t request_time_us;   // 请求时间，用于统计指令到动作的延迟
 };
 
 class PetController {
@@ -29,6 +30,9 @@ public:
     // 加入动作队列（异步执行）
     bool EnqueueAction(PetActionId action_id, const ActionParams* params = nullptr);
 
+    // 打断当前动作并清空队列后立即执行（不阻塞，可在音频任务中调用）
+    bool PreemptAction(PetActionId action_id, const ActionParams* params = nullptr);
+
     // 停止当前动作
     void StopCurrentAction();
 
@@ -42,6 +46,9 @@ public:
     // 注册MCP工具
     void RegisterMcpTools();
 
+    // 注册本地命令词（CONFIG_USE_LOCAL_COMMAND_WORDS），识别后直接执行动作，不经过服务器
+    void RegisterLocalCommands();
+
 private:
     PetController();
     ~PetController();
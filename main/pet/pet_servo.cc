@@ -2,6 +2,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
+#include "metrics.h"
+#include "trace_recorder.h"
 #include <cmath>
 
 static const char* TAG = "PetServo";
@@ -100,6 +102,8 @@ void PetServo::SetAngle(ServoIndex index, uint8_t angle) {
 
     // 限制角度范围
     if (angle > SERVO_MAX_DEGREE) angle = SERVO_MAX_DEGREE;
+    Metrics::GetInstance().Increment(kMetricServoCommands);
+    TraceRecorder::GetInstance().Record(kTraceServo, index, angle);
 
     // 自动节流:如果距离上次移动不足60ms,则等待
     // 这样可以避免多个舵机几乎同时启动导致电流冲击
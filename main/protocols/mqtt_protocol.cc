@@ -1,10 +1,15 @@
 #include "mqtt_protocol.h"
+#include "udp_audio_packet.h"
 #include "board.h"
 #include "application.h"
 #include "settings.h"
+#include "metrics.h"
 
 #include <esp_log.h>
+#include <esp_random.h>
+#include <freertos/task.h>
 #include <cstring>
+#include <algorithm>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -12,18 +17,28 @@
 
 MqttProtocol::MqttProtocol() {
     event_group_handle_ = xEventGroupCreate();
+    reorder_window_.OnOutput([this](std::unique_ptr<AudioStreamPacket> packet) {
+        if (on_incoming_audio_ != nullptr) {
+            on_incoming_audio_(std::move(packet));
+        }
+    });
 
     // Initialize reconnect timer
     esp_timer_create_args_t reconnect_timer_args = {
         .callback = [](void* arg) {
             MqttProtocol* protocol = (MqttProtocol*)arg;
-            auto& app = Application::GetInstance();
-            if (app.GetDeviceState() == kDeviceStateIdle) {
-                ESP_LOGI(TAG, "Reconnecting to MQTT server");
-                app.Schedule([protocol]() {
-                    protocol->StartMqttClient(false);
-                });
+            if (protocol->connected_time_us_ != 0) {
+                // Connected again in the meantime, e.g. by OpenAudioChannel
+                return;
+            }
+            auto state = Application::GetInstance().GetDeviceState();
+            // A conversation keeps its UDP channel, only the control messages need the broker back
+            if (state != kDeviceStateIdle && state != kDeviceStateListening && state != kDeviceStateSpeaking) {
+                // No attempt was made, wait the same delay again without growing the backoff
+                esp_timer_start_once(protocol->reconnect_timer_, protocol->reconnect_delay_ms_ * 1000LL);
+                return;
             }
+            protocol->StartReconnectTask();
         },
         .arg = this,
     };
@@ -42,7 +57,65 @@ MqttProtocol::~MqttProtocol() {
 }
 
 bool MqttProtocol::Start() {
-    return StartMqttClient(false);
+    if (StartMqttClient(true)) {
+        return true;
+    }
+    // A broker that cannot be reached at boot is retried like a dropped connection
+    Settings settings("mqtt", false);
+    if (!settings.GetString("endpoint").empty()) {
+        ScheduleReconnect();
+    }
+    return false;
+}
+
+void MqttProtocol::ScheduleReconnect() {
+    int attempt = reconnect_attempts_++;
+    int delay_ms;
+    if (attempt == 0) {
+        delay_ms = MQTT_RECONNECT_FIRST_MS + esp_random() % MQTT_RECONNECT_FIRST_MS;
+    } else {
+        int cap = std::min(MQTT_RECONNECT_BASE_MS << std::min(attempt - 1, 5), MQTT_RECONNECT_MAX_MS);
+        delay_ms = cap / 2 + esp_random() % (cap / 2);
+    }
+    ESP_LOGI(TAG, "Schedule reconnect in %d ms", delay_ms);
+    reconnect_delay_ms_ = delay_ms;
+    esp_timer_stop(reconnect_timer_);
+    esp_timer_start_once(reconnect_timer_, delay_ms * 1000LL);
+}
+
+void MqttProtocol::StartReconnectTask() {
+    bool expected = false;
+    if (!reconnecting_.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    if (xTaskCreate([](void* arg) {
+        ((MqttProtocol*)arg)->ReconnectTask();
+        vTaskDelete(NULL);
+    }, "mqtt_reconnect", 4096, this, 2, nullptr) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create MQTT reconnect task");
+        reconnecting_ = false;
+        ScheduleReconnect();
+    }
+}
+
+// Connect takes up to the network timeout, it must not hold up the main loop in a conversation
+void MqttProtocol::ReconnectTask() {
+    ESP_LOGI(TAG, "Reconnecting to MQTT server, attempt %d", reconnect_attempts_.load());
+    auto mqtt = ConnectMqttClient(false);
+    if (mqtt == nullptr) {
+        reconnecting_ = false;
+        ScheduleReconnect();
+        return;
+    }
+
+    // mqtt_ is only used by the main loop, replace it there
+    Mqtt* client = mqtt.release();
+    while (!Application::GetInstance().Schedule([this, client]() {
+        mqtt_.reset(client);
+        reconnecting_ = false;
+    }, kMainEventProtocol)) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
 }
 
 bool MqttProtocol::StartMqttClient(bool report_error) {
@@ -51,45 +124,75 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         mqtt_.reset();
     }
 
+    Settings settings("mqtt", false);
+    publish_topic_ = settings.GetString("publish_topic");
+    mqtt_ = ConnectMqttClient(report_error);
+    return mqtt_ != nullptr;
+}
+
+std::unique_ptr<Mqtt> MqttProtocol::ConnectMqttClient(bool report_error) {
     Settings settings("mqtt", false);
     auto endpoint = settings.GetString("endpoint");
     auto client_id = settings.GetString("client_id");
     auto username = settings.GetString("username");
     auto password = settings.GetString("password");
     int keepalive_interval = settings.GetInt("keepalive", 240);
-    publish_topic_ = settings.GetString("publish_topic");
+    auto subscribe_topic = settings.GetString("subscribe_topic");
 
     if (endpoint.empty()) {
         ESP_LOGW(TAG, "MQTT endpoint is not specified");
         if (report_error) {
             SetError(Lang::Strings::SERVER_NOT_FOUND);
         }
-        return false;
+        return nullptr;
     }
 
     auto network = Board::GetInstance().GetNetwork();
-    mqtt_ = network->CreateMqtt(0);
-    mqtt_->SetKeepAlive(keepalive_interval);
+    auto mqtt = network->CreateMqtt(0);
+    mqtt->SetKeepAlive(keepalive_interval);
+    uint32_t generation = ++client_generation_;
 
-    mqtt_->OnDisconnected([this]() {
+    mqtt->OnDisconnected([this, generation]() {
+        if (generation != client_generation_) {
+            return;
+        }
         if (on_disconnected_ != nullptr) {
             on_disconnected_();
         }
-        ESP_LOGI(TAG, "MQTT disconnected, schedule reconnect in %d seconds", MQTT_RECONNECT_INTERVAL_MS / 1000);
-        esp_timer_start_once(reconnect_timer_, MQTT_RECONNECT_INTERVAL_MS * 1000);
+        int64_t expected = 0;
+        if (disconnected_time_us_.compare_exchange_strong(expected, esp_timer_get_time())) {
+            Metrics::GetInstance().Increment(kMetricMqttDisconnects);
+        }
+        int64_t connected_time = connected_time_us_.exchange(0);
+        if (connected_time != 0 && esp_timer_get_time() - connected_time >= MQTT_RECONNECT_STABLE_MS * 1000LL) {
+            reconnect_attempts_ = 0;
+        }
+        ESP_LOGI(TAG, "MQTT disconnected");
+        ScheduleReconnect();
     });
 
-    mqtt_->OnConnected([this]() {
+    mqtt->OnConnected([this, generation]() {
+        if (generation != client_generation_) {
+            return;
+        }
         if (on_connected_ != nullptr) {
             on_connected_();
         }
         esp_timer_stop(reconnect_timer_);
+        connected_time_us_ = esp_timer_get_time();
+        int64_t disconnected_time = disconnected_time_us_.exchange(0);
+        if (disconnected_time != 0) {
+            int outage_ms = (esp_timer_get_time() - disconnected_time) / 1000;
+            ESP_LOGI(TAG, "MQTT reconnected after %d ms", outage_ms);
+            Metrics::GetInstance().Increment(kMetricMqttReconnects);
+            Metrics::GetInstance().SetGauge(kMetricMqttOutage, outage_ms);
+        }
     });
 
-    mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
+    mqtt->OnMessage([this](const std::string& topic, const std::string& payload) {
+        cJSON* root = ParseJson(payload.data(), payload.size());
         if (root == nullptr) {
-            ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
+            ESP_LOGE(TAG, "Failed to parse json message %.*s", (int)std::min<size_t>(payload.size(), 128), payload.c_str());
             return;
         }
         cJSON* type = cJSON_GetObjectItem(root, "type");
@@ -103,14 +206,24 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
             ParseServerHello(root);
         } else if (strcmp(type->valuestring, "goodbye") == 0) {
             auto session_id = cJSON_GetObjectItem(root, "session_id");
+            if (!cJSON_IsString(session_id)) {
+                session_id = nullptr;
+            }
             ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
             if (session_id == nullptr || session_id_ == session_id->valuestring) {
                 Application::GetInstance().Schedule([this]() {
                     CloseAudioChannel();
-                });
+                }, kMainEventControl);
             }
         } else if (on_incoming_json_ != nullptr) {
             on_incoming_json_(root);
+            // 每轮 TTS 结束后向服务器报告 UDP 接收统计，便于服务器调整码率
+            auto state = cJSON_GetObjectItem(root, "state");
+            if (strcmp(type->valuestring, "tts") == 0 && cJSON_IsString(state) && strcmp(state->valuestring, "stop") == 0) {
+                Application::GetInstance().Schedule([this]() {
+                    SendAudioStats();
+                }, kMainEventProtocol);
+            }
         }
         cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
@@ -126,22 +239,30 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     } else {
         broker_address = endpoint;
     }
-    if (!mqtt_->Connect(broker_address, broker_port, client_id, username, password)) {
+    if (!mqtt->Connect(broker_address, broker_port, client_id, username, password)) {
         ESP_LOGE(TAG, "Failed to connect to endpoint");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
+        Metrics::GetInstance().Increment(kMetricMqttConnectFailures);
+        if (report_error) {
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+        }
+        return nullptr;
     }
 
+    // The client is new on every connect, so the subscription is made again each time
+    if (!subscribe_topic.empty() && !mqtt->Subscribe(subscribe_topic)) {
+        ESP_LOGW(TAG, "Failed to subscribe to %s", subscribe_topic.c_str());
+    }
     ESP_LOGI(TAG, "Connected to endpoint");
-    return true;
+    return mqtt;
 }
 
 bool MqttProtocol::SendText(const std::string& text) {
-    if (publish_topic_.empty()) {
+    if (publish_topic_.empty() || mqtt_ == nullptr) {
         return false;
     }
     if (!mqtt_->Publish(publish_topic_, text)) {
         ESP_LOGE(TAG, "Failed to publish message: %s", text.c_str());
+        Metrics::GetInstance().Increment(kMetricTextSendFailures);
         SetError(Lang::Strings::SERVER_ERROR);
         return false;
     }
@@ -174,10 +295,31 @@ bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
     return udp_->Send(encrypted) > 0;
 }
 
+bool MqttProtocol::GetAudioLoss(uint32_t& received, uint32_t& lost) {
+    auto stats = reorder_window_.GetStats();
+    received = stats.received;
+    lost = stats.lost;
+    return true;
+}
+
+void MqttProtocol::SendAudioStats() {
+    {
+        std::lock_guard<std::mutex> lock(channel_mutex_);
+        if (udp_ == nullptr) {
+            return;
+        }
+    }
+    auto stats = reorder_window_.GetStatsJson();
+    ESP_LOGI(TAG, "UDP receive stats: %s", stats.c_str());
+    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"audio_stats\",\"udp\":" + stats + "}";
+    SendText(message);
+}
+
 void MqttProtocol::CloseAudioChannel() {
     {
         std::lock_guard<std::mutex> lock(channel_mutex_);
         udp_.reset();
+        udp_closed_time_us_ = esp_timer_get_time();
     }
 
     std::string message = "{";
@@ -193,6 +335,11 @@ void MqttProtocol::CloseAudioChannel() {
 
 bool MqttProtocol::OpenAudioChannel() {
     if (mqtt_ == nullptr || !mqtt_->IsConnected()) {
+        if (reconnecting_) {
+            ESP_LOGW(TAG, "MQTT is reconnecting in the background");
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+            return false;
+        }
         ESP_LOGI(TAG, "MQTT is not connected, try to connect now");
         if (!StartMqttClient(true)) {
             return false;
@@ -200,6 +347,11 @@ bool MqttProtocol::OpenAudioChannel() {
     }
 
     error_occurred_ = false;
+    resume_session_id_.clear();
+    if (udp_resume_seconds_ > 0 && !session_id_.empty() &&
+        esp_timer_get_time() - udp_closed_time_us_ < udp_resume_seconds_ * 1000000LL) {
+        resume_session_id_ = session_id_;
+    }
     session_id_ = "";
     xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 
@@ -220,48 +372,14 @@ bool MqttProtocol::OpenAudioChannel() {
     auto network = Board::GetInstance().GetNetwork();
     udp_ = network->CreateUdp(2);
     udp_->OnMessage([this](const std::string& data) {
-        /*
-         * UDP Encrypted OPUS Packet Format:
-         * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
-         * |payload payload_len|
-         */
-        if (data.size() < sizeof(aes_nonce_)) {
-            ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
-            return;
-        }
-        if (data[0] != 0x01) {
-            ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
-            return;
-        }
-        uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
-        uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
-            return;
-        }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
-
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
         auto packet = std::make_unique<AudioStreamPacket>();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
-        packet->timestamp = timestamp;
-        packet->payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        uint32_t sequence;
+        if (!DecodeUdpAudioPacket(aes_ctx_, (const uint8_t*)data.data(), data.size(), *packet, sequence)) {
             return;
         }
-        if (on_incoming_audio_ != nullptr) {
-            on_incoming_audio_(std::move(packet));
-        }
-        remote_sequence_ = sequence;
+        reorder_window_.Push(sequence, std::move(packet));
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -284,6 +402,9 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddBoolToObject(features, "aec", true);
 #endif
     cJSON_AddBoolToObject(features, "mcp", true);
+#if CONFIG_USE_VAD_GATED_UPLINK
+    cJSON_AddBoolToObject(features, "vad_gate", true);
+#endif
     cJSON_AddItemToObject(root, "features", features);
     cJSON* audio_params = cJSON_CreateObject();
     cJSON_AddStringToObject(audio_params, "format", "opus");
@@ -291,6 +412,9 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
     cJSON_AddItemToObject(root, "audio_params", audio_params);
+    if (!resume_session_id_.empty()) {
+        cJSON_AddStringToObject(root, "resume", resume_session_id_.c_str());
+    }
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
     cJSON_free(json_str);
@@ -300,8 +424,8 @@ std::string MqttProtocol::GetHelloMessage() {
 
 void MqttProtocol::ParseServerHello(const cJSON* root) {
     auto transport = cJSON_GetObjectItem(root, "transport");
-    if (transport == nullptr || strcmp(transport->valuestring, "udp") != 0) {
-        ESP_LOGE(TAG, "Unsupported transport: %s", transport->valuestring);
+    if (!cJSON_IsString(transport) || strcmp(transport->valuestring, "udp") != 0) {
+        ESP_LOGE(TAG, "Unsupported transport: %s", cJSON_IsString(transport) ? transport->valuestring : "null");
         return;
     }
 
@@ -324,23 +448,46 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
         }
     }
 
+    ParseServerFeatures(root);
+
     auto udp = cJSON_GetObjectItem(root, "udp");
     if (!cJSON_IsObject(udp)) {
         ESP_LOGE(TAG, "UDP is not specified");
         return;
     }
-    udp_server_ = cJSON_GetObjectItem(udp, "server")->valuestring;
-    udp_port_ = cJSON_GetObjectItem(udp, "port")->valueint;
-    auto key = cJSON_GetObjectItem(udp, "key")->valuestring;
-    auto nonce = cJSON_GetObjectItem(udp, "nonce")->valuestring;
+    auto resume_seconds = cJSON_GetObjectItem(udp, "resume_seconds");
+    udp_resume_seconds_ = cJSON_IsNumber(resume_seconds) ? resume_seconds->valueint : 0;
+
+    if (!resume_session_id_.empty() && cJSON_IsTrue(cJSON_GetObjectItem(udp, "resumed"))) {
+        // Same server, key and nonce as the last session. The sequence goes on from where it
+        // stopped, restarting it would repeat the CTR key stream
+        ESP_LOGI(TAG, "UDP session %s resumed", resume_session_id_.c_str());
+        Metrics::GetInstance().Increment(kMetricUdpResumed);
+        reorder_window_.Reset(server_frame_duration_);
+        xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
+        return;
+    }
+
+    auto server = cJSON_GetObjectItem(udp, "server");
+    auto port = cJSON_GetObjectItem(udp, "port");
+    auto key = cJSON_GetObjectItem(udp, "key");
+    auto nonce = cJSON_GetObjectItem(udp, "nonce");
+    // AES-128 的 key 和 nonce 都是 16 字节，即 32 个十六进制字符
+    if (!cJSON_IsString(server) || !cJSON_IsNumber(port) || !cJSON_IsString(key) || !cJSON_IsString(nonce) ||
+        strlen(key->valuestring) != 32 || strlen(nonce->valuestring) != 32) {
+        ESP_LOGE(TAG, "Invalid UDP parameters");
+        return;
+    }
+    udp_server_ = server->valuestring;
+    udp_port_ = port->valueint;
 
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
-    aes_nonce_ = DecodeHexString(nonce);
+    aes_nonce_ = DecodeHexString(nonce->valuestring);
     mbedtls_aes_init(&aes_ctx_);
-    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
+    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key->valuestring).c_str(), 128);
     local_sequence_ = 0;
-    remote_sequence_ = 0;
+    reorder_window_.Reset(server_frame_duration_);
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
@@ -3,6 +3,7 @@
 
 
 #include "protocol.h"
+#include "udp_reorder_window.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
@@ -11,13 +12,26 @@
 #include <freertos/event_groups.h>
 #include <esp_timer.h>
 
+#include <atomic>
 #include <functional>
 #include <string>
 #include <map>
 #include <mutex>
 
 #define MQTT_PING_INTERVAL_SECONDS 90
-#define MQTT_RECONNECT_INTERVAL_MS 60000
+
+/*
+ * Reconnect backoff: the first retry comes after 250~500ms because most drops are a blip of the
+ * access point or a broker failover, later retries wait a random time between half and all of
+ * MQTT_RECONNECT_BASE_MS * 2^n, capped at MQTT_RECONNECT_MAX_MS, so a fleet dropped by a broker
+ * restart does not come back in lockstep. The backoff only starts over once a connection stayed
+ * up for MQTT_RECONNECT_STABLE_MS, a broker that drops every client right after connecting is
+ * not hammered. Reconnects run in their own task, the main loop only swaps in the new client.
+ */
+#define MQTT_RECONNECT_FIRST_MS 250
+#define MQTT_RECONNECT_BASE_MS 2000
+#define MQTT_RECONNECT_MAX_MS 60000
+#define MQTT_RECONNECT_STABLE_MS 30000
 
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
@@ -31,6 +45,7 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    bool GetAudioLoss(uint32_t& received, uint32_t& lost) override;
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -45,12 +60,30 @@ private:
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
+    UdpReorderWindow reorder_window_;
     esp_timer_handle_t reconnect_timer_;
+    std::atomic<int> reconnect_attempts_ = 0;
+    std::atomic<int> reconnect_delay_ms_ = 0;   // Delay of the scheduled attempt
+    std::atomic<bool> reconnecting_ = false;
+    std::atomic<int64_t> disconnected_time_us_ = 0;
+    std::atomic<int64_t> connected_time_us_ = 0;
+    // Callbacks of a client replaced by a newer one are ignored
+    std::atomic<uint32_t> client_generation_ = 0;
+
+    // UDP session resumption: a server hello with udp.resume_seconds keeps the key and nonce of
+    // the session that long after it closes, the next hello asks for it with "resume"
+    int udp_resume_seconds_ = 0;
+    int64_t udp_closed_time_us_ = 0;
+    std::string resume_session_id_;
 
     bool StartMqttClient(bool report_error=false);
+    std::unique_ptr<Mqtt> ConnectMqttClient(bool report_error);
+    void ScheduleReconnect();
+    void StartReconnectTask();
+    void ReconnectTask();
     void ParseServerHello(const cJSON* root);
     std::string DecodeHexString(const std::string& hex_string);
+    void SendAudioStats();
 
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
@@ -1,9 +1,70 @@
 #include "protocol.h"
 
 #include <esp_log.h>
+#include <arpa/inet.h>
 
 #define TAG "Protocol"
 
+cJSON* Protocol::ParseJson(const char* data, size_t len) {
+    if (len > PROTOCOL_MAX_JSON_SIZE) {
+        ESP_LOGE(TAG, "JSON message too large: %u bytes", len);
+        return nullptr;
+    }
+    // 先扫描嵌套深度，避免深层嵌套的消息在 cJSON 递归时耗尽任务栈
+    int depth = 0;
+    bool in_string = false;
+    for (size_t i = 0; i < len; i++) {
+        char c = data[i];
+        if (in_string) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == '{' || c == '[') {
+            if (++depth > PROTOCOL_MAX_JSON_DEPTH) {
+                ESP_LOGE(TAG, "JSON message nested deeper than %d", PROTOCOL_MAX_JSON_DEPTH);
+                return nullptr;
+            }
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+    }
+    return cJSON_ParseWithLength(data, len);
+}
+
+bool Protocol::ParseBinaryFrame(int version, const uint8_t* data, size_t len, AudioStreamPacket& packet) {
+    if (version == 2) {
+        if (len < sizeof(BinaryProtocol2)) {
+            return false;
+        }
+        auto bp2 = (const BinaryProtocol2*)data;
+        uint32_t payload_size = ntohl(bp2->payload_size);
+        if (payload_size > len - sizeof(BinaryProtocol2)) {
+            return false;
+        }
+        packet.timestamp = ntohl(bp2->timestamp);
+        packet.payload.assign(bp2->payload, bp2->payload + payload_size);
+    } else if (version == 3) {
+        if (len < sizeof(BinaryProtocol3)) {
+            return false;
+        }
+        auto bp3 = (const BinaryProtocol3*)data;
+        uint16_t payload_size = ntohs(bp3->payload_size);
+        if (payload_size > len - sizeof(BinaryProtocol3)) {
+            return false;
+        }
+        packet.timestamp = 0;
+        packet.payload.assign(bp3->payload, bp3->payload + payload_size);
+    } else {
+        packet.timestamp = 0;
+        packet.payload.assign(data, data + len);
+    }
+    return true;
+}
+
 void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
@@ -32,6 +93,18 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
     on_disconnected_ = callback;
 }
 
+void Protocol::ParseServerFeatures(const cJSON* root) {
+    server_vad_gate_ = false;
+    auto features = cJSON_GetObjectItem(root, "features");
+    if (!cJSON_IsObject(features)) {
+        return;
+    }
+#if CONFIG_USE_VAD_GATED_UPLINK
+    server_vad_gate_ = cJSON_IsTrue(cJSON_GetObjectItem(features, "vad_gate"));
+    ESP_LOGI(TAG, "Server %s VAD gated uplink", server_vad_gate_ ? "accepted" : "did not accept");
+#endif
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
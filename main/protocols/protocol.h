@@ -4,6 +4,7 @@
 #include <cJSON.h>
 #include <string>
 #include <functional>
+#include <memory>
 #include <chrono>
 #include <vector>
 
@@ -12,6 +13,7 @@ struct AudioStreamPacket {
     int frame_duration = 0;
     uint32_t timestamp = 0;
     std::vector<uint8_t> payload;
+    int64_t trace_time_us = 0;  // Local time the packet entered its queue, for the latency tracer
 };
 
 struct BinaryProtocol2 {
@@ -30,6 +32,11 @@ struct BinaryProtocol3 {
     uint8_t payload[];
 } __attribute__((packed));
 
+// 服务器消息的上限，超出的消息在 cJSON 分配内存之前被丢弃
+// cJSON recurses once per nesting level on the receiving task's stack
+#define PROTOCOL_MAX_JSON_SIZE (32 * 1024)
+#define PROTOCOL_MAX_JSON_DEPTH 16
+
 enum AbortReason {
     kAbortReasonNone,
     kAbortReasonWakeWordDetected
@@ -54,6 +61,10 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    // The server accepted VAD gated listening audio in its hello, silence may be left out
+    inline bool server_vad_gate() const {
+        return server_vad_gate_;
+    }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
@@ -63,6 +74,11 @@ public:
     void OnConnected(std::function<void()> callback);
     void OnDisconnected(std::function<void()> callback);
 
+    // Parse a JSON message from the server, nullptr if it is malformed or over the limits above
+    static cJSON* ParseJson(const char* data, size_t len);
+    // Parse a binary audio frame of the websocket protocol version, false if the header does not fit
+    static bool ParseBinaryFrame(int version, const uint8_t* data, size_t len, AudioStreamPacket& packet);
+
     virtual bool Start() = 0;
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel() = 0;
@@ -73,6 +89,8 @@ public:
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    // Audio packets received / lost on the current channel, false if the transport cannot lose packets
+    virtual bool GetAudioLoss(uint32_t& received, uint32_t& lost) { return false; }
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
@@ -85,11 +103,14 @@ protected:
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    bool server_vad_gate_ = false;
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual bool SendText(const std::string& text) = 0;
+    // Features of the server hello shared by the transports
+    void ParseServerFeatures(const cJSON* root);
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
 };
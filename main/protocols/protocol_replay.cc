@@ -0,0 +1,183 @@
+#include "protocol_replay.h"
+#include "protocol.h"
+#include "udp_audio_packet.h"
+#include "board.h"
+#include "system_info.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <mbedtls/aes.h>
+#include <cJSON.h>
+
+#include <cstring>
+#include <vector>
+
+#define TAG "ProtocolReplay"
+
+// Give the idle task a tick now and then, the replay can take seconds
+#define REPLAY_YIELD_INTERVAL 64
+
+static const char* kKindNames[kCaptureKindCount] = {"", "json", "binary", "udp", "udp_key"};
+
+static bool ReadExactly(Http* http, uint8_t* buffer, size_t size) {
+    while (size > 0) {
+        int ret = http->Read((char*)buffer, size);
+        if (ret <= 0) {
+            return false;
+        }
+        buffer += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+bool ProtocolReplay::Run(const std::string& url) {
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(3);
+    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    if (!http->Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to open %s", url.c_str());
+        return false;
+    }
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to download %s, status code: %d", url.c_str(), http->GetStatusCode());
+        http->Close();
+        return false;
+    }
+
+    uint8_t header[8];
+    if (!ReadExactly(http.get(), header, sizeof(header)) || memcmp(header, "XZCP", 4) != 0 || header[4] != CAPTURE_VERSION) {
+        ESP_LOGE(TAG, "Not a capture");
+        http->Close();
+        return false;
+    }
+
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    uint8_t key[16] = {0};
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+
+    std::vector<uint8_t> data;
+    data.reserve(4096);
+    int64_t start_time = esp_timer_get_time();
+    uint8_t record[12];
+    bool success = true;
+    while (true) {
+        int ret = http->Read((char*)record, 1);
+        if (ret == 0) {
+            break;
+        }
+        if (ret < 0 || !ReadExactly(http.get(), record + 1, sizeof(record) - 1)) {
+            success = false;
+            break;
+        }
+        uint8_t kind = record[0];
+        int version = record[1];
+        uint32_t length;
+        memcpy(&length, record + 8, 4);
+        bytes_ += sizeof(record) + length;
+
+        // Oversized records are read through in pieces and not parsed
+        bool oversized = length > CAPTURE_MAX_RECORD_SIZE;
+        data.resize(oversized ? CAPTURE_MAX_RECORD_SIZE : length);
+        for (uint32_t left = length; left > 0;) {
+            uint32_t n = left < data.size() ? left : data.size();
+            if (!ReadExactly(http.get(), data.data(), n)) {
+                success = false;
+                break;
+            }
+            left -= n;
+        }
+        if (!success) {
+            break;
+        }
+        uint32_t index = records_++;
+        if (oversized || kind == 0 || kind >= kCaptureKindCount) {
+            skipped_++;
+            continue;
+        }
+
+        auto& stats = stats_[kind];
+        size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        size_t free_after = free_before;
+        bool accepted = false;
+        int64_t t0 = esp_timer_get_time();
+        if (kind == kCaptureJson) {
+            auto root = Protocol::ParseJson((const char*)data.data(), data.size());
+            accepted = cJSON_IsString(cJSON_GetObjectItem(root, "type"));
+            free_after = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+            cJSON_Delete(root);
+        } else if (kind == kCaptureBinary) {
+            AudioStreamPacket packet;
+            accepted = Protocol::ParseBinaryFrame(version, data.data(), data.size(), packet);
+            free_after = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        } else if (kind == kCaptureUdp) {
+            AudioStreamPacket packet;
+            uint32_t sequence;
+            accepted = DecodeUdpAudioPacket(aes, data.data(), data.size(), packet, sequence);
+            free_after = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        } else if (data.size() == sizeof(key)) {
+            memcpy(key, data.data(), sizeof(key));
+            accepted = mbedtls_aes_setkey_enc(&aes, key, 128) == 0;
+        }
+        uint32_t elapsed = esp_timer_get_time() - t0;
+
+        stats.count++;
+        if (!accepted) {
+            stats.rejected++;
+        }
+        stats.total_us += elapsed;
+        if (elapsed > stats.max_us) {
+            stats.max_us = elapsed;
+            stats.slowest_record = index;
+        }
+        // Other tasks allocate at the same time, so this is an estimate
+        if (free_before > free_after && free_before - free_after > stats.max_heap) {
+            stats.max_heap = free_before - free_after;
+        }
+        if (records_ % REPLAY_YIELD_INTERVAL == 0) {
+            vTaskDelay(1);
+        }
+    }
+    duration_us_ = esp_timer_get_time() - start_time;
+    mbedtls_aes_free(&aes);
+    http->Close();
+
+    ESP_LOGI(TAG, "Replayed %lu records (%llu bytes) in %lld ms", (unsigned long)records_, bytes_, duration_us_ / 1000);
+    if (!success) {
+        ESP_LOGE(TAG, "Capture truncated after %lu records", (unsigned long)records_);
+    }
+    return success;
+}
+
+std::string ProtocolReplay::GetReportJson() {
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "records", records_);
+    cJSON_AddNumberToObject(root, "skipped", skipped_);
+    cJSON_AddNumberToObject(root, "bytes", bytes_);
+    cJSON_AddNumberToObject(root, "duration_ms", duration_us_ / 1000);
+    auto kinds = cJSON_CreateObject();
+    for (int kind = 1; kind < kCaptureKindCount; kind++) {
+        auto& stats = stats_[kind];
+        if (stats.count == 0) {
+            continue;
+        }
+        auto item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "count", stats.count);
+        cJSON_AddNumberToObject(item, "rejected", stats.rejected);
+        cJSON_AddNumberToObject(item, "avg_us", stats.total_us / stats.count);
+        cJSON_AddNumberToObject(item, "max_us", stats.max_us);
+        cJSON_AddNumberToObject(item, "max_heap_bytes", stats.max_heap);
+        cJSON_AddNumberToObject(item, "slowest_record", stats.slowest_record);
+        cJSON_AddItemToObject(kinds, kKindNames[kind], item);
+    }
+    cJSON_AddItemToObject(root, "kinds", kinds);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,54 @@
+#ifndef PROTOCOL_REPLAY_H
+#define PROTOCOL_REPLAY_H
+
+#include <string>
+#include <cstdint>
+
+/*
+ * Replay of captured server messages through the protocol parsers, to measure the CPU time
+ * and heap used per message and to check that malformed input is rejected.
+ *
+ * Captures are written by `scripts/mock_server.py --capture` (every message sent to the device)
+ * and mutated by `scripts/fuzz_capture.py`. Each record runs, without side effects, through the
+ * same code as a live message: Protocol::ParseJson and the "type" lookup, ParseBinaryFrame
+ * or DecodeUdpAudioPacket. Capture layout (little endian):
+ *   header  "XZCP" | version u8 | reserved u8[3]
+ *   record  kind u8 | binary_protocol_version u8 | reserved u16 | time_ms u32 | length u32 | data
+ */
+#define CAPTURE_VERSION 1
+#define CAPTURE_MAX_RECORD_SIZE (64 * 1024)
+
+enum CaptureRecordKind : uint8_t {
+    kCaptureJson = 1,           // WebSocket text frame or MQTT message
+    kCaptureBinary = 2,         // WebSocket binary frame
+    kCaptureUdp = 3,            // Encrypted UDP audio packet
+    kCaptureUdpKey = 4,         // AES key of the following UDP packets, 16 bytes
+    kCaptureKindCount,
+};
+
+class ProtocolReplay {
+public:
+    // Download the capture and parse every record as fast as possible
+    bool Run(const std::string& url);
+    // Per record kind: count, rejected, avg / max parse time in us, max heap bytes held by
+    // the parsed message and the index of the slowest record
+    std::string GetReportJson();
+
+private:
+    struct KindStats {
+        uint32_t count = 0;
+        uint32_t rejected = 0;
+        uint64_t total_us = 0;
+        uint32_t max_us = 0;
+        uint32_t max_heap = 0;
+        uint32_t slowest_record = 0;
+    };
+
+    KindStats stats_[kCaptureKindCount];
+    uint32_t records_ = 0;
+    uint32_t skipped_ = 0;
+    uint64_t bytes_ = 0;
+    int64_t duration_us_ = 0;
+};
+
+#endif // PROTOCOL_REPLAY_H
@@ -0,0 +1,39 @@
+#include "udp_audio_packet.h"
+
+#include <esp_log.h>
+#include <arpa/inet.h>
+#include <cstring>
+
+#define TAG "UdpAudio"
+
+bool DecodeUdpAudioPacket(mbedtls_aes_context& aes, const uint8_t* data, size_t len,
+    AudioStreamPacket& packet, uint32_t& sequence) {
+    if (len < UDP_AUDIO_HEADER_SIZE) {
+        ESP_LOGE(TAG, "Invalid audio packet size: %u", (unsigned)len);
+        return false;
+    }
+    if (data[0] != 0x01) {
+        ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
+        return false;
+    }
+    uint32_t value;
+    memcpy(&value, &data[8], sizeof(value));
+    packet.timestamp = ntohl(value);
+    memcpy(&value, &data[12], sizeof(value));
+    sequence = ntohl(value);
+
+    // The packet header is the CTR counter block
+    size_t decrypted_size = len - UDP_AUDIO_HEADER_SIZE;
+    size_t nc_off = 0;
+    uint8_t nonce[UDP_AUDIO_HEADER_SIZE];
+    uint8_t stream_block[16] = {0};
+    memcpy(nonce, data, sizeof(nonce));
+    packet.payload.resize(decrypted_size);
+    int ret = mbedtls_aes_crypt_ctr(&aes, decrypted_size, &nc_off, nonce, stream_block,
+        data + UDP_AUDIO_HEADER_SIZE, packet.payload.data());
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef UDP_AUDIO_PACKET_H
+#define UDP_AUDIO_PACKET_H
+
+#include "protocol.h"
+
+#include <mbedtls/aes.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Encrypted UDP audio packet of the MQTT protocol:
+ * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
+ * |payload payload_len|
+ * The 16 byte header is the AES-CTR counter block of the payload. Kept apart from
+ * MqttProtocol so the host fuzz targets (scripts/host_test/fuzz) build without the MQTT client.
+ */
+#define UDP_AUDIO_HEADER_SIZE 16
+
+// Check the header of an encrypted UDP audio packet and decrypt its payload
+bool DecodeUdpAudioPacket(mbedtls_aes_context& aes, const uint8_t* data, size_t len,
+    AudioStreamPacket& packet, uint32_t& sequence);
+
+#endif // UDP_AUDIO_PACKET_H
@@ -0,0 +1,195 @@
+#include "udp_reorder_window.h"
+#include "metrics.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+
+#define TAG "UdpReorder"
+
+UdpReorderWindow::UdpReorderWindow() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<UdpReorderWindow*>(arg)->Flush();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "udp_reorder",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&timer_args, &flush_timer_);
+}
+
+UdpReorderWindow::~UdpReorderWindow() {
+    if (flush_timer_ != nullptr) {
+        esp_timer_stop(flush_timer_);
+        esp_timer_delete(flush_timer_);
+    }
+}
+
+void UdpReorderWindow::OnOutput(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
+    on_output_ = callback;
+}
+
+void UdpReorderWindow::Reset(int frame_duration_ms) {
+    esp_timer_stop(flush_timer_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& slot : slots_) {
+        slot.reset();
+    }
+    started_ = false;
+    history_ = 0;
+    lost_run_ = 0;
+    frame_duration_ms_ = frame_duration_ms > 0 ? frame_duration_ms : 60;
+    last_arrival_us_ = 0;
+    jitter_us_ = 0;
+    stats_ = UdpReceiveStats();
+}
+
+void UdpReorderWindow::Push(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    if (!started_) {
+        started_ = true;
+        next_sequence_ = sequence;
+        highest_sequence_ = sequence;
+    }
+
+    // Transit time variation against the sender's frame clock, smoothed like RFC 3550
+    if (last_arrival_us_ != 0) {
+        int32_t sequence_diff = (int32_t)(sequence - last_arrival_sequence_);
+        int64_t deviation = (now - last_arrival_us_) - (int64_t)sequence_diff * frame_duration_ms_ * 1000;
+        if (deviation < 0) {
+            deviation = -deviation;
+        }
+        jitter_us_ += (deviation - jitter_us_) / 16;
+    }
+    last_arrival_us_ = now;
+    last_arrival_sequence_ = sequence;
+    sample_rate_ = packet->sample_rate;
+
+    int32_t offset = (int32_t)(sequence - next_sequence_);
+    if (offset < 0) {
+        if (-offset <= 64 && ((history_ >> (-offset - 1)) & 1)) {
+            stats_.duplicate++;
+            Metrics::GetInstance().Increment(kMetricUdpDuplicate);
+        } else {
+            stats_.late++;
+            Metrics::GetInstance().Increment(kMetricUdpLate);
+        }
+        return;
+    }
+    if (offset >= UDP_REORDER_WINDOW_PACKETS) {
+        // Too far ahead, give up waiting for the oldest gaps
+        SkipTo(sequence - UDP_REORDER_WINDOW_PACKETS + 1);
+    }
+
+    int index = sequence % UDP_REORDER_WINDOW_PACKETS;
+    if (slots_[index] != nullptr && slot_sequences_[index] == sequence) {
+        stats_.duplicate++;
+        Metrics::GetInstance().Increment(kMetricUdpDuplicate);
+        return;
+    }
+    if ((int32_t)(sequence - highest_sequence_) < 0) {
+        stats_.reordered++;
+        Metrics::GetInstance().Increment(kMetricUdpReordered);
+    } else {
+        highest_sequence_ = sequence;
+    }
+    slots_[index] = std::move(packet);
+    slot_sequences_[index] = sequence;
+
+    ReleaseReady();
+    // Something is waiting behind a gap
+    if (highest_sequence_ != next_sequence_ - 1 && !esp_timer_is_active(flush_timer_)) {
+        esp_timer_start_once(flush_timer_, frame_duration_ms_ * 2 * 1000);
+    }
+}
+
+void UdpReorderWindow::ReleaseReady() {
+    while (true) {
+        int index = next_sequence_ % UDP_REORDER_WINDOW_PACKETS;
+        if (slots_[index] == nullptr || slot_sequences_[index] != next_sequence_) {
+            return;
+        }
+        auto packet = std::move(slots_[index]);
+        history_ = (history_ << 1) | 1;
+        next_sequence_++;
+        lost_run_ = 0;
+        stats_.received++;
+        if (on_output_ != nullptr) {
+            on_output_(std::move(packet));
+        }
+    }
+}
+
+// Declare everything before sequence that has not arrived as lost
+void UdpReorderWindow::SkipTo(uint32_t sequence) {
+    while ((int32_t)(sequence - next_sequence_) > 0) {
+        int index = next_sequence_ % UDP_REORDER_WINDOW_PACKETS;
+        if (slots_[index] != nullptr && slot_sequences_[index] == next_sequence_) {
+            ReleaseReady();
+            continue;
+        }
+        history_ <<= 1;
+        next_sequence_++;
+        stats_.lost++;
+        Metrics::GetInstance().Increment(kMetricUdpLost);
+        // Conceal short gaps only, the decoder needs a real frame before
+        if (++lost_run_ <= UDP_MAX_CONCEALED_FRAMES && stats_.received > 0 && on_output_ != nullptr) {
+            auto packet = std::make_unique<AudioStreamPacket>();
+            packet->sample_rate = sample_rate_;
+            packet->frame_duration = frame_duration_ms_;
+            stats_.concealed++;
+            on_output_(std::move(packet));
+        }
+    }
+    ReleaseReady();
+}
+
+void UdpReorderWindow::Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Find the oldest packet waiting behind the gap
+    bool found = false;
+    uint32_t oldest = 0;
+    for (int i = 0; i < UDP_REORDER_WINDOW_PACKETS; i++) {
+        if (slots_[i] == nullptr) {
+            continue;
+        }
+        int32_t offset = (int32_t)(slot_sequences_[i] - next_sequence_);
+        if (offset > 0 && (!found || (int32_t)(slot_sequences_[i] - oldest) < 0)) {
+            oldest = slot_sequences_[i];
+            found = true;
+        }
+    }
+    if (!found) {
+        return;
+    }
+    SkipTo(oldest);
+    if (highest_sequence_ != next_sequence_ - 1) {
+        esp_timer_start_once(flush_timer_, frame_duration_ms_ * 2 * 1000);
+    }
+}
+
+UdpReceiveStats UdpReorderWindow::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.jitter_us = jitter_us_;
+    return stats;
+}
+
+std::string UdpReorderWindow::GetStatsJson() {
+    auto stats = GetStats();
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "received", stats.received);
+    cJSON_AddNumberToObject(root, "lost", stats.lost);
+    cJSON_AddNumberToObject(root, "late", stats.late);
+    cJSON_AddNumberToObject(root, "duplicate", stats.duplicate);
+    cJSON_AddNumberToObject(root, "reordered", stats.reordered);
+    cJSON_AddNumberToObject(root, "concealed", stats.concealed);
+    cJSON_AddNumberToObject(root, "jitter_ms", stats.jitter_us / 1000.0);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
@@ -0,0 +1,76 @@
+#ifndef UDP_REORDER_WINDOW_H
+#define UDP_REORDER_WINDOW_H
+
+#include "protocol.h"
+
+#include <esp_timer.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+/*
+ * Reorder window of the UDP audio channel.
+ *
+ * Packets are held in UDP_REORDER_WINDOW_PACKETS slots keyed by sequence and released in
+ * order. A packet behind a gap waits at most two frame durations for the missing one, then
+ * the gap is declared lost. Up to UDP_MAX_CONCEALED_FRAMES lost frames of a gap are released
+ * as packets with an empty payload, which the decoder turns into Opus packet loss concealment;
+ * longer gaps are skipped. Duplicates and packets arriving after their gap was closed are
+ * dropped and counted.
+ */
+#define UDP_REORDER_WINDOW_PACKETS 8
+#define UDP_MAX_CONCEALED_FRAMES 2
+
+struct UdpReceiveStats {
+    uint32_t received = 0;      // Unique packets released in order
+    uint32_t lost = 0;          // Sequences never received
+    uint32_t late = 0;          // Arrived after their gap was declared lost
+    uint32_t duplicate = 0;
+    uint32_t reordered = 0;     // Arrived after a higher sequence, in time to be put back in order
+    uint32_t concealed = 0;     // Lost frames released for packet loss concealment
+    uint32_t jitter_us = 0;     // RFC 3550 interarrival jitter against the frame duration
+};
+
+class UdpReorderWindow {
+public:
+    UdpReorderWindow();
+    ~UdpReorderWindow();
+    UdpReorderWindow(const UdpReorderWindow&) = delete;
+    UdpReorderWindow& operator=(const UdpReorderWindow&) = delete;
+
+    void OnOutput(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
+    // Start a new stream, the next packet sets the expected sequence
+    void Reset(int frame_duration_ms);
+    void Push(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet);
+    UdpReceiveStats GetStats();
+    // {"received":n,"lost":n,"late":n,"duplicate":n,"reordered":n,"concealed":n,"jitter_ms":n}
+    std::string GetStatsJson();
+
+private:
+    std::mutex mutex_;
+    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_output_;
+    esp_timer_handle_t flush_timer_ = nullptr;
+
+    std::unique_ptr<AudioStreamPacket> slots_[UDP_REORDER_WINDOW_PACKETS];
+    uint32_t slot_sequences_[UDP_REORDER_WINDOW_PACKETS] = {};
+    bool started_ = false;
+    uint32_t next_sequence_ = 0;
+    uint32_t highest_sequence_ = 0;
+    uint64_t history_ = 0;      // Bit i set: next_sequence_ - 1 - i was received
+    int lost_run_ = 0;          // Sequences lost since the last released packet
+    int frame_duration_ms_ = 60;
+    int sample_rate_ = 0;
+    int64_t last_arrival_us_ = 0;
+    uint32_t last_arrival_sequence_ = 0;
+    int64_t jitter_us_ = 0;
+    UdpReceiveStats stats_;
+
+    void ReleaseReady();
+    void SkipTo(uint32_t sequence);
+    void Flush();
+};
+
+#endif // UDP_REORDER_WINDOW_H
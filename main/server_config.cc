@@ -0,0 +1,60 @@
+#include "server_config.h"
+#include "settings.h"
+
+#include <esp_log.h>
+
+#define TAG "ServerConfig"
+
+static void SaveSection(const cJSON* section, const char* ns) {
+    Settings settings(ns, true);
+    cJSON *item = NULL;
+    cJSON_ArrayForEach(item, section) {
+        if (cJSON_IsString(item)) {
+            if (settings.GetString(item->string) != item->valuestring) {
+                settings.SetString(item->string, item->valuestring);
+            }
+        } else if (cJSON_IsNumber(item)) {
+            if (settings.GetInt(item->string) != item->valueint) {
+                settings.SetInt(item->string, item->valueint);
+            }
+        }
+    }
+}
+
+ServerConfig SaveServerConfig(const cJSON* root) {
+    ServerConfig config;
+    cJSON *mqtt = cJSON_GetObjectItem(root, "mqtt");
+    cJSON *websocket = cJSON_GetObjectItem(root, "websocket");
+
+    if (cJSON_IsObject(mqtt)) {
+        SaveSection(mqtt, "mqtt");
+        Settings settings("mqtt", false);
+        config.has_mqtt = !settings.GetString("endpoint").empty();
+    } else {
+        ESP_LOGI(TAG, "No mqtt section found !");
+        if (cJSON_IsObject(websocket)) {
+            Settings settings("mqtt", true);
+            if (!settings.GetString("endpoint").empty()) {
+                ESP_LOGI(TAG, "Websocket only server, erasing the saved MQTT endpoint");
+                settings.EraseKey("endpoint");
+            }
+        }
+    }
+
+    if (cJSON_IsObject(websocket)) {
+        SaveSection(websocket, "websocket");
+        config.has_websocket = true;
+    } else {
+        ESP_LOGI(TAG, "No websocket section found!");
+    }
+    return config;
+}
+
+ServerConfig LoadServerConfig() {
+    Settings mqtt("mqtt", false);
+    Settings websocket("websocket", false);
+    ServerConfig config;
+    config.has_mqtt = !mqtt.GetString("endpoint").empty();
+    config.has_websocket = !websocket.GetString("url").empty();
+    return config;
+}
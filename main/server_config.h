@@ -0,0 +1,24 @@
+#ifndef SERVER_CONFIG_H
+#define SERVER_CONFIG_H
+
+#include <cJSON.h>
+
+/*
+ * Server config of the version check reply: the "mqtt" and "websocket" sections are saved to
+ * the settings namespaces of the same name.
+ *
+ * With a saved config the boot sequence starts the protocol before the next version check, from
+ * what LoadServerConfig() returns, and a saved broker endpoint wins over a websocket URL. So the
+ * saved config has to follow the server: a reply with a websocket section and no mqtt section
+ * erases the saved endpoint, otherwise a device once configured for MQTT would keep connecting
+ * to the old broker on every boot. An mqtt section with an empty endpoint is no MQTT config.
+ */
+struct ServerConfig {
+    bool has_mqtt = false;
+    bool has_websocket = false;
+};
+
+ServerConfig SaveServerConfig(const cJSON* root);
+ServerConfig LoadServerConfig();
+
+#endif // SERVER_CONFIG_H
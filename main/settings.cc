@@ -1,88 +1,348 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
 
+#include <map>
+#include <mutex>
+#include <vector>
+#include <optional>
+
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
-}
+namespace {
+
+enum SettingType : uint8_t {
+    kSettingTypeInt,
+    kSettingTypeBool,
+    kSettingTypeString,
+};
+
+struct SettingValue {
+    SettingType type = kSettingTypeInt;
+    int32_t int_value = 0;
+    std::string string_value;
+    bool dirty = false;         // 未提交到 flash
+    bool erased = false;        // 已删除，提交时从 flash 中擦除
+    bool retyped = false;       // 类型变化，提交时先擦除旧条目
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+    bool operator==(const SettingValue& other) const {
+        return type == other.type && int_value == other.int_value && string_value == other.string_value;
+    }
+};
+
+struct SettingsNamespace {
+    std::map<std::string, SettingValue> values;
+    bool erase_all = false;
+    bool dirty = false;
+};
+
+class SettingsCache {
+public:
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
+    }
+
+    std::optional<SettingValue> Get(const std::string& ns, const std::string& key, SettingType type) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& values = Load(ns).values;
+        auto it = values.find(key);
+        if (it == values.end() || it->second.erased) {
+            return std::nullopt;
+        }
+        if (it->second.type != type) {
+            ESP_LOGW(TAG, "Type mismatch for %s.%s", ns.c_str(), key.c_str());
+            return std::nullopt;
         }
-        nvs_close(nvs_handle_);
+        return it->second;
     }
-}
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+    void Set(const std::string& ns, const std::string& key, SettingValue value) {
+        if (!IsValidKey(key)) {
+            ESP_LOGE(TAG, "Invalid key for namespace %s: '%s'", ns.c_str(), key.c_str());
+            return;
+        }
+        if (value.type == kSettingTypeString && value.string_value.size() >= kMaxStringLength) {
+            ESP_LOGE(TAG, "Value of %s.%s is too long: %u bytes", ns.c_str(), key.c_str(), (unsigned)value.string_value.size());
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = Load(ns);
+        auto it = entry.values.find(key);
+        if (it != entry.values.end() && !it->second.erased) {
+            if (it->second == value) {
+                return;  // 值没有变化，不产生写入
+            }
+            if (it->second.type != value.type) {
+                ESP_LOGW(TAG, "Changing type of %s.%s", ns.c_str(), key.c_str());
+                value.retyped = true;
+            } else {
+                value.retyped = it->second.retyped;
+            }
+        } else if (it != entry.values.end()) {
+            value.retyped = true;  // 待擦除的旧条目可能是其它类型
+        }
+        value.dirty = true;
+        value.erased = false;
+        entry.values[key] = std::move(value);
+        entry.dirty = true;
+        ScheduleCommit();
+    }
+
+    void Erase(const std::string& ns, const std::string& key) {
+        if (!IsValidKey(key)) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = Load(ns);
+        // 缓存中没有的键也可能是 blob 等未缓存的类型，同样提交擦除
+        auto& value = entry.values[key];
+        value = SettingValue();
+        value.dirty = true;
+        value.erased = true;
+        entry.dirty = true;
+        ScheduleCommit();
+    }
+
+    void EraseAll(const std::string& ns) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& entry = Load(ns);
+        entry.values.clear();
+        entry.erase_all = true;
+        entry.dirty = true;
+        ScheduleCommit();
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+
+        // 在锁内取出待提交的修改，写 flash 时不阻塞读取
+        struct PendingNamespace {
+            std::string name;
+            bool erase_all;
+            std::vector<std::pair<std::string, SettingValue>> values;
+        };
+        std::vector<PendingNamespace> pending;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& [name, entry] : namespaces_) {
+                if (!entry.dirty) {
+                    continue;
+                }
+                PendingNamespace item = {name, entry.erase_all, {}};
+                for (auto it = entry.values.begin(); it != entry.values.end();) {
+                    if (it->second.dirty) {
+                        item.values.emplace_back(it->first, it->second);
+                        it->second.dirty = false;
+                        it->second.retyped = false;
+                    }
+                    if (it->second.erased) {
+                        it = entry.values.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                entry.erase_all = false;
+                entry.dirty = false;
+                pending.push_back(std::move(item));
+            }
+        }
+
+        for (auto& item : pending) {
+            Commit(item.name, item.erase_all, item.values);
+        }
+    }
+
+private:
+    static constexpr size_t kMaxStringLength = 4000;  // NVS 字符串上限
+
+    std::mutex mutex_;
+    std::mutex flush_mutex_;
+    std::map<std::string, SettingsNamespace> namespaces_;
+    esp_timer_handle_t commit_timer_ = nullptr;
+
+    SettingsCache() {
+        esp_timer_create_args_t timer_args = {
+            .callback = [](void* arg) {
+                static_cast<SettingsCache*>(arg)->Flush();
+            },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "settings_commit",
+            .skip_unhandled_events = true,
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &commit_timer_));
+        esp_register_shutdown_handler([]() {
+            SettingsCache::GetInstance().Flush();
+        });
+    }
+
+    static bool IsValidKey(const std::string& key) {
+        return !key.empty() && key.size() < NVS_KEY_NAME_MAX_SIZE;
     }
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    // 写入后延迟提交，期间的修改合并为一次 commit。定时器只在空闲时启动，保证提交延迟有上限
+    void ScheduleCommit() {
+        if (!esp_timer_is_active(commit_timer_)) {
+            esp_timer_start_once(commit_timer_, CONFIG_SETTINGS_COMMIT_DELAY_MS * 1000ULL);
+        }
     }
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    // 调用者持有 mutex_
+    SettingsNamespace& Load(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it != namespaces_.end()) {
+            return it->second;
+        }
+
+        auto& entry = namespaces_[ns];
+        nvs_handle_t handle = 0;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            return entry;  // 命名空间还不存在
+        }
+
+        nvs_iterator_t iterator = nullptr;
+        esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &iterator);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(iterator, &info);
+
+            SettingValue value;
+            bool loaded = false;
+            if (info.type == NVS_TYPE_I32) {
+                value.type = kSettingTypeInt;
+                loaded = nvs_get_i32(handle, info.key, &value.int_value) == ESP_OK;
+            } else if (info.type == NVS_TYPE_U8) {
+                uint8_t u8 = 0;
+                value.type = kSettingTypeBool;
+                loaded = nvs_get_u8(handle, info.key, &u8) == ESP_OK;
+                value.int_value = u8 != 0;
+            } else if (info.type == NVS_TYPE_STR) {
+                size_t length = 0;
+                value.type = kSettingTypeString;
+                if (nvs_get_str(handle, info.key, nullptr, &length) == ESP_OK) {
+                    value.string_value.resize(length);
+                    loaded = nvs_get_str(handle, info.key, value.string_value.data(), &length) == ESP_OK;
+                    while (!value.string_value.empty() && value.string_value.back() == '\0') {
+                        value.string_value.pop_back();
+                    }
+                }
+            }
+            if (loaded) {
+                entry.values[info.key] = std::move(value);
+            }
+            err = nvs_entry_next(&iterator);
+        }
+        nvs_release_iterator(iterator);
+        nvs_close(handle);
+
+        ESP_LOGD(TAG, "Loaded %u keys from namespace %s", (unsigned)entry.values.size(), ns.c_str());
+        return entry;
     }
-    return value;
+
+    void Commit(const std::string& ns, bool erase_all, const std::vector<std::pair<std::string, SettingValue>>& values) {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            return;
+        }
+
+        if (erase_all) {
+            err = nvs_erase_all(handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            }
+        }
+
+        for (auto& [key, value] : values) {
+            if (value.erased || value.retyped) {
+                err = nvs_erase_key(handle, key.c_str());
+                if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) {
+                    ESP_LOGE(TAG, "Failed to erase %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(err));
+                }
+                if (value.erased) {
+                    continue;
+                }
+            }
+            switch (value.type) {
+            case kSettingTypeInt:
+                err = nvs_set_i32(handle, key.c_str(), value.int_value);
+                break;
+            case kSettingTypeBool:
+                err = nvs_set_u8(handle, key.c_str(), value.int_value ? 1 : 0);
+                break;
+            case kSettingTypeString:
+                err = nvs_set_str(handle, key.c_str(), value.string_value.c_str());
+                break;
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(err));
+            }
+        }
+
+        err = nvs_commit(handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+        } else {
+            ESP_LOGI(TAG, "Committed %u change(s) to namespace %s", (unsigned)values.size(), ns.c_str());
+        }
+        nvs_close(handle);
+    }
+};
+
+} // namespace
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    auto value = SettingsCache::GetInstance().Get(ns_, key, kSettingTypeString);
+    return value ? value->string_value : default_value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingValue setting;
+        setting.type = kSettingTypeString;
+        setting.string_value = value;
+        SettingsCache::GetInstance().Set(ns_, key, std::move(setting));
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value;
+    auto value = SettingsCache::GetInstance().Get(ns_, key, kSettingTypeInt);
+    return value ? value->int_value : default_value;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingValue setting;
+        setting.type = kSettingTypeInt;
+        setting.int_value = value;
+        SettingsCache::GetInstance().Set(ns_, key, std::move(setting));
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value != 0;
+    auto value = SettingsCache::GetInstance().Get(ns_, key, kSettingTypeBool);
+    return value ? value->int_value != 0 : default_value;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingValue setting;
+        setting.type = kSettingTypeBool;
+        setting.int_value = value ? 1 : 0;
+        SettingsCache::GetInstance().Set(ns_, key, std::move(setting));
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +350,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsCache::GetInstance().Erase(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,8 +358,12 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsCache::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
+
+void Settings::Flush() {
+    SettingsCache::GetInstance().Flush();
+}
@@ -4,10 +4,15 @@
 #include <string>
 #include <nvs_flash.h>
 
+/*
+ * Settings 是某个 NVS 命名空间的视图，所有实例共享一个进程级的内存缓存：
+ * 第一次访问命名空间时一次性读入全部键值，之后的读取都在内存中完成；写入只修改缓存，
+ * 延迟 CONFIG_SETTINGS_COMMIT_DELAY_MS 后合并提交到 flash，进入待机、重启和深度睡眠前也会提交。
+ * 不经过 Settings 直接写入 NVS 的值（例如 esp-wifi-connect 组件）在重启后才会被读到。
+ */
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
-    ~Settings();
 
     std::string GetString(const std::string& key, const std::string& default_value = "");
     void SetString(const std::string& key, const std::string& value);
@@ -18,11 +23,12 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // 立即把所有未提交的修改写入 flash
+    static void Flush();
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
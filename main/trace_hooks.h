@@ -0,0 +1,29 @@
+#ifndef TRACE_HOOKS_H
+#define TRACE_HOOKS_H
+
+/*
+ * FreeRTOS trace hooks of the trace recorder (trace_recorder.h).
+ *
+ * With CONFIG_USE_TRACE_RECORDER this header is force-included into every C file of the build
+ * (see main/CMakeLists.txt), so the kernel's tasks.c picks up the macros below instead of its
+ * empty defaults. Keep it plain C without includes.
+ */
+#ifndef __ASSEMBLER__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void trace_recorder_task_switched_in(void);
+void trace_recorder_task_created(void* handle, const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define traceTASK_SWITCHED_IN() trace_recorder_task_switched_in()
+#define traceTASK_CREATE(pxNewTCB) trace_recorder_task_created((void*)(pxNewTCB), (pxNewTCB)->pcTaskName)
+
+#endif // __ASSEMBLER__
+
+#endif // TRACE_HOOKS_H
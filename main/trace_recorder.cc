@@ -0,0 +1,294 @@
+#include "trace_recorder.h"
+
+#if CONFIG_USE_TRACE_RECORDER
+
+#include "trace_hooks.h"
+#include "board.h"
+#include "system_info.h"
+
+#include <esp_log.h>
+#include <esp_attr.h>
+#include <esp_cpu.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <esp_heap_caps.h>
+#include <esp_freertos_hooks.h>
+#include <esp_private/cache_utils.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cJSON.h>
+
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "TraceRecorder"
+
+#define TRACE_MAGIC 0x52545A58                  // "XZTR"
+#define TRACE_SYNC_INTERVAL_CYCLES (1u << 27)   // ~0.56s at 240MHz, well below the 32 bit wrap
+#define TRACE_UPLOAD_CHUNK_EVENTS 256
+
+struct TraceEvent {
+    uint32_t cycles;
+    uint8_t type;
+    uint8_t core;
+    uint16_t id;
+    uint32_t value;
+    uint32_t extra;
+};
+
+struct TraceTaskName {
+    uint32_t handle;
+    char name[16];
+};
+
+#define TRACE_EVENT_COUNT (CONFIG_TRACE_RECORDER_BUFFER_KB * 1024 / sizeof(TraceEvent))
+
+struct TraceStorage {
+    uint32_t magic;
+    uint32_t capacity;
+    uint32_t write_index;       // Copy of the write index, to find the ring again after a reset
+    uint32_t task_count;
+    TraceTaskName tasks[TRACE_MAX_TASK_NAMES];
+    TraceEvent events[TRACE_EVENT_COUNT];
+};
+
+#if CONFIG_SPIRAM_ALLOW_NOINIT_SEG_EXTERNAL_MEMORY
+EXT_RAM_NOINIT_ATTR static TraceStorage trace_noinit_storage;
+#endif
+
+// Accessed from the scheduler, so these stay in internal RAM
+static TraceStorage* trace_storage = nullptr;
+static volatile bool trace_paused = true;
+static std::atomic<uint32_t> trace_write_index = 0;
+static std::atomic<uint32_t> trace_task_count = 0;
+static std::atomic<uint32_t> trace_dropped = 0;
+static uint32_t trace_last_sync[portNUM_PROCESSORS];
+
+extern "C" void IRAM_ATTR trace_recorder_write(uint8_t type, uint16_t id, uint32_t value, uint32_t extra) {
+    auto storage = trace_storage;
+    if (storage == nullptr || trace_paused) {
+        return;
+    }
+    // PSRAM is not reachable while a flash operation has the cache disabled
+    if (!spi_flash_cache_enabled()) {
+        trace_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    uint32_t index = trace_write_index.fetch_add(1, std::memory_order_relaxed);
+    auto& event = storage->events[index % TRACE_EVENT_COUNT];
+    event.cycles = esp_cpu_get_cycle_count();
+    event.type = type;
+    event.core = esp_cpu_get_core_id();
+    event.id = id;
+    event.value = value;
+    event.extra = extra;
+    storage->write_index = index + 1;
+}
+
+extern "C" void IRAM_ATTR trace_recorder_task_switched_in(void) {
+    trace_recorder_write(kTraceTaskSwitch, 0, (uint32_t)xTaskGetCurrentTaskHandle(), 0);
+}
+
+static void IRAM_ATTR AddTaskName(TraceStorage* storage, uint32_t handle, const char* name) {
+    // Task memory is reused, a new task with the same handle replaces the old name
+    uint32_t count = trace_task_count.load(std::memory_order_relaxed);
+    if (count > TRACE_MAX_TASK_NAMES) {
+        count = TRACE_MAX_TASK_NAMES;
+    }
+    TraceTaskName* entry = nullptr;
+    for (uint32_t i = 0; i < count; i++) {
+        if (storage->tasks[i].handle == handle) {
+            entry = &storage->tasks[i];
+            break;
+        }
+    }
+    if (entry == nullptr) {
+        uint32_t index = trace_task_count.fetch_add(1, std::memory_order_relaxed);
+        entry = &storage->tasks[index % TRACE_MAX_TASK_NAMES];
+        storage->task_count = index < TRACE_MAX_TASK_NAMES ? index + 1 : TRACE_MAX_TASK_NAMES;
+    }
+    entry->handle = handle;
+    int i = 0;
+    for (; i < (int)sizeof(entry->name) - 1 && name[i] != '\0'; i++) {
+        entry->name[i] = name[i];
+    }
+    entry->name[i] = '\0';
+}
+
+extern "C" void IRAM_ATTR trace_recorder_task_created(void* handle, const char* name) {
+    auto storage = trace_storage;
+    if (storage == nullptr || trace_paused || !spi_flash_cache_enabled()) {
+        return;
+    }
+    AddTaskName(storage, (uint32_t)handle, name);
+}
+
+static bool TraceIdleHook() {
+    int core = esp_cpu_get_core_id();
+    uint32_t now = esp_cpu_get_cycle_count();
+    if (now - trace_last_sync[core] >= TRACE_SYNC_INTERVAL_CYCLES) {
+        trace_last_sync[core] = now;
+        uint64_t time_us = esp_timer_get_time();
+        trace_recorder_write(kTraceSync, 0, (uint32_t)time_us, (uint32_t)(time_us >> 32));
+    }
+    return true;
+}
+
+void TraceRecorder::Initialize() {
+    if (trace_storage != nullptr) {
+        return;
+    }
+#if CONFIG_SPIRAM_ALLOW_NOINIT_SEG_EXTERNAL_MEMORY
+    auto storage = &trace_noinit_storage;
+    auto reason = esp_reset_reason();
+    bool crashed = reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT || reason == ESP_RST_TASK_WDT ||
+        reason == ESP_RST_WDT;
+    if (crashed && storage->magic == TRACE_MAGIC && storage->capacity == TRACE_EVENT_COUNT &&
+        storage->task_count <= TRACE_MAX_TASK_NAMES) {
+        // Keep the events that led to the crash, recording resumes after they are uploaded
+        previous_boot_ = true;
+        trace_write_index = storage->write_index;
+        trace_task_count = storage->task_count;
+        trace_storage = storage;
+        ESP_LOGW(TAG, "Keeping the trace of the crashed boot (%lu events) until it is uploaded",
+            (unsigned long)std::min<uint32_t>(storage->write_index, TRACE_EVENT_COUNT));
+    }
+#else
+    auto storage = (TraceStorage*)heap_caps_malloc(sizeof(TraceStorage), MALLOC_CAP_SPIRAM);
+    if (storage == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for the trace buffer", sizeof(TraceStorage));
+        return;
+    }
+#endif
+    if (!previous_boot_) {
+        trace_storage = storage;
+        ResetBuffer();
+        ESP_LOGI(TAG, "Recording %u events into PSRAM", TRACE_EVENT_COUNT);
+    }
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        esp_register_freertos_idle_hook_for_cpu(TraceIdleHook, core);
+    }
+}
+
+void TraceRecorder::ResetBuffer() {
+    trace_paused = true;
+    auto storage = trace_storage;
+    storage->magic = TRACE_MAGIC;
+    storage->capacity = TRACE_EVENT_COUNT;
+    storage->write_index = 0;
+    storage->task_count = 0;
+    trace_write_index = 0;
+    trace_task_count = 0;
+    trace_dropped = 0;
+    UpdateTaskNames();
+    // Force a sync event on both cores before the first task switches
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        trace_last_sync[core] = esp_cpu_get_cycle_count() - TRACE_SYNC_INTERVAL_CYCLES;
+    }
+    trace_paused = false;
+}
+
+// Tasks created before Initialize() never went through the create hook
+void TraceRecorder::UpdateTaskNames() {
+    UBaseType_t size = uxTaskGetNumberOfTasks() + 4;
+    auto status = (TaskStatus_t*)malloc(sizeof(TaskStatus_t) * size);
+    if (status == nullptr) {
+        return;
+    }
+    size = uxTaskGetSystemState(status, size, nullptr);
+    for (UBaseType_t i = 0; i < size; i++) {
+        AddTaskName(trace_storage, (uint32_t)status[i].xHandle, status[i].pcTaskName);
+    }
+    free(status);
+}
+
+bool TraceRecorder::Upload(const std::string& url) {
+    auto storage = trace_storage;
+    if (storage == nullptr) {
+        return false;
+    }
+    if (!previous_boot_) {
+        UpdateTaskNames();
+    }
+    trace_paused = true;
+    // Let an event in progress on the other core complete
+    vTaskDelay(pdMS_TO_TICKS(2));
+
+    uint32_t total = trace_write_index.load();
+    uint32_t count = std::min<uint32_t>(total, TRACE_EVENT_COUNT);
+    uint32_t task_count = std::min<uint32_t>(trace_task_count.load(), TRACE_MAX_TASK_NAMES);
+
+    uint8_t header[32] = {'X', 'Z', 'T', 'R', TRACE_DUMP_VERSION};
+    header[5] = previous_boot_ ? TRACE_DUMP_FLAG_PREVIOUS_BOOT : 0;
+    uint16_t event_size = sizeof(TraceEvent);
+    uint32_t dropped = trace_dropped.load();
+    memcpy(header + 6, &event_size, 2);
+    memcpy(header + 8, &count, 4);
+    memcpy(header + 12, &dropped, 4);
+    memcpy(header + 16, &task_count, 4);
+
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(3);
+    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    http->SetHeader("Content-Type", "application/octet-stream");
+    http->SetHeader("Transfer-Encoding", "chunked");
+    bool success = http->Open("POST", url);
+    if (success) {
+        http->Write((const char*)header, sizeof(header));
+        http->Write((const char*)storage->tasks, task_count * sizeof(TraceTaskName));
+        // Oldest first, in pieces that do not wrap around the end of the ring
+        for (uint32_t i = 0; i < count;) {
+            uint32_t slot = (total - count + i) % TRACE_EVENT_COUNT;
+            uint32_t n = std::min<uint32_t>({count - i, (uint32_t)TRACE_EVENT_COUNT - slot, TRACE_UPLOAD_CHUNK_EVENTS});
+            http->Write((const char*)&storage->events[slot], n * sizeof(TraceEvent));
+            i += n;
+        }
+        http->Write("", 0);
+        success = http->GetStatusCode() == 200;
+        http->Close();
+    }
+    if (success) {
+        ESP_LOGI(TAG, "Uploaded %lu events to %s", (unsigned long)count, url.c_str());
+    } else {
+        ESP_LOGE(TAG, "Failed to upload the trace to %s", url.c_str());
+    }
+
+    if (success && previous_boot_) {
+        previous_boot_ = false;
+        ResetBuffer();
+    } else if (!previous_boot_) {
+        trace_paused = false;
+    }
+    return success;
+}
+
+std::string TraceRecorder::GetStatusJson() {
+    auto root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "enabled", trace_storage != nullptr);
+    cJSON_AddNumberToObject(root, "capacity", TRACE_EVENT_COUNT);
+    cJSON_AddNumberToObject(root, "events", std::min<uint32_t>(trace_write_index.load(), TRACE_EVENT_COUNT));
+    cJSON_AddNumberToObject(root, "dropped", trace_dropped.load());
+    cJSON_AddBoolToObject(root, "previous_boot", previous_boot_);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+#else
+
+void TraceRecorder::Initialize() {
+}
+
+bool TraceRecorder::Upload(const std::string& url) {
+    return false;
+}
+
+std::string TraceRecorder::GetStatusJson() {
+    return "{\"enabled\":false}";
+}
+
+#endif // CONFIG_USE_TRACE_RECORDER
@@ -0,0 +1,78 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <string>
+#include <cstdint>
+
+/*
+ * Always-on binary trace of task scheduling and key application events.
+ *
+ * Every event is 16 bytes written into a fixed ring in PSRAM with a CPU cycle counter
+ * timestamp: task switches and task creation come from the FreeRTOS trace hooks, the
+ * application adds device state changes, audio queue depths and servo moves. The idle hook of
+ * each core writes a sync event (cycle counter + esp_timer time) about twice a second, so the
+ * host can convert cycles to time on both cores, also across frequency changes.
+ *
+ * With CONFIG_SPIRAM_ALLOW_NOINIT_SEG_EXTERNAL_MEMORY the ring lives in no-init PSRAM and
+ * survives a panic or watchdog reset. Recording then stays paused until that trace is uploaded.
+ *
+ * Upload() posts the dump to a HTTP receiver, scripts/trace_to_perfetto.py converts it to
+ * Chrome / Perfetto trace JSON. Dump layout (little endian):
+ *   header  "XZTR" | version u8 | flags u8 | event_size u16 | event_count u32 | dropped u32 |
+ *           task_count u32 | reserved u32[3]
+ *   tasks   handle u32 | name char[16]
+ *   events  cycles u32 | type u8 | core u8 | id u16 | value u32 | extra u32, oldest first
+ */
+#define TRACE_DUMP_VERSION 1
+#define TRACE_DUMP_FLAG_PREVIOUS_BOOT 0x01
+#define TRACE_MAX_TASK_NAMES 64
+
+enum TraceEventType : uint8_t {
+    kTraceTaskSwitch = 1,       // value: task handle
+    kTraceDeviceState = 2,      // value: DeviceState
+    kTraceAudioQueues = 3,      // value: decode | encode << 8 | send << 16 | playback << 24
+    kTraceServo = 4,            // id: servo index, value: angle
+    kTraceSync = 5,             // value / extra: esp_timer time in us, low / high word
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void trace_recorder_write(uint8_t type, uint16_t id, uint32_t value, uint32_t extra);
+#ifdef __cplusplus
+}
+#endif
+
+class TraceRecorder {
+public:
+    static TraceRecorder& GetInstance() {
+        static TraceRecorder instance;
+        return instance;
+    }
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // Allocate the ring, or keep the one left by a crashed boot
+    void Initialize();
+
+    inline void Record(TraceEventType type, uint16_t id, uint32_t value) {
+#if CONFIG_USE_TRACE_RECORDER
+        trace_recorder_write(type, id, value, 0);
+#endif
+    }
+
+    // Post the dump to url, recording pauses during the upload
+    bool Upload(const std::string& url);
+    // {"enabled":true,"capacity":n,"events":n,"dropped":n,"previous_boot":false}
+    std::string GetStatusJson();
+
+private:
+    TraceRecorder() = default;
+
+    bool previous_boot_ = false;
+
+    void ResetBuffer();
+    void UpdateTaskNames();
+};
+
+#endif // TRACE_RECORDER_H
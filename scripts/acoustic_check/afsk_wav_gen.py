@@ -0,0 +1,70 @@
+"""
+生成声波配网测试用的AFSK WAV文件, 调制方式与 sonic_wifi_config.html 一致:
+START(0x01 0x02) + 文本 + 校验和 + END(0x03 0x04), 每字节高位在前, MARK=1800Hz, SPACE=1500Hz
+"""
+
+import argparse
+import array
+import math
+import random
+import wave
+
+MARK = 1800
+SPACE = 1500
+START_BYTES = [0x01, 0x02]
+END_BYTES = [0x03, 0x04]
+
+
+def frame_bits(text):
+    data = list(text.encode('utf-8'))
+    frame = START_BYTES + data + [sum(data) & 0xff] + END_BYTES
+    return [(b >> i) & 1 for b in frame for i in range(7, -1, -1)]
+
+
+def modulate(bits, sample_rate, bit_rate):
+    # 与网页相同: 按绝对时间计算相位, 比特边界处相位不连续
+    samples_per_bit = sample_rate / bit_rate
+    total = int(len(bits) * samples_per_bit)
+    signal = []
+    for i in range(total):
+        freq = MARK if bits[min(int(i / samples_per_bit), len(bits) - 1)] else SPACE
+        signal.append(math.sin(2 * math.pi * freq * i / sample_rate))
+    return signal
+
+
+def main():
+    parser = argparse.ArgumentParser(description='生成AFSK声波配网WAV文件')
+    parser.add_argument('--ssid', default='xiaozhi')
+    parser.add_argument('--password', default='12345678')
+    parser.add_argument('--baud', type=int, default=100, help='比特率 (默认: 100)')
+    parser.add_argument('--samplerate', type=int, default=16000, help='采样率 (默认: 16000, 与设备输入一致)')
+    parser.add_argument('--snr', type=float, default=None, help='加入白噪声的信噪比(dB), 不指定则无噪声')
+    parser.add_argument('--amplitude', type=float, default=0.5, help='信号幅度 0~1 (默认: 0.5)')
+    parser.add_argument('--repeat', type=int, default=1, help='重复次数, 之间插入静音')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--output', '-o', default='afsk.wav')
+    args = parser.parse_args()
+
+    text = args.ssid + '\n' + args.password
+    tone = [x * args.amplitude for x in modulate(frame_bits(text), args.samplerate, args.baud)]
+    gap = [0.0] * (args.samplerate // 2)
+    signal = gap + (tone + gap) * args.repeat
+
+    if args.snr is not None:
+        rng = random.Random(args.seed)
+        noise_power = sum(x * x for x in tone) / len(tone) / (10 ** (args.snr / 10))
+        sigma = math.sqrt(noise_power)
+        signal = [x + rng.gauss(0, sigma) for x in signal]
+
+    pcm = array.array('h', (max(-32768, min(32767, int(x * 32767))) for x in signal))
+    with wave.open(args.output, 'wb') as wav_file:
+        wav_file.setnchannels(1)
+        wav_file.setsampwidth(2)
+        wav_file.setframerate(args.samplerate)
+        wav_file.writeframes(pcm.tobytes())
+    print(f"{args.output}: {len(pcm) / args.samplerate:.2f}s, {args.baud} baud, "
+          f"snr={'inf' if args.snr is None else args.snr}dB, text={text!r}")
+
+
+if __name__ == '__main__':
+    main()
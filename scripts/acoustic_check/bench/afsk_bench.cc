@@ -0,0 +1,191 @@
+// Host bench for main/boards/common/afsk_demod.cc, see ../readme.md
+//
+// Feeds a 16 kHz WAV (afsk_wav_gen.py) through AfskDemodulator in 30 ms blocks, like
+// ReceiveWifiCredentialsFromAudio does, and reports the decoded frames, the bit error rate
+// against the expected text and the cost per second of audio.
+
+#include "afsk_demod.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#endif
+
+using namespace audio_wifi_config;
+
+bool g_bench_verbose = false;
+
+static bool ReadWav(const char* path, std::vector<int16_t>& samples, int& sample_rate, int& channels) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    char riff[12];
+    if (fread(riff, 1, 12, file) != 12 || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        fclose(file);
+        return false;
+    }
+    bool ok = false;
+    char id[4];
+    uint32_t size;
+    while (fread(id, 1, 4, file) == 4 && fread(&size, 4, 1, file) == 1) {
+        if (memcmp(id, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, file) != 16) {
+                break;
+            }
+            channels = fmt[2] | (fmt[3] << 8);
+            sample_rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+            int bits = fmt[14] | (fmt[15] << 8);
+            if (bits != 16) {
+                fprintf(stderr, "Only 16-bit PCM is supported\n");
+                break;
+            }
+            fseek(file, size - 16 + (size & 1), SEEK_CUR);
+        } else if (memcmp(id, "data", 4) == 0) {
+            samples.resize(size / 2);
+            ok = fread(samples.data(), 2, samples.size(), file) == samples.size();
+            break;
+        } else {
+            fseek(file, size + (size & 1), SEEK_CUR);
+        }
+    }
+    fclose(file);
+    return ok && channels > 0;
+}
+
+static std::vector<uint8_t> FrameBits(const std::string& text) {
+    std::vector<uint8_t> bytes = {0x01, 0x02};
+    bytes.insert(bytes.end(), text.begin(), text.end());
+    bytes.push_back(AudioDataBuffer::CalculateChecksum(text));
+    bytes.push_back(0x03);
+    bytes.push_back(0x04);
+    std::vector<uint8_t> bits;
+    for (uint8_t byte : bytes) {
+        for (int i = 7; i >= 0; i--) {
+            bits.push_back((byte >> i) & 1);
+        }
+    }
+    return bits;
+}
+
+// Bit errors of the best aligned occurrence of each expected frame in the demodulated stream
+static void CountBitErrors(const std::vector<uint8_t>& received, const std::vector<uint8_t>& expected,
+                           size_t& errors, size_t& total) {
+    size_t n = expected.size();
+    for (size_t start = 0; start + n <= received.size();) {
+        // Lock on the 16-bit start identifier, then compare the rest of the frame
+        if (memcmp(&received[start], expected.data(), 16) != 0) {
+            start++;
+            continue;
+        }
+        size_t frame_errors = 0;
+        for (size_t i = 0; i < n; i++) {
+            frame_errors += received[start + i] != expected[i];
+        }
+        errors += frame_errors;
+        total += n;
+        start += n;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    int baud = kBitRate;
+    std::string expected_text;
+    bool has_expected = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--baud") == 0 && i + 1 < argc) {
+            baud = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+            expected_text = argv[++i];
+            has_expected = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            g_bench_verbose = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "Usage: %s [--baud N] [--expect \"ssid\\npassword\"] [-v] file.wav\n", argv[0]);
+        return 2;
+    }
+    // Allow a literal "\n" on the command line
+    for (size_t p; (p = expected_text.find("\\n")) != std::string::npos;) {
+        expected_text.replace(p, 2, "\n");
+    }
+
+    std::vector<int16_t> samples;
+    int sample_rate = 0, channels = 0;
+    if (!ReadWav(path, samples, sample_rate, channels)) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        return 2;
+    }
+    if (sample_rate != static_cast<int>(kInputSampleRate)) {
+        fprintf(stderr, "Expected %d Hz input, got %d Hz\n", static_cast<int>(kInputSampleRate), sample_rate);
+        return 2;
+    }
+
+    AfskDemodulator demodulator(kMarkFrequency, kSpaceFrequency, baud);
+    AudioDataBuffer data_buffer;
+    std::vector<uint8_t> received;
+    uint8_t bits[64];
+    size_t frames = samples.size() / channels;
+    const size_t kBlockFrames = kInputSampleRate * 30 / 1000;
+    int decoded = 0, correct = 0;
+    uint64_t demod_ns = 0;
+#ifdef BENCH_HAS_TSC
+    uint64_t demod_cycles = 0;
+#endif
+
+    for (size_t offset = 0; offset < frames; offset += kBlockFrames) {
+        size_t block = std::min(kBlockFrames, frames - offset);
+        auto begin = std::chrono::steady_clock::now();
+#ifdef BENCH_HAS_TSC
+        uint64_t tsc = __rdtsc();
+#endif
+        size_t count = demodulator.Process(&samples[offset * channels], block, channels, bits, sizeof(bits));
+#ifdef BENCH_HAS_TSC
+        demod_cycles += __rdtsc() - tsc;
+#endif
+        demod_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+        received.insert(received.end(), bits, bits + count);
+        if (data_buffer.ProcessBits(bits, count) && data_buffer.decoded_text.has_value()) {
+            decoded++;
+            bool match = has_expected && *data_buffer.decoded_text == expected_text;
+            correct += match;
+            printf("Decoded #%d at %.2fs: \"%s\"%s\n", decoded, static_cast<double>(offset) / sample_rate,
+                   data_buffer.decoded_text->c_str(), has_expected ? (match ? " (ok)" : " (MISMATCH)") : "");
+            data_buffer.decoded_text.reset();
+        }
+    }
+
+    double seconds = static_cast<double>(frames) / sample_rate;
+    printf("Audio: %.2fs, %d baud, %zu bits demodulated\n", seconds, baud, received.size());
+    printf("Frames decoded: %d", decoded);
+    if (has_expected) {
+        size_t errors = 0, total = 0;
+        CountBitErrors(received, FrameBits(expected_text), errors, total);
+        printf(", correct: %d\n", correct);
+        if (total > 0) {
+            printf("BER: %zu / %zu = %.2e\n", errors, total, static_cast<double>(errors) / total);
+        } else {
+            printf("BER: no start identifier found\n");
+        }
+    } else {
+        printf("\n");
+    }
+    printf("Demodulator: %.1f us per second of audio", demod_ns / 1000.0 / seconds);
+#ifdef BENCH_HAS_TSC
+    printf(", %.0f TSC cycles per second of audio", demod_cycles / seconds);
+#endif
+    printf("\n");
+    return has_expected && correct == 0 ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+// Host stub of esp_log.h for the benches
+#pragma once
+#include <cstdio>
+
+extern bool g_bench_verbose;
+
+#define ESP_LOG_STUB(level, tag, format, ...) \
+    do { if (g_bench_verbose) fprintf(stderr, level " (%s) " format "\n", tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGE(tag, format, ...) ESP_LOG_STUB("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_STUB("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_STUB("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_STUB("D", tag, format, ##__VA_ARGS__)
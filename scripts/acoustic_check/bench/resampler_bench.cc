@@ -0,0 +1,268 @@
+// Host bench for main/audio/audio_resampler.cc, see ../readme.md
+//
+// Converts sine tones in 60 ms blocks, like AudioService does, and reports for every ratio the
+// SNR of in-band tones, the rejection of a tone above the output Nyquist frequency and the cost
+// per second of audio. Built with -DWITH_SILK_RESAMPLER and the libopus sources, the same
+// numbers are printed for silk_resampler, which OpusResampler of esp-opus-encoder wraps.
+
+#include "audio_resampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#endif
+
+#ifdef WITH_SILK_RESAMPLER
+#include "opus_types.h"
+#include "resampler_structs.h"
+extern "C" {
+int silk_resampler_init(silk_resampler_state_struct* S, opus_int32 Fs_Hz_in, opus_int32 Fs_Hz_out, int forEnc);
+int silk_resampler(silk_resampler_state_struct* S, opus_int16 out[], const opus_int16 in[], opus_int32 inLen);
+}
+#endif
+
+bool g_bench_verbose = false;
+
+#define BLOCK_MS 60
+#define TONE_AMPLITUDE 12000.0
+// The filters settle within a few ms, the first and last blocks are left out of the fit
+#define SETTLE_MS 20
+
+// Interleaved in, interleaved out, one 60 ms block at a time
+class BenchResampler {
+public:
+    virtual ~BenchResampler() = default;
+    virtual const char* name() const = 0;
+    virtual void Process(std::vector<int16_t>& data) = 0;
+};
+
+class PolyphaseResampler : public BenchResampler {
+public:
+    PolyphaseResampler(int input_sample_rate, int output_sample_rate, int channels) {
+        resampler_.Configure(input_sample_rate, output_sample_rate, channels);
+    }
+    const char* name() const override { return "AudioResampler"; }
+    void Process(std::vector<int16_t>& data) override { resampler_.Process(data); }
+
+private:
+    AudioResampler resampler_;
+};
+
+#ifdef WITH_SILK_RESAMPLER
+// Configured like OpusResampler, one mono state per channel like AudioService did before
+class SilkResampler : public BenchResampler {
+public:
+    SilkResampler(int input_sample_rate, int output_sample_rate, int channels)
+        : input_sample_rate_(input_sample_rate), output_sample_rate_(output_sample_rate), states_(channels) {
+        int encode = input_sample_rate > output_sample_rate ? 1 : 0;
+        for (auto& state : states_) {
+            ok_ = ok_ && silk_resampler_init(&state, input_sample_rate, output_sample_rate, encode) == 0;
+        }
+    }
+    bool ok() const { return ok_; }
+    const char* name() const override { return "silk_resampler"; }
+    void Process(std::vector<int16_t>& data) override {
+        int channels = states_.size();
+        size_t frames = data.size() / channels;
+        size_t output_frames = frames * output_sample_rate_ / input_sample_rate_;
+        std::vector<int16_t> input(frames), output(output_frames);
+        std::vector<int16_t> result(output_frames * channels);
+        for (int c = 0; c < channels; c++) {
+            for (size_t i = 0; i < frames; i++) {
+                input[i] = data[i * channels + c];
+            }
+            silk_resampler(&states_[c], output.data(), input.data(), frames);
+            for (size_t i = 0; i < output_frames; i++) {
+                result[i * channels + c] = output[i];
+            }
+        }
+        data = std::move(result);
+    }
+
+private:
+    int input_sample_rate_;
+    int output_sample_rate_;
+    std::vector<silk_resampler_state_struct> states_;
+    bool ok_ = true;
+};
+#endif
+
+// Sine of `frequency` on every channel, the second channel at half the amplitude
+static std::vector<int16_t> Tone(double frequency, int sample_rate, int channels, double seconds) {
+    size_t frames = seconds * sample_rate;
+    std::vector<int16_t> data(frames * channels);
+    for (size_t i = 0; i < frames; i++) {
+        double value = TONE_AMPLITUDE * sin(2 * M_PI * frequency * i / sample_rate);
+        for (int c = 0; c < channels; c++) {
+            data[i * channels + c] = lround(c == 0 ? value : value / 2);
+        }
+    }
+    return data;
+}
+
+static std::vector<int16_t> Run(BenchResampler& resampler, const std::vector<int16_t>& input, int sample_rate,
+                                int channels) {
+    size_t block = sample_rate * BLOCK_MS / 1000 * channels;
+    std::vector<int16_t> output;
+    for (size_t offset = 0; offset + block <= input.size(); offset += block) {
+        std::vector<int16_t> data(input.begin() + offset, input.begin() + offset + block);
+        resampler.Process(data);
+        output.insert(output.end(), data.begin(), data.end());
+    }
+    return output;
+}
+
+// Least squares fit of a sine of the known frequency, returns the amplitude and the residual power
+static void FitTone(const std::vector<int16_t>& data, int channel, int channels, double frequency,
+                    int sample_rate, double& amplitude, double& residual) {
+    size_t frames = data.size() / channels;
+    size_t skip = sample_rate * SETTLE_MS / 1000;
+    double cc = 0, ss = 0, cs = 0, xc = 0, xs = 0;
+    for (size_t i = skip; i + skip < frames; i++) {
+        double w = 2 * M_PI * frequency * i / sample_rate;
+        double x = data[i * channels + channel];
+        cc += cos(w) * cos(w);
+        ss += sin(w) * sin(w);
+        cs += cos(w) * sin(w);
+        xc += x * cos(w);
+        xs += x * sin(w);
+    }
+    double det = cc * ss - cs * cs;
+    double a = (xc * ss - xs * cs) / det;
+    double b = (xs * cc - xc * cs) / det;
+    amplitude = sqrt(a * a + b * b);
+    residual = 0;
+    size_t count = 0;
+    for (size_t i = skip; i + skip < frames; i++) {
+        double w = 2 * M_PI * frequency * i / sample_rate;
+        double e = data[i * channels + channel] - a * cos(w) - b * sin(w);
+        residual += e * e;
+        count++;
+    }
+    residual /= count;
+}
+
+static double Power(const std::vector<int16_t>& data, int channel, int channels, int sample_rate) {
+    size_t frames = data.size() / channels;
+    size_t skip = sample_rate * SETTLE_MS / 1000;
+    double sum = 0;
+    size_t count = 0;
+    for (size_t i = skip; i + skip < frames; i++) {
+        double x = data[i * channels + channel];
+        sum += x * x;
+        count++;
+    }
+    return count > 0 ? sum / count : 0;
+}
+
+typedef std::unique_ptr<BenchResampler> (*ResamplerFactory)(int, int, int);
+
+static void Measure(ResamplerFactory factory, int input_rate, int output_rate, int channels, double seconds) {
+    auto probe = factory(input_rate, output_rate, channels);
+    if (!probe) {
+        return;
+    }
+    printf("  %-15s %5d -> %5d Hz, %d ch:", probe->name(), input_rate, output_rate, channels);
+
+    // Worst SNR of the in-band tones, over all channels
+    int nyquist = std::min(input_rate, output_rate) / 2;
+    double worst_snr = 1e9;
+    for (double frequency : { 300.0, 1000.0, 3000.0, nyquist * 0.8 }) {
+        auto resampler = factory(input_rate, output_rate, channels);
+        auto output = Run(*resampler, Tone(frequency, input_rate, channels, 1.0), input_rate, channels);
+        for (int c = 0; c < channels; c++) {
+            double amplitude, residual;
+            FitTone(output, c, channels, frequency, output_rate, amplitude, residual);
+            double snr = 10 * log10(amplitude * amplitude / 2 / std::max(residual, 1e-9));
+            worst_snr = std::min(worst_snr, snr);
+        }
+    }
+    printf(" SNR %5.1f dB", worst_snr);
+
+    // A tone above the output Nyquist frequency should not fold back into the band
+    if (output_rate < input_rate) {
+        double frequency = output_rate * 0.6;
+        auto resampler = factory(input_rate, output_rate, channels);
+        auto output = Run(*resampler, Tone(frequency, input_rate, channels, 1.0), input_rate, channels);
+        double power = Power(output, 0, channels, output_rate);
+        printf(", %5.0f Hz rejected by %5.1f dB", frequency,
+               10 * log10(TONE_AMPLITUDE * TONE_AMPLITUDE / 2 / std::max(power, 1e-9)));
+    } else {
+        printf("                               ");
+    }
+
+    // Cost per second of audio, the input converted in 60 ms blocks
+    auto input = Tone(1000, input_rate, channels, seconds);
+    size_t block = input_rate * BLOCK_MS / 1000 * channels;
+    auto resampler = factory(input_rate, output_rate, channels);
+    std::vector<int16_t> data;
+    uint64_t elapsed_ns = 0;
+#ifdef BENCH_HAS_TSC
+    uint64_t cycles = 0;
+#endif
+    for (size_t offset = 0; offset + block <= input.size(); offset += block) {
+        data.assign(input.begin() + offset, input.begin() + offset + block);
+        auto begin = std::chrono::steady_clock::now();
+#ifdef BENCH_HAS_TSC
+        uint64_t tsc = __rdtsc();
+#endif
+        resampler->Process(data);
+#ifdef BENCH_HAS_TSC
+        cycles += __rdtsc() - tsc;
+#endif
+        elapsed_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    }
+    printf(", %6.1f us", elapsed_ns / 1000.0 / seconds);
+#ifdef BENCH_HAS_TSC
+    printf(" %8.0f cycles", cycles / seconds);
+#endif
+    printf(" per second\n");
+}
+
+static std::unique_ptr<BenchResampler> MakePolyphase(int input_rate, int output_rate, int channels) {
+    return std::make_unique<PolyphaseResampler>(input_rate, output_rate, channels);
+}
+
+#ifdef WITH_SILK_RESAMPLER
+static std::unique_ptr<BenchResampler> MakeSilk(int input_rate, int output_rate, int channels) {
+    auto resampler = std::make_unique<SilkResampler>(input_rate, output_rate, channels);
+    if (!resampler->ok()) {
+        printf("  %-15s %5d -> %5d Hz, %d ch: not supported\n", "silk_resampler", input_rate, output_rate, channels);
+        return nullptr;
+    }
+    return resampler;
+}
+#endif
+
+int main(int argc, char** argv) {
+    double seconds = 10;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            g_bench_verbose = true;
+        } else {
+            fprintf(stderr, "Usage: %s [--seconds N] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    const int ratios[][2] = { { 24000, 16000 }, { 16000, 24000 }, { 48000, 16000 }, { 44100, 16000 }, { 16000, 8000 } };
+    for (auto& ratio : ratios) {
+        for (int channels = 1; channels <= 2; channels++) {
+            Measure(MakePolyphase, ratio[0], ratio[1], channels, seconds);
+#ifdef WITH_SILK_RESAMPLER
+            Measure(MakeSilk, ratio[0], ratio[1], channels, seconds);
+#endif
+        }
+    }
+    return 0;
+}
@@ -1,54 +1,167 @@
 import socket
+import struct
 import wave
+import json
+import array
 import argparse
 
 
 '''
-  Create a UDP socket and bind it to the server's IP:8000.
-  Listen for incoming messages and print them to the console.
-  Save the audio to a WAV file.
+  Receive the audio tap protocol sent by AudioDebugger (CONFIG_USE_AUDIO_DEBUGGER).
+  Each datagram carries one batch of PCM of one pipeline stage:
+
+    magic "XZTP" | version u8 | stage u8 | channels u8 | reserved u8 |
+    sequence u32 | sample_rate u32 | frames u32 | timestamp_us u64 | int16 PCM...
+
+  Lost datagrams are detected from the per-stage sequence number. On exit all stages are
+  aligned by their device timestamps, resampled to --samplerate and saved as one
+  multi-track WAV (one track per stage channel). Latency reports ("XZRP" + JSON) are printed.
 '''
-def main(samplerate, channels):
-    # Create a UDP socket
-    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    server_socket.bind(('0.0.0.0', 8000))
+HEADER = struct.Struct('<4sBBBBIIIQ')
+TAP_MAGIC = b'XZTP'
+REPORT_MAGIC = b'XZRP'
+STAGE_NAMES = ['mic_raw', 'processed', 'decoded', 'playback']
+
+
+class StageTrack:
+    def __init__(self, stage):
+        self.stage = stage
+        self.channels = 0
+        self.next_sequence = None
+        self.received = 0
+        self.lost = 0
+        # (timestamp_us, sample_rate, channels, samples, contiguous with previous batch)
+        self.batches = []
+
+    def add(self, sequence, sample_rate, channels, timestamp_us, samples):
+        contiguous = self.next_sequence is not None and sequence == self.next_sequence
+        if self.next_sequence is not None and sequence != self.next_sequence:
+            self.lost += (sequence - self.next_sequence) & 0xFFFFFFFF
+        self.next_sequence = (sequence + 1) & 0xFFFFFFFF
+        self.channels = max(self.channels, channels)
+        self.received += 1
+        self.batches.append((timestamp_us, sample_rate, channels, samples, contiguous))
+
+
+def resample(samples, channels, src_rate, dst_rate):
+    '''Linear interpolation per channel, returns interleaved int16 samples'''
+    if src_rate == dst_rate:
+        return samples
+    frames = len(samples) // channels
+    out_frames = frames * dst_rate // src_rate
+    out = array.array('h', bytes(out_frames * channels * 2))
+    step = src_rate / dst_rate
+    for i in range(out_frames):
+        pos = i * step
+        j = int(pos)
+        frac = pos - j
+        k = min(j + 1, frames - 1)
+        for c in range(channels):
+            a = samples[j * channels + c]
+            b = samples[k * channels + c]
+            out[i * channels + c] = int(a + (b - a) * frac)
+    return out
+
+
+def render_track(track, rate, start_us):
+    '''Place every batch at its device timestamp, batches that follow without loss are appended'''
+    channels = track.channels
+    pcm = array.array('h')
+    position = 0
+    for timestamp_us, sample_rate, batch_channels, samples, contiguous in track.batches:
+        if batch_channels != channels:
+            continue
+        if not contiguous:
+            position = max(0, round((timestamp_us - start_us) * rate / 1000000))
+        data = resample(samples, channels, sample_rate, rate)
+        end = position * channels + len(data)
+        if len(pcm) < end:
+            pcm.extend(array.array('h', bytes((end - len(pcm)) * 2)))
+        pcm[position * channels:end] = data
+        position += len(data) // channels
+    return pcm
+
+
+def save_wav(tracks, filename, rate):
+    tracks = [t for t in tracks if t.batches]
+    if not tracks:
+        print("No audio received")
+        return
+    start_us = min(t.batches[0][0] for t in tracks)
+    rendered = [(t, render_track(t, rate, start_us)) for t in tracks]
+    total_channels = sum(t.channels for t in tracks)
+    length = max(len(pcm) // t.channels for t, pcm in rendered)
 
-    # Create WAV file with parameters
-    filename = f"{samplerate}_{channels}.wav"
-    wav_file = wave.open(filename, "wb")
-    wav_file.setnchannels(channels)     # channels parameter
-    wav_file.setsampwidth(2)            # 2 bytes per sample (16-bit)
-    wav_file.setframerate(samplerate)   # samplerate parameter
+    merged = array.array('h', bytes(length * total_channels * 2))
+    offset = 0
+    for t, pcm in rendered:
+        frames = len(pcm) // t.channels
+        for c in range(t.channels):
+            merged[offset + c:frames * total_channels:total_channels] = pcm[c::t.channels][:frames]
+            print(f"Track {offset + c}: {STAGE_NAMES[t.stage] if t.stage < len(STAGE_NAMES) else t.stage} channel {c}")
+        offset += t.channels
 
-    print(f"Start saving audio from 0.0.0.0:8000 to {filename}...")
+    with wave.open(filename, "wb") as wav_file:
+        wav_file.setnchannels(total_channels)
+        wav_file.setsampwidth(2)
+        wav_file.setframerate(rate)
+        wav_file.writeframes(merged.tobytes())
+    print(f"WAV file '{filename}' saved successfully, {total_channels} tracks, {length / rate:.1f}s")
+
+
+def print_report(report):
+    print(f"{'stage':<18}{'count':>8}{'p50(us)':>10}{'p95(us)':>10}{'p99(us)':>10}")
+    for stage, stats in report.items():
+        print(f"{stage:<18}{stats['count']:>8}{stats['p50']:>10}{stats['p95']:>10}{stats['p99']:>10}")
+
+
+def main(port, samplerate, output):
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server_socket.bind(('0.0.0.0', port))
+    tracks = {}
+
+    print(f"Start receiving audio taps on 0.0.0.0:{port}...")
 
     try:
         while True:
-            # Receive a message from the client
-            message, address = server_socket.recvfrom(8000)
-            
-            # Write PCM data to WAV file
-            wav_file.writeframes(message)
-
-            # Print length of the message
-            print(f"Received {len(message)} bytes from {address}")
-    
+            message, address = server_socket.recvfrom(2048)
+
+            # Latency report from the device, not audio data
+            if message.startswith(REPORT_MAGIC):
+                print_report(json.loads(message[len(REPORT_MAGIC):]))
+                continue
+
+            if len(message) < HEADER.size or not message.startswith(TAP_MAGIC):
+                print(f"Ignored {len(message)} bytes from {address}, not an audio tap datagram")
+                continue
+
+            magic, version, stage, channels, _, sequence, sample_rate, frames, timestamp_us = HEADER.unpack_from(message)
+            samples = array.array('h')
+            samples.frombytes(message[HEADER.size:HEADER.size + frames * channels * 2])
+            track = tracks.setdefault(stage, StageTrack(stage))
+            lost = track.lost
+            track.add(sequence, sample_rate, channels, timestamp_us, samples)
+            if track.lost != lost:
+                print(f"Stage {stage}: lost {track.lost - lost} datagram(s) before #{sequence}")
+
     except KeyboardInterrupt:
         print("\nStopping recording...")
-    
+
     finally:
-        # Close files and socket
-        wav_file.close()
         server_socket.close()
-        print(f"WAV file '{filename}' saved successfully")
+        for stage, track in sorted(tracks.items()):
+            print(f"Stage {stage}: {track.received} datagrams, {track.lost} lost")
+        save_wav([tracks[s] for s in sorted(tracks)], output, samplerate)
 
 
 if __name__ == "__main__":
-    parser = argparse.ArgumentParser(description='UDP音频数据接收器，保存为WAV文件')
-    parser.add_argument('--samplerate', '-s', type=int, default=16000, 
-                        help='采样率 (默认: 16000)')
-    parser.add_argument('--channels', '-c', type=int, default=2, 
-                        help='声道数 (默认: 2)')
-    
+    parser = argparse.ArgumentParser(description='UDP音频抓取接收器，按时间戳对齐各阶段并保存为多轨WAV文件')
+    parser.add_argument('--port', '-p', type=int, default=8000,
+                        help='UDP端口 (默认: 8000)')
+    parser.add_argument('--samplerate', '-s', type=int, default=16000,
+                        help='输出WAV采样率 (默认: 16000)')
+    parser.add_argument('--output', '-o', type=str, default='audio_tap.wav',
+                        help='输出文件名 (默认: audio_tap.wav)')
+
     args = parser.parse_args()
-    main(args.samplerate, args.channels)
+    main(args.port, args.samplerate, args.output)
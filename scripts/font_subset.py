@@ -0,0 +1,128 @@
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+
+'''
+  Generate an LVGL text font that only has the characters one language needs: the strings of
+  main/assets/locales/<language>/language.json (and the en-US fallback), printable ASCII and
+  one or more common-character lists. Called by main/CMakeLists.txt when CONFIG_USE_FONT_SUBSET
+  is set, the font is converted with lv_font_conv (npm install -g lv_font_conv).
+
+    python font_subset.py --language zh-CN --font AlibabaPuHuiTi.ttf --size 14 --bpp 1 \\
+        --common gb2312-1 --name font_text_subset --output font_text_subset.c
+    python font_subset.py --language zh-CN --common gb2312-1 --list
+
+  Common-character lists: gb2312-1 (the 3755 level 1 Hanzi), big5-1 (the 5401 common
+  traditional characters), latin (Latin-1 and Latin Extended-A), cyrillic, or the path of a
+  UTF-8 text file whose characters are all taken. CJK and full width punctuation always come
+  with the CJK lists.
+'''
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+LOCALES_DIR = os.path.join(PROJECT_DIR, 'main', 'assets', 'locales')
+
+CJK_PUNCTUATION = set(chr(c) for c in range(0x3000, 0x3040)) | set(chr(c) for c in range(0xFF01, 0xFF5F))
+
+
+def double_byte_charset(encoding, first_bytes, second_bytes):
+    chars = set()
+    for first in first_bytes:
+        for second in second_bytes:
+            try:
+                chars.add(bytes([first, second]).decode(encoding))
+            except UnicodeDecodeError:
+                pass
+    return chars
+
+
+def common_charset(name):
+    if name == 'gb2312-1':
+        return double_byte_charset('gb2312', range(0xB0, 0xD8), range(0xA1, 0xFF)) | CJK_PUNCTUATION
+    if name == 'big5-1':
+        return double_byte_charset('big5', range(0xA4, 0xC7), list(range(0x40, 0x7F)) + list(range(0xA1, 0xFF))) | CJK_PUNCTUATION
+    if name == 'latin':
+        return set(chr(c) for c in range(0xA0, 0x180))
+    if name == 'cyrillic':
+        return set(chr(c) for c in range(0x400, 0x460))
+    if os.path.isfile(name):
+        with open(name, encoding='utf-8') as f:
+            return set(f.read()) - set('\r\n\t')
+    raise ValueError('unknown common-character list %s' % name)
+
+
+def language_charset(language):
+    chars = set()
+    for code in ('en-US', language):
+        path = os.path.join(LOCALES_DIR, code, 'language.json')
+        with open(path, encoding='utf-8') as f:
+            data = json.load(f)
+        for value in data.get('strings', {}).values():
+            chars.update(value)
+    return chars
+
+
+def collect(language, common):
+    chars = set(chr(c) for c in range(0x20, 0x7F)) | language_charset(language)
+    for name in common.split(','):
+        name = name.strip()
+        if name and name != 'none':
+            chars |= common_charset(name)
+    # Control characters and the private use area (icon fonts) are never drawn from the text font
+    return sorted(c for c in chars if ord(c) >= 0x20 and not 0xE000 <= ord(c) <= 0xF8FF)
+
+
+def convert(args, chars):
+    lv_font_conv = shutil.which('lv_font_conv')
+    command = [lv_font_conv] if lv_font_conv else ['npx', '--yes', 'lv_font_conv']
+    command += ['--font', args.font, '--symbols', ''.join(chars),
+                '--size', str(args.size), '--bpp', str(args.bpp),
+                '--format', 'lvgl', '--lv-font-name', args.name, '-o', args.output]
+    if not args.compress:
+        # LVGL only decodes compressed fonts with LV_USE_FONT_COMPRESSED
+        command.append('--no-compress')
+    subprocess.run(command, check=True)
+
+    # Include lvgl.h the way the rest of the tree does
+    with open(args.output, encoding='utf-8') as f:
+        source = f.read()
+    source = re.sub(r'#ifdef LV_LVGL_H_INCLUDE_SIMPLE\n.*?#endif\n', '#include <lvgl.h>\n', source, count=1, flags=re.S)
+    with open(args.output, 'w', encoding='utf-8') as f:
+        f.write(source)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate an LVGL font subset for one language')
+    parser.add_argument('--language', required=True, help='directory in main/assets/locales, e.g. zh-CN')
+    parser.add_argument('--common', default='none', help='comma separated common-character lists')
+    parser.add_argument('--font', help='TTF / OTF font file')
+    parser.add_argument('--size', type=int, default=14)
+    parser.add_argument('--bpp', type=int, default=1, choices=[1, 2, 3, 4, 8])
+    parser.add_argument('--compress', action='store_true', help='RLE compress the glyph bitmaps')
+    parser.add_argument('--name', default='font_text_subset', help='name of the lv_font_t')
+    parser.add_argument('--output', help='C file to write')
+    parser.add_argument('--list', action='store_true', help='print the characters instead of converting')
+    args = parser.parse_args()
+
+    chars = collect(args.language, args.common)
+    non_ascii = sum(1 for c in chars if ord(c) > 0x7F)
+    if args.list:
+        print(''.join(chars))
+        print('%d characters, %d outside ASCII' % (len(chars), non_ascii), file=sys.stderr)
+        return
+    if not args.font or not args.output:
+        parser.error('--font and --output are required to convert')
+    if not os.path.isfile(args.font):
+        parser.error('font file %s not found, set CONFIG_FONT_SUBSET_TTF' % args.font)
+
+    convert(args, chars)
+    print('%s: %d characters (%d outside ASCII), %d bytes of C source' %
+          (args.output, len(chars), non_ascii, os.path.getsize(args.output)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,190 @@
+import argparse
+import json
+import random
+import struct
+import sys
+
+
+'''
+  Mutate a capture of server messages (scripts/mock_server.py --capture) into a fuzz capture for
+  self.diagnostics.replay_capture, which runs every record through the device's parsers and
+  reports the rejected records, the slowest record and the most heap one message held.
+
+    python fuzz_capture.py session.bin fuzz.bin --mutants 20 --seed 1
+    python fuzz_capture.py --list fuzz.bin
+
+  The same seed always gives the same capture, so a slow or crashing record can be found again
+  by its index. Besides the random mutations every output has a fixed set of edge cases: deep
+  nesting, oversized messages, wrong value types and frames shorter than their header.
+'''
+
+CAPTURE_HEADER = b'XZCP' + bytes([1, 0, 0, 0])
+RECORD = struct.Struct('<BBHII')
+
+CAPTURE_JSON = 1
+CAPTURE_BINARY = 2
+CAPTURE_UDP = 3
+CAPTURE_UDP_KEY = 4
+KIND_NAMES = {CAPTURE_JSON: 'json', CAPTURE_BINARY: 'binary', CAPTURE_UDP: 'udp', CAPTURE_UDP_KEY: 'udp_key'}
+
+# Same limits as main/protocols/protocol.h
+MAX_JSON_SIZE = 32 * 1024
+MAX_JSON_DEPTH = 16
+
+
+def read_capture(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:5] != CAPTURE_HEADER[:5]:
+        raise ValueError('%s is not a capture' % path)
+    records = []
+    offset = len(CAPTURE_HEADER)
+    while offset + RECORD.size <= len(data):
+        kind, version, _, time_ms, length = RECORD.unpack_from(data, offset)
+        offset += RECORD.size
+        records.append((kind, version, time_ms, data[offset:offset + length]))
+        offset += length
+    return records
+
+
+def write_capture(path, records):
+    with open(path, 'wb') as f:
+        f.write(CAPTURE_HEADER)
+        for kind, version, time_ms, data in records:
+            f.write(RECORD.pack(kind, version, 0, time_ms, len(data)) + data)
+
+
+def mutate_bytes(rng, data):
+    data = bytearray(data)
+    choice = rng.randrange(5)
+    if choice == 0 and data:
+        for _ in range(rng.randint(1, 8)):
+            data[rng.randrange(len(data))] ^= 1 << rng.randrange(8)
+    elif choice == 1 and data:
+        del data[rng.randrange(len(data)):]
+    elif choice == 2:
+        data += bytes(rng.randrange(256) for _ in range(rng.randint(1, 64)))
+    elif choice == 3 and len(data) > 1:
+        start = rng.randrange(len(data))
+        data[start:start] = data[start:start + rng.randint(1, 32)] * rng.randint(2, 16)
+    elif data:
+        data[rng.randrange(len(data))] = rng.choice(b'{}[]",:\\\0')
+    return bytes(data)
+
+
+def mutate_value(rng, value):
+    candidates = [None, True, 0, -1, 2 ** 63, 1e308, '', 'x' * rng.randint(1, 4096), [], {}, [value], {'v': value}]
+    return rng.choice(candidates)
+
+
+def mutate_json(rng, data):
+    try:
+        message = json.loads(data)
+    except ValueError:
+        return mutate_bytes(rng, data)
+    if not isinstance(message, dict) or rng.random() < 0.2:
+        return mutate_bytes(rng, data)
+
+    # Change one value anywhere in the message, or drop a key
+    path = []
+    node = message
+    while isinstance(node, dict) and node and rng.random() < 0.6:
+        key = rng.choice(list(node))
+        path.append((node, key))
+        node = node[key]
+    if not path:
+        key = rng.choice(list(message)) if message else 'type'
+        path.append((message, key))
+    parent, key = path[-1]
+    if rng.random() < 0.3:
+        parent.pop(key, None)
+    else:
+        parent[key] = mutate_value(rng, parent.get(key))
+    return json.dumps(message).encode()
+
+
+def mutate_header_length(rng, kind, version, data):
+    '''Make the payload size in the frame header disagree with the frame'''
+    data = bytearray(data)
+    if kind == CAPTURE_BINARY and version == 2 and len(data) >= 16:
+        struct.pack_into('>I', data, 12, rng.choice([0, len(data), 0xFFFFFFFF, rng.getrandbits(32)]))
+    elif kind == CAPTURE_BINARY and version == 3 and len(data) >= 4:
+        struct.pack_into('>H', data, 2, rng.choice([0, len(data), 0xFFFF, rng.getrandbits(16)]))
+    elif kind == CAPTURE_UDP and len(data) >= 16:
+        struct.pack_into('>H', data, 2, rng.choice([0, 0xFFFF, rng.getrandbits(16)]))
+        if rng.random() < 0.5:
+            data[0] = rng.randrange(256)
+    return bytes(data)
+
+
+def edge_cases(binary_version):
+    deep = b'{"type":"mcp","payload":' + b'[' * 5000 + b']' * 5000 + b'}'
+    nested = b'{"type":"tts","state":' + b'{"a":' * MAX_JSON_DEPTH + b'1' + b'}' * MAX_JSON_DEPTH + b'}'
+    quoted = b'{"type":"stt","text":"' + b'[{' * 5000 + b'"}'
+    big = json.dumps({'type': 'stt', 'text': 'x' * MAX_JSON_SIZE}).encode()
+    wide = json.dumps({'type': 'custom', 'payload': {str(i): i for i in range(3000)}}).encode()
+    cases = [
+        (CAPTURE_JSON, deep),
+        (CAPTURE_JSON, nested),
+        (CAPTURE_JSON, quoted),
+        (CAPTURE_JSON, big),
+        (CAPTURE_JSON, wide[:MAX_JSON_SIZE - 1]),
+        (CAPTURE_JSON, b''),
+        (CAPTURE_JSON, b'{"type":1}'),
+        (CAPTURE_JSON, b'{"type":"tts","state":null}'),
+        (CAPTURE_JSON, b'{"type":"hello","transport":5,"udp":{"server":1,"key":"00"}}'),
+        (CAPTURE_JSON, b'{"type":"mcp","payload":{"jsonrpc":"2.0","method":"\\"}","id":1}}'),
+        (CAPTURE_BINARY, b''),
+        (CAPTURE_BINARY, b'\x00\x02'),
+        (CAPTURE_BINARY, struct.pack('>HHIII', 2, 0, 0, 0, 0xFFFFFFFF)),
+        (CAPTURE_BINARY, struct.pack('>BBH', 0, 0, 0xFFFF)),
+        (CAPTURE_UDP, b'\x01' * 15),
+        (CAPTURE_UDP, b'\x02' + bytes(15)),
+        (CAPTURE_UDP, b'\x01' + bytes(15) + bytes(1400)),
+    ]
+    return [(kind, binary_version, 0, data) for kind, data in cases]
+
+
+def fuzz(records, mutants, seed):
+    rng = random.Random(seed)
+    binary_version = next((r[1] for r in records if r[0] == CAPTURE_BINARY), 3)
+    output = edge_cases(binary_version)
+    for kind, version, time_ms, data in records:
+        output.append((kind, version, time_ms, data))
+        if kind == CAPTURE_UDP_KEY:
+            continue
+        for _ in range(mutants):
+            if kind == CAPTURE_JSON:
+                mutant = mutate_json(rng, data)
+            elif rng.random() < 0.5:
+                mutant = mutate_header_length(rng, kind, version, data)
+            else:
+                mutant = mutate_bytes(rng, data)
+            output.append((kind, version, time_ms, mutant))
+    return output
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mutate a capture of server messages into a fuzz capture')
+    parser.add_argument('input')
+    parser.add_argument('output', nargs='?')
+    parser.add_argument('--mutants', type=int, default=10, help='mutants per record')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--list', action='store_true', help='print the records of the input')
+    args = parser.parse_args()
+
+    records = read_capture(args.input)
+    if args.list:
+        for i, (kind, version, time_ms, data) in enumerate(records):
+            print('%6d %8d ms %-7s v%d %6d bytes %r' % (i, time_ms, KIND_NAMES.get(kind, kind), version, len(data),
+                                                       data[:60]))
+        return
+    if not args.output:
+        parser.error('the output capture is required')
+    output = fuzz(records, args.mutants, args.seed)
+    write_capture(args.output, output)
+    print('Wrote %d records (%d from the input) to %s' % (len(output), len(records), args.output))
+
+
+if __name__ == '__main__':
+    sys.exit(main())
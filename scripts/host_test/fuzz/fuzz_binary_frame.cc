@@ -0,0 +1,18 @@
+// Websocket binary frames: the first byte picks the protocol version, the rest is the frame
+#include "protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 1) {
+        return 0;
+    }
+    int version = data[0] % 4;
+    AudioStreamPacket packet;
+    if (Protocol::ParseBinaryFrame(version, data + 1, size - 1, packet) && packet.payload.size() > size - 1) {
+        abort();
+    }
+    return 0;
+}
@@ -0,0 +1,43 @@
+// Corpus replay for compilers without libFuzzer: runs every file given, directories recursively.
+// Options starting with '-' are libFuzzer flags and ignored, so ctest uses one command for both.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static int RunFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    // A copy of the exact size, so reading past the input is caught by AddressSanitizer
+    auto buffer = new uint8_t[data.size()];
+    std::copy(data.begin(), data.end(), buffer);
+    LLVMFuzzerTestOneInput(buffer, data.size());
+    delete[] buffer;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    int runs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            continue;
+        }
+        std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path)) {
+            for (auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+                if (entry.is_regular_file()) {
+                    runs += RunFile(entry.path());
+                }
+            }
+        } else {
+            runs += RunFile(path);
+        }
+    }
+    printf("%d inputs\n", runs);
+    return runs > 0 ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+// Server text messages: Protocol::ParseJson and the "type" lookup every handler starts with
+#include "protocol.h"
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    auto root = Protocol::ParseJson((const char*)data, size);
+    if (root != nullptr) {
+        auto type = cJSON_GetObjectItem(root, "type");
+        if (cJSON_IsString(type)) {
+            cJSON_GetObjectItem(root, "state");
+        }
+        cJSON_Delete(root);
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+// Encrypted UDP audio packets of the MQTT protocol, with a fixed session key
+#include "udp_audio_packet.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static const uint8_t key[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+        0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff};
+    static mbedtls_aes_context aes;
+    static bool initialized = false;
+    if (!initialized) {
+        mbedtls_aes_init(&aes);
+        mbedtls_aes_setkey_enc(&aes, key, 128);
+        initialized = true;
+    }
+
+    AudioStreamPacket packet;
+    uint32_t sequence;
+    if (DecodeUdpAudioPacket(aes, data, size, packet, sequence) &&
+        packet.payload.size() != size - UDP_AUDIO_HEADER_SIZE) {
+        abort();
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+// Host shim of esp_log.h: errors and warnings go to stderr, HOST_TEST_VERBOSE=1 adds the rest
+#ifndef HOST_SHIM_ESP_LOG_H
+#define HOST_SHIM_ESP_LOG_H
+
+#include <cstdio>
+
+bool HostLogEnabled(char level);
+
+#define HOST_LOG(level, tag, format, ...) \
+    do { if (HostLogEnabled(level)) fprintf(stderr, "%c (%s) " format "\n", level, tag, ##__VA_ARGS__); } while (0)
+#define ESP_LOGE(tag, format, ...) HOST_LOG('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG('V', tag, format, ##__VA_ARGS__)
+
+#endif // HOST_SHIM_ESP_LOG_H
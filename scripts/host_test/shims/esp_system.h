@@ -0,0 +1,11 @@
+// Host shim of esp_system.h: shutdown handlers are kept but never run, there is no esp_restart
+#ifndef HOST_SHIM_ESP_SYSTEM_H
+#define HOST_SHIM_ESP_SYSTEM_H
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+
+#endif // HOST_SHIM_ESP_SYSTEM_H
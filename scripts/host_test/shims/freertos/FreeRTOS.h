@@ -0,0 +1,27 @@
+// Host shim of the FreeRTOS kernel on std::thread, covering what the tested sources use.
+// Ticks are milliseconds, priorities and stack sizes are ignored.
+#ifndef HOST_SHIM_FREERTOS_H
+#define HOST_SHIM_FREERTOS_H
+
+#include <cstdint>
+#include <cstddef>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configMAX_TASK_NAME_LEN 16
+#define configRUN_TIME_COUNTER_TYPE uint32_t
+#ifndef CONFIG_FREERTOS_NUMBER_OF_CORES
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+#endif
+
+#endif // HOST_SHIM_FREERTOS_H
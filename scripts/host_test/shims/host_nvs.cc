@@ -0,0 +1,341 @@
+// Host implementation of the NVS shim: one partition in memory, written to a text file on commit
+#include "nvs.h"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct nvs_opaque_iterator_t {
+    std::vector<nvs_entry_info_t> entries;
+    size_t index = 0;
+};
+
+namespace {
+
+struct NvsEntry {
+    nvs_type_t type;
+    int64_t int_value = 0;
+    std::string string_value;
+};
+
+typedef std::map<std::string, std::map<std::string, NvsEntry>> NvsPartition;
+
+class HostNvs {
+public:
+    static HostNvs& GetInstance() {
+        static HostNvs instance;
+        return instance;
+    }
+
+    std::mutex mutex;
+    NvsPartition partition;
+    std::string path;
+    std::map<nvs_handle_t, std::pair<std::string, bool>> handles;     // namespace, writable
+    nvs_handle_t next_handle = 1;
+
+    // One line per entry: namespace, key, type and value separated by tabs, strings escaped
+    void Load() {
+        partition.clear();
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            std::string ns, key, type, value;
+            if (!std::getline(fields, ns, '\t') || !std::getline(fields, key, '\t') ||
+                !std::getline(fields, type, '\t')) {
+                continue;
+            }
+            std::getline(fields, value);
+            NvsEntry entry;
+            entry.type = (nvs_type_t)std::stoi(type);
+            if (entry.type == NVS_TYPE_STR) {
+                entry.string_value = Unescape(value);
+            } else {
+                entry.int_value = std::stoll(value);
+            }
+            partition[ns][key] = entry;
+        }
+    }
+
+    void Save() {
+        if (path.empty()) {
+            return;
+        }
+        std::ofstream file(path, std::ios::trunc);
+        for (auto& [ns, entries] : partition) {
+            for (auto& [key, entry] : entries) {
+                file << ns << '\t' << key << '\t' << (int)entry.type << '\t';
+                if (entry.type == NVS_TYPE_STR) {
+                    file << Escape(entry.string_value);
+                } else {
+                    file << entry.int_value;
+                }
+                file << '\n';
+            }
+        }
+    }
+
+    // Caller holds mutex
+    esp_err_t Find(nvs_handle_t handle, bool write, std::map<std::string, NvsEntry>** entries) {
+        auto it = handles.find(handle);
+        if (it == handles.end()) {
+            return ESP_ERR_NVS_INVALID_HANDLE;
+        }
+        if (write && !it->second.second) {
+            return ESP_ERR_NVS_READ_ONLY;
+        }
+        *entries = &partition[it->second.first];
+        return ESP_OK;
+    }
+
+private:
+    static std::string Escape(const std::string& value) {
+        std::string result;
+        for (char c : value) {
+            if (c == '\\') {
+                result += "\\\\";
+            } else if (c == '\t') {
+                result += "\\t";
+            } else if (c == '\n') {
+                result += "\\n";
+            } else {
+                result += c;
+            }
+        }
+        return result;
+    }
+
+    static std::string Unescape(const std::string& value) {
+        std::string result;
+        for (size_t i = 0; i < value.size(); i++) {
+            if (value[i] == '\\' && i + 1 < value.size()) {
+                char c = value[++i];
+                result += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+            } else {
+                result += value[i];
+            }
+        }
+        return result;
+    }
+};
+
+bool IsValidName(const char* name) {
+    return name != nullptr && name[0] != '\0' && strlen(name) < NVS_KEY_NAME_MAX_SIZE;
+}
+
+esp_err_t SetEntry(nvs_handle_t handle, const char* key, const NvsEntry& entry) {
+    if (!IsValidName(key)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    std::map<std::string, NvsEntry>* entries;
+    esp_err_t err = nvs.Find(handle, true, &entries);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto it = entries->find(key);
+    if (it != entries->end() && it->second.type != entry.type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    (*entries)[key] = entry;
+    return ESP_OK;
+}
+
+esp_err_t GetEntry(nvs_handle_t handle, const char* key, nvs_type_t type, NvsEntry& entry) {
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    std::map<std::string, NvsEntry>* entries;
+    esp_err_t err = nvs.Find(handle, false, &entries);
+    if (err != ESP_OK) {
+        return err;
+    }
+    auto it = entries->find(key);
+    if (it == entries->end() || it->second.type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    entry = it->second;
+    return ESP_OK;
+}
+
+} // namespace
+
+esp_err_t nvs_open(const char* namespace_name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    if (!IsValidName(namespace_name)) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    if (open_mode == NVS_READONLY && nvs.partition.count(namespace_name) == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (open_mode == NVS_READWRITE) {
+        nvs.partition[namespace_name];
+    }
+    *out_handle = nvs.next_handle++;
+    nvs.handles[*out_handle] = { namespace_name, open_mode == NVS_READWRITE };
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    nvs.handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    std::map<std::string, NvsEntry>* entries;
+    esp_err_t err = nvs.Find(handle, false, &entries);
+    if (err == ESP_OK) {
+        nvs.Save();
+    }
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    std::map<std::string, NvsEntry>* entries;
+    esp_err_t err = nvs.Find(handle, true, &entries);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return entries->erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    std::map<std::string, NvsEntry>* entries;
+    esp_err_t err = nvs.Find(handle, true, &entries);
+    if (err == ESP_OK) {
+        entries->clear();
+    }
+    return err;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    return SetEntry(handle, key, { NVS_TYPE_I32, value, {} });
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return SetEntry(handle, key, { NVS_TYPE_U8, value, {} });
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return SetEntry(handle, key, { NVS_TYPE_STR, 0, value });
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    NvsEntry entry;
+    esp_err_t err = GetEntry(handle, key, NVS_TYPE_I32, entry);
+    if (err == ESP_OK) {
+        *out_value = (int32_t)entry.int_value;
+    }
+    return err;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* out_value) {
+    NvsEntry entry;
+    esp_err_t err = GetEntry(handle, key, NVS_TYPE_U8, entry);
+    if (err == ESP_OK) {
+        *out_value = (uint8_t)entry.int_value;
+    }
+    return err;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    NvsEntry entry;
+    esp_err_t err = GetEntry(handle, key, NVS_TYPE_STR, entry);
+    if (err != ESP_OK) {
+        return err;
+    }
+    size_t needed = entry.string_value.size() + 1;
+    if (out_value == nullptr) {
+        *length = needed;
+        return ESP_OK;
+    }
+    if (*length < needed) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, entry.string_value.c_str(), needed);
+    *length = needed;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_find(const char* part_name, const char* namespace_name, nvs_type_t type, nvs_iterator_t* output_iterator) {
+    *output_iterator = nullptr;
+    if (part_name == nullptr || strcmp(part_name, NVS_DEFAULT_PART_NAME) != 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    auto iterator = new nvs_opaque_iterator_t;
+    for (auto& [ns, entries] : nvs.partition) {
+        if (namespace_name != nullptr && ns != namespace_name) {
+            continue;
+        }
+        for (auto& [key, entry] : entries) {
+            if (type != NVS_TYPE_ANY && entry.type != type) {
+                continue;
+            }
+            nvs_entry_info_t info = {};
+            strncpy(info.namespace_name, ns.c_str(), sizeof(info.namespace_name) - 1);
+            strncpy(info.key, key.c_str(), sizeof(info.key) - 1);
+            info.type = entry.type;
+            iterator->entries.push_back(info);
+        }
+    }
+    if (iterator->entries.empty()) {
+        delete iterator;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *output_iterator = iterator;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t* iterator) {
+    if (iterator == nullptr || *iterator == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (++(*iterator)->index >= (*iterator)->entries.size()) {
+        delete *iterator;
+        *iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_info(const nvs_iterator_t iterator, nvs_entry_info_t* out_info) {
+    if (iterator == nullptr || out_info == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_info = iterator->entries[iterator->index];
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    delete iterator;
+}
+
+void HostNvsSetFile(const char* path) {
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    nvs.path = path != nullptr ? path : "";
+    if (!nvs.path.empty()) {
+        nvs.Load();
+    }
+}
+
+void HostNvsErase() {
+    auto& nvs = HostNvs::GetInstance();
+    std::lock_guard<std::mutex> lock(nvs.mutex);
+    nvs.partition.clear();
+    nvs.Save();
+}
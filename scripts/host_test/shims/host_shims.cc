@@ -0,0 +1,381 @@
+// Host implementation of the FreeRTOS, esp_timer, esp_system and esp_log shims
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+bool HostLogEnabled(char level) {
+    static const bool verbose = getenv("HOST_TEST_VERBOSE") != nullptr;
+    return verbose || level == 'E' || level == 'W';
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    static thread_local char name[16];
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    default:
+        snprintf(name, sizeof(name), "0x%x", code);
+        return name;
+    }
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    return handler != nullptr ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+static const auto kStartTime = std::chrono::steady_clock::now();
+
+static std::atomic<int64_t> time_offset_us{0};
+
+int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - kStartTime).count() +
+        time_offset_us.load();
+}
+
+void HostTimerAdvance(int64_t us) {
+    time_offset_us += us;
+}
+
+static std::atomic<size_t> heap_free_size{0};
+static std::atomic<size_t> heap_minimum_free_size{0};
+static std::atomic<size_t> heap_largest_free_block{0};
+
+size_t heap_caps_get_free_size(uint32_t) {
+    return heap_free_size;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t) {
+    return heap_minimum_free_size;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t) {
+    return heap_largest_free_block;
+}
+
+void HostHeapSetSizes(size_t free_size, size_t largest_free_block) {
+    heap_free_size = free_size;
+    heap_largest_free_block = largest_free_block;
+    size_t minimum = heap_minimum_free_size;
+    if (minimum == 0 || free_size < minimum) {
+        heap_minimum_free_size = free_size;
+    }
+}
+
+// Waits for the condition with a FreeRTOS timeout, false on timeout
+template <typename Predicate>
+static bool WaitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate predicate) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, predicate);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), predicate);
+}
+
+/* Queues */
+
+struct HostQueue {
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<uint8_t>> items;
+    size_t length;
+    size_t item_size;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    auto queue = new HostQueue;
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!WaitFor(queue->changed, lock, ticks_to_wait, [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFAIL;
+    }
+    auto data = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(data, data + (data != nullptr ? queue->item_size : 0));
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!WaitFor(queue->changed, lock, ticks_to_wait, [queue]() { return !queue->items.empty(); })) {
+        return pdFAIL;
+    }
+    if (item != nullptr && queue->item_size > 0) {
+        memcpy(item, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+/* Tasks */
+
+struct HostTask {
+    TaskFunction_t function;
+    void* arg;
+};
+
+static thread_local HostTask* current_task = nullptr;
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+    UBaseType_t priority, TaskHandle_t* handle) {
+    auto task = new HostTask{function, arg};
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    std::thread([task]() {
+        // Returning is the end of the task, like vTaskDelete(NULL) on the device
+        std::unique_ptr<HostTask> owner(task);
+        current_task = task;
+        task->function(task->arg);
+    }).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+    UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    return xTaskCreate(function, name, stack_size, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    // The thread owns its handle and releases it when the task function returns
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    // Threads not created by xTaskCreate (the test main) get a handle of their own
+    static thread_local HostTask own_task{nullptr, nullptr};
+    if (current_task == nullptr) {
+        current_task = &own_task;
+    }
+    return current_task;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task) {
+    return 1;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+    return 0;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* status, UBaseType_t size, configRUN_TIME_COUNTER_TYPE* total_run_time) {
+    if (total_run_time != nullptr) {
+        *total_run_time = 0;
+    }
+    return 0;
+}
+
+/* Event groups */
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable changed;
+    EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto satisfied = [group, bits, wait_for_all]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    WaitFor(group->changed, lock, ticks_to_wait, satisfied);
+    EventBits_t result = group->bits;
+    if (satisfied() && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
+
+/* esp_timer */
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    int64_t expiry_us = 0;
+    uint64_t period_us = 0;
+    bool active = false;
+};
+
+namespace {
+
+// All timers share one dispatcher thread, callbacks run without the lock held
+class TimerDispatcher {
+public:
+    // Never destroyed, the detached thread may still wait on it while the process exits
+    static TimerDispatcher& GetInstance() {
+        static TimerDispatcher* instance = new TimerDispatcher();
+        return *instance;
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::list<esp_timer*> timers;
+    esp_timer* running = nullptr;
+
+private:
+    TimerDispatcher() {
+        std::thread([this]() { Run(); }).detach();
+    }
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            esp_timer* next = nullptr;
+            for (auto timer : timers) {
+                if (timer->active && (next == nullptr || timer->expiry_us < next->expiry_us)) {
+                    next = timer;
+                }
+            }
+            if (next == nullptr) {
+                changed.wait(lock);
+                continue;
+            }
+            int64_t now = esp_timer_get_time();
+            if (next->expiry_us > now) {
+                changed.wait_for(lock, std::chrono::microseconds(next->expiry_us - now));
+                continue;
+            }
+            if (next->period_us > 0) {
+                next->expiry_us += next->period_us;
+            } else {
+                next->active = false;
+            }
+            running = next;
+            lock.unlock();
+            next->callback(next->arg);
+            lock.lock();
+            running = nullptr;
+            changed.notify_all();
+        }
+    }
+};
+
+} // namespace
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    auto timer = new esp_timer;
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+    dispatcher.timers.push_back(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t StartTimer(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->expiry_us = esp_timer_get_time() + timeout_us;
+    timer->period_us = period_us;
+    timer->active = true;
+    dispatcher.changed.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return StartTimer(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period) {
+    return StartTimer(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    dispatcher.changed.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::unique_lock<std::mutex> lock(dispatcher.mutex);
+    dispatcher.changed.wait(lock, [&]() { return dispatcher.running != timer; });
+    dispatcher.timers.remove(timer);
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    auto& dispatcher = TimerDispatcher::GetInstance();
+    std::lock_guard<std::mutex> lock(dispatcher.mutex);
+    return timer->active;
+}
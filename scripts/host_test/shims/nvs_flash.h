@@ -0,0 +1,10 @@
+// Host shim of nvs_flash.h, the partition needs no init on the host
+#ifndef HOST_SHIM_NVS_FLASH_H
+#define HOST_SHIM_NVS_FLASH_H
+
+#include "nvs.h"
+
+inline esp_err_t nvs_flash_init() { return ESP_OK; }
+inline esp_err_t nvs_flash_erase() { HostNvsErase(); return ESP_OK; }
+
+#endif // HOST_SHIM_NVS_FLASH_H
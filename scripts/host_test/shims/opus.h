@@ -0,0 +1,9 @@
+// Host shim of opus.h: only the declarations opus_uplink_encoder.h needs, there is no codec
+#ifndef HOST_SHIM_OPUS_H
+#define HOST_SHIM_OPUS_H
+
+#define OPUS_AUTO -1000
+
+typedef struct OpusEncoder OpusEncoder;
+
+#endif // HOST_SHIM_OPUS_H
@@ -0,0 +1,47 @@
+#include "host_test.h"
+#include "audio_feed_clock.h"
+
+TEST(OutputIsTimedFromTheFeedOfItsLastSample) {
+    AudioFeedClock clock;
+    // AFE feed chunks of 512 samples, 60 ms output frames of 960 samples
+    for (int i = 1; i <= 4; i++) {
+        clock.OnFeed(512, i * 1000);
+    }
+    CHECK_EQ(clock.OnOutput(960), 2000);     // samples 0..959, the last one in the second chunk
+    CHECK_EQ(clock.OnOutput(960), 4000);     // samples 960..1919, the last one in the fourth chunk
+    CHECK_EQ(clock.OnOutput(960), 0);        // not fed yet
+}
+
+TEST(AnOutputFrameOnAChunkBoundary) {
+    AudioFeedClock clock;
+    clock.OnFeed(480, 10);
+    clock.OnFeed(480, 20);
+    CHECK_EQ(clock.OnOutput(480), 10);
+    CHECK_EQ(clock.OnOutput(480), 20);
+}
+
+TEST(FullRingLeavesTheDroppedFramesUntimed) {
+    AudioFeedClock clock;
+    for (int i = 1; i <= AUDIO_FEED_CLOCK_SIZE + 2; i++) {
+        clock.OnFeed(100, i);
+    }
+    for (int i = 1; i <= AUDIO_FEED_CLOCK_SIZE; i++) {
+        CHECK_EQ(clock.OnOutput(100), i);
+    }
+    CHECK_EQ(clock.OnOutput(100), 0);
+    CHECK_EQ(clock.OnOutput(100), 0);
+    // Room again, the counts stay aligned
+    clock.OnFeed(100, 99);
+    CHECK_EQ(clock.OnOutput(100), 99);
+}
+
+TEST(ResetRestartsTheCount) {
+    AudioFeedClock clock;
+    clock.OnFeed(512, 1);
+    clock.OnFeed(512, 2);
+    CHECK_EQ(clock.OnOutput(256), 1);
+    // Stop dropped what the processor still held
+    clock.Reset();
+    clock.OnFeed(512, 3);
+    CHECK_EQ(clock.OnOutput(512), 3);
+}
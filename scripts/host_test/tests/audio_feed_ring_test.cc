@@ -0,0 +1,102 @@
+#include "host_test.h"
+#include "audio_feed_ring.h"
+
+#include <thread>
+#include <vector>
+
+TEST(CapacityIsRoundedUpToAPowerOfTwo) {
+    AudioFeedRing ring;
+    CHECK(!ring.allocated());
+    CHECK(ring.Allocate(1000));
+    CHECK(ring.allocated());
+    CHECK_EQ(ring.capacity(), 1024u);
+    CHECK_EQ(ring.available(), 0u);
+}
+
+TEST(PushShiftsAndSaturates) {
+    AudioFeedRing ring;
+    ring.Allocate(8);
+    const int32_t slots[] = {0x10000, -0x10000, 0x7FFFFFFF, (int32_t)0x80000000, 0x12345678};
+    CHECK_EQ(ring.PushInt32(slots, 5, 12), 5u);
+    int16_t out[5];
+    CHECK_EQ(ring.Pop(out, 5), 5u);
+    CHECK_EQ(out[0], 16);
+    CHECK_EQ(out[1], -16);
+    CHECK_EQ(out[2], INT16_MAX);
+    CHECK_EQ(out[3], -INT16_MAX);
+    CHECK_EQ(out[4], INT16_MAX);
+}
+
+TEST(OverflowDropsTheNewestSamples) {
+    AudioFeedRing ring;
+    ring.Allocate(4);
+    const int32_t slots[] = {1, 2, 3, 4, 5, 6};
+    CHECK_EQ(ring.PushInt32(slots, 6, 0), 4u);
+    CHECK_EQ(ring.PushInt32(slots, 1, 0), 0u);
+    int16_t out[6] = {};
+    CHECK_EQ(ring.Pop(out, 6), 4u);
+    CHECK_EQ(out[0], 1);
+    CHECK_EQ(out[3], 4);
+}
+
+TEST(WrapsAroundAndClears) {
+    AudioFeedRing ring;
+    ring.Allocate(8);
+    int32_t slots[5];
+    int16_t out[5];
+    int32_t next = 0;
+    int16_t expected = 0;
+    for (int round = 0; round < 20; round++) {
+        for (auto& slot : slots) {
+            slot = next++;
+        }
+        CHECK_EQ(ring.PushInt32(slots, 5, 0), 5u);
+        CHECK_EQ(ring.Pop(out, 5), 5u);
+        for (auto sample : out) {
+            CHECK_EQ(sample, expected++);
+        }
+    }
+    ring.PushInt32(slots, 3, 0);
+    ring.Clear();
+    CHECK_EQ(ring.available(), 0u);
+    CHECK_EQ(ring.Pop(out, 5), 0u);
+}
+
+// One producer and one consumer thread, like the I2S callback and the audio input task
+TEST(ProducerAndConsumerThreadsKeepTheOrder) {
+    AudioFeedRing ring;
+    ring.Allocate(256);
+    const int total = 200000;
+    std::thread producer([&ring]() {
+        int32_t block[48];
+        int value = 0;
+        while (value < total) {
+            int count = 0;
+            while (count < 48 && value + count < total) {
+                block[count] = (value + count) & 0x7FFF;
+                count++;
+            }
+            size_t pushed = ring.PushInt32(block, count, 0);
+            value += pushed;
+            if (pushed == 0) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    int received = 0;
+    bool in_order = true;
+    int16_t block[64];
+    while (received < total) {
+        size_t n = ring.Pop(block, 64);
+        for (size_t i = 0; i < n; i++) {
+            in_order = in_order && block[i] == ((received + (int)i) & 0x7FFF);
+        }
+        received += n;
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    CHECK(in_order);
+    CHECK_EQ(received, total);
+}
@@ -0,0 +1,149 @@
+#include "host_test.h"
+#include "audio_resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// 1 kHz tone on every channel, channel c at 1 / (c + 1) of the amplitude
+static std::vector<int16_t> Tone(int sample_rate, int channels, size_t frames, size_t first_frame) {
+    std::vector<int16_t> data(frames * channels);
+    for (size_t i = 0; i < frames; i++) {
+        double value = 12000 * sin(2 * M_PI * 1000 * (first_frame + i) / sample_rate);
+        for (int c = 0; c < channels; c++) {
+            data[i * channels + c] = (int16_t)lrint(value / (c + 1));
+        }
+    }
+    return data;
+}
+
+// SNR of the 1 kHz tone in one channel, the filter settling time at both ends is left out
+static double ToneSnr(const std::vector<int16_t>& data, int sample_rate, int channels, int channel) {
+    size_t frames = data.size() / channels;
+    size_t skip = sample_rate / 100;
+    double re = 0, im = 0;
+    for (size_t i = skip; i < frames - skip; i++) {
+        double w = 2 * M_PI * 1000 * i / sample_rate;
+        re += data[i * channels + channel] * cos(w);
+        im += data[i * channels + channel] * sin(w);
+    }
+    size_t n = frames - 2 * skip;
+    double amplitude = 2 * sqrt(re * re + im * im) / n;
+    double phase = atan2(im, re);
+    double signal = 0, noise = 0;
+    for (size_t i = skip; i < frames - skip; i++) {
+        double reference = amplitude * cos(2 * M_PI * 1000 * i / sample_rate - phase);
+        double error = data[i * channels + channel] - reference;
+        signal += reference * reference;
+        noise += error * error;
+    }
+    return 10 * log10(signal / noise);
+}
+
+static std::vector<int16_t> Convert(int input_rate, int output_rate, int channels, int blocks) {
+    AudioResampler resampler;
+    resampler.Configure(input_rate, output_rate, channels);
+    size_t block_frames = input_rate * 60 / 1000;
+    std::vector<int16_t> output;
+    for (int b = 0; b < blocks; b++) {
+        auto data = Tone(input_rate, channels, block_frames, b * block_frames);
+        size_t expected = resampler.GetOutputSamples(data.size());
+        resampler.Process(data);
+        CHECK_EQ(data.size(), expected);
+        output.insert(output.end(), data.begin(), data.end());
+    }
+    return output;
+}
+
+TEST(OutputLengthFollowsTheRatio) {
+    const int rates[][2] = {{24000, 16000}, {16000, 24000}, {48000, 16000}, {44100, 16000}, {16000, 8000}};
+    for (auto& rate : rates) {
+        auto output = Convert(rate[0], rate[1], 1, 50);
+        // 50 blocks of 60ms, at most one frame off for the filter phase
+        long expected = (long)rate[1] * 3;
+        CHECK(labs((long)output.size() - expected) <= 1);
+    }
+}
+
+TEST(InputSizedForAnExactOutput) {
+    const int rates[][2] = {{24000, 16000}, {16000, 24000}, {48000, 16000}, {44100, 16000}, {16000, 8000}};
+    for (auto& rate : rates) {
+        for (int channels = 1; channels <= 2; channels++) {
+            AudioResampler resampler;
+            resampler.Configure(rate[0], rate[1], channels);
+            // 30ms blocks like ReadAudioData, the input length changes with the filter phase
+            size_t wanted = rate[1] * 30 / 1000 * channels;
+            size_t total_input = 0;
+            for (int block = 0; block < 200; block++) {
+                size_t input = resampler.GetInputSamples(wanted);
+                CHECK_EQ(input % channels, 0u);
+                // One frame less is not enough
+                CHECK(resampler.GetOutputSamples(input - channels) < wanted);
+                total_input += input;
+                std::vector<int16_t> data(input);
+                resampler.Process(data);
+                if (rate[1] < rate[0]) {
+                    CHECK_EQ(data.size(), wanted);
+                } else {
+                    CHECK(data.size() >= wanted && data.size() <= wanted + channels);
+                }
+            }
+            // No input is skipped or read twice over 6 seconds
+            long expected = (long)rate[0] * 6 * channels;
+            CHECK(labs((long)total_input - expected) <= 2 * channels);
+        }
+    }
+}
+
+TEST(ToneSurvivesCommonRatios) {
+    const int rates[][2] = {{24000, 16000}, {16000, 24000}, {48000, 16000}, {44100, 16000}};
+    for (auto& rate : rates) {
+        auto output = Convert(rate[0], rate[1], 1, 20);
+        double snr = ToneSnr(output, rate[1], 1, 0);
+        if (snr < 60) {
+            fprintf(stderr, "  %d -> %d Hz: SNR %.1f dB\n", rate[0], rate[1], snr);
+        }
+        CHECK(snr >= 60);
+    }
+}
+
+TEST(ChannelsStayApart) {
+    auto output = Convert(24000, 16000, 2, 20);
+    CHECK(ToneSnr(output, 16000, 2, 0) >= 60);
+    CHECK(ToneSnr(output, 16000, 2, 1) >= 54);
+    // Channel 1 carries half the amplitude of channel 0
+    double peak0 = 0, peak1 = 0;
+    for (size_t i = 0; i < output.size(); i += 2) {
+        peak0 = std::max(peak0, fabs((double)output[i]));
+        peak1 = std::max(peak1, fabs((double)output[i + 1]));
+    }
+    CHECK(fabs(peak1 * 2 - peak0) < peak0 * 0.02);
+}
+
+TEST(PointerAndVectorCallsMatch) {
+    AudioResampler a, b;
+    a.Configure(48000, 16000, 1);
+    b.Configure(48000, 16000, 1);
+    for (int block = 0; block < 5; block++) {
+        auto input = Tone(48000, 1, 2880, block * 2880);
+        std::vector<int16_t> output(b.GetOutputSamples(input.size()));
+        size_t written = b.Process(input.data(), input.size(), output.data());
+        a.Process(input);
+        CHECK_EQ(written, input.size());
+        CHECK(output == input);
+    }
+}
+
+TEST(ResetDropsTheHistory) {
+    AudioResampler resampler;
+    resampler.Configure(16000, 24000, 1);
+    auto loud = Tone(16000, 1, 960, 0);
+    resampler.Process(loud);
+    resampler.Reset();
+    std::vector<int16_t> silence(960, 0);
+    resampler.Process(silence);
+    for (auto sample : silence) {
+        CHECK_EQ(sample, 0);
+    }
+}
@@ -0,0 +1,107 @@
+#include "host_test.h"
+#include "boot_sequence.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cJSON.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Recorder {
+public:
+    void Add(const std::string& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(event);
+    }
+
+    int IndexOf(const std::string& event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < (int)events_.size(); i++) {
+            if (events_[i] == event) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::string> events_;
+};
+
+TEST(StagesWaitForTheirDependencies) {
+    BootSequence boot;
+    Recorder recorder;
+    auto stage = [&recorder](const char* name, int delay_ms) {
+        return [&recorder, name, delay_ms]() {
+            recorder.Add(std::string(name) + "+");
+            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+            recorder.Add(std::string(name) + "-");
+        };
+    };
+    boot.AddStage("audio", {}, stage("audio", 30));
+    boot.AddStage("main_loop", {}, stage("main_loop", 5));
+    boot.AddStage("idle", {"audio", "main_loop"}, stage("idle", 1));
+    boot.AddStage("mcp_tools", {}, stage("mcp_tools", 1));
+    boot.AddStage("network", {"idle", "mcp_tools"}, stage("network", 10));
+    boot.AddStage("protocol", {"network", "mcp_tools", "idle"}, stage("protocol", 1));
+    boot.Run();
+
+    CHECK(recorder.IndexOf("audio-") < recorder.IndexOf("idle+"));
+    CHECK(recorder.IndexOf("main_loop-") < recorder.IndexOf("idle+"));
+    CHECK(recorder.IndexOf("idle-") < recorder.IndexOf("network+"));
+    CHECK(recorder.IndexOf("mcp_tools-") < recorder.IndexOf("network+"));
+    CHECK(recorder.IndexOf("network-") < recorder.IndexOf("protocol+"));
+    CHECK(recorder.IndexOf("protocol-") >= 0);
+}
+
+TEST(IndependentStagesRunInParallel) {
+    BootSequence boot;
+    std::atomic<bool> a_running = false;
+    std::atomic<bool> overlapped = false;
+    boot.AddStage("a", {}, [&]() {
+        a_running = true;
+        vTaskDelay(pdMS_TO_TICKS(50));
+        a_running = false;
+    });
+    boot.AddStage("b", {}, [&]() {
+        for (int i = 0; i < 40 && !overlapped; i++) {
+            overlapped = a_running.load();
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+    });
+    boot.Run();
+    CHECK(overlapped);
+}
+
+TEST(MilestonesAndTimelineJson) {
+    BootSequence boot;
+    boot.AddStage("first", {}, [&boot]() {
+        boot.Mark("ready");
+    });
+    boot.AddStage("second", {"first", "missing"}, []() {});
+    boot.Run();
+    vTaskDelay(pdMS_TO_TICKS(5));
+    // Only the first mark of a milestone counts
+    boot.Mark("ready");
+
+    auto root = cJSON_Parse(boot.GetTimelineJson().c_str());
+    CHECK(root != nullptr);
+    if (root == nullptr) {
+        return;
+    }
+    auto stages = cJSON_GetObjectItem(root, "stages");
+    CHECK_EQ(cJSON_GetArraySize(stages), 2);
+    auto second = cJSON_GetArrayItem(stages, 1);
+    // The unknown dependency is left out
+    CHECK_EQ(cJSON_GetArraySize(cJSON_GetObjectItem(second, "after")), 1);
+    CHECK(cJSON_GetObjectItem(second, "end_ms")->valuedouble >= 0);
+    auto milestones = cJSON_GetObjectItem(root, "milestones");
+    CHECK(cJSON_GetObjectItem(milestones, "ready") != nullptr);
+    CHECK(cJSON_GetObjectItem(milestones, "boot_done") != nullptr);
+    CHECK(cJSON_GetObjectItem(milestones, "ready")->valuedouble <= cJSON_GetObjectItem(milestones, "boot_done")->valuedouble);
+    cJSON_Delete(root);
+}
@@ -0,0 +1,54 @@
+// Minimal test registry for the host tests, one executable per tested module
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct HostTestCase {
+    const char* name;
+    void (*function)();
+};
+
+inline std::vector<HostTestCase>& HostTestCases() {
+    static std::vector<HostTestCase> cases;
+    return cases;
+}
+
+inline int& HostTestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct HostTestRegistrar {
+    HostTestRegistrar(const char* name, void (*function)()) {
+        HostTestCases().push_back({name, function});
+    }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static HostTestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            HostTestFailures()++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        auto _actual = (actual); \
+        auto _expected = (expected); \
+        if (!(_actual == _expected)) { \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #actual, #expected, \
+                (long long)_actual, (long long)_expected); \
+            HostTestFailures()++; \
+        } \
+    } while (0)
+
+#endif // HOST_TEST_H
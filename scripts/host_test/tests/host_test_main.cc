@@ -0,0 +1,19 @@
+#include "host_test.h"
+
+#include <cstring>
+
+// Runs every registered test, or the ones whose name contains argv[1]
+int main(int argc, char** argv) {
+    int run = 0;
+    for (auto& test : HostTestCases()) {
+        if (argc > 1 && strstr(test.name, argv[1]) == nullptr) {
+            continue;
+        }
+        int failures = HostTestFailures();
+        test.function();
+        printf("%-40s %s\n", test.name, HostTestFailures() == failures ? "ok" : "FAILED");
+        run++;
+    }
+    printf("%d tests, %d failed checks\n", run, HostTestFailures());
+    return HostTestFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#include "host_test.h"
+#include "main_event_queue.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST(HigherPriorityRunsFirst) {
+    MainEventQueue queue;
+    std::string order;
+    queue.Push(kMainEventMcpTool, [&order]() { order += "m"; });
+    queue.Push(kMainEventGeneric, [&order]() { order += "g"; });
+    queue.Push(kMainEventUi, [&order]() { order += "u"; });
+    queue.Push(kMainEventControl, [&order]() { order += "c"; });
+    while (queue.RunNext()) {
+    }
+    CHECK(order == "cgum");
+    CHECK(queue.Empty());
+}
+
+TEST(SamePriorityKeepsTheOrder) {
+    MainEventQueue queue;
+    std::vector<int> order;
+    for (int i = 0; i < 20; i++) {
+        queue.Push(i % 2 ? kMainEventUi : kMainEventProtocol, [&order, i]() { order.push_back(i); });
+    }
+    while (queue.RunNext()) {
+    }
+    CHECK_EQ(order.size(), 20u);
+    for (int i = 0; i < (int)order.size(); i++) {
+        CHECK_EQ(order[i], i);
+    }
+}
+
+TEST(FullRingDropsToolCalls) {
+    MainEventQueue queue;
+    int pushed = 0;
+    while (queue.Push(kMainEventMcpTool, []() {})) {
+        pushed++;
+    }
+    CHECK_EQ(pushed, 16);
+    // The other priorities still have room
+    CHECK(queue.Push(kMainEventProtocol, []() {}));
+    CHECK(queue.GetReportJson().find("\"low\":1") != std::string::npos);
+}
+
+TEST(FullRingSpillsControlEventsInOrder) {
+    MainEventQueue queue;
+    std::vector<int> order;
+    for (int i = 0; i < 20; i++) {
+        CHECK(queue.Push(kMainEventControl, [&order, i]() { order.push_back(i); }));
+    }
+    // Room in the ring is taken by the spilled events first
+    CHECK(queue.RunNext());
+    CHECK(queue.Push(kMainEventControl, [&order]() { order.push_back(20); }));
+    while (queue.RunNext()) {
+    }
+    CHECK_EQ(order.size(), 21u);
+    for (int i = 0; i < (int)order.size(); i++) {
+        CHECK_EQ(order[i], i);
+    }
+    auto report = queue.GetReportJson();
+    CHECK(report.find("\"spilled\":{\"high\":13") != std::string::npos);
+    CHECK(report.find("\"overflows\":{\"high\":0") != std::string::npos);
+}
+
+TEST(McpRepliesAreNotDropped) {
+    MainEventQueue queue;
+    int replies = 0;
+    while (queue.Push(kMainEventProtocol, []() {})) {
+    }
+    for (int i = 0; i < 5; i++) {
+        CHECK(queue.Push(kMainEventMcpReply, [&replies]() { replies++; }));
+    }
+    while (queue.RunNext()) {
+    }
+    CHECK_EQ(replies, 5);
+}
+
+TEST(RingWrapsAround) {
+    MainEventQueue queue;
+    int runs = 0;
+    for (int round = 0; round < 100; round++) {
+        CHECK(queue.Push(kMainEventGeneric, [&runs]() { runs++; }));
+        CHECK(queue.Push(kMainEventGeneric, [&runs]() { runs++; }));
+        CHECK(queue.RunNext());
+        CHECK(queue.RunNext());
+    }
+    CHECK_EQ(runs, 200);
+    CHECK(!queue.RunNext());
+}
+
+TEST(MoveOnlyCapturesAreReleasedAfterTheRun) {
+    MainEventQueue queue;
+    auto value = std::make_shared<int>(42);
+    std::weak_ptr<int> watch = value;
+    int seen = 0;
+    auto owned = std::make_unique<std::shared_ptr<int>>(std::move(value));
+    queue.Push(kMainEventGeneric, [owned = std::move(owned), &seen]() { seen = **owned; });
+    CHECK(!watch.expired());
+    CHECK(queue.RunNext());
+    CHECK_EQ(seen, 42);
+    CHECK(watch.expired());
+}
+
+TEST(DroppedEventReleasesItsCaptures) {
+    MainEventQueue queue;
+    while (queue.Push(kMainEventMcpTool, []() {})) {
+    }
+    auto value = std::make_shared<int>(1);
+    std::weak_ptr<int> watch = value;
+    CHECK(!queue.Push(kMainEventMcpTool, [value = std::move(value)]() {}));
+    CHECK(watch.expired());
+}
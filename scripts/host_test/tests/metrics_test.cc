@@ -0,0 +1,56 @@
+#include "host_test.h"
+#include "metrics.h"
+
+#include <esp_heap_caps.h>
+#include <cJSON.h>
+
+#include <string>
+#include <vector>
+
+// One column of the last `samples` rows of the ring
+static std::vector<int> Column(const char* name, int samples) {
+    std::vector<int> values;
+    auto root = cJSON_Parse(Metrics::GetInstance().GetReportJson(samples).c_str());
+    auto ring = cJSON_GetObjectItem(root, "ring");
+    auto columns = cJSON_GetObjectItem(ring, "columns");
+    int index = -1;
+    for (int i = 0; i < cJSON_GetArraySize(columns); i++) {
+        if (std::string(cJSON_GetArrayItem(columns, i)->valuestring) == name) {
+            index = i;
+        }
+    }
+    auto rows = cJSON_GetObjectItem(ring, "rows");
+    for (int i = 0; index >= 0 && i < cJSON_GetArraySize(rows); i++) {
+        values.push_back(cJSON_GetArrayItem(cJSON_GetArrayItem(rows, i), index)->valueint);
+    }
+    cJSON_Delete(root);
+    return values;
+}
+
+TEST(HeapRowsHoldTheSampledValue) {
+    auto& metrics = Metrics::GetInstance();
+    HostHeapSetSizes(100000, 60000);
+    metrics.Sample();
+    HostHeapSetSizes(40000, 8000);
+    metrics.Sample();
+    HostHeapSetSizes(70000, 30000);
+    metrics.Sample();
+    CHECK((Column("sram_free", 3) == std::vector<int>{100000, 40000, 70000}));
+    CHECK((Column("sram_largest", 3) == std::vector<int>{60000, 8000, 30000}));
+    CHECK((Column("psram_largest", 3) == std::vector<int>{60000, 8000, 30000}));
+    CHECK((Column("sram_min_free", 3) == std::vector<int>{100000, 40000, 40000}));
+}
+
+TEST(QueueRowsHoldTheIntervalPeak) {
+    auto& metrics = Metrics::GetInstance();
+    metrics.SetGauge(kMetricSendQueue, 7);
+    metrics.SetGauge(kMetricSendQueue, 2);
+    metrics.Sample();
+    metrics.Sample();
+    metrics.SetGauge(kMetricSendQueue, 0);
+    metrics.Sample();
+    // The burst counts in its own interval, the next one starts from the current value
+    CHECK((Column("send_queue", 3) == std::vector<int>{7, 2, 2}));
+    metrics.Sample();
+    CHECK_EQ(Column("send_queue", 1)[0], 0);
+}
@@ -0,0 +1,206 @@
+#include "host_test.h"
+#include "ota_package.h"
+
+#include <mbedtls/sha256.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+static void PutLe32(Bytes& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back((value >> (i * 8)) & 0xFF);
+    }
+}
+
+static void Sha256(const Bytes& data, uint8_t* digest) {
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    mbedtls_sha256_update(&ctx, data.data(), data.size());
+    mbedtls_sha256_finish(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+}
+
+// Package in the layout of ota_package.h, every block stored uncompressed unless given
+static Bytes Package(OtaPackageFormat format, const Bytes& stream, const Bytes& image, const Bytes& base,
+    size_t block_size, const std::vector<Bytes>& compressed_blocks = {}) {
+    Bytes out = {'X', 'Z', 'P', 'K', OTA_PACKAGE_VERSION, format, 0, 0};
+    PutLe32(out, block_size);
+    PutLe32(out, stream.size());
+    PutLe32(out, image.size());
+    PutLe32(out, base.size());
+    uint8_t digest[32];
+    Sha256(image, digest);
+    out.insert(out.end(), digest, digest + 32);
+    Sha256(base, digest);
+    out.insert(out.end(), digest, digest + 32);
+    if (!compressed_blocks.empty()) {
+        for (auto& block : compressed_blocks) {
+            PutLe32(out, block.size());
+            out.insert(out.end(), block.begin(), block.end());
+        }
+        return out;
+    }
+    for (size_t offset = 0; offset < stream.size(); offset += block_size) {
+        size_t n = std::min(block_size, stream.size() - offset);
+        PutLe32(out, n | 0x80000000);
+        out.insert(out.end(), stream.begin() + offset, stream.begin() + offset + n);
+    }
+    return out;
+}
+
+class Decoder {
+public:
+    explicit Decoder(const Bytes& base = {}) : base_(base), decoder_(
+        [this](const uint8_t* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            return true;
+        },
+        [this](size_t offset, uint8_t* data, size_t size) {
+            if (offset + size > base_.size()) {
+                return false;
+            }
+            memcpy(data, base_.data() + offset, size);
+            return true;
+        }) {
+    }
+
+    // Feeds the package in pieces of `step` bytes
+    bool Feed(const Bytes& package, size_t step) {
+        for (size_t offset = 0; offset < package.size(); offset += step) {
+            if (!decoder_.Feed(package.data() + offset, std::min(step, package.size() - offset))) {
+                return false;
+            }
+        }
+        return decoder_.Finished();
+    }
+
+    Bytes output;
+
+private:
+    Bytes base_;
+    OtaPackageDecoder decoder_;
+};
+
+static Bytes Pattern(size_t size, uint32_t seed) {
+    Bytes data(size);
+    for (auto& byte : data) {
+        seed = seed * 1103515245 + 12345;
+        byte = seed >> 16;
+    }
+    return data;
+}
+
+TEST(StoredBlocksInAnyPieceSize) {
+    auto image = Pattern(10000, 1);
+    auto package = Package(kOtaPackageLz4, image, image, {}, 4096);
+    CHECK(OtaPackageDecoder::IsPackage(package.data(), package.size()));
+    for (size_t step : {1, 7, 88, 4096, 100000}) {
+        Decoder decoder;
+        CHECK(decoder.Feed(package, step));
+        CHECK(decoder.output == image);
+    }
+}
+
+TEST(Lz4BlockWithOverlappingMatch) {
+    // "abcd" literals, then a 12 byte match at offset 4, then "xyz" literals
+    Bytes block = {0x48, 'a', 'b', 'c', 'd', 4, 0, 0x30, 'x', 'y', 'z'};
+    Bytes image;
+    for (int i = 0; i < 4; i++) {
+        image.insert(image.end(), {'a', 'b', 'c', 'd'});
+    }
+    image.insert(image.end(), {'x', 'y', 'z'});
+    auto package = Package(kOtaPackageLz4, image, image, {}, 64, {block});
+    Decoder decoder;
+    CHECK(decoder.Feed(package, 5));
+    CHECK(decoder.output == image);
+}
+
+TEST(CorruptedLz4BlockFails) {
+    Bytes image(19, 'a');
+    // The match points before the start of the block
+    Bytes block = {0x48, 'a', 'b', 'c', 'd', 9, 0, 0x30, 'x', 'y', 'z'};
+    Decoder decoder;
+    CHECK(!decoder.Feed(Package(kOtaPackageLz4, image, image, {}, 64, {block}), 1000));
+}
+
+TEST(DeltaRebuildsTheImageFromTheBase) {
+    auto base = Pattern(6000, 2);
+    Bytes image(base.begin(), base.begin() + 3000);
+    Bytes inserted = Pattern(500, 3);
+    image.insert(image.end(), inserted.begin(), inserted.end());
+    for (size_t i = 4000; i < 5000; i++) {
+        image.push_back(base[i] + 1);
+    }
+
+    Bytes stream = {0};
+    PutLe32(stream, 0);
+    PutLe32(stream, 3000);
+    stream.push_back(2);
+    PutLe32(stream, inserted.size());
+    stream.insert(stream.end(), inserted.begin(), inserted.end());
+    stream.push_back(1);
+    PutLe32(stream, 4000);
+    PutLe32(stream, 1000);
+    stream.insert(stream.end(), 1000, 1);
+
+    // Block boundaries fall inside operation headers
+    auto package = Package(kOtaPackageDelta, stream, image, base, 501);
+    Decoder decoder(base);
+    CHECK(decoder.Feed(package, 333));
+    CHECK(decoder.output == image);
+}
+
+TEST(DeltaForAnotherBaseIsRejected) {
+    auto base = Pattern(1000, 4);
+    Bytes stream = {0};
+    PutLe32(stream, 0);
+    PutLe32(stream, 1000);
+    auto package = Package(kOtaPackageDelta, stream, base, base, 64);
+    auto other = base;
+    other[500] ^= 1;
+    Decoder decoder(other);
+    CHECK(!decoder.Feed(package, 1000));
+    CHECK(decoder.output.empty());
+}
+
+TEST(DeltaOutsideTheBaseIsRejected) {
+    auto base = Pattern(1000, 5);
+    Bytes stream = {0};
+    PutLe32(stream, 900);
+    PutLe32(stream, 200);
+    Bytes image(200);
+    Decoder decoder(base);
+    CHECK(!decoder.Feed(Package(kOtaPackageDelta, stream, image, base, 64), 1000));
+}
+
+TEST(BadHeadersAreRejected) {
+    auto image = Pattern(100, 6);
+    auto package = Package(kOtaPackageLz4, image, image, {}, 64);
+    auto bad_version = package;
+    bad_version[4] = OTA_PACKAGE_VERSION + 1;
+    Decoder a;
+    CHECK(!a.Feed(bad_version, 1000));
+
+    auto bad_format = package;
+    bad_format[5] = 9;
+    Decoder b;
+    CHECK(!b.Feed(bad_format, 1000));
+
+    auto huge_block = Package(kOtaPackageLz4, image, image, {}, OTA_PACKAGE_MAX_BLOCK_SIZE + 1);
+    Decoder c;
+    CHECK(!c.Feed(huge_block, 1000));
+}
+
+TEST(TruncatedPackageIsNotFinished) {
+    auto image = Pattern(1000, 7);
+    auto package = Package(kOtaPackageLz4, image, image, {}, 256);
+    package.resize(package.size() - 10);
+    Decoder decoder;
+    CHECK(!decoder.Feed(package, 100));
+    CHECK(decoder.output.size() < image.size());
+}
@@ -0,0 +1,101 @@
+#include "host_test.h"
+#include "protocol.h"
+
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+static cJSON* Parse(const std::string& text) {
+    return Protocol::ParseJson(text.data(), text.size());
+}
+
+TEST(ParseJsonAcceptsServerMessages) {
+    auto root = Parse("{\"type\":\"tts\",\"state\":\"start\",\"session_id\":\"abc\"}");
+    CHECK(root != nullptr);
+    if (root != nullptr) {
+        CHECK(strcmp(cJSON_GetObjectItem(root, "state")->valuestring, "start") == 0);
+        cJSON_Delete(root);
+    }
+    // The length is honoured, a websocket frame is not terminated
+    std::string framed = "{\"type\":\"stt\"}garbage";
+    root = Protocol::ParseJson(framed.data(), 14);
+    CHECK(root != nullptr);
+    cJSON_Delete(root);
+}
+
+TEST(ParseJsonRejectsOversizedMessages) {
+    std::string text = "{\"text\":\"" + std::string(PROTOCOL_MAX_JSON_SIZE, 'a') + "\"}";
+    CHECK(Parse(text) == nullptr);
+}
+
+TEST(ParseJsonLimitsTheNesting) {
+    std::string ok, deep;
+    for (int i = 0; i < PROTOCOL_MAX_JSON_DEPTH; i++) {
+        ok += "[";
+    }
+    ok += std::string(PROTOCOL_MAX_JSON_DEPTH, ']');
+    auto root = Parse(ok);
+    CHECK(root != nullptr);
+    cJSON_Delete(root);
+
+    deep = std::string(PROTOCOL_MAX_JSON_DEPTH + 1, '[') + std::string(PROTOCOL_MAX_JSON_DEPTH + 1, ']');
+    CHECK(Parse(deep) == nullptr);
+    // Brackets inside strings, also after an escaped quote, do not count
+    std::string quoted = "{\"text\":\"\\\"" + std::string(100, '{') + "\"}";
+    root = Parse(quoted);
+    CHECK(root != nullptr);
+    cJSON_Delete(root);
+}
+
+TEST(ParseJsonRejectsMalformedText) {
+    CHECK(Parse("{\"type\":") == nullptr);
+    CHECK(Parse("") == nullptr);
+}
+
+TEST(BinaryFrameVersion2) {
+    std::vector<uint8_t> frame(sizeof(BinaryProtocol2) + 3);
+    auto bp2 = (BinaryProtocol2*)frame.data();
+    bp2->version = htons(2);
+    bp2->type = 0;
+    bp2->timestamp = htonl(1234);
+    bp2->payload_size = htonl(3);
+    memcpy(bp2->payload, "abc", 3);
+    AudioStreamPacket packet;
+    CHECK(Protocol::ParseBinaryFrame(2, frame.data(), frame.size(), packet));
+    CHECK_EQ(packet.timestamp, 1234u);
+    CHECK((packet.payload == std::vector<uint8_t>{'a', 'b', 'c'}));
+
+    // The declared payload is longer than the frame
+    bp2->payload_size = htonl(4);
+    CHECK(!Protocol::ParseBinaryFrame(2, frame.data(), frame.size(), packet));
+    bp2->payload_size = htonl(0xFFFFFFFF);
+    CHECK(!Protocol::ParseBinaryFrame(2, frame.data(), frame.size(), packet));
+    CHECK(!Protocol::ParseBinaryFrame(2, frame.data(), sizeof(BinaryProtocol2) - 1, packet));
+}
+
+TEST(BinaryFrameVersion3) {
+    std::vector<uint8_t> frame(sizeof(BinaryProtocol3) + 2);
+    auto bp3 = (BinaryProtocol3*)frame.data();
+    bp3->type = 0;
+    bp3->payload_size = htons(2);
+    bp3->payload[0] = 7;
+    bp3->payload[1] = 8;
+    AudioStreamPacket packet;
+    packet.timestamp = 99;
+    CHECK(Protocol::ParseBinaryFrame(3, frame.data(), frame.size(), packet));
+    CHECK_EQ(packet.timestamp, 0u);
+    CHECK((packet.payload == std::vector<uint8_t>{7, 8}));
+
+    bp3->payload_size = htons(3);
+    CHECK(!Protocol::ParseBinaryFrame(3, frame.data(), frame.size(), packet));
+    CHECK(!Protocol::ParseBinaryFrame(3, frame.data(), 3, packet));
+}
+
+TEST(BinaryFrameVersion1IsThePayload) {
+    const uint8_t data[] = {1, 2, 3, 4, 5};
+    AudioStreamPacket packet;
+    CHECK(Protocol::ParseBinaryFrame(1, data, sizeof(data), packet));
+    CHECK_EQ(packet.payload.size(), sizeof(data));
+}
@@ -0,0 +1,81 @@
+#include "host_test.h"
+#include "server_config.h"
+#include "settings.h"
+
+#include <nvs.h>
+
+#include <string>
+
+static ServerConfig Save(const char* reply) {
+    auto root = cJSON_Parse(reply);
+    auto config = SaveServerConfig(root);
+    cJSON_Delete(root);
+    return config;
+}
+
+// Saved config starts empty, like a device after erase-flash
+static void EraseSavedConfig() {
+    Settings("mqtt", true).EraseAll();
+    Settings("websocket", true).EraseAll();
+    Settings::Flush();
+}
+
+static std::string ReadNvsString(const char* ns, const char* key) {
+    nvs_handle_t handle;
+    if (nvs_open(ns, NVS_READONLY, &handle) != ESP_OK) {
+        return "";
+    }
+    char value[64] = {};
+    size_t length = sizeof(value);
+    esp_err_t err = nvs_get_str(handle, key, value, &length);
+    nvs_close(handle);
+    return err == ESP_OK ? value : "";
+}
+
+TEST(MqttReplyIsSavedForTheNextBoot) {
+    EraseSavedConfig();
+    auto config = Save(R"({"mqtt":{"endpoint":"mqtt.example.com","client_id":"c1","keepalive":240}})");
+    CHECK(config.has_mqtt);
+    CHECK(!config.has_websocket);
+    auto saved = LoadServerConfig();
+    CHECK(saved.has_mqtt);
+    CHECK(!saved.has_websocket);
+    CHECK_EQ(Settings("mqtt").GetInt("keepalive"), 240);
+    Settings::Flush();
+    CHECK(ReadNvsString("mqtt", "endpoint") == "mqtt.example.com");
+}
+
+TEST(WebsocketOnlyReplyErasesTheSavedBroker) {
+    EraseSavedConfig();
+    Save(R"({"mqtt":{"endpoint":"mqtt.example.com","client_id":"c1"}})");
+    Settings::Flush();
+
+    // The server moved the device to websocket, the saved broker must not win on the next boot
+    auto config = Save(R"({"websocket":{"url":"ws://192.168.1.2:8000/xiaozhi/v1/","token":"t"}})");
+    CHECK(!config.has_mqtt);
+    CHECK(config.has_websocket);
+    auto saved = LoadServerConfig();
+    CHECK(!saved.has_mqtt);
+    CHECK(saved.has_websocket);
+    Settings::Flush();
+    CHECK(ReadNvsString("mqtt", "endpoint").empty());
+    // The rest of the mqtt namespace is left alone
+    CHECK(Settings("mqtt").GetString("client_id") == "c1");
+}
+
+TEST(EmptyEndpointIsNoMqttConfig) {
+    EraseSavedConfig();
+    auto config = Save(R"({"mqtt":{"endpoint":""},"websocket":{"url":"ws://192.168.1.2:8000/xiaozhi/v1/"}})");
+    CHECK(!config.has_mqtt);
+    CHECK(config.has_websocket);
+    CHECK(!LoadServerConfig().has_mqtt);
+}
+
+TEST(ReplyWithoutServerSectionsKeepsTheSavedConfig) {
+    EraseSavedConfig();
+    Save(R"({"mqtt":{"endpoint":"mqtt.example.com"}})");
+    auto config = Save(R"({"firmware":{"version":"1.0.0","url":""}})");
+    CHECK(!config.has_mqtt);
+    CHECK(!config.has_websocket);
+    CHECK(LoadServerConfig().has_mqtt);
+}
@@ -0,0 +1,126 @@
+#include "host_test.h"
+#include "udp_reorder_window.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <mutex>
+#include <vector>
+
+// Collects the released packets, an empty payload is a concealed frame (-1)
+class Receiver {
+public:
+    explicit Receiver(UdpReorderWindow& window) {
+        window.OnOutput([this](std::unique_ptr<AudioStreamPacket> packet) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            output_.push_back(packet->payload.empty() ? -1 : packet->payload[0]);
+        });
+    }
+
+    std::vector<int> Output() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return output_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<int> output_;
+};
+
+static std::unique_ptr<AudioStreamPacket> Packet(uint8_t marker) {
+    auto packet = std::make_unique<AudioStreamPacket>();
+    packet->sample_rate = 24000;
+    packet->frame_duration = 20;
+    packet->payload.assign(1, marker);
+    return packet;
+}
+
+TEST(InOrderPacketsPassStraightThrough) {
+    UdpReorderWindow window;
+    Receiver receiver(window);
+    window.Reset(20);
+    for (uint32_t sequence = 100; sequence < 110; sequence++) {
+        window.Push(sequence, Packet(sequence - 100));
+    }
+    CHECK((receiver.Output() == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    auto stats = window.GetStats();
+    CHECK_EQ(stats.received, 10u);
+    CHECK_EQ(stats.lost, 0u);
+}
+
+TEST(SwappedPacketsArePutBackInOrder) {
+    UdpReorderWindow window;
+    Receiver receiver(window);
+    window.Reset(20);
+    window.Push(1, Packet(1));
+    window.Push(3, Packet(3));
+    window.Push(2, Packet(2));
+    window.Push(4, Packet(4));
+    CHECK((receiver.Output() == std::vector<int>{1, 2, 3, 4}));
+    auto stats = window.GetStats();
+    CHECK_EQ(stats.reordered, 1u);
+    CHECK_EQ(stats.lost, 0u);
+}
+
+TEST(DuplicatesAreDropped) {
+    UdpReorderWindow window;
+    Receiver receiver(window);
+    window.Reset(20);
+    window.Push(1, Packet(1));
+    window.Push(1, Packet(1));
+    window.Push(3, Packet(3));
+    window.Push(3, Packet(3));
+    window.Push(2, Packet(2));
+    CHECK((receiver.Output() == std::vector<int>{1, 2, 3}));
+    CHECK_EQ(window.GetStats().duplicate, 2u);
+}
+
+TEST(GapIsConcealedAfterTwoFrameDurations) {
+    UdpReorderWindow window;
+    Receiver receiver(window);
+    window.Reset(20);
+    window.Push(1, Packet(1));
+    window.Push(5, Packet(5));
+    CHECK((receiver.Output() == std::vector<int>{1}));
+    // The flush timer fires 40ms after the gap showed up
+    vTaskDelay(pdMS_TO_TICKS(100));
+    // Three lost frames, only UDP_MAX_CONCEALED_FRAMES of them are concealed
+    CHECK((receiver.Output() == std::vector<int>{1, -1, -1, 5}));
+    auto stats = window.GetStats();
+    CHECK_EQ(stats.lost, 3u);
+    CHECK_EQ(stats.concealed, (uint32_t)UDP_MAX_CONCEALED_FRAMES);
+
+    // A packet of the closed gap is late
+    window.Push(3, Packet(3));
+    CHECK_EQ(window.GetStats().late, 1u);
+    CHECK_EQ(receiver.Output().size(), 4u);
+}
+
+TEST(FarAheadPacketSkipsTheWindow) {
+    UdpReorderWindow window;
+    Receiver receiver(window);
+    window.Reset(20);
+    window.Push(10, Packet(10));
+    window.Push(10 + UDP_REORDER_WINDOW_PACKETS + 4, Packet(99));
+    // Only the oldest sequences are given up to make room in the window
+    CHECK_EQ(window.GetStats().lost, 4u);
+    CHECK_EQ(receiver.Output().back(), -1);
+    // The rest of the gap is closed by the flush timer
+    vTaskDelay(pdMS_TO_TICKS(100));
+    auto output = receiver.Output();
+    CHECK_EQ(output.front(), 10);
+    CHECK_EQ(output.back(), 99);
+    CHECK_EQ(window.GetStats().lost, (uint32_t)(UDP_REORDER_WINDOW_PACKETS + 3));
+}
+
+TEST(SequenceWrapsAround) {
+    UdpReorderWindow window;
+    Receiver receiver(window);
+    window.Reset(20);
+    window.Push(0xFFFFFFFE, Packet(1));
+    window.Push(0, Packet(3));
+    window.Push(0xFFFFFFFF, Packet(2));
+    window.Push(1, Packet(4));
+    CHECK((receiver.Output() == std::vector<int>{1, 2, 3, 4}));
+    CHECK_EQ(window.GetStats().lost, 0u);
+}
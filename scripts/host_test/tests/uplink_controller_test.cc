@@ -0,0 +1,143 @@
+#include "host_test.h"
+#include "uplink_controller.h"
+
+#include <esp_timer.h>
+
+#include <cstdio>
+#include <deque>
+
+/*
+ * The uplink of the websocket protocol behind a bottleneck, like `mock_server.py --up-bandwidth`:
+ * every 60ms the encoder queues a packet at the current bitrate, the main loop sends them in
+ * order, and a send blocks while the TCP send buffer is full. The buffer drains at the link rate.
+ */
+#define FRAME_MS 60
+#define SEND_QUEUE_PACKETS 40           // MAX_SEND_PACKETS_IN_QUEUE
+#define TCP_SEND_BUFFER 5760            // lwIP TCP_SND_BUF, 4 * MSS
+#define PACKET_OVERHEAD 50              // Websocket, TCP and IP headers per packet
+
+struct SimulationResult {
+    int final_level = 0;
+    int seconds_at_level[4] = {};       // Over the second half of the run
+    int64_t max_wait_us = 0;
+    int dropped_frames = 0;             // Encoded while the send queue was full
+    double delivered_kbps = 0;          // Over the second half of the run
+};
+
+static SimulationResult Simulate(int link_kbps, int seconds) {
+    UplinkController controller;
+    SimulationResult result;
+    struct Packet {
+        int64_t queued_us;
+        int bytes;
+    };
+    std::deque<Packet> queue;
+    double buffered = 0;                // Bytes in the TCP send buffer
+    bool sending = false;
+    Packet in_flight = {};
+    int64_t send_start_us = 0;
+    int64_t delivered_bytes = 0;
+    int current_bitrate = 0;
+    int current_level = 0;
+
+    for (int ms = 0; ms < seconds * 1000; ms++) {
+        HostTimerAdvance(1000);
+        int64_t now = esp_timer_get_time();
+        bool second_half = ms >= seconds * 500;
+
+        buffered -= link_kbps / 8.0;
+        if (buffered < 0) {
+            buffered = 0;
+        }
+
+        if (ms % FRAME_MS == 0) {
+            UplinkSettings settings;
+            if (controller.Update(settings)) {
+                current_bitrate = settings.bitrate;
+                current_level = settings.level;
+            }
+            int bytes = current_bitrate * FRAME_MS / 8000 + PACKET_OVERHEAD;
+            if (queue.size() < SEND_QUEUE_PACKETS) {
+                queue.push_back({now, bytes});
+            } else {
+                result.dropped_frames++;
+            }
+            controller.OnPacketEncoded(5000, queue.size());
+        }
+        if (ms % 1000 == 0) {
+            controller.OnLinkQuality(-60, 0, 0);
+        }
+
+        if (!sending && !queue.empty()) {
+            in_flight = queue.front();
+            queue.pop_front();
+            sending = true;
+            send_start_us = now;
+        }
+        if (sending && buffered + in_flight.bytes <= TCP_SEND_BUFFER) {
+            buffered += in_flight.bytes;
+            sending = false;
+            int64_t wait_us = send_start_us - in_flight.queued_us;
+            if (wait_us > result.max_wait_us) {
+                result.max_wait_us = wait_us;
+            }
+            controller.OnPacketSent(wait_us, now - send_start_us, true);
+            if (second_half) {
+                delivered_bytes += in_flight.bytes - PACKET_OVERHEAD;
+            }
+        }
+
+        if (second_half && ms % 1000 == 0) {
+            result.seconds_at_level[current_level]++;
+        }
+    }
+    result.final_level = current_level;
+    result.delivered_kbps = delivered_bytes * 8.0 / (seconds * 500);
+    printf("  %3d kbps link: level 0/1/2/3 %2d/%2d/%2d/%2ds, max wait %4lldms, %d frames dropped, %.1f kbps sent\n",
+        link_kbps, result.seconds_at_level[0], result.seconds_at_level[1], result.seconds_at_level[2],
+        result.seconds_at_level[3], (long long)result.max_wait_us / 1000, result.dropped_frames, result.delivered_kbps);
+    return result;
+}
+
+TEST(StartsAtTheTopBitrate) {
+    UplinkController controller;
+    UplinkSettings settings;
+    CHECK(controller.Update(settings));
+    CHECK_EQ(settings.level, 0);
+    CHECK_EQ(settings.bitrate, 24000);
+    CHECK(!controller.Update(settings));
+}
+
+TEST(FastLinkKeepsTheTopLevel) {
+    auto result = Simulate(64, 60);
+    CHECK_EQ(result.seconds_at_level[0], 30);
+    CHECK_EQ(result.dropped_frames, 0);
+    CHECK(result.max_wait_us < 100000);
+}
+
+TEST(BottleneckSettlesAtTheLevelThatFits) {
+    // Packets on the wire: 24k 31.9, 16k 23.9, 12k 19.9, 8k 15.9 kbps. Every UPLINK_RECOVER_INTERVALS
+    // the level above is probed again, it takes a while to fill the TCP send buffer before the
+    // queue backs up, so some time is spent there, but nothing is dropped.
+    struct {
+        int link_kbps;
+        int highest_level;      // Fits the link
+    } cases[] = { { 28, 1 }, { 22, 2 }, { 18, 3 } };
+    for (auto& c : cases) {
+        auto result = Simulate(c.link_kbps, 120);
+        CHECK_EQ(result.dropped_frames, 0);
+        CHECK(result.max_wait_us < 1000000);
+        CHECK(result.delivered_kbps <= c.link_kbps);
+        // Never more than one level below the one that fits
+        for (int level = c.highest_level + 2; level < 4; level++) {
+            CHECK_EQ(result.seconds_at_level[level], 0);
+        }
+        CHECK(result.seconds_at_level[c.highest_level] >= 10);
+    }
+}
+
+TEST(LinkBelowTheLowestLevelStaysThere) {
+    auto result = Simulate(12, 60);
+    CHECK_EQ(result.final_level, 3);
+    CHECK_EQ(result.seconds_at_level[3], 30);
+}
@@ -0,0 +1,64 @@
+#include "host_test.h"
+#include "vad_uplink_gate.h"
+
+#include <deque>
+#include <memory>
+
+typedef std::deque<std::unique_ptr<AudioStreamPacket>> SendQueue;
+
+static std::unique_ptr<AudioStreamPacket> Packet(uint32_t timestamp) {
+    auto packet = std::make_unique<AudioStreamPacket>();
+    packet->frame_duration = 60;
+    packet->timestamp = timestamp;
+    packet->payload.resize(10);
+    return packet;
+}
+
+// Past the hangover, then the silent frames after a hint wait in the preroll
+static void FillPreroll(VadUplinkGate& gate, SendQueue& queue, uint32_t& timestamp) {
+    gate.Reset(true);
+    for (int i = 0; i < VAD_GATE_HANGOVER_FRAMES + 1 + VAD_GATE_PREROLL_FRAMES; i++) {
+        gate.Push(Packet(timestamp++), queue, 100);
+    }
+}
+
+TEST(SpeechSendsThePrerollFirst) {
+    VadUplinkGate gate;
+    SendQueue queue;
+    uint32_t timestamp = 0;
+    FillPreroll(gate, queue, timestamp);
+    CHECK(gate.IsSuppressing());
+    size_t sent = queue.size();
+    gate.OnVadChange(true);
+    gate.Push(Packet(timestamp), queue, 100);
+    CHECK_EQ(queue.size(), sent + VAD_GATE_PREROLL_FRAMES + 1);
+    for (size_t i = 1; i < queue.size(); i++) {
+        CHECK_EQ(queue[i]->timestamp, queue[i - 1]->timestamp + 1);
+    }
+}
+
+TEST(PrerollFlushKeepsTheQueueBound) {
+    VadUplinkGate gate;
+    SendQueue queue;
+    uint32_t timestamp = 0;
+    FillPreroll(gate, queue, timestamp);
+    // Two free slots, the packet and the newest preroll frame
+    size_t max_queued = queue.size() + 2;
+    gate.OnVadChange(true);
+    gate.Push(Packet(timestamp), queue, max_queued);
+    CHECK_EQ(queue.size(), max_queued);
+    CHECK_EQ(queue.back()->timestamp, timestamp);
+    CHECK_EQ(queue[queue.size() - 2]->timestamp, timestamp - 1);
+}
+
+TEST(FullQueueStillTakesTheSpeechPacket) {
+    VadUplinkGate gate;
+    SendQueue queue;
+    uint32_t timestamp = 0;
+    FillPreroll(gate, queue, timestamp);
+    size_t queued = queue.size();
+    gate.OnVadChange(true);
+    gate.Push(Packet(timestamp), queue, queued);
+    CHECK_EQ(queue.size(), queued + 1);
+    CHECK_EQ(queue.back()->timestamp, timestamp);
+}
@@ -0,0 +1,1003 @@
+import argparse
+import asyncio
+import base64
+import csv
+import hashlib
+import json
+import os
+import random
+import socket
+import struct
+import time
+import uuid
+
+
+'''
+  Local mock of the xiaozhi server, for testing WebsocketProtocol and MqttProtocol on a laptop.
+  Only the Python standard library is used.
+
+    OTA       http://<host>:8002/xiaozhi/ota/   answers the check version request with the
+              websocket or the mqtt section pointing to this server (--transport)
+    WebSocket ws://<host>:8000/xiaozhi/v1/      hello, BinaryProtocol 1 / 2 / 3 audio, JSON
+    MQTT      <host>:1883                        minimal MQTT 3.1.1 broker for the JSON messages
+    UDP       <host>:8888                        AES-CTR encrypted audio, key / nonce from the hello
+
+  Point the device OTA URL at the OTA endpoint (CONFIG_OTA_URL or Settings "wifi" / "ota_url").
+
+  Without --script every listening turn is answered after --turn-seconds of audio (or when the
+  device stops listening) with stt / llm / tts messages, and the recorded uplink Opus packets
+  are played back as the TTS audio, which makes the audio round trip audible and measurable.
+
+  --script runs a canned session (JSON list of steps) after every hello instead:
+    {"wait": "listen:start", "timeout": 30}      wait for a device message (type[:state])
+    {"sleep": 1.5}
+    {"send": {"type": "llm", "emotion": "happy"}} send a JSON message, session_id is added
+    {"speak": "text", "audio": "echo" | "<file>", "emotion": "happy"}
+    {"mcp": "tools/call", "name": "self.get_device_status", "arguments": {}}
+    {"goodbye": true}                             end the session
+    {"repeat": 10, "steps": [...]}
+  Audio files hold Opus packets as u16 length + data, written by --save-uplink.
+
+  Network faults are injected on the audio path (both directions for UDP, server to device for
+  WebSocket where only latency, jitter and bandwidth apply because TCP keeps order; --bandwidth
+  is the server to device direction):
+    --latency-ms --jitter-ms --loss --reorder --bandwidth --disconnect-after
+  --up-bandwidth limits the device to server audio: UDP packets queue behind each other and are
+  dropped once more than --queue-ms is waiting, WebSocket frames are read no faster than the rate
+  so TCP pushes back on the device. The session stats show the uplink bitrate the device settled on.
+  --record writes one CSV row per packet and message with its timing.
+  --udp-resume-seconds keeps an MQTT session whose connection dropped (the device reattaches by
+  client id and its UDP audio never stops) and the UDP key of a closed session, which the next
+  hello can ask for with "resume": <session_id>.
+  --vad-gate accepts the device's vad_gate feature: silence is then mostly left out while
+  listening. Each turn logs its bytes per minute, the close stats the total per minute of
+  conversation. --save-turns keeps every turn as a separate audio file, so the same corpus played
+  to the device with and without --vad-gate can be transcribed offline and the results compared.
+  --capture writes every message sent to the device in the capture format of
+  main/protocols/protocol_replay.h, the OTA port serves *.bin files of the current directory so
+  the device can replay them with self.diagnostics.replay_capture (see scripts/fuzz_capture.py).
+'''
+
+OPUS_FRAME_DURATION_MS = 60
+
+CAPTURE_JSON = 1
+CAPTURE_BINARY = 2
+CAPTURE_UDP = 3
+CAPTURE_UDP_KEY = 4
+
+
+# AES-128, only encryption is needed for CTR mode
+
+def _aes_tables():
+    sbox = [0] * 256
+    p = q = 1
+    while True:
+        p = p ^ ((p << 1) & 0xFF) ^ (0x1B if p & 0x80 else 0)
+        q ^= q << 1
+        q ^= q << 2
+        q ^= q << 4
+        q &= 0xFF
+        if q & 0x80:
+            q ^= 0x09
+        x = q ^ (q << 1 | q >> 7) ^ (q << 2 | q >> 6) ^ (q << 3 | q >> 5) ^ (q << 4 | q >> 4)
+        sbox[p] = (x ^ 0x63) & 0xFF
+        if p == 1:
+            break
+    sbox[0] = 0x63
+    return sbox
+
+
+AES_SBOX = _aes_tables()
+
+
+def _xtime(a):
+    return ((a << 1) ^ 0x1B) & 0xFF if a & 0x80 else a << 1
+
+
+class Aes128:
+    def __init__(self, key):
+        words = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+        rcon = 1
+        for i in range(4, 44):
+            word = list(words[i - 1])
+            if i % 4 == 0:
+                word = [AES_SBOX[b] for b in word[1:] + word[:1]]
+                word[0] ^= rcon
+                rcon = _xtime(rcon)
+            words.append([a ^ b for a, b in zip(words[i - 4], word)])
+        self.round_keys = [sum(words[r * 4:r * 4 + 4], []) for r in range(11)]
+
+    def encrypt_block(self, block):
+        s = [a ^ b for a, b in zip(block, self.round_keys[0])]
+        for r in range(1, 11):
+            s = [AES_SBOX[b] for b in s]
+            s = [s[(i + 4 * (i % 4)) % 16] for i in range(16)]  # ShiftRows, column major
+            if r != 10:
+                mixed = []
+                for c in range(4):
+                    a = s[c * 4:c * 4 + 4]
+                    t = a[0] ^ a[1] ^ a[2] ^ a[3]
+                    mixed += [a[i] ^ t ^ _xtime(a[i] ^ a[(i + 1) % 4]) for i in range(4)]
+                s = mixed
+            s = [a ^ b for a, b in zip(s, self.round_keys[r])]
+        return bytes(s)
+
+    def ctr(self, counter, data):
+        '''Same as mbedtls_aes_crypt_ctr starting at offset 0, the counter is a 128 bit big endian'''
+        value = int.from_bytes(counter, 'big')
+        out = bytearray()
+        for i in range(0, len(data), 16):
+            stream = self.encrypt_block((value & ((1 << 128) - 1)).to_bytes(16, 'big'))
+            out += bytes(a ^ b for a, b in zip(data[i:i + 16], stream))
+            value += 1
+        return bytes(out)
+
+
+# Fault injection and per-packet recording
+
+class Recorder:
+    def __init__(self, path):
+        self.start = time.monotonic()
+        self.file = open(path, 'w', newline='') if path else None
+        self.writer = csv.writer(self.file) if self.file else None
+        if self.writer:
+            self.writer.writerow(['time_s', 'session', 'direction', 'kind', 'sequence', 'size', 'action', 'delay_ms'])
+
+    def log(self, session, direction, kind, sequence, size, action, delay_ms=0):
+        if self.writer:
+            self.writer.writerow(['%.6f' % (time.monotonic() - self.start), session, direction, kind, sequence, size,
+                                  action, '%.1f' % delay_ms])
+            self.file.flush()
+
+
+class Capture:
+    def __init__(self, path):
+        self.start = time.monotonic()
+        self.file = open(path, 'wb') if path else None
+        if self.file:
+            self.file.write(b'XZCP' + bytes([1, 0, 0, 0]))
+
+    def write(self, kind, data, version=0):
+        if self.file:
+            time_ms = int((time.monotonic() - self.start) * 1000)
+            self.file.write(struct.pack('<BBHII', kind, version, 0, time_ms, len(data)) + data)
+            self.file.flush()
+
+
+class Link:
+    '''Delays, drops, reorders and rate limits packets in one direction'''
+
+    def __init__(self, args, reliable, bandwidth):
+        self.args = args
+        self.reliable = reliable
+        self.bandwidth = bandwidth
+        self.next_free = 0.0
+        self.last_time = 0.0
+
+    def schedule(self, size):
+        '''Returns the delay in seconds, or None when the packet is lost'''
+        args = self.args
+        now = time.monotonic()
+        if not self.reliable and random.random() < args.loss:
+            return None
+        at = now + args.latency_ms / 1000 + random.uniform(0, args.jitter_ms / 1000)
+        if self.bandwidth > 0:
+            start = max(self.next_free, now)
+            if not self.reliable and start - now > args.queue_ms / 1000:
+                return None  # Tail drop, the bottleneck queue is full
+            self.next_free = start + size / self.bandwidth
+            at = max(at, self.next_free)
+        if self.reliable:
+            at = max(at, self.last_time)  # TCP keeps the order
+        elif random.random() < args.reorder:
+            at += OPUS_FRAME_DURATION_MS / 1000 * 1.5  # Arrives after the next packet
+        self.last_time = max(self.last_time, at)
+        return at - now
+
+
+# Protocol logic shared by both transports
+
+class Session:
+    def __init__(self, server, transport, name):
+        self.server = server
+        self.args = server.args
+        self.transport = transport
+        self.id = uuid.uuid4().hex[:12]
+        self.name = name
+        self.messages = asyncio.Queue()
+        self.turn_audio = []
+        self.last_turn_audio = []
+        self.listening = False
+        self.speaking_task = None
+        self.mcp_id = 0
+        self.mcp_pending = {}
+        self.closed = False
+        self.created = time.monotonic()
+        self.stats = {'up_packets': 0, 'up_bytes': 0, 'down_packets': 0, 'down_dropped': 0, 'up_dropped': 0,
+                      'up_gaps': 0, 'listen_seconds': 0.0, 'listen_packets': 0, 'listen_bytes': 0}
+        self.vad_gate = False
+        self.listen_start = None
+        self.turn_packets = 0
+        self.turn_bytes = 0
+        self.last_up_time = None
+        self.up_jitter = 0.0
+        self.last_sequence = None
+        self.turn_end_time = None
+        self.latencies = {}
+
+    def log(self, message):
+        print('[%s %s] %s' % (self.name, self.id[:6], message))
+
+    def add_latency(self, name, seconds):
+        self.latencies.setdefault(name, []).append(seconds * 1000)
+
+    def hello_reply(self, hello):
+        reply = {
+            'type': 'hello',
+            'transport': self.transport.name,
+            'session_id': self.id,
+            'audio_params': {'format': 'opus', 'sample_rate': 16000, 'channels': 1,
+                             'frame_duration': OPUS_FRAME_DURATION_MS},
+        }
+        # The device may leave out silence only when both sides agree
+        self.vad_gate = self.args.vad_gate and hello.get('features', {}).get('vad_gate') is True
+        if self.vad_gate:
+            reply['features'] = {'vad_gate': True}
+        return reply
+
+    async def start(self):
+        self.add_latency('hello', time.monotonic() - self.created)
+        if self.args.disconnect_after > 0:
+            asyncio.get_running_loop().call_later(self.args.disconnect_after, self.disconnect)
+        await self.mcp_call('initialize', {'capabilities': {}}, wait=False)
+        if self.server.script is not None:
+            asyncio.create_task(self.run_script(self.server.script))
+
+    def disconnect(self):
+        if not self.closed:
+            self.log('Injected disconnect')
+            self.transport.close()
+
+    def send_json(self, message):
+        message.setdefault('session_id', self.id)
+        link = self.transport.down_link
+        if link.reliable:
+            # Same connection as the audio, keep the order
+            delay = link.schedule(0)
+            self.server.recorder.log(self.id, 'down', 'json', message.get('type'), 0, 'sent', delay * 1000)
+            asyncio.get_running_loop().call_later(delay, self.transport.send_json, message)
+        else:
+            self.server.recorder.log(self.id, 'down', 'json', message.get('type'), 0, 'sent')
+            self.transport.send_json(message)
+
+    def on_json(self, message):
+        kind = message.get('type')
+        state = message.get('state')
+        self.server.recorder.log(self.id, 'up', 'json', kind, 0, state or '')
+        if kind == 'listen' and state == 'start':
+            self.listening = True
+            self.turn_audio = []
+            self.listen_start = time.monotonic()
+            self.turn_packets = 0
+            self.turn_bytes = 0
+            self.log('Listening (%s%s)' % (message.get('mode'), ', VAD gated' if self.vad_gate else ''))
+        elif kind == 'listen' and state == 'stop':
+            # Audio still in flight or delayed on the UDP link belongs to this turn
+            up_link = getattr(self.transport, 'up_link', None)
+            delay = max(up_link.last_time - time.monotonic(), 0) + OPUS_FRAME_DURATION_MS / 1000 if up_link else 0
+            asyncio.get_running_loop().call_later(delay, self.stop_listening, time.monotonic())
+        elif kind == 'listen' and state == 'detect':
+            self.log('Wake word %s' % message.get('text'))
+        elif kind == 'abort':
+            self.log('Abort %s' % message.get('reason', ''))
+            if self.speaking_task:
+                self.speaking_task.cancel()
+        elif kind == 'mcp':
+            payload = message.get('payload', {})
+            pending = self.mcp_pending.pop(payload.get('id'), None)
+            if pending:
+                future, method, start = pending
+                self.add_latency('mcp ' + method, time.monotonic() - start)
+                if not future.done():
+                    future.set_result(payload)
+        elif kind == 'audio_stats':
+            self.log('Device receive stats %s' % json.dumps(message.get('udp')))
+        elif kind == 'goodbye':
+            self.close()
+        self.messages.put_nowait(message)
+
+    def on_audio(self, payload, timestamp, sequence=None):
+        now = time.monotonic()
+        self.stats['up_packets'] += 1
+        self.stats['up_bytes'] += len(payload)
+        if self.last_up_time is not None:
+            # RFC 3550 style inter-arrival jitter against the frame duration
+            deviation = abs((now - self.last_up_time) * 1000 - OPUS_FRAME_DURATION_MS)
+            self.up_jitter += (deviation - self.up_jitter) / 16
+        self.last_up_time = now
+        if sequence is not None:
+            if self.last_sequence is not None and sequence != self.last_sequence + 1:
+                self.stats['up_gaps'] += 1
+            self.last_sequence = sequence
+        self.server.recorder.log(self.id, 'up', 'audio', sequence if sequence is not None else timestamp, len(payload),
+                                 'received')
+        if self.server.uplink_file:
+            self.server.uplink_file.write(struct.pack('<H', len(payload)) + payload)
+        if self.listening:
+            self.turn_packets += 1
+            self.turn_bytes += len(payload)
+            self.turn_audio.append(payload)
+            if self.server.script is None and \
+                    len(self.turn_audio) * OPUS_FRAME_DURATION_MS >= self.args.turn_seconds * 1000:
+                self.end_turn()
+
+    def stop_listening(self, end_time):
+        if self.listening and self.listen_start is not None:
+            seconds = end_time - self.listen_start
+            frames = int(seconds * 1000 / OPUS_FRAME_DURATION_MS)
+            self.stats['listen_seconds'] += seconds
+            self.stats['listen_packets'] += self.turn_packets
+            self.stats['listen_bytes'] += self.turn_bytes
+            self.log('Turn of %.1fs: %d packets, %d bytes (%d bytes/min), ~%d frames left out' % (
+                seconds, self.turn_packets, self.turn_bytes, self.turn_bytes * 60 / max(seconds, 0.001),
+                max(frames - self.turn_packets, 0)))
+            if self.args.save_turns and self.turn_audio:
+                self.save_turn(self.turn_audio)
+        self.listening = False
+        self.end_turn(end_time)
+
+    def save_turn(self, packets):
+        self.server.turn_count += 1
+        path = os.path.join(self.args.save_turns, 'turn_%04d%s.opus' % (
+            self.server.turn_count, '_gated' if self.vad_gate else ''))
+        with open(path, 'wb') as f:
+            for payload in packets:
+                f.write(struct.pack('<H', len(payload)) + payload)
+
+    def end_turn(self, end_time=None):
+        if self.turn_audio:
+            self.last_turn_audio = self.turn_audio
+        self.turn_audio = []
+        self.turn_end_time = end_time or time.monotonic()
+        if self.server.script is None and self.last_turn_audio:
+            self.speak('Echo of %.1f seconds' % (len(self.last_turn_audio) * OPUS_FRAME_DURATION_MS / 1000), 'echo')
+
+    def speak(self, text, audio, emotion='happy'):
+        if self.speaking_task and not self.speaking_task.done():
+            self.speaking_task.cancel()
+        self.speaking_task = asyncio.create_task(self.stream_tts(text, audio, emotion))
+        return self.speaking_task
+
+    async def stream_tts(self, text, audio, emotion):
+        packets = self.last_turn_audio if audio == 'echo' else self.server.load_audio(audio)
+        self.send_json({'type': 'stt', 'text': text})
+        self.send_json({'type': 'llm', 'emotion': emotion})
+        self.send_json({'type': 'tts', 'state': 'start'})
+        self.send_json({'type': 'tts', 'state': 'sentence_start', 'text': text})
+        start = time.monotonic()
+        try:
+            for i, payload in enumerate(packets):
+                # A few packets ahead like the real server, then at the frame rate
+                at = start + max(i - self.args.prebuffer, 0) * OPUS_FRAME_DURATION_MS / 1000
+                await asyncio.sleep(max(at - time.monotonic(), 0))
+                if i == 0 and self.turn_end_time is not None:
+                    self.add_latency('turn end to first audio', time.monotonic() - self.turn_end_time)
+                self.send_audio(payload, int((time.monotonic() - self.created) * 1000))
+            # Stop after the last packet has left the link
+            await asyncio.sleep(max(self.transport.down_link.last_time - time.monotonic(), 0))
+        except asyncio.CancelledError:
+            self.log('TTS aborted')
+        self.send_json({'type': 'tts', 'state': 'stop'})
+
+    def send_audio(self, payload, timestamp):
+        link = self.transport.down_link
+        delay = link.schedule(len(payload))
+        self.stats['down_packets'] += 1
+        if delay is None:
+            self.stats['down_dropped'] += 1
+            self.server.recorder.log(self.id, 'down', 'audio', self.stats['down_packets'], len(payload), 'dropped')
+            return
+        self.server.recorder.log(self.id, 'down', 'audio', self.stats['down_packets'], len(payload), 'sent',
+                                 delay * 1000)
+        asyncio.get_running_loop().call_later(delay, self.transport.send_audio, payload, timestamp)
+
+    async def mcp_call(self, method, params, wait=True, timeout=10):
+        self.mcp_id += 1
+        future = asyncio.get_running_loop().create_future()
+        self.mcp_pending[self.mcp_id] = (future, method, time.monotonic())
+        self.send_json({'type': 'mcp', 'payload': {'jsonrpc': '2.0', 'method': method, 'params': params,
+                                                   'id': self.mcp_id}})
+        if not wait:
+            return None
+        try:
+            return await asyncio.wait_for(future, timeout)
+        except asyncio.TimeoutError:
+            self.log('MCP %s timed out' % method)
+            return None
+
+    async def wait_message(self, pattern, timeout):
+        kind, _, state = pattern.partition(':')
+        deadline = time.monotonic() + timeout
+        while True:
+            message = await asyncio.wait_for(self.messages.get(), max(deadline - time.monotonic(), 0))
+            if message.get('type') == kind and (not state or message.get('state') == state):
+                return message
+
+    async def run_script(self, steps):
+        try:
+            for step in steps:
+                if self.closed:
+                    return
+                if 'repeat' in step:
+                    for _ in range(step['repeat']):
+                        await self.run_script(step['steps'])
+                elif 'wait' in step:
+                    start = time.monotonic()
+                    await self.wait_message(step['wait'], step.get('timeout', 30))
+                    self.add_latency('wait ' + step['wait'], time.monotonic() - start)
+                elif 'sleep' in step:
+                    await asyncio.sleep(step['sleep'])
+                elif 'send' in step:
+                    self.send_json(dict(step['send']))
+                elif 'speak' in step:
+                    if step.get('audio', 'echo') == 'echo':
+                        self.end_turn()
+                    await self.speak(step['speak'], step.get('audio', 'echo'), step.get('emotion', 'happy'))
+                elif 'mcp' in step:
+                    params = {'name': step['name'], 'arguments': step.get('arguments', {})} if 'name' in step else {}
+                    result = await self.mcp_call(step['mcp'], params, timeout=step.get('timeout', 10))
+                    self.log('MCP %s -> %s' % (step['mcp'], json.dumps(result, ensure_ascii=False)[:200]))
+                elif step.get('goodbye'):
+                    self.send_json({'type': 'goodbye'})
+                    self.transport.close()
+        except asyncio.TimeoutError:
+            self.log('Script step timed out, session ends')
+            self.transport.close()
+
+    def close(self):
+        if self.closed:
+            return
+        self.closed = True
+        if self.speaking_task:
+            self.speaking_task.cancel()
+        if self.server.uplink_file:
+            self.server.uplink_file.flush()
+        self.print_stats()
+
+    def print_stats(self):
+        stats = self.stats
+        elapsed = time.monotonic() - self.created
+        self.log('Closed after %.1fs: up %d packets (%d bytes, %d gaps, jitter %.1fms), down %d packets (%d dropped)' % (
+            elapsed, stats['up_packets'], stats['up_bytes'], stats['up_gaps'], self.up_jitter,
+            stats['down_packets'], stats['down_dropped']))
+        if stats['listen_seconds'] > 0:
+            self.log('  listening %.1fs, %d bytes per minute of conversation, %d%% of the frames sent' % (
+                stats['listen_seconds'], stats['listen_bytes'] * 60 / stats['listen_seconds'],
+                stats['listen_packets'] * OPUS_FRAME_DURATION_MS / 10 / stats['listen_seconds']))
+        if stats['up_packets'] > 0:
+            # Opus payload only, per packet of OPUS_FRAME_DURATION_MS
+            self.log('  uplink %.1f kbps while sending, %.0f bytes per packet, %d dropped by the link' % (
+                stats['up_bytes'] * 8 / (stats['up_packets'] * OPUS_FRAME_DURATION_MS),
+                stats['up_bytes'] / stats['up_packets'], stats['up_dropped']))
+        for name, values in self.latencies.items():
+            values = sorted(values)
+            self.log('  %-28s n=%-4d min %.1fms p50 %.1fms max %.1fms' % (
+                name, len(values), values[0], values[len(values) // 2], values[-1]))
+
+
+# WebSocket transport
+
+WS_GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+
+
+async def read_http_request(reader):
+    request_line = (await reader.readline()).decode(errors='replace').strip()
+    headers = {}
+    while True:
+        line = (await reader.readline()).decode(errors='replace').strip()
+        if not line:
+            break
+        key, _, value = line.partition(':')
+        headers[key.strip().lower()] = value.strip()
+    return request_line, headers
+
+
+class WebsocketTransport:
+    name = 'websocket'
+
+    def __init__(self, server, writer, version):
+        self.server = server
+        self.writer = writer
+        self.version = version
+        self.down_link = Link(server.args, reliable=True, bandwidth=server.args.bandwidth)
+        self.up_link = Link(server.args, reliable=True, bandwidth=server.args.up_bandwidth)
+
+    def send_frame(self, opcode, data):
+        if self.writer.is_closing():
+            return
+        header = bytearray([0x80 | opcode])
+        if len(data) < 126:
+            header.append(len(data))
+        elif len(data) < 65536:
+            header += struct.pack('>BH', 126, len(data))
+        else:
+            header += struct.pack('>BQ', 127, len(data))
+        self.writer.write(bytes(header) + data)
+
+    def send_json(self, message):
+        data = json.dumps(message, ensure_ascii=False).encode()
+        self.server.capture.write(CAPTURE_JSON, data)
+        self.send_frame(0x1, data)
+
+    def send_audio(self, payload, timestamp):
+        if self.version == 2:
+            data = struct.pack('>HHIII', 2, 0, 0, timestamp, len(payload)) + payload
+        elif self.version == 3:
+            data = struct.pack('>BBH', 0, 0, len(payload)) + payload
+        else:
+            data = payload
+        self.server.capture.write(CAPTURE_BINARY, data, self.version)
+        self.send_frame(0x2, data)
+
+    def parse_audio(self, data):
+        if self.version == 2:
+            _, kind, _, timestamp, size = struct.unpack_from('>HHIII', data)
+            return data[16:16 + size], timestamp
+        if self.version == 3:
+            _, _, size = struct.unpack_from('>BBH', data)
+            return data[4:4 + size], 0
+        return data, 0
+
+    def close(self):
+        self.send_frame(0x8, struct.pack('>H', 1000))
+        self.writer.close()
+
+
+async def read_ws_frame(reader):
+    '''Returns (opcode, payload) of a complete message'''
+    message = bytearray()
+    message_opcode = None
+    while True:
+        b0, b1 = await reader.readexactly(2)
+        opcode = b0 & 0x0F
+        length = b1 & 0x7F
+        if length == 126:
+            length = struct.unpack('>H', await reader.readexactly(2))[0]
+        elif length == 127:
+            length = struct.unpack('>Q', await reader.readexactly(8))[0]
+        mask = await reader.readexactly(4) if b1 & 0x80 else b'\0\0\0\0'
+        data = await reader.readexactly(length)
+        data = bytes(b ^ mask[i % 4] for i, b in enumerate(data))
+        if opcode >= 0x8:
+            return opcode, data  # Control frames are never fragmented
+        if opcode != 0:
+            message_opcode = opcode
+        message += data
+        if b0 & 0x80:
+            return message_opcode, bytes(message)
+
+
+async def handle_websocket(server, reader, writer):
+    peer = writer.get_extra_info('peername')
+    connected = time.monotonic()
+    request_line, headers = await read_http_request(reader)
+    key = headers.get('sec-websocket-key')
+    if key is None:
+        writer.write(b'HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n')
+        writer.close()
+        return
+    accept = base64.b64encode(hashlib.sha1((key + WS_GUID).encode()).digest()).decode()
+    writer.write(('HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n'
+                  'Sec-WebSocket-Accept: %s\r\n\r\n' % accept).encode())
+    version = int(headers.get('protocol-version', '1'))
+    transport = WebsocketTransport(server, writer, version)
+    print('WebSocket connection from %s:%d, %s, version %d, device %s' % (
+        peer[0], peer[1], request_line.split(' ')[1] if ' ' in request_line else '', version,
+        headers.get('device-id')))
+
+    session = None
+    try:
+        while True:
+            opcode, data = await read_ws_frame(reader)
+            if opcode == 0x8:
+                break
+            if opcode == 0x9:
+                transport.send_frame(0xA, data)
+            elif opcode == 0x1:
+                message = json.loads(data)
+                if message.get('type') == 'hello':
+                    session = Session(server, transport, 'ws')
+                    session.created = connected
+                    transport.send_json(session.hello_reply(message))
+                    await session.start()
+                elif session:
+                    session.on_json(message)
+            elif opcode == 0x2 and session:
+                payload, timestamp = transport.parse_audio(data)
+                if server.args.up_bandwidth > 0:
+                    # Stop reading until the frame has passed the bottleneck, the device's send blocks
+                    await asyncio.sleep(transport.up_link.schedule(len(data)))
+                session.on_audio(payload, timestamp)
+    except (asyncio.IncompleteReadError, ConnectionError, json.JSONDecodeError, struct.error) as e:
+        if not isinstance(e, asyncio.IncompleteReadError):
+            print('WebSocket error from %s: %s' % (peer[0], e))
+    finally:
+        if session:
+            session.close()
+        writer.close()
+
+
+# MQTT broker for the JSON messages, audio over encrypted UDP
+
+class UdpTransport:
+    name = 'udp'
+
+    def __init__(self, server, mqtt):
+        self.server = server
+        self.mqtt = mqtt
+        self.key = os.urandom(16)
+        self.ssrc = random.getrandbits(32)
+        self.nonce = struct.pack('>BBHIII', 1, 0, 0, self.ssrc, 0, 0)
+        self.aes = Aes128(self.key)
+        server.capture.write(CAPTURE_UDP_KEY, self.key)
+        self.address = None
+        self.sequence = 0
+        self.down_link = Link(server.args, reliable=False, bandwidth=server.args.bandwidth)
+        self.up_link = Link(server.args, reliable=False, bandwidth=server.args.up_bandwidth)
+
+    def hello_block(self):
+        block = {'server': self.server.host_ip, 'port': self.server.args.udp_port, 'encryption': 'aes-128-ctr',
+                 'key': self.key.hex().upper(), 'nonce': self.nonce.hex().upper()}
+        if self.server.args.udp_resume_seconds > 0:
+            block['resume_seconds'] = self.server.args.udp_resume_seconds
+        return block
+
+    def send_json(self, message):
+        self.mqtt.publish(json.dumps(message, ensure_ascii=False).encode())
+
+    def send_audio(self, payload, timestamp):
+        if self.address is None:
+            return  # The device has not sent anything yet, its address is unknown
+        self.sequence += 1
+        header = struct.pack('>BBHIII', 1, 0, len(payload), self.ssrc, timestamp, self.sequence)
+        data = header + self.aes.ctr(header, payload)
+        self.server.capture.write(CAPTURE_UDP, data)
+        self.server.udp.sendto(data, self.address)
+
+    def close(self):
+        self.mqtt.close()
+
+
+class MqttConnection:
+    def __init__(self, server, reader, writer):
+        self.server = server
+        self.reader = reader
+        self.writer = writer
+        self.topic = server.args.mqtt_topic
+        self.session = None
+        self.client_id = None
+        self.connected = time.monotonic()
+
+    async def read_packet(self):
+        header = (await self.reader.readexactly(1))[0]
+        length, shift = 0, 0
+        while True:
+            byte = (await self.reader.readexactly(1))[0]
+            length |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        return header, await self.reader.readexactly(length)
+
+    def write_packet(self, header, body):
+        if self.writer.is_closing():
+            return
+        length = bytearray()
+        remaining = len(body)
+        while True:
+            byte = remaining & 0x7F
+            remaining >>= 7
+            length.append(byte | (0x80 if remaining else 0))
+            if not remaining:
+                break
+        self.writer.write(bytes([header]) + bytes(length) + body)
+
+    def publish(self, payload):
+        self.server.capture.write(CAPTURE_JSON, payload)
+        topic = self.topic.encode()
+        self.write_packet(0x30, struct.pack('>H', len(topic)) + topic + payload)
+
+    def close(self):
+        self.writer.close()
+
+    def on_connect(self, body):
+        name_length = struct.unpack_from('>H', body)[0]
+        offset = 2 + name_length + 1
+        flags = body[offset]
+        keepalive = struct.unpack_from('>H', body, offset + 1)[0]
+        offset += 3
+        fields = []
+        while offset < len(body):
+            size = struct.unpack_from('>H', body, offset)[0]
+            fields.append(body[offset + 2:offset + 2 + size].decode(errors='replace'))
+            offset += 2 + size
+        client_id = fields[0] if fields else ''
+        self.client_id = client_id
+        if flags & 0x04:
+            fields = fields[:1] + fields[3:]  # Skip the will topic and message
+        password = fields[2] if flags & 0x40 and len(fields) > 2 else ''
+        accepted = not self.server.args.mqtt_password or password == self.server.args.mqtt_password
+        self.write_packet(0x20, bytes([0, 0 if accepted else 5]))
+        print('MQTT connection from %s, client %s, keepalive %ds, clean session %d%s' % (
+            self.writer.get_extra_info('peername')[0], client_id, keepalive, (flags >> 1) & 1,
+            '' if accepted else ', bad password'))
+        parked = self.server.parked_sessions.pop(client_id, None)
+        if accepted and parked:
+            # The device came back while its conversation was still going, the UDP channel never stopped
+            session, expiry = parked
+            expiry.cancel()
+            session.transport.mqtt = self
+            self.session = session
+            session.log('Reattached after an MQTT outage of %.1fs' % (time.monotonic() - session.parked_time))
+        return accepted
+
+    async def on_publish(self, header, body):
+        size = struct.unpack_from('>H', body)[0]
+        offset = 2 + size
+        if (header >> 1) & 0x03:
+            packet_id = body[offset:offset + 2]
+            offset += 2
+            self.write_packet(0x40, packet_id)
+        message = json.loads(body[offset:])
+        if message.get('type') == 'hello':
+            if self.session:
+                self.session.close()
+                self.server.udp_sessions.pop(self.session.transport.ssrc, None)
+            resumed = self.server.resumable_sessions.pop(message.get('resume'), None)
+            if resumed and resumed[1] < time.monotonic():
+                resumed = None
+            transport = resumed[0] if resumed else UdpTransport(self.server, self)
+            transport.mqtt = self
+            self.session = Session(self.server, transport, 'mqtt')
+            self.server.udp_sessions[transport.ssrc] = self.session
+            reply = self.session.hello_reply(message)
+            if resumed:
+                # Same key, nonce and sequence, the device keeps what it has
+                self.session.id = message['resume']
+                reply['session_id'] = self.session.id
+                reply['udp'] = {'resumed': True, 'resume_seconds': self.server.args.udp_resume_seconds}
+                self.session.log('Resumed UDP session')
+            else:
+                reply['udp'] = transport.hello_block()
+            self.publish(json.dumps(reply).encode())
+            await self.session.start()
+        elif self.session:
+            self.session.on_json(message)
+            if message.get('type') == 'goodbye':
+                self.server.udp_sessions.pop(self.session.transport.ssrc, None)
+                if self.server.args.udp_resume_seconds > 0:
+                    self.server.resumable_sessions[self.session.id] = (
+                        self.session.transport, time.monotonic() + self.server.args.udp_resume_seconds)
+                self.session = None
+
+    async def run(self):
+        try:
+            header, body = await self.read_packet()
+            if header >> 4 != 1 or not self.on_connect(body):
+                return
+            while True:
+                header, body = await self.read_packet()
+                kind = header >> 4
+                if kind == 3:
+                    await self.on_publish(header, body)
+                elif kind == 8:
+                    count = max((len(body) - 2) // 4, 1)
+                    self.write_packet(0x90, body[:2] + bytes(count))
+                elif kind == 12:
+                    self.write_packet(0xD0, b'')
+                elif kind == 14:
+                    self.client_id = None  # A clean disconnect ends the session
+                    break
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        except (json.JSONDecodeError, struct.error, IndexError) as e:
+            print('MQTT protocol error: %s' % e)
+        finally:
+            if self.session and self.server.args.udp_resume_seconds > 0 and self.client_id:
+                self.park_session()
+            elif self.session:
+                self.server.udp_sessions.pop(self.session.transport.ssrc, None)
+                self.session.close()
+            self.writer.close()
+
+    def park_session(self):
+        # Keeps the session of a dropped connection, its UDP audio goes on until the device reconnects
+        session = self.session
+        session.parked_time = time.monotonic()
+
+        def expire():
+            if self.server.parked_sessions.get(self.client_id, (None,))[0] is session:
+                del self.server.parked_sessions[self.client_id]
+                self.server.udp_sessions.pop(session.transport.ssrc, None)
+                session.log('Not reattached within %ds' % self.server.args.udp_resume_seconds)
+                session.close()
+
+        handle = asyncio.get_running_loop().call_later(self.server.args.udp_resume_seconds, expire)
+        self.server.parked_sessions[self.client_id] = (session, handle)
+        session.log('MQTT connection lost, keeping the session for %ds' % self.server.args.udp_resume_seconds)
+
+
+class UdpProtocol(asyncio.DatagramProtocol):
+    def __init__(self, server):
+        self.server = server
+
+    def datagram_received(self, data, address):
+        if len(data) < 16 or data[0] != 0x01:
+            return
+        _, _, size, ssrc, timestamp, sequence = struct.unpack_from('>BBHIII', data)
+        session = self.server.udp_sessions.get(ssrc)
+        if session is None:
+            return
+        transport = session.transport
+        transport.address = address
+        delay = transport.up_link.schedule(len(data))
+        if delay is None:
+            session.stats['up_dropped'] += 1
+            self.server.recorder.log(session.id, 'up', 'audio', sequence, len(data), 'dropped')
+            return
+        payload = transport.aes.ctr(data[:16], data[16:16 + size])
+        asyncio.get_running_loop().call_later(delay, session.on_audio, payload, timestamp, sequence)
+
+
+# OTA endpoint, also serves captures to replay
+
+def serve_file(writer, path):
+    name = os.path.basename(path.split('?')[0])
+    if not name.endswith('.bin') or not os.path.isfile(name):
+        writer.write(b'HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n')
+        return
+    with open(name, 'rb') as f:
+        data = f.read()
+    writer.write(b'HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %d\r\n'
+                 b'Connection: close\r\n\r\n' % len(data) + data)
+    print('Served %s (%d bytes) to %s' % (name, len(data), writer.get_extra_info('peername')[0]))
+
+
+async def handle_http(server, reader, writer):
+    try:
+        request_line, headers = await read_http_request(reader)
+        body = await reader.readexactly(int(headers.get('content-length', 0)))
+        method, _, path = request_line.partition(' ')
+        if method == 'GET' and path.split(' ')[0].endswith('.bin'):
+            serve_file(writer, path.split(' ')[0])
+            await writer.drain()
+            return
+        try:
+            version = json.loads(body)['application']['version']
+        except (ValueError, KeyError, TypeError):
+            version = '0.0.0'
+        reply = {
+            'server_time': {'timestamp': int(time.time() * 1000), 'timezone_offset': server.args.timezone_offset},
+            'firmware': {'version': version, 'url': ''},
+        }
+        args = server.args
+        if args.transport == 'mqtt':
+            reply['mqtt'] = {'endpoint': '%s:%d' % (server.host_ip, args.mqtt_port), 'client_id': 'mock',
+                             'username': 'mock', 'password': args.mqtt_password or 'mock',
+                             'publish_topic': 'device-server', 'subscribe_topic': args.mqtt_topic}
+        else:
+            # No mqtt section, the device drops a broker saved by an earlier MQTT run
+            reply['websocket'] = {'url': 'ws://%s:%d/xiaozhi/v1/' % (server.host_ip, args.ws_port),
+                                  'token': 'mock-token', 'version': args.ws_version}
+        data = json.dumps(reply).encode()
+        writer.write(b'HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %d\r\n'
+                     b'Connection: close\r\n\r\n' % len(data) + data)
+        print('OTA %s from %s (firmware %s), sent the %s config' % (
+            request_line.split(' ')[0], writer.get_extra_info('peername')[0], version, args.transport))
+        await writer.drain()
+    except (asyncio.IncompleteReadError, ConnectionError):
+        pass
+    finally:
+        writer.close()
+
+
+class MockServer:
+    def __init__(self, args):
+        self.args = args
+        self.host_ip = args.host_ip or self.guess_host_ip()
+        self.recorder = Recorder(args.record)
+        self.capture = Capture(args.capture)
+        self.script = None
+        if args.script:
+            with open(args.script) as f:
+                self.script = json.load(f)
+        self.uplink_file = open(args.save_uplink, 'wb') if args.save_uplink else None
+        self.turn_count = 0
+        if args.save_turns:
+            os.makedirs(args.save_turns, exist_ok=True)
+        self.udp_sessions = {}
+        self.parked_sessions = {}       # client_id: (session, expiry handle), MQTT dropped mid-conversation
+        self.resumable_sessions = {}    # session_id: (UDP transport, expiry time), after goodbye
+        self.udp = None
+        self.audio_files = {}
+
+    @staticmethod
+    def guess_host_ip():
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+            try:
+                s.connect(('10.255.255.255', 1))  # No packet is sent
+                return s.getsockname()[0]
+            except OSError:
+                return '127.0.0.1'
+
+    def load_audio(self, path):
+        if path not in self.audio_files:
+            packets = []
+            with open(path, 'rb') as f:
+                data = f.read()
+            offset = 0
+            while offset + 2 <= len(data):
+                size = struct.unpack_from('<H', data, offset)[0]
+                packets.append(data[offset + 2:offset + 2 + size])
+                offset += 2 + size
+            self.audio_files[path] = packets
+        return self.audio_files[path]
+
+    async def run(self):
+        args = self.args
+        loop = asyncio.get_running_loop()
+        await asyncio.start_server(lambda r, w: handle_http(self, r, w), '0.0.0.0', args.http_port)
+        await asyncio.start_server(lambda r, w: handle_websocket(self, r, w), '0.0.0.0', args.ws_port)
+        await asyncio.start_server(lambda r, w: MqttConnection(self, r, w).run(), '0.0.0.0', args.mqtt_port)
+        self.udp, _ = await loop.create_datagram_endpoint(lambda: UdpProtocol(self), local_addr=('0.0.0.0', args.udp_port))
+        print('OTA URL http://%s:%d/xiaozhi/ota/ (%s), WebSocket :%d, MQTT :%d, UDP :%d' % (
+            self.host_ip, args.http_port, args.transport, args.ws_port, args.mqtt_port, args.udp_port))
+        await asyncio.Event().wait()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local mock xiaozhi server')
+    parser.add_argument('--transport', choices=['websocket', 'mqtt'], default='websocket',
+                        help='config returned by the OTA endpoint')
+    parser.add_argument('--host-ip', help='address the device uses to reach this machine')
+    parser.add_argument('--http-port', type=int, default=8002)
+    parser.add_argument('--ws-port', type=int, default=8000)
+    parser.add_argument('--ws-version', type=int, default=1, choices=[1, 2, 3])
+    parser.add_argument('--mqtt-port', type=int, default=1883)
+    parser.add_argument('--mqtt-topic', default='devices/p2p/mock', help='topic of the messages to the device')
+    parser.add_argument('--mqtt-password', default='', help='reject other passwords')
+    parser.add_argument('--udp-resume-seconds', type=int, default=0,
+                        help='keep UDP sessions this long after an MQTT drop or goodbye for the device to resume')
+    parser.add_argument('--udp-port', type=int, default=8888)
+    parser.add_argument('--timezone-offset', type=int, default=480, help='minutes')
+    parser.add_argument('--script', help='canned session, JSON list of steps')
+    parser.add_argument('--turn-seconds', type=float, default=3.0, help='answer after this much audio')
+    parser.add_argument('--prebuffer', type=int, default=3, help='TTS packets sent ahead of real time')
+    parser.add_argument('--save-uplink', help='append the received Opus packets to this file')
+    parser.add_argument('--record', help='per-packet timing CSV')
+    parser.add_argument('--vad-gate', action='store_true',
+                        help='accept the vad_gate feature, the device may leave out silence while listening')
+    parser.add_argument('--save-turns', help='write every listening turn to DIR/turn_NNNN[_gated].opus')
+    parser.add_argument('--capture', help='write the messages sent to the device to this capture file')
+    parser.add_argument('--latency-ms', type=float, default=0)
+    parser.add_argument('--jitter-ms', type=float, default=0)
+    parser.add_argument('--loss', type=float, default=0, help='UDP packet loss probability')
+    parser.add_argument('--reorder', type=float, default=0, help='UDP reorder probability')
+    parser.add_argument('--bandwidth', type=float, default=0, help='server to device audio bytes per second, 0 for unlimited')
+    parser.add_argument('--up-bandwidth', type=float, default=0,
+                        help='device to server audio bytes per second, 0 for unlimited')
+    parser.add_argument('--queue-ms', type=float, default=500,
+                        help='UDP packets waiting longer than this at a bandwidth limit are dropped')
+    parser.add_argument('--disconnect-after', type=float, default=0, help='close every session after N seconds')
+    parser.add_argument('--seed', type=int, help='random seed for reproducible fault patterns')
+    args = parser.parse_args()
+    if args.seed is not None:
+        random.seed(args.seed)
+    try:
+        asyncio.run(MockServer(args).run())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
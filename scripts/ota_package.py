@@ -0,0 +1,380 @@
+import argparse
+import hashlib
+import random
+import struct
+import sys
+
+
+'''
+  Build compressed and delta OTA packages (main/ota_package.h).
+
+    pack   new.bin -o new.xzpk                 LZ4 compressed image
+    delta  old.bin new.bin -o new.delta.xzpk   delta against the running image old.bin
+    apply  package [--base old.bin] -o out.bin decode a package like the device does
+    selftest                                   round trip on generated images
+
+  The delta is a list of COPY / ADD / INSERT operations (bsdiff style): regions found in
+  the old image are encoded as byte differences, so code that moved and had its addresses
+  relocated still turns into mostly zero bytes, which the LZ4 stage then removes.
+  The operation stream is LZ4 compressed in independent blocks of --block-size bytes.
+
+  "apply" reads the base from a file padded with 0xFF up to the partition size, like the
+  device reads its running partition, and checks the image and base SHA-256.
+'''
+MAGIC = b'XZPK'
+VERSION = 1
+FORMAT_LZ4 = 1
+FORMAT_DELTA = 2
+HEADER = struct.Struct('<4sBBHIIII32s32s')
+MAX_BLOCK_SIZE = 64 * 1024
+
+OP_COPY = 0
+OP_ADD = 1
+OP_INSERT = 2
+
+MIN_MATCH = 4
+MAX_OFFSET = 65535
+
+
+def match_length(a, i, b, j, limit):
+    # Length of the common prefix of a[i:] and b[j:], at most limit, compares slices in C
+    n = 0
+    step = 64
+    while n < limit:
+        k = min(step, limit - n)
+        if a[i + n:i + n + k] == b[j + n:j + n + k]:
+            n += k
+            step *= 2
+        elif k == 1:
+            break
+        else:
+            step = max(1, k // 2)
+    return n
+
+
+def lz4_compress_block(src):
+    '''Greedy LZ4 block compressor, follows the end of block rules of the LZ4 format'''
+    n = len(src)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+    match_limit = n - 12
+
+    def write_length(value):
+        while value >= 255:
+            out.append(255)
+            value -= 255
+        out.append(value)
+
+    while i < match_limit:
+        key = src[i:i + 4]
+        candidate = table.get(key)
+        table[key] = i
+        if candidate is None or i - candidate > MAX_OFFSET:
+            i += 1
+            continue
+        length = MIN_MATCH + match_length(src, i + MIN_MATCH, src, candidate + MIN_MATCH, n - 5 - i - MIN_MATCH)
+        literals = i - anchor
+        token = (min(literals, 15) << 4) | min(length - MIN_MATCH, 15)
+        out.append(token)
+        if literals >= 15:
+            write_length(literals - 15)
+        out += src[anchor:i]
+        out += struct.pack('<H', i - candidate)
+        if length - MIN_MATCH >= 15:
+            write_length(length - MIN_MATCH - 15)
+        i += length
+        anchor = i
+        if i < match_limit:
+            table[src[i - 2:i + 2]] = i - 2
+
+    literals = n - anchor
+    out.append(min(literals, 15) << 4)
+    if literals >= 15:
+        write_length(literals - 15)
+    out += src[anchor:]
+    return bytes(out)
+
+
+def lz4_decompress_block(src, size):
+    out = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+        literals = token >> 4
+        if literals == 15:
+            while True:
+                b = src[i]
+                i += 1
+                literals += b
+                if b != 255:
+                    break
+        out += src[i:i + literals]
+        i += literals
+        if i == len(src):
+            break
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        length = (token & 15) + MIN_MATCH
+        if token & 15 == 15:
+            while True:
+                b = src[i]
+                i += 1
+                length += b
+                if b != 255:
+                    break
+        if offset == 0 or offset > len(out):
+            raise ValueError('bad match offset')
+        start = len(out) - offset
+        for k in range(length):
+            out.append(out[start + k])
+    if len(out) != size:
+        raise ValueError('block size mismatch')
+    return bytes(out)
+
+
+def make_delta(old, new, min_match=32):
+    '''Greedy bsdiff style matcher, returns the operation stream'''
+    index = {}
+    for k in range(0, len(old) - 8, 4):
+        index.setdefault(old[k:k + 8], k)
+
+    ops = bytearray()
+    stats = {'copy': 0, 'add': 0, 'insert': 0}
+
+    def insert(start, end):
+        if end > start:
+            ops.extend(struct.pack('<BI', OP_INSERT, end - start))
+            ops.extend(new[start:end])
+            stats['insert'] += end - start
+
+    def extend(start, source):
+        # Exact run first, then 32 byte windows while at least half of the bytes match
+        end = start + match_length(new, start, old, source, min(len(new) - start, len(old) - source))
+        while True:
+            window = min(32, len(new) - end, len(old) - (source + end - start))
+            if window < 8:
+                break
+            a = new[end:end + window]
+            b = old[source + end - start:source + end - start + window]
+            if sum(x == y for x, y in zip(a, b)) * 2 < window:
+                break
+            end += window
+            end += match_length(new, end, old, source + end - start, min(len(new) - end, len(old) - (source + end - start)))
+        return end
+
+    pos = 0
+    pending = 0
+    last_shift = None
+    while pos <= len(new) - 8:
+        candidates = []
+        if last_shift is not None and 0 <= pos + last_shift <= len(old) - 8:
+            candidates.append(pos + last_shift)
+        found = index.get(new[pos:pos + 8])
+        if found is not None:
+            candidates.append(found)
+        best = None
+        for source in candidates:
+            # Grow backwards into the pending insert with exact bytes
+            back = 0
+            while pos - back > pending and source - back > 0 and new[pos - back - 1] == old[source - back - 1]:
+                back += 1
+            start = pos - back
+            end = extend(start, source - back)
+            if best is None or end - start > best[1] - best[0]:
+                best = (start, end, source - back)
+        if best is None or best[1] - best[0] < min_match:
+            pos += 1
+            continue
+
+        start, end, source = best
+        insert(pending, start)
+        diff = bytes((x - y) & 0xFF for x, y in zip(new[start:end], old[source:source + end - start]))
+        if diff.count(0) == len(diff):
+            ops.extend(struct.pack('<BII', OP_COPY, source, end - start))
+            stats['copy'] += end - start
+        else:
+            ops.extend(struct.pack('<BII', OP_ADD, source, end - start))
+            ops.extend(diff)
+            stats['add'] += end - start
+        last_shift = source - start
+        pos = pending = end
+
+    insert(pending, len(new))
+    return bytes(ops), stats
+
+
+def build_package(fmt, stream, image, base, block_size):
+    blocks = bytearray()
+    for offset in range(0, len(stream), block_size):
+        block = stream[offset:offset + block_size]
+        compressed = lz4_compress_block(block)
+        if len(compressed) >= len(block):
+            blocks += struct.pack('<I', 0x80000000 | len(block)) + block
+        else:
+            blocks += struct.pack('<I', len(compressed)) + compressed
+    header = HEADER.pack(MAGIC, VERSION, fmt, 0, block_size, len(stream), len(image), len(base),
+                         hashlib.sha256(image).digest(), hashlib.sha256(base).digest())
+    return header + bytes(blocks)
+
+
+def apply_package(package, partition):
+    '''Reference decoder, partition is the running partition content (image + 0xFF)'''
+    magic, version, fmt, _, block_size, stream_size, image_size, base_size, image_sha, base_sha = \
+        HEADER.unpack_from(package)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('not a package')
+    if not 0 < block_size <= MAX_BLOCK_SIZE:
+        raise ValueError('bad block size')
+
+    stream = bytearray()
+    pos = HEADER.size
+    while len(stream) < stream_size:
+        value, = struct.unpack_from('<I', package, pos)
+        pos += 4
+        length = value & 0x7FFFFFFF
+        expected = min(block_size, stream_size - len(stream))
+        data = package[pos:pos + length]
+        pos += length
+        stream += data if value & 0x80000000 else lz4_decompress_block(data, expected)
+
+    if fmt == FORMAT_LZ4:
+        image = bytes(stream)
+    elif fmt == FORMAT_DELTA:
+        if hashlib.sha256(partition[:base_size]).digest() != base_sha:
+            raise ValueError('base image does not match')
+        image = bytearray()
+        i = 0
+        while i < len(stream):
+            op = stream[i]
+            if op == OP_INSERT:
+                length, = struct.unpack_from('<I', stream, i + 1)
+                image += stream[i + 5:i + 5 + length]
+                i += 5 + length
+                continue
+            source, length = struct.unpack_from('<II', stream, i + 1)
+            if source + length > base_size:
+                raise ValueError('operation outside of the base image')
+            if op == OP_COPY:
+                image += partition[source:source + length]
+                i += 9
+            elif op == OP_ADD:
+                diff = stream[i + 9:i + 9 + length]
+                image += bytes((x + y) & 0xFF for x, y in zip(partition[source:source + length], diff))
+                i += 9 + length
+            else:
+                raise ValueError('unknown operation %d' % op)
+        image = bytes(image)
+    else:
+        raise ValueError('unknown format %d' % fmt)
+
+    if len(image) != image_size or hashlib.sha256(image).digest() != image_sha:
+        raise ValueError('image SHA-256 mismatch')
+    return image
+
+
+def synthetic_image(rng, size):
+    # Looks like code: repeated instruction patterns and 32-bit addresses into the image
+    out = bytearray()
+    patterns = [bytes(rng.randrange(256) for _ in range(rng.randrange(2, 12))) for _ in range(200)]
+    while len(out) < size:
+        if rng.random() < 0.2:
+            out += struct.pack('<I', 0x42000000 + rng.randrange(size))
+        else:
+            out += rng.choice(patterns)
+    return bytearray(out[:size])
+
+
+def relocate(image, shift_at, shift):
+    # Insert shift bytes and fix up the addresses pointing after the insertion point
+    out = bytearray(image[:shift_at]) + bytearray(random.Random(shift).randbytes(shift)) + bytearray(image[shift_at:])
+    for k in range(0, len(out) - 3, 4):
+        value, = struct.unpack_from('<I', out, k)
+        if 0x42000000 + shift_at <= value < 0x42000000 + len(image):
+            struct.pack_into('<I', out, k, value + shift)
+    return out
+
+
+def selftest(block_size):
+    rng = random.Random(1)
+    old = synthetic_image(rng, 600 * 1024)
+    new = relocate(old, 200 * 1024, 1000)
+    new[400 * 1024:400 * 1024 + 5000] = bytes(rng.randrange(256) for _ in range(5000))
+    old, new = bytes(old), bytes(new)
+    partition = old + b'\xff' * (1024 * 1024 - len(old))
+
+    full = build_package(FORMAT_LZ4, new, new, b'', block_size)
+    assert apply_package(full, partition) == new
+    stream, stats = make_delta(old, new)
+    delta = build_package(FORMAT_DELTA, stream, new, old, block_size)
+    assert apply_package(delta, partition) == new
+    print('image %d bytes, lz4 package %d bytes, delta package %d bytes (%s)' % (len(new), len(full), len(delta), stats))
+
+    wrong = bytearray(partition)
+    wrong[100] ^= 1
+    try:
+        apply_package(delta, bytes(wrong))
+        raise AssertionError('delta applied to a different base')
+    except ValueError:
+        pass
+    corrupted = bytearray(delta)
+    corrupted[-10] ^= 0x55
+    try:
+        apply_package(bytes(corrupted), partition)
+        raise AssertionError('corrupted package accepted')
+    except (ValueError, IndexError, struct.error):
+        pass
+    print('selftest passed')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build compressed and delta OTA packages')
+    sub = parser.add_subparsers(dest='command', required=True)
+    p = sub.add_parser('pack')
+    p.add_argument('new')
+    p.add_argument('-o', '--output', required=True)
+    p = sub.add_parser('delta')
+    p.add_argument('old', help='image currently running on the devices')
+    p.add_argument('new')
+    p.add_argument('-o', '--output', required=True)
+    p = sub.add_parser('apply')
+    p.add_argument('package')
+    p.add_argument('--base', help='running image, required for delta packages')
+    p.add_argument('--partition-size', type=lambda x: int(x, 0), default=0x3f0000)
+    p.add_argument('-o', '--output', required=True)
+    sub.add_parser('selftest')
+    parser.add_argument('--block-size', type=int, default=32 * 1024)
+    args = parser.parse_args()
+
+    if not 0 < args.block_size <= MAX_BLOCK_SIZE:
+        sys.exit('block size must be at most %d' % MAX_BLOCK_SIZE)
+
+    if args.command == 'selftest':
+        selftest(args.block_size)
+        return
+
+    if args.command == 'apply':
+        package = open(args.package, 'rb').read()
+        base = open(args.base, 'rb').read() if args.base else b''
+        partition = base + b'\xff' * max(0, args.partition_size - len(base))
+        image = apply_package(package, partition)
+        open(args.output, 'wb').write(image)
+        print('%s: %d bytes, SHA-256 %s' % (args.output, len(image), hashlib.sha256(image).hexdigest()))
+        return
+
+    new = open(args.new, 'rb').read()
+    if args.command == 'pack':
+        package = build_package(FORMAT_LZ4, new, new, b'', args.block_size)
+    else:
+        old = open(args.old, 'rb').read()
+        stream, stats = make_delta(old, new)
+        package = build_package(FORMAT_DELTA, stream, new, old, args.block_size)
+        print('copy %(copy)d, add %(add)d, insert %(insert)d bytes' % stats)
+    open(args.output, 'wb').write(package)
+    print('%s: %d -> %d bytes (%.1f%%)' % (args.output, len(new), len(package), len(package) * 100 / len(new)))
+
+
+if __name__ == '__main__':
+    main()
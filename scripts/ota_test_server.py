@@ -0,0 +1,139 @@
+import argparse
+import hashlib
+import json
+import os
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+'''
+  Local OTA server for measuring firmware download throughput and testing resume.
+
+  Point the device OTA URL at http://<host>:<port>/ota/ (Settings "wifi" / "ota_url" or
+  CONFIG_OTA_URL). The check version request is answered with a forced firmware entry
+  pointing to --firmware, including its SHA-256. The firmware is served with HTTP Range
+  support; every transfer prints its size and throughput.
+
+    --rate        limit the send rate in bytes/s, to emulate a slow link
+    --drop-after  close the connection after N bytes of the first transfer, the device
+                  must resume with a Range request
+    --no-range    ignore Range headers, the device must skip what it already has
+'''
+
+
+class OtaHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        pass
+
+    def do_GET(self):
+        if self.path.startswith('/ota'):
+            self.send_version()
+        elif self.path == '/firmware.bin':
+            self.send_firmware()
+        else:
+            self.send_error(404)
+
+    def do_POST(self):
+        length = int(self.headers.get('Content-Length', 0))
+        self.rfile.read(length)
+        self.send_version()
+
+    def send_version(self):
+        server = self.server
+        host = self.headers.get('Host', '%s:%d' % server.server_address[:2])
+        body = json.dumps({
+            'server_time': {'timestamp': int(time.time() * 1000), 'timezone_offset': 0},
+            'firmware': {
+                'version': server.version,
+                'url': 'http://%s/firmware.bin' % host,
+                'sha256': server.sha256,
+                'force': 1,
+            },
+        }).encode()
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+        print('[%s] check version -> %s' % (self.client_address[0], server.version))
+
+    def send_firmware(self):
+        server = self.server
+        size = len(server.firmware)
+        start = 0
+        range_header = self.headers.get('Range')
+        if range_header and not server.no_range and range_header.startswith('bytes='):
+            start = int(range_header[6:].split('-')[0])
+            if start >= size:
+                self.send_error(416)
+                return
+            self.send_response(206)
+            self.send_header('Content-Range', 'bytes %d-%d/%d' % (start, size - 1, size))
+        else:
+            self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(size - start))
+        self.end_headers()
+
+        with server.lock:
+            drop_after = server.drop_after
+            server.drop_after = 0
+        sent = 0
+        chunk = 4096
+        begin = time.monotonic()
+        try:
+            while start + sent < size:
+                if drop_after and sent >= drop_after:
+                    print('[%s] dropping connection after %d bytes' % (self.client_address[0], sent))
+                    self.close_connection = True
+                    return
+                data = server.firmware[start + sent:start + sent + chunk]
+                self.wfile.write(data)
+                sent += len(data)
+                if server.rate:
+                    delay = begin + sent / server.rate - time.monotonic()
+                    if delay > 0:
+                        time.sleep(delay)
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+        finally:
+            elapsed = max(time.monotonic() - begin, 1e-6)
+            print('[%s] %s bytes %d-%d: %d bytes in %.2fs, %.1f KB/s' % (
+                self.client_address[0], 'range' if start else 'full', start, start + sent, sent,
+                elapsed, sent / elapsed / 1024))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local OTA server with Range support')
+    parser.add_argument('firmware', help='application image, e.g. build/xiaozhi.bin')
+    parser.add_argument('--version', default='99.0.0', help='version reported to the device')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--rate', type=int, default=0, help='send rate limit in bytes/s, 0 = unlimited')
+    parser.add_argument('--drop-after', type=int, default=0, help='drop the first transfer after N bytes')
+    parser.add_argument('--no-range', action='store_true', help='ignore Range requests')
+    args = parser.parse_args()
+
+    with open(args.firmware, 'rb') as f:
+        firmware = f.read()
+
+    server = ThreadingHTTPServer(('0.0.0.0', args.port), OtaHandler)
+    server.firmware = firmware
+    server.sha256 = hashlib.sha256(firmware).hexdigest()
+    server.version = args.version
+    server.rate = args.rate
+    server.drop_after = args.drop_after
+    server.no_range = args.no_range
+    server.lock = threading.Lock()
+    print('Serving %s (%d bytes, sha256 %s) on port %d' % (
+        os.path.basename(args.firmware), len(firmware), server.sha256, args.port))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
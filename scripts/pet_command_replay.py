@@ -0,0 +1,139 @@
+import argparse
+import re
+import subprocess
+import sys
+import threading
+import time
+
+
+'''
+  Replay recorded command words to the xiaozhi-pet board and measure command-to-motion latency.
+
+  Every WAV is played through the host speaker (--player) next to the microphone while the
+  serial log is read. For each replay the script waits for
+
+    I (..) CustomWakeWord: Local command detected: qian jin
+    I (..) PetController: Received action command: 4, latency: 0 ms
+
+  and reports two numbers:
+    device  detection -> pet task starts the action, measured on the device (budget: --budget-ms)
+    e2e     end of playback on the host -> action log line received, includes MultiNet endpointing
+
+  --log replays a captured serial log instead of a live board, only the device latency is checked.
+'''
+COMMAND_RE = re.compile(r'Local command detected: (.+)$')
+ACTION_RE = re.compile(r'Received action command: (\d+), latency: (\d+) ms')
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(round(p / 100 * (len(values) - 1))))]
+
+
+class LogReader:
+    '''Collect (host_time, command, action, device_latency_ms) from log lines'''
+
+    def __init__(self):
+        self.events = []
+        self.pending_command = None
+        self.condition = threading.Condition()
+
+    def feed(self, line, host_time):
+        match = COMMAND_RE.search(line)
+        if match:
+            self.pending_command = match.group(1).strip()
+            return
+        match = ACTION_RE.search(line)
+        if match and self.pending_command is not None:
+            with self.condition:
+                self.events.append((host_time, self.pending_command, int(match.group(1)), int(match.group(2))))
+                self.pending_command = None
+                self.condition.notify_all()
+
+    def wait_event(self, index, timeout):
+        with self.condition:
+            self.condition.wait_for(lambda: len(self.events) > index, timeout)
+            return self.events[index] if len(self.events) > index else None
+
+
+def read_serial(port, baudrate, reader, stop):
+    import serial  # pip install pyserial
+    with serial.Serial(port, baudrate, timeout=0.1) as ser:
+        buffer = b''
+        while not stop.is_set():
+            buffer += ser.read(256)
+            while b'\n' in buffer:
+                line, buffer = buffer.split(b'\n', 1)
+                reader.feed(line.decode('utf-8', errors='replace').rstrip(), time.monotonic())
+
+
+def report(device, e2e, budget_ms, failed):
+    print(f"\nreplays: {len(device)}, not recognized: {failed}")
+    if device:
+        print(f"device (ms): p50={percentile(device, 50)} p95={percentile(device, 95)} max={max(device)}")
+    if e2e:
+        print(f"e2e    (ms): p50={percentile(e2e, 50)} p95={percentile(e2e, 95)} max={max(e2e)}")
+    ok = bool(device) and max(device) <= budget_ms
+    print(f"command-to-motion budget {budget_ms} ms: {'PASS' if ok else 'FAIL'}")
+    return 0 if ok else 1
+
+
+def replay_log(path, budget_ms):
+    reader = LogReader()
+    with open(path, encoding='utf-8', errors='replace') as log:
+        for line in log:
+            reader.feed(line.rstrip(), 0)
+    for _, command, action, latency in reader.events:
+        print(f"{command:<16} action={action:<3} device={latency} ms")
+    return report([e[3] for e in reader.events], [], budget_ms, 0)
+
+
+def replay_live(args):
+    reader = LogReader()
+    stop = threading.Event()
+    thread = threading.Thread(target=read_serial, args=(args.port, args.baudrate, reader, stop), daemon=True)
+    thread.start()
+    time.sleep(1)
+
+    device, e2e, failed = [], [], 0
+    for _ in range(args.repeat):
+        for wav in args.wav:
+            index = len(reader.events)
+            subprocess.run(args.player.split() + [wav], check=True)
+            end_of_playback = time.monotonic()
+            event = reader.wait_event(index, args.timeout)
+            if event is None:
+                print(f"{wav:<24} not recognized")
+                failed += 1
+            else:
+                host_time, command, action, latency = event
+                device.append(latency)
+                e2e.append(int((host_time - end_of_playback) * 1000))
+                print(f"{wav:<24} {command:<16} action={action:<3} device={latency} ms e2e={e2e[-1]} ms")
+            # 等待动作和提示音结束，避免下一条录音被打断
+            time.sleep(args.interval)
+
+    stop.set()
+    return report(device, e2e, args.budget_ms, failed)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='回放命令词录音，测量桌面宠物本地命令词到动作的延迟')
+    parser.add_argument('wav', nargs='*', help='命令词录音 (WAV)')
+    parser.add_argument('--port', '-p', type=str, default='/dev/ttyUSB0', help='串口 (默认: /dev/ttyUSB0)')
+    parser.add_argument('--baudrate', '-b', type=int, default=115200, help='波特率 (默认: 115200)')
+    parser.add_argument('--player', type=str, default='aplay -q', help='播放命令 (默认: aplay -q, macOS 用 afplay)')
+    parser.add_argument('--repeat', '-r', type=int, default=3, help='每条录音重复次数 (默认: 3)')
+    parser.add_argument('--interval', type=float, default=2.0, help='两次回放间隔秒数 (默认: 2)')
+    parser.add_argument('--timeout', type=float, default=3.0, help='等待识别结果的秒数 (默认: 3)')
+    parser.add_argument('--budget-ms', type=int, default=100, help='识别到动作的延迟上限 (默认: 100)')
+    parser.add_argument('--log', type=str, help='分析已保存的串口日志而不是实时回放')
+
+    args = parser.parse_args()
+    if args.log:
+        sys.exit(replay_log(args.log, args.budget_ms))
+    if not args.wav:
+        parser.error('no WAV files given')
+    sys.exit(replay_live(args))
@@ -0,0 +1,247 @@
+import argparse
+import json
+import os
+import struct
+import sys
+import time
+from bisect import bisect_right
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+'''
+  Receive and convert the binary scheduling trace of the trace recorder (main/trace_recorder.h).
+
+    receive   run a HTTP server for self.diagnostics.upload_trace, every upload is saved as
+              trace-<time>.bin and converted to trace-<time>.json
+    convert   convert a dump to Chrome / Perfetto trace JSON (open it in ui.perfetto.dev)
+    summary   print the CPU time and the longest uninterrupted slice of every task
+
+  In the trace, every core is a track showing the running task, the "Device" process has the
+  device state, the audio queue depths and the servo angles.
+'''
+
+TRACE_HEADER = struct.Struct('<4sBBHIII12x')
+TRACE_TASK = struct.Struct('<I16s')
+TRACE_EVENT = struct.Struct('<IBBHII')
+
+TRACE_TASK_SWITCH = 1
+TRACE_DEVICE_STATE = 2
+TRACE_AUDIO_QUEUES = 3
+TRACE_SERVO = 4
+TRACE_SYNC = 5
+
+DEFAULT_CPU_MHZ = 240
+DEVICE_PID = 100
+
+# Same order as DeviceState in main/device_state.h
+DEVICE_STATES = ['unknown', 'starting', 'configuring', 'idle', 'connecting', 'listening', 'speaking',
+                 'upgrading', 'activating', 'audio_testing', 'fatal_error']
+AUDIO_QUEUES = ['decode', 'encode', 'send', 'playback']
+SERVOS = ['left_front', 'right_front', 'left_back', 'right_back']
+
+
+class Trace:
+    def __init__(self, data):
+        magic, version, flags, event_size, count, dropped, task_count = TRACE_HEADER.unpack_from(data, 0)
+        if magic != b'XZTR' or version != 1 or event_size != TRACE_EVENT.size:
+            raise ValueError('not a trace dump')
+        self.previous_boot = bool(flags & 1)
+        self.dropped = dropped
+        offset = TRACE_HEADER.size
+
+        self.tasks = {}
+        for _ in range(task_count):
+            handle, name = TRACE_TASK.unpack_from(data, offset)
+            self.tasks[handle] = name.split(b'\0', 1)[0].decode(errors='replace')
+            offset += TRACE_TASK.size
+
+        count = min(count, (len(data) - offset) // TRACE_EVENT.size)
+        self.events = []
+        last_cycles = {}
+        wraps = {}
+        for i in range(count):
+            cycles, kind, core, id, value, extra = TRACE_EVENT.unpack_from(data, offset + i * TRACE_EVENT.size)
+            if kind < TRACE_TASK_SWITCH or kind > TRACE_SYNC or core > 1:
+                continue  # Torn write at the moment of a crash
+            # The cycle counter wraps every ~18s, small steps back are events that were
+            # interrupted between taking a slot and reading the counter
+            last = last_cycles.get(core)
+            if last is not None and last - cycles > 0x80000000:
+                wraps[core] = wraps.get(core, 0) + 1
+            last_cycles[core] = cycles
+            self.events.append((core, (wraps.get(core, 0) << 32) + cycles, kind, id, value, extra))
+
+        # Map cycles to esp_timer time per core, piecewise linear between the sync events
+        self.sync = {}
+        for core, cycles, kind, id, value, extra in self.events:
+            if kind == TRACE_SYNC:
+                self.sync.setdefault(core, []).append((cycles, (extra << 32) | value))
+        self.start_us = min((self.time_us(e[0], e[1]) for e in self.events), default=0)
+
+    def time_us(self, core, cycles):
+        points = self.sync.get(core)
+        if not points:
+            return cycles / DEFAULT_CPU_MHZ
+        if len(points) == 1:
+            return points[0][1] + (cycles - points[0][0]) / DEFAULT_CPU_MHZ
+        i = min(max(bisect_right(points, (cycles, float('inf'))) - 1, 0), len(points) - 2)
+        (c0, t0), (c1, t1) = points[i], points[i + 1]
+        if c1 == c0:
+            return t0
+        return t0 + (cycles - c0) * (t1 - t0) / (c1 - c0)
+
+    def timed_events(self):
+        events = [(round(self.time_us(e[0], e[1]) - self.start_us, 3),) + e for e in self.events]
+        events.sort(key=lambda e: e[0])
+        return events
+
+    def task_name(self, handle):
+        return self.tasks.get(handle, '0x%08x' % handle)
+
+    def slices(self):
+        '''(core, task, start_us, end_us) of every task run'''
+        current = {}
+        result = []
+        events = self.timed_events()
+        for ts, core, _, kind, _, value, _ in events:
+            if kind != TRACE_TASK_SWITCH:
+                continue
+            if core in current:
+                task, start = current[core]
+                result.append((core, task, start, ts))
+            current[core] = (self.task_name(value), ts)
+        end = events[-1][0] if events else 0
+        for core, (task, start) in current.items():
+            result.append((core, task, start, end))
+        return result
+
+
+def convert(trace):
+    out = []
+    for core in (0, 1):
+        out.append({'ph': 'M', 'name': 'process_name', 'pid': core, 'args': {'name': 'Core %d' % core}})
+        out.append({'ph': 'M', 'name': 'thread_name', 'pid': core, 'tid': core, 'args': {'name': 'tasks'}})
+    out.append({'ph': 'M', 'name': 'process_name', 'pid': DEVICE_PID, 'args': {'name': 'Device'}})
+    out.append({'ph': 'M', 'name': 'thread_name', 'pid': DEVICE_PID, 'tid': 1, 'args': {'name': 'state'}})
+
+    for core, task, start, end in trace.slices():
+        out.append({'ph': 'X', 'name': task, 'pid': core, 'tid': core, 'ts': start, 'dur': max(end - start, 0)})
+
+    events = trace.timed_events()
+    state = None
+    for ts, core, _, kind, id, value, _ in events:
+        if kind == TRACE_DEVICE_STATE:
+            if state is not None:
+                out.append({'ph': 'X', 'name': state[0], 'pid': DEVICE_PID, 'tid': 1, 'ts': state[1], 'dur': ts - state[1]})
+            name = DEVICE_STATES[value] if value < len(DEVICE_STATES) else str(value)
+            state = (name, ts)
+        elif kind == TRACE_AUDIO_QUEUES:
+            depths = {name: (value >> (8 * i)) & 0xFF for i, name in enumerate(AUDIO_QUEUES)}
+            out.append({'ph': 'C', 'name': 'audio_queues', 'pid': DEVICE_PID, 'ts': ts, 'args': depths})
+        elif kind == TRACE_SERVO:
+            name = SERVOS[id] if id < len(SERVOS) else 'servo%d' % id
+            out.append({'ph': 'C', 'name': 'servo_' + name, 'pid': DEVICE_PID, 'ts': ts, 'args': {'angle': value}})
+    if state is not None and events:
+        out.append({'ph': 'X', 'name': state[0], 'pid': DEVICE_PID, 'tid': 1, 'ts': state[1],
+                    'dur': events[-1][0] - state[1]})
+
+    return {
+        'traceEvents': out,
+        'displayTimeUnit': 'ms',
+        'metadata': {'previous_boot': trace.previous_boot, 'dropped': trace.dropped},
+    }
+
+
+def summary(trace):
+    slices = trace.slices()
+    if not slices:
+        print('Empty trace')
+        return
+    duration = max(s[3] for s in slices) - min(s[2] for s in slices)
+    print('%d events over %.1f ms, %d dropped%s' % (len(trace.events), duration / 1000, trace.dropped,
+                                                    ', from the boot before a crash' if trace.previous_boot else ''))
+    stats = {}
+    for core, task, start, end in slices:
+        total, longest, runs = stats.get((core, task), (0, 0, 0))
+        stats[(core, task)] = (total + end - start, max(longest, end - start), runs + 1)
+    print('%-4s %-16s %10s %6s %12s %8s' % ('core', 'task', 'cpu ms', 'cpu %', 'longest ms', 'runs'))
+    for (core, task), (total, longest, runs) in sorted(stats.items(), key=lambda item: -item[1][0]):
+        share = total * 100 / duration if duration else 0
+        print('%-4d %-16s %10.1f %6.1f %12.2f %8d' % (core, task, total / 1000, share, longest / 1000, runs))
+
+
+def convert_file(path, output=None):
+    with open(path, 'rb') as f:
+        trace = Trace(f.read())
+    output = output or os.path.splitext(path)[0] + '.json'
+    with open(output, 'w') as f:
+        json.dump(convert(trace), f)
+    print('Wrote %s (%d events)' % (output, len(trace.events)))
+    return trace
+
+
+class TraceHandler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def log_message(self, format, *args):
+        pass
+
+    def read_body(self):
+        if self.headers.get('Transfer-Encoding', '').lower() != 'chunked':
+            return self.rfile.read(int(self.headers.get('Content-Length', 0)))
+        body = bytearray()
+        while True:
+            size = int(self.rfile.readline().split(b';', 1)[0].strip(), 16)
+            if size == 0:
+                self.rfile.readline()
+                return bytes(body)
+            body += self.rfile.read(size)
+            self.rfile.readline()
+
+    def do_POST(self):
+        data = self.read_body()
+        path = os.path.join(self.server.output_dir, time.strftime('trace-%Y%m%d-%H%M%S.bin'))
+        with open(path, 'wb') as f:
+            f.write(data)
+        print('Received %d bytes from %s (%s)' % (len(data), self.client_address[0], self.headers.get('Device-Id')))
+        try:
+            summary(convert_file(path))
+            status, reply = 200, b'{"success":true}'
+        except (ValueError, struct.error) as e:
+            print('Invalid trace: %s' % e)
+            status, reply = 400, b'{"success":false}'
+        self.send_response(status)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(reply)))
+        self.end_headers()
+        self.wfile.write(reply)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Receive and convert trace recorder dumps')
+    commands = parser.add_subparsers(dest='command', required=True)
+    receive = commands.add_parser('receive')
+    receive.add_argument('--port', type=int, default=8090)
+    receive.add_argument('--output-dir', default='.')
+    convert_parser = commands.add_parser('convert')
+    convert_parser.add_argument('dump')
+    convert_parser.add_argument('-o', '--output')
+    summary_parser = commands.add_parser('summary')
+    summary_parser.add_argument('dump')
+    args = parser.parse_args()
+
+    if args.command == 'receive':
+        server = ThreadingHTTPServer(('0.0.0.0', args.port), TraceHandler)
+        server.output_dir = args.output_dir
+        print('Waiting for traces on port %d, upload with self.diagnostics.upload_trace url=http://<host>:%d/trace'
+              % (args.port, args.port))
+        server.serve_forever()
+    elif args.command == 'convert':
+        convert_file(args.dump, args.output)
+    else:
+        with open(args.dump, 'rb') as f:
+            summary(Trace(f.read()))
+
+
+if __name__ == '__main__':
+    sys.exit(main())